@@ -124,6 +124,7 @@ namespace nscapi {
 		typedef NSCAPI::log_level::level(*lpNSAPIGetLoglevel)();
 		typedef NSCAPI::errorReturn(*lpNSAPISettingsQuery)(const char *, const unsigned int, char **, unsigned int *);
 		typedef NSCAPI::errorReturn(*lpNSAPIRegistryQuery)(const char *, const unsigned int, char **, unsigned int *);
+		typedef NSCAPI::errorReturn(*lpNSAPIFetchMetrics)(char **, unsigned int *);
 		typedef NSCAPI::errorReturn(*lpNSCAPIJson2Protobuf)(const char *, const unsigned int, char **, unsigned int *);
 		typedef NSCAPI::errorReturn(*lpNSCAPIProtobuf2Json)(const char *, const char *, const unsigned int, char **, unsigned int *);
 
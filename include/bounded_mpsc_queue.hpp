@@ -0,0 +1,137 @@
+/*
+ * Copyright 2004-2016 The NSClient++ Authors - https://nsclient.org
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <cstddef>
+
+#include <boost/atomic.hpp>
+#include <boost/noncopyable.hpp>
+
+/**
+ * Bounded lock-free queue for many producers and a single consumer.
+ * Every cell carries a sequence number which tells producers and the consumer
+ * whether the cell is free or holds data for the current lap (D. Vyukov's bounded queue).
+ * The capacity is rounded up to a power of two.
+ */
+template<typename T>
+class bounded_mpsc_queue : boost::noncopyable {
+	struct cell {
+		boost::atomic<std::size_t> sequence;
+		T data;
+	};
+	cell *cells_;
+	std::size_t size_;
+	std::size_t mask_;
+	char pad1_[64];
+	boost::atomic<std::size_t> enqueue_pos_;
+	char pad2_[64];
+	boost::atomic<std::size_t> dequeue_pos_;
+
+public:
+	bounded_mpsc_queue(std::size_t capacity) : size_(round_up(capacity)), mask_(size_ - 1), enqueue_pos_(0), dequeue_pos_(0) {
+		cells_ = new cell[size_];
+		for (std::size_t i = 0; i < size_; i++)
+			cells_[i].sequence.store(i, boost::memory_order_relaxed);
+	}
+	~bounded_mpsc_queue() {
+		delete[] cells_;
+	}
+
+	std::size_t capacity() const {
+		return size_;
+	}
+
+	// Approximate number of queued items (exact when called from the consumer with no producers active)
+	std::size_t size() const {
+		std::size_t tail = dequeue_pos_.load(boost::memory_order_relaxed);
+		std::size_t head = enqueue_pos_.load(boost::memory_order_relaxed);
+		return head >= tail ? head - tail : 0;
+	}
+
+	bool empty() const {
+		return size() == 0;
+	}
+
+	/**
+	 * Add an item, returns false if the queue is full.
+	 * Safe to call from any number of threads.
+	 */
+	bool try_push(const T &value) {
+		cell *c;
+		std::size_t pos = enqueue_pos_.load(boost::memory_order_relaxed);
+		for (;;) {
+			c = &cells_[pos & mask_];
+			std::size_t seq = c->sequence.load(boost::memory_order_acquire);
+			std::ptrdiff_t diff = static_cast<std::ptrdiff_t>(seq) - static_cast<std::ptrdiff_t>(pos);
+			if (diff == 0) {
+				if (enqueue_pos_.compare_exchange_weak(pos, pos + 1, boost::memory_order_relaxed))
+					break;
+			} else if (diff < 0) {
+				return false;
+			} else {
+				pos = enqueue_pos_.load(boost::memory_order_relaxed);
+			}
+		}
+		c->data = value;
+		c->sequence.store(pos + 1, boost::memory_order_release);
+		return true;
+	}
+
+	/**
+	 * Remove the oldest item, returns false if the queue is empty.
+	 * Must only be called from the consumer thread.
+	 */
+	bool try_pop(T &value) {
+		std::size_t pos = dequeue_pos_.load(boost::memory_order_relaxed);
+		cell *c = &cells_[pos & mask_];
+		if (c->sequence.load(boost::memory_order_acquire) != pos + 1)
+			return false;
+		swap_out(c->data, value);
+		c->sequence.store(pos + mask_ + 1, boost::memory_order_release);
+		dequeue_pos_.store(pos + 1, boost::memory_order_relaxed);
+		return true;
+	}
+
+	/**
+	 * Move up to max items to the end of target, returns the number of items moved.
+	 * Must only be called from the consumer thread.
+	 */
+	template<class TContainer>
+	std::size_t drain(TContainer &target, std::size_t max) {
+		std::size_t count = 0;
+		T value;
+		while (count < max && try_pop(value)) {
+			target.push_back(T());
+			swap_out(value, target.back());
+			count++;
+		}
+		return count;
+	}
+
+private:
+	static std::size_t round_up(std::size_t capacity) {
+		std::size_t size = 2;
+		while (size < capacity)
+			size <<= 1;
+		return size;
+	}
+	static void swap_out(T &from, T &to) {
+		using std::swap;
+		swap(from, to);
+		from = T();
+	}
+};
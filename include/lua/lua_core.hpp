@@ -35,6 +35,7 @@ extern "C" {
 #include <strEx.h>
 #include <scripts/script_interface.hpp>
 #include <lua/lua_script.hpp>
+#include <lua/lua_state_pool.hpp>
 
 namespace lua {
 	typedef scripts::script_information<lua_traits> script_information;
@@ -48,8 +49,11 @@ namespace lua {
 	struct lua_runtime : public scripts::script_runtime_interface<lua::lua_traits> {
 		std::string base_path;
 		std::list<lua_runtime_plugin_type> plugins;
+		// Number of pooled states loaded up front and the number of states a script can grow to (0 disables pooling).
+		std::size_t pool_size;
+		std::size_t max_pool_size;
 
-		lua_runtime(std::string base_path) : base_path(base_path) {}
+		lua_runtime(std::string base_path) : base_path(base_path), pool_size(0), max_pool_size(0) {}
 
 		virtual void register_query(const std::string &command, const std::string &description);
 		virtual void register_subscription(const std::string &channel, const std::string &description);
@@ -67,7 +71,9 @@ namespace lua {
 		}
 
 		static lua_State * prep_function(const lua::script_information *information, const lua::lua_traits::function_type &c) {
-			lua_State *L = information->user_data.L;
+			return prep_function(information->user_data.L, c);
+		}
+		static lua_State * prep_function(lua_State *L, const lua::lua_traits::function_type &c) {
 			lua_rawgeti(L, LUA_REGISTRYINDEX, c.function_ref);
 			if (c.object_ref != 0)
 				lua_rawgeti(L, LUA_REGISTRYINDEX, c.object_ref);
@@ -79,5 +85,11 @@ namespace lua {
 			return L;
 		}
 		void create_user_data(script_information* info);
+
+	private:
+		void load_script(script_information *info, lua_State *L);
+		void load_state(script_information *info, pooled_state &state);
+		void unload_state(pooled_state &state);
+		void run_query(lua_State *L, const std::string &command, const lua::lua_traits::function_type &function, bool simple, const Plugin::QueryRequestMessage::Request &request, Plugin::QueryResponseMessage::Response *response, const Plugin::QueryRequestMessage &request_message);
 	};
 }
\ No newline at end of file
@@ -20,6 +20,8 @@
 
 #include <boost/filesystem.hpp>
 #include <boost/optional.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/mutex.hpp>
 
 extern "C" {
 #include <lua.h>
@@ -34,12 +36,20 @@ extern "C" {
 #include <scripts/script_interface.hpp>
 
 namespace lua {
+	class lua_state_pool;
+	struct pooled_state;
+
 	struct lua_traits {
 		static const std::string user_data_tag;
+		static const std::string pooled_state_tag;
 
 		struct user_data_type {
 			std::string base_path_;
+			// The main state: loaded first, registers the commands and runs everything which is not a query.
 			Lua_State L;
+			boost::mutex mutex;
+			// Additional states used to run queries concurrently (empty if pooling is disabled).
+			boost::shared_ptr<lua_state_pool> pool;
 		};
 
 		struct function {
@@ -86,6 +96,7 @@ namespace lua {
 	struct registry_wrapper {
 	private:
 		script_information *info;
+		pooled_state *state;
 	public:
 		registry_wrapper(lua_State *L, bool fromLua);
 
@@ -101,6 +112,8 @@ namespace lua {
 		int register_simple_cmdline(lua_State *L);
 		int subscription(lua_State *L);
 		int simple_subscription(lua_State *L);
+	private:
+		void add_command(const std::string &type, const std::string &command, const std::string &description, const lua::lua_traits::function &function);
 		//	private:
 		//		boost::shared_ptr<regitration_provider> get();
 	};
@@ -0,0 +1,148 @@
+/*
+ * Copyright 2004-2016 The NSClient++ Authors - https://nsclient.org
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <map>
+#include <list>
+#include <string>
+
+#include <boost/function.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
+
+#include <lua/lua_cpp.hpp>
+#include <lua/lua_script.hpp>
+
+namespace lua {
+
+	/**
+	 * A lua state owned by a pool.
+	 * Each state has loaded the script on its own so function references are only valid
+	 * within the state which registered them.
+	 */
+	struct pooled_state : public boost::noncopyable {
+		typedef std::map<std::string, lua_traits::function_type> function_map;
+
+		Lua_State L;
+		function_map functions;
+
+		void add_function(const std::string &type, const std::string &command, const lua_traits::function_type &function) {
+			functions[type + "$$" + command] = function;
+		}
+		const lua_traits::function_type* find_function(const std::string &type, const std::string &command) const {
+			function_map::const_iterator it = functions.find(type + "$$" + command);
+			if (it == functions.end())
+				return NULL;
+			return &it->second;
+		}
+	};
+
+	/**
+	 * Pool of pre-loaded lua states for a single script.
+	 * A lua_State can only be used by one thread at a time, the pool hands out states to
+	 * concurrent callers and creates new ones (up to max_size) when all are busy.
+	 * When the pool is at max_size callers wait for a state to be released.
+	 */
+	class lua_state_pool : public boost::noncopyable {
+	public:
+		typedef boost::function<void(pooled_state&)> loader_type;
+
+		struct pool_metrics {
+			std::size_t size;
+			std::size_t idle;
+			unsigned long long hits;
+			unsigned long long misses;
+			unsigned long long created;
+			unsigned long long waits;
+			unsigned long long wait_total_us;
+			unsigned long long wait_max_us;
+			pool_metrics() : size(0), idle(0), hits(0), misses(0), created(0), waits(0), wait_total_us(0), wait_max_us(0) {}
+		};
+
+		/**
+		 * Holds a state for the duration of a call and returns it to the pool when done.
+		 */
+		class lease : public boost::noncopyable {
+			lua_state_pool &pool_;
+			pooled_state *state_;
+			std::string error_;
+		public:
+			lease(lua_state_pool &pool) : pool_(pool), state_(NULL) {
+				try {
+					state_ = pool_.acquire();
+				} catch (const std::exception &e) {
+					error_ = e.what();
+				}
+			}
+			~lease() {
+				if (state_ != NULL)
+					pool_.release(state_);
+			}
+			operator bool() const {
+				return state_ != NULL;
+			}
+			pooled_state* operator->() const {
+				return state_;
+			}
+			pooled_state& operator*() const {
+				return *state_;
+			}
+			const std::string& get_error() const {
+				return error_;
+			}
+		};
+
+	private:
+		boost::mutex mutex_;
+		boost::condition_variable cond_;
+		std::list<pooled_state*> idle_;
+		std::size_t size_;
+		std::size_t max_size_;
+		bool closed_;
+		loader_type loader_;
+		loader_type unloader_;
+		pool_metrics metrics_;
+
+	public:
+		lua_state_pool(loader_type loader, loader_type unloader, std::size_t max_size);
+		~lua_state_pool();
+
+		/**
+		 * Load states until the pool holds count (or max_size) states.
+		 * Throws if the script fails to load.
+		 */
+		void prefill(std::size_t count);
+
+		/**
+		 * Get a state, creating one if none is idle and the pool is not full, otherwise wait for one.
+		 * Throws if a new state could not be loaded or the pool has been closed.
+		 */
+		pooled_state* acquire();
+		void release(pooled_state *state);
+
+		/**
+		 * Wait for all states to be returned and unload them. The pool cannot be used afterwards.
+		 */
+		void close();
+
+		pool_metrics get_metrics();
+
+	private:
+		pooled_state* create();
+	};
+}
@@ -0,0 +1,142 @@
+/*
+ * Copyright 2004-2016 The NSClient++ Authors - https://nsclient.org
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <metrics/metrics_prometheus.hpp>
+
+#include <cstdio>
+#include <clocale>
+
+#include <boost/foreach.hpp>
+#include <strEx.h>
+
+namespace metrics {
+
+	// Write to the stream once this much has been buffered
+	static const std::size_t flush_size = 16 * 1024;
+
+	prometheus_writer::prometheus_writer(std::ostream &out, const std::string &prefix) : out_(out), samples_(0) {
+		append_name(prefix_, prefix);
+		buffer_.reserve(flush_size + 512);
+	}
+	prometheus_writer::~prometheus_writer() {
+		flush();
+	}
+
+	void prometheus_writer::write(const Plugin::MetricsMessage &message) {
+		BOOST_FOREACH(const Plugin::MetricsMessage::Response &p, message.payload()) {
+			BOOST_FOREACH(const Plugin::Common::MetricsBundle &b, p.bundles()) {
+				write(b);
+			}
+		}
+	}
+	void prometheus_writer::write(const Plugin::Common::MetricsBundle &bundle) {
+		write(prefix_, bundle);
+	}
+	void prometheus_writer::flush() {
+		if (buffer_.empty())
+			return;
+		out_.write(buffer_.data(), buffer_.size());
+		buffer_.clear();
+	}
+
+	void prometheus_writer::write(const std::string &parent, const Plugin::Common::MetricsBundle &bundle) {
+		std::string path = parent;
+		if (!path.empty())
+			path += '_';
+		append_name(path, bundle.key());
+		BOOST_FOREACH(const Plugin::Common::Metric &v, bundle.value()) {
+			write_sample(path, v);
+		}
+		BOOST_FOREACH(const Plugin::Common::MetricsBundle &b, bundle.children()) {
+			write(path, b);
+		}
+	}
+
+	void prometheus_writer::write_sample(const std::string &path, const Plugin::Common::Metric &metric) {
+		const Plugin::Common::AnyDataType &value = metric.value();
+		if (!value.has_int_data() && !value.has_float_data() && !value.has_string_data())
+			return;
+		buffer_ += path;
+		buffer_ += '_';
+		append_name(buffer_, metric.key());
+		if (value.has_int_data()) {
+			buffer_ += ' ';
+			buffer_ += strEx::s::xtos(value.int_data());
+		} else if (value.has_float_data()) {
+			buffer_ += ' ';
+			append_double(buffer_, value.float_data());
+		} else {
+			buffer_ += "_info{value=\"";
+			append_label_value(buffer_, value.string_data());
+			buffer_ += "\"} 1";
+		}
+		buffer_ += '\n';
+		samples_++;
+		if (buffer_.size() >= flush_size)
+			flush();
+	}
+
+	void prometheus_writer::append_name(std::string &buffer, const std::string &name) {
+		// Metric names: [a-zA-Z_:][a-zA-Z0-9_:]* (the first character is always preceded by the prefix except for the prefix itself)
+		if (buffer.empty() && !name.empty() && name[0] >= '0' && name[0] <= '9')
+			buffer += '_';
+		BOOST_FOREACH(char c, name) {
+			if ((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_' || c == ':')
+				buffer += c;
+			else
+				buffer += '_';
+		}
+	}
+
+	void prometheus_writer::append_label_value(std::string &buffer, const std::string &value) {
+		BOOST_FOREACH(char c, value) {
+			if (c == '\\')
+				buffer += "\\\\";
+			else if (c == '"')
+				buffer += "\\\"";
+			else if (c == '\n')
+				buffer += "\\n";
+			else
+				buffer += c;
+		}
+	}
+
+	void prometheus_writer::append_double(std::string &buffer, double value) {
+		if (value != value) {
+			buffer += "NaN";
+			return;
+		}
+		if (value > 0 && value * 0.5 == value) {
+			buffer += "+Inf";
+			return;
+		}
+		if (value < 0 && value * 0.5 == value) {
+			buffer += "-Inf";
+			return;
+		}
+		// %.15g is at most 22 characters ("-1.23456789012345e-308")
+		char tmp[40];
+		int len = std::sprintf(tmp, "%.15g", value);
+		const char *dp = std::localeconv()->decimal_point;
+		if (dp != NULL && dp[0] != '.' && dp[0] != '\0') {
+			for (int i = 0; i < len; i++) {
+				if (tmp[i] == dp[0])
+					tmp[i] = '.';
+			}
+		}
+		buffer.append(tmp, len);
+	}
+}
@@ -0,0 +1,57 @@
+/*
+ * Copyright 2004-2016 The NSClient++ Authors - https://nsclient.org
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <string>
+#include <ostream>
+#include <nscapi/nscapi_protobuf.hpp>
+
+namespace metrics {
+
+	/**
+	 * Writes metrics in the Prometheus text exposition format (version 0.0.4).
+	 *
+	 * The bundle tree is walked depth first and every value is written as soon as it is reached,
+	 * nothing is collected or sorted first. Names are the bundle path joined with "_" (invalid
+	 * characters replaced) and prefixed with prefix. Numeric values become untyped samples and
+	 * string values become an "_info" sample with the string as the value label.
+	 */
+	class prometheus_writer {
+	public:
+		prometheus_writer(std::ostream &out, const std::string &prefix = "nscp");
+		~prometheus_writer();
+
+		void write(const Plugin::MetricsMessage &message);
+		void write(const Plugin::Common::MetricsBundle &bundle);
+		void flush();
+		std::size_t samples() const {
+			return samples_;
+		}
+
+	private:
+		void write(const std::string &path, const Plugin::Common::MetricsBundle &bundle);
+		void write_sample(const std::string &path, const Plugin::Common::Metric &metric);
+		static void append_name(std::string &buffer, const std::string &name);
+		static void append_label_value(std::string &buffer, const std::string &value);
+		static void append_double(std::string &buffer, double value);
+
+		std::ostream &out_;
+		std::string prefix_;
+		std::string buffer_;
+		std::size_t samples_;
+	};
+}
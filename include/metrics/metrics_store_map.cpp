@@ -17,11 +17,40 @@
 #include <metrics/metrics_store_map.hpp>
 
 #include <boost/foreach.hpp>
+#include <boost/bind.hpp>
+#include <boost/make_shared.hpp>
 #include <strEx.h>
 
 namespace metrics {
 
-	void build_metrics(metrics_store::values_map &metrics, const Plugin::Common::MetricsBundle &b, const std::string &path) {
+	metric_value metric_value::from_int(long long value) {
+		metric_value ret;
+		ret.type = type_int;
+		ret.int_value = value;
+		return ret;
+	}
+	metric_value metric_value::from_float(double value) {
+		metric_value ret;
+		ret.type = type_float;
+		ret.float_value = value;
+		return ret;
+	}
+	metric_value metric_value::from_string(const std::string &value) {
+		metric_value ret;
+		ret.type = type_string;
+		ret.string_value = value;
+		return ret;
+	}
+
+	std::string metric_value::to_string() const {
+		if (type == type_int)
+			return strEx::s::xtos(int_value);
+		if (type == type_float)
+			return strEx::s::xtos(float_value);
+		return string_value;
+	}
+
+	void build_metrics(metrics_store::typed_map &metrics, const Plugin::Common::MetricsBundle &b, const std::string &path) {
 		std::string p = "";
 		if (!path.empty())
 			p += path + ".";
@@ -33,45 +62,71 @@ namespace metrics {
 
 		BOOST_FOREACH(const Plugin::Common::Metric &v, b.value()) {
 			if (v.value().has_int_data())
-				metrics[ p + "." + v.key()] = strEx::s::xtos(v.value().int_data());
+				metrics[p + "." + v.key()] = metric_value::from_int(v.value().int_data());
 			else if (v.value().has_string_data())
-				metrics[p + "." + v.key()] = v.value().string_data();
+				metrics[p + "." + v.key()] = metric_value::from_string(v.value().string_data());
 			else if (v.value().has_float_data())
-				metrics[p + "." + v.key()] = strEx::s::xtos(v.value().int_data());
+				metrics[p + "." + v.key()] = metric_value::from_float(v.value().float_data());
 		}
 	}
 
-
 	void metrics_store::set(const Plugin::MetricsMessage &response) {
-		metrics_store::values_map tmp;
-
+		// Each message holds the metrics from all modules so the table is rebuilt (and bundles
+		// from unloaded modules disappear). Readers keep using the old table until the swap.
+		boost::shared_ptr<typed_map> next = boost::make_shared<typed_map>();
 		BOOST_FOREACH(const Plugin::MetricsMessage::Response &p, response.payload()) {
 			BOOST_FOREACH(const Plugin::Common::MetricsBundle &b, p.bundles()) {
-				build_metrics(tmp, b, "");
+				build_metrics(*next, b, "");
 			}
 		}
-		{
-			boost::unique_lock<boost::timed_mutex> lock(mutex_, boost::get_system_time() + boost::posix_time::seconds(5));
-			if (!lock.owns_lock())
-				return;
-			values_ = tmp;
-		}
+		boost::mutex::scoped_lock lock(snapshot_mutex_);
+		metrics_ = next;
 	}
 
-	metrics_store::values_map metrics_store::get(const std::string &filter) {
-		bool f = !filter.empty();
-		metrics_store::values_map ret;
-		{
-			boost::unique_lock<boost::timed_mutex> lock(mutex_, boost::get_system_time() + boost::posix_time::seconds(5));
-			if (!lock.owns_lock())
-				return ret;
+	metrics_store::snapshot_ptr metrics_store::snapshot() const {
+		boost::mutex::scoped_lock lock(snapshot_mutex_);
+		return metrics_;
+	}
 
-			BOOST_FOREACH(const values_map::value_type &v, values_) {
-				if (!f || v.first.find(filter) != std::string::npos)
-					ret[v.first] = v.second;
-			}
+	metrics_store::values_map metrics_store::get(const std::string &filter) const {
+		values_map ret;
+		snapshot_ptr current = snapshot();
+		if (!current)
+			return ret;
+		bool f = !filter.empty();
+		BOOST_FOREACH(const typed_map::value_type &v, *current) {
+			if (!f || v.first.find(filter) != std::string::npos)
+				ret.insert(ret.end(), std::make_pair(v.first, v.second.to_string()));
 		}
 		return ret;
 	}
 
-}
\ No newline at end of file
+	void add_value(metrics_store::values_map &ret, const std::string &key, const metric_value &value) {
+		ret.insert(ret.end(), std::make_pair(key, value.to_string()));
+	}
+
+	metrics_store::values_map metrics_store::get_prefix(const std::string &prefix) const {
+		values_map ret;
+		visit(prefix, boost::bind(&add_value, boost::ref(ret), _1, _2));
+		return ret;
+	}
+
+	void metrics_store::visit(const std::string &prefix, const visitor_type &visitor) const {
+		snapshot_ptr current = snapshot();
+		if (!current)
+			return;
+		typed_map::const_iterator end = current->end();
+		for (typed_map::const_iterator it = current->lower_bound(prefix); it != end; ++it) {
+			if (it->first.compare(0, prefix.size(), prefix) != 0)
+				break;
+			visitor(it->first, it->second);
+		}
+	}
+
+	std::size_t metrics_store::size() const {
+		snapshot_ptr current = snapshot();
+		if (!current)
+			return 0;
+		return current->size();
+	}
+}
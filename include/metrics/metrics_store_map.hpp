@@ -20,18 +20,69 @@
 #include <string>
 #include <nscapi/nscapi_protobuf.hpp>
 
-#include <boost/thread/shared_mutex.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/function.hpp>
 #include <boost/thread/mutex.hpp>
 
 namespace metrics {
 
+	struct metric_value {
+		enum value_type { type_int, type_float, type_string };
+		value_type type;
+		long long int_value;
+		double float_value;
+		std::string string_value;
+
+		metric_value() : type(type_int), int_value(0), float_value(0.0) {}
+		static metric_value from_int(long long value);
+		static metric_value from_float(double value);
+		static metric_value from_string(const std::string &value);
+
+		bool is_numeric() const {
+			return type != type_string;
+		}
+		double as_double() const {
+			return type == type_float ? float_value : static_cast<double>(int_value);
+		}
+		std::string to_string() const;
+	};
+
+	/**
+	 * Metrics store keyed on the flattened "bundle.child.key" path.
+	 *
+	 * Each set() builds a new table (the message holds the metrics from all modules) and swaps it in.
+	 * Tables are immutable once published so readers grab the current table and iterate it
+	 * without holding any lock.
+	 * As the table is a sorted map prefix lookups are a lower_bound followed by a range scan.
+	 */
 	struct metrics_store {
 		typedef std::map<std::string, std::string> values_map;
+		typedef std::map<std::string, metric_value> typed_map;
+		typedef boost::function<void(const std::string &key, const metric_value &value)> visitor_type;
+
 		void set(const Plugin::MetricsMessage &response);
-		values_map get(const std::string &filter);
+
+		/**
+		 * Render all metrics whose key contains filter (or all metrics if filter is empty).
+		 */
+		values_map get(const std::string &filter) const;
+		/**
+		 * Render all metrics whose key starts with prefix.
+		 */
+		values_map get_prefix(const std::string &prefix) const;
+		/**
+		 * Stream all metrics whose key starts with prefix (in key order) without copying them.
+		 */
+		void visit(const std::string &prefix, const visitor_type &visitor) const;
+		std::size_t size() const;
+
 	private:
-		values_map values_;
-		boost::timed_mutex mutex_;
+		typedef boost::shared_ptr<const typed_map> snapshot_ptr;
+
+		snapshot_ptr snapshot() const;
+
+		snapshot_ptr metrics_;
+		mutable boost::mutex snapshot_mutex_;
 	};
 
 }
@@ -16,21 +16,31 @@
 
 #pragma once
 
-#include <boost/asio.hpp>
-#include <boost/bind.hpp>
+#include <string>
+#include <vector>
+#include <stdexcept>
 #include <istream>
-#include <iostream>
 #include <ostream>
 
+#include <boost/asio.hpp>
+#include <boost/bind.hpp>
+#include <boost/atomic.hpp>
+
 #include <net/icmp_header.hpp>
 #include <net/ipv4_header.hpp>
 
+#if !defined(BOOST_WINDOWS)
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#endif
+
 using boost::asio::ip::icmp;
 using boost::asio::deadline_timer;
 namespace posix_time = boost::posix_time;
 
 struct result_container {
-	result_container() : num_send_(0), num_replies_(0), num_timeouts_(0),  length_(0), sequence_number_(0), ttl_(0), time_(0) {}
+	result_container() : num_send_(0), num_replies_(0), num_timeouts_(0), length_(0), sequence_number_(0), ttl_(0), time_(0), time_min_(0), time_max_(0), jitter_(0), rtt_total_us_(0), jitter_total_us_(0), jitter_samples_(0) {}
 
 	std::string destination_;
 	std::string ip_;
@@ -40,111 +50,357 @@ struct result_container {
 	std::size_t length_;
 	unsigned short sequence_number_;
 	unsigned short ttl_;
+	// Round trip times in ms: average, min, max and jitter (average difference between consecutive replies)
 	std::size_t time_;
+	std::size_t time_min_;
+	std::size_t time_max_;
+	std::size_t jitter_;
+
+	unsigned long long rtt_total_us_;
+	unsigned long long jitter_total_us_;
+	std::size_t jitter_samples_;
+
+	void add(const result_container &other) {
+		if (other.num_replies_ > 0) {
+			if (num_replies_ == 0 || other.time_min_ < time_min_)
+				time_min_ = other.time_min_;
+			if (num_replies_ == 0 || other.time_max_ > time_max_)
+				time_max_ = other.time_max_;
+		}
+		num_send_ += other.num_send_;
+		num_replies_ += other.num_replies_;
+		num_timeouts_ += other.num_timeouts_;
+		rtt_total_us_ += other.rtt_total_us_;
+		jitter_total_us_ += other.jitter_total_us_;
+		jitter_samples_ += other.jitter_samples_;
+		update_averages();
+	}
+	void update_averages() {
+		time_ = num_replies_ == 0 ? 0 : static_cast<std::size_t>(rtt_total_us_ / num_replies_ / 1000);
+		jitter_ = jitter_samples_ == 0 ? 0 : static_cast<std::size_t>(jitter_total_us_ / jitter_samples_ / 1000);
+	}
+};
+
+/**
+ * Keeps track of the echo requests sent to a set of targets and matches the replies to them.
+ * Replies are matched on identifier, sequence number and source address. Replies arriving after
+ * the timeout count as lost. Contains no socket code so it can be tested on its own.
+ */
+class echo_tracker {
+	struct echo {
+		std::size_t target;
+		posix_time::ptime time_sent;
+		long long rtt_us;
+		bool done;
+		echo(std::size_t target, posix_time::ptime time_sent) : target(target), time_sent(time_sent), rtt_us(-1), done(false) {}
+	};
+	struct target {
+		boost::asio::ip::address address;
+		result_container result;
+	};
+
+public:
+	enum reply_status {
+		reply_matched,
+		reply_late,
+		reply_ignored
+	};
+
+	echo_tracker(unsigned short identifier, int timeout) : identifier_(identifier), timeout_(timeout), outstanding_(0) {}
+
+	std::size_t add_target(const std::string &destination, const boost::asio::ip::address &address) {
+		target t;
+		t.address = address;
+		t.result.destination_ = destination;
+		t.result.ip_ = address.to_string();
+		targets_.push_back(t);
+		return targets_.size() - 1;
+	}
+	std::size_t size() const {
+		return targets_.size();
+	}
+	void reserve(std::size_t echoes) {
+		echoes_.reserve(echoes);
+	}
+	unsigned short get_identifier() const {
+		return identifier_;
+	}
+	std::size_t get_outstanding() const {
+		return outstanding_;
+	}
+	unsigned short get_next_sequence_number() const {
+		return static_cast<unsigned short>(echoes_.size() + 1);
+	}
+
+	/**
+	 * Record an echo sent to a target and return its sequence number (starting at 1).
+	 * If sending failed the echo is counted as lost right away.
+	 */
+	unsigned short add_echo(std::size_t index, posix_time::ptime now, bool sent) {
+		result_container &r = targets_[index].result;
+		echoes_.push_back(echo(index, now));
+		unsigned short sequence_number = static_cast<unsigned short>(echoes_.size());
+		r.num_send_++;
+		r.sequence_number_ = sequence_number;
+		if (sent)
+			outstanding_++;
+		else
+			echoes_.back().done = true;
+		return sequence_number;
+	}
+
+	/**
+	 * Match a reply to an echo.
+	 * The identifier is only checked when check_identifier is set (the kernel picks it for datagram sockets).
+	 * length and ttl describe the reply and are stored in the result of the target.
+	 */
+	reply_status add_reply(bool check_identifier, unsigned short identifier, unsigned short sequence_number, const boost::asio::ip::address &source, posix_time::ptime now, std::size_t length, unsigned short ttl) {
+		if (check_identifier && identifier != identifier_)
+			return reply_ignored;
+		if (sequence_number == 0 || sequence_number > echoes_.size())
+			return reply_ignored;
+		echo &e = echoes_[sequence_number - 1];
+		target &t = targets_[e.target];
+		if (e.done || source != t.address)
+			return reply_ignored;
+		e.done = true;
+		outstanding_--;
+		long long rtt = (now - e.time_sent).total_microseconds();
+		if (rtt > static_cast<long long>(timeout_) * 1000)
+			return reply_late;
+		e.rtt_us = rtt;
+		t.result.num_replies_++;
+		t.result.length_ = length;
+		t.result.ttl_ = ttl;
+		return reply_matched;
+	}
+
+	/**
+	 * Count the lost echoes and calculate the average, min, max and jitter of every target.
+	 */
+	void calculate_results() {
+		std::vector<long long> last_rtt(targets_.size(), -1);
+		for (std::vector<echo>::const_iterator cit = echoes_.begin(); cit != echoes_.end(); ++cit) {
+			result_container &r = targets_[cit->target].result;
+			if (cit->rtt_us < 0) {
+				r.num_timeouts_++;
+				continue;
+			}
+			std::size_t ms = static_cast<std::size_t>(cit->rtt_us / 1000);
+			long long &last = last_rtt[cit->target];
+			if (last < 0) {
+				r.time_min_ = ms;
+				r.time_max_ = ms;
+			} else {
+				r.jitter_total_us_ += last > cit->rtt_us ? last - cit->rtt_us : cit->rtt_us - last;
+				r.jitter_samples_++;
+			}
+			if (ms < r.time_min_)
+				r.time_min_ = ms;
+			if (ms > r.time_max_)
+				r.time_max_ = ms;
+			r.rtt_total_us_ += cit->rtt_us;
+			last = cit->rtt_us;
+		}
+		for (std::vector<target>::iterator it = targets_.begin(); it != targets_.end(); ++it)
+			it->result.update_averages();
+	}
+
+	std::vector<result_container> get_results() const {
+		std::vector<result_container> ret;
+		for (std::vector<target>::const_iterator cit = targets_.begin(); cit != targets_.end(); ++cit)
+			ret.push_back(cit->result);
+		return ret;
+	}
+
+private:
+	unsigned short identifier_;
+	int timeout_;
+	std::size_t outstanding_;
+	std::vector<target> targets_;
+	std::vector<echo> echoes_;
 };
+
+/**
+ * Sends ICMP echo requests to any number of hosts over a single socket.
+ * All hosts are pinged in parallel: every interval one echo is sent to each host and replies are
+ * matched back to the echo using the identifier and sequence number.
+ * If raw sockets are not allowed the unprivileged ICMP datagram sockets on Linux are used instead
+ * (requires the group to be in net.ipv4.ping_group_range).
+ */
 class pinger {
 public:
-	pinger(boost::asio::io_service& io_service, result_container &result, const char* destination, int timeout)
-		: resolver_(io_service)
-		, socket_(io_service, icmp::v4())
-		, timer_(io_service)
-		, sequence_number_(0)
+	pinger(int timeout, int count, int interval)
+		: resolver_(io_service_)
+		, socket_(io_service_)
+		, timer_(io_service_)
+		, datagram_(false)
+		, tracker_(create_identifier(), timeout)
 		, timeout_(timeout)
-		, result_(result)
+		, count_(count)
+		, interval_(interval)
+		, rounds_(0) {
+		if (interval <= 0)
+			throw std::invalid_argument("Invalid interval, must be greater than 0");
+		open_socket();
+	}
 
-	{
+	void add_host(const std::string &destination) {
 		icmp::resolver::query query(icmp::v4(), destination, "");
-		destination_ = *resolver_.resolve(query);
-		result.destination_ = destination;
-		result.ip_ = destination_.address().to_string();
+		icmp::endpoint endpoint = *resolver_.resolve(query);
+		tracker_.add_target(destination, endpoint.address());
+		destinations_.push_back(endpoint);
 	}
 
-	void ping() {
-		start_send();
+	/**
+	 * Send all echo requests and wait for the replies (or the timeout of the last echo).
+	 */
+	void run() {
+		if (destinations_.empty() || count_ <= 0)
+			return;
+		if (destinations_.size() * count_ > 0xffff)
+			throw std::runtime_error("Too many hosts or packets, at most 65535 echo requests can be sent at once");
+		tracker_.reserve(destinations_.size() * count_);
 		start_receive();
+		send_round(boost::system::error_code());
+		io_service_.run();
+		tracker_.calculate_results();
+	}
+
+	std::vector<result_container> get_results() const {
+		return tracker_.get_results();
+	}
+	bool is_datagram() const {
+		return datagram_;
 	}
 
 private:
-	void start_send() {
-		std::string body("Hello from NSClient++.");
+	void open_socket() {
+		boost::system::error_code ec;
+		socket_.open(icmp::v4(), ec);
+		if (!ec)
+			return;
+#if defined(__linux__)
+		int fd = ::socket(AF_INET, SOCK_DGRAM, IPPROTO_ICMP);
+		if (fd >= 0) {
+			boost::system::error_code ec2;
+			socket_.assign(icmp::v4(), fd, ec2);
+			if (!ec2) {
+				datagram_ = true;
+				return;
+			}
+			::close(fd);
+		}
+#endif
+		throw boost::system::system_error(ec, "Failed to open ICMP socket");
+	}
+
+	void send_round(const boost::system::error_code &ec) {
+		if (ec)
+			return;
+		posix_time::ptime now = posix_time::microsec_clock::universal_time();
+		for (std::size_t i = 0; i < destinations_.size(); i++)
+			send_echo(i, now);
+		if (++rounds_ < count_) {
+			timer_.expires_at(now + posix_time::millisec(interval_));
+			timer_.async_wait(boost::bind(&pinger::send_round, this, boost::asio::placeholders::error));
+		} else {
+			timer_.expires_at(now + posix_time::millisec(timeout_));
+			timer_.async_wait(boost::bind(&pinger::handle_timeout, this, boost::asio::placeholders::error));
+			check_done();
+		}
+	}
+
+	void send_echo(std::size_t index, posix_time::ptime now) {
+		static const std::string body("Hello from NSClient++.");
+		unsigned short sequence_number = tracker_.get_next_sequence_number();
 
 		icmp_header echo_request;
 		echo_request.type(icmp_header::echo_request);
 		echo_request.code(0);
-		echo_request.identifier(get_identifier());
-		echo_request.sequence_number(++sequence_number_);
+		echo_request.identifier(tracker_.get_identifier());
+		echo_request.sequence_number(sequence_number);
 		compute_checksum(echo_request, body.begin(), body.end());
 
 		boost::asio::streambuf request_buffer;
 		std::ostream os(&request_buffer);
 		os << echo_request << body;
 
-		result_.num_send_++;
-		time_sent_ = posix_time::microsec_clock::universal_time();
-		socket_.send_to(request_buffer.data(), destination_);
-
-		timer_.expires_at(time_sent_ + posix_time::millisec(timeout_));
-		timer_.async_wait(boost::bind(&pinger::handle_timeout, this, boost::asio::placeholders::error));
+		boost::system::error_code ec;
+		socket_.send_to(request_buffer.data(), destinations_[index], 0, ec);
+		tracker_.add_echo(index, now, !ec);
 	}
 
-	void handle_timeout(const boost::system::error_code ec) {
+	void handle_timeout(const boost::system::error_code &ec) {
 		if (ec != boost::asio::error::operation_aborted) {
-			result_.num_timeouts_++;
-			socket_.cancel();
+			boost::system::error_code ignored;
+			socket_.cancel(ignored);
 		}
 	}
 
 	void start_receive() {
 		reply_buffer_.consume(reply_buffer_.size());
-		socket_.async_receive(reply_buffer_.prepare(65536), boost::bind(&pinger::handle_receive, this, _2, boost::asio::placeholders::error));
+		socket_.async_receive_from(reply_buffer_.prepare(65536), reply_source_,
+			boost::bind(&pinger::handle_receive, this, boost::asio::placeholders::bytes_transferred, boost::asio::placeholders::error));
 	}
 
-	void handle_receive(std::size_t length, const boost::system::error_code ec) {
-		if (ec == boost::asio::error::operation_aborted) {
+	void handle_receive(std::size_t length, const boost::system::error_code &ec) {
+		if (ec == boost::asio::error::operation_aborted)
 			return;
+		if (!ec) {
+			reply_buffer_.commit(length);
+			parse_reply(length, posix_time::microsec_clock::universal_time());
 		}
+		if (check_done())
+			return;
+		start_receive();
+	}
 
-
-		reply_buffer_.commit(length);
-
+	void parse_reply(std::size_t length, posix_time::ptime now) {
 		std::istream is(&reply_buffer_);
 		ipv4_header ipv4_hdr;
 		icmp_header icmp_hdr;
-		is >> ipv4_hdr >> icmp_hdr;
-
-		if (is 
-			&& icmp_hdr.type() == icmp_header::echo_reply
-			&& icmp_hdr.identifier() == get_identifier()
-			&& icmp_hdr.sequence_number() == sequence_number_)
-		{
-			timer_.cancel();
-			result_.num_replies_++;
-
-			posix_time::ptime now = posix_time::microsec_clock::universal_time();
-			result_.length_ = length - ipv4_hdr.header_length();
-			result_.ttl_ = ipv4_hdr.time_to_live();
-			result_.time_ = (now - time_sent_).total_milliseconds();
+		// Datagram sockets only return the ICMP message (and the kernel picks the identifier)
+		if (!datagram_)
+			is >> ipv4_hdr;
+		is >> icmp_hdr;
+		if (!is || icmp_hdr.type() != icmp_header::echo_reply)
 			return;
-		}
-		//start_receive();
+		tracker_.add_reply(!datagram_, icmp_hdr.identifier(), icmp_hdr.sequence_number(), reply_source_.address(), now,
+			length - (datagram_ ? 0 : ipv4_hdr.header_length()), datagram_ ? 0 : ipv4_hdr.time_to_live());
 	}
 
+	bool check_done() {
+		if (rounds_ < count_ || tracker_.get_outstanding() > 0)
+			return false;
+		boost::system::error_code ignored;
+		timer_.cancel(ignored);
+		socket_.cancel(ignored);
+		return true;
+	}
 
-	static unsigned short get_identifier() {
+	static unsigned short create_identifier() {
+		// Several checks can run at once (and with raw sockets they all see each others replies)
+		static boost::atomic<unsigned short> instance(0);
 #if defined(BOOST_WINDOWS)
-		return static_cast<unsigned short>(::GetCurrentProcessId());
+		unsigned short pid = static_cast<unsigned short>(::GetCurrentProcessId());
 #else
-		return static_cast<unsigned short>(::getpid());
+		unsigned short pid = static_cast<unsigned short>(::getpid());
 #endif
+		return static_cast<unsigned short>(pid + (instance++ << 8));
 	}
 
+	boost::asio::io_service io_service_;
 	icmp::resolver resolver_;
-	icmp::endpoint destination_;
 	icmp::socket socket_;
 	deadline_timer timer_;
-	unsigned short sequence_number_;
-	posix_time::ptime time_sent_;
-	boost::asio::streambuf reply_buffer_;
-	result_container& result_;
+	bool datagram_;
+	echo_tracker tracker_;
 	int timeout_;
+	int count_;
+	int interval_;
+	int rounds_;
+	std::vector<icmp::endpoint> destinations_;
+	icmp::endpoint reply_source_;
+	boost::asio::streambuf reply_buffer_;
 };
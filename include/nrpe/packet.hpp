@@ -18,6 +18,9 @@
 
 #include <types.hpp>
 #include <string>
+#include <vector>
+#include <cstddef>
+#include <cstring>
 #include <unicode_char.hpp>
 #include <boost/asio/buffer.hpp>
 #include <swap_bytes.hpp>
@@ -74,11 +77,80 @@ namespace nrpe {
 		}
 	};
 
-	class packet /*: public boost::noncopyable*/ {
-	public:
+	/**
+	 * A verified packet which references the buffer it was parsed from (the payload is not copied).
+	 */
+	struct packet_view {
+		short type;
+		short version;
+		int16_t result;
+		unsigned int crc32;
+		const char *payload;
+		std::size_t payload_size;
+
+		packet_view() : type(nrpe::data::unknownPacket), version(nrpe::data::version2), result(0), crc32(0), payload(NULL), payload_size(0) {}
+	};
+
+	/**
+	 * Encodes and decodes NRPE packets directly in caller owned buffers.
+	 */
+	struct frame {
+		static packet_view parse(const char *buffer, std::size_t length, unsigned int payload_length) {
+			if (buffer == NULL)
+				throw nrpe::nrpe_exception("No buffer.");
+			if (length != nrpe::length::get_packet_length(payload_length))
+				throw nrpe::nrpe_exception("Invalid packet length: " + strEx::s::xtos(length) + " != " + strEx::s::xtos(nrpe::length::get_packet_length(payload_length)) + " configured payload is: " + strEx::s::xtos(payload_length));
+			const nrpe::data::packet *p = reinterpret_cast<const nrpe::data::packet*>(buffer);
+			packet_view ret;
+			ret.type = swap_bytes::ntoh<int16_t>(p->packet_type);
+			if (ret.type != nrpe::data::queryPacket && ret.type != nrpe::data::responsePacket  && ret.type != nrpe::data::moreResponsePacket)
+				throw nrpe::nrpe_exception("Invalid packet type: " + strEx::s::xtos(ret.type));
+			ret.version = swap_bytes::ntoh<int16_t>(p->packet_version);
+			if (ret.version != nrpe::data::version2)
+				throw nrpe::nrpe_exception("Invalid packet version." + strEx::s::xtos(ret.version));
+			ret.crc32 = swap_bytes::ntoh<u_int32_t>(p->crc32_value);
+			unsigned int calculated = calculate(buffer, length);
+			if (ret.crc32 != calculated)
+				throw nrpe::nrpe_exception("Invalid checksum in NRPE packet: " + strEx::s::xtos(ret.crc32) + "!=" + strEx::s::xtos(calculated));
+			ret.result = swap_bytes::ntoh<int16_t>(p->result_code);
+			ret.payload = buffer + nrpe::data::buffer_offset;
+			const void *term = memchr(ret.payload, 0, payload_length);
+			ret.payload_size = term == NULL ? payload_length : static_cast<const char*>(term) - ret.payload;
+			return ret;
+		}
+
+		/**
+		 * Encode a packet into buffer which has to be get_packet_length(payload_length) bytes.
+		 */
+		static unsigned int encode(char *buffer, unsigned int payload_length, short type, short version, int16_t result, const char *payload, std::size_t payload_size) {
+			if (payload_size >= payload_length)
+				throw nrpe::nrpe_exception("To much data cant create return packet (truncate data)");
+			unsigned int packet_length = nrpe::length::get_packet_length(payload_length);
+			memset(buffer, 0, packet_length);
+			nrpe::data::packet *p = reinterpret_cast<nrpe::data::packet*>(buffer);
+			p->result_code = swap_bytes::hton<int16_t>(result);
+			p->packet_type = swap_bytes::hton<int16_t>(type);
+			p->packet_version = swap_bytes::hton<int16_t>(version);
+			memcpy(buffer + nrpe::data::buffer_offset, payload, payload_size);
+			unsigned int crc32 = static_cast<unsigned int>(calculate_crc32(buffer, packet_length));
+			p->crc32_value = swap_bytes::hton<u_int32_t>(crc32);
+			return crc32;
+		}
 
+		// The checksum is calculated with the crc field set to 0 so it is skipped instead of copying the packet.
+		static unsigned int calculate(const char *buffer, std::size_t length) {
+			static const char zero[sizeof(u_int32_t)] = { 0 };
+			const std::size_t crc_offset = offsetof(nrpe::data::packet, crc32_value);
+			unsigned long crc = update_crc32(0, buffer, static_cast<int>(crc_offset));
+			crc = update_crc32(crc, zero, sizeof(u_int32_t));
+			std::size_t rest = crc_offset + sizeof(u_int32_t);
+			return static_cast<unsigned int>(update_crc32(crc, buffer + rest, static_cast<int>(length - rest)));
+		}
+	};
+
+	class packet {
 	private:
-		char *tmpBuffer;
+		std::vector<char> buffer_;
 		unsigned int payload_length_;
 		short type_;
 		short version_;
@@ -87,24 +159,15 @@ namespace nrpe {
 		unsigned int crc32_;
 		unsigned int calculatedCRC32_;
 	public:
-		packet(unsigned int payload_length) : tmpBuffer(NULL), payload_length_(payload_length) {};
-		packet(std::vector<char> buffer, unsigned int payload_length) : tmpBuffer(NULL), payload_length_(payload_length) {
-			char *tmp = new char[buffer.size() + 1];
-			copy(buffer.begin(), buffer.end(), tmp);
-			try {
-				readFrom(tmp, buffer.size());
-			} catch (const nrpe::nrpe_exception &e) {
-				delete[] tmp;
-				throw e;
-			}
-			delete[] tmp;
+		packet(unsigned int payload_length) : payload_length_(payload_length) {};
+		packet(const std::vector<char> &buffer, unsigned int payload_length) : payload_length_(payload_length) {
+			readFrom(buffer.empty() ? NULL : &buffer[0], buffer.size());
 		};
-		packet(const char *buffer, unsigned int buffer_length) : tmpBuffer(NULL), payload_length_(length::get_payload_length(buffer_length)) {
+		packet(const char *buffer, unsigned int buffer_length) : payload_length_(length::get_payload_length(buffer_length)) {
 			readFrom(buffer, buffer_length);
 		};
 		packet(short type, short version, int result, std::string payLoad, unsigned int payload_length)
-			: tmpBuffer(NULL)
-			, payload_length_(payload_length)
+			: payload_length_(payload_length)
 			, type_(type)
 			, version_(version)
 			, result_(result)
@@ -112,14 +175,13 @@ namespace nrpe {
 			, crc32_(0)
 			, calculatedCRC32_(0) {}
 		packet()
-			: tmpBuffer(NULL)
-			, payload_length_(nrpe::length::get_payload_length())
+			: payload_length_(nrpe::length::get_payload_length())
 			, type_(nrpe::data::unknownPacket)
 			, version_(nrpe::data::version2)
 			, result_(0)
 			, crc32_(0)
 			, calculatedCRC32_(0) {}
-		packet(const packet &other) : tmpBuffer(NULL) {
+		packet(const packet &other) {
 			payload_ = other.payload_;
 			type_ = other.type_;
 			version_ = other.version_;
@@ -129,7 +191,6 @@ namespace nrpe {
 			payload_length_ = other.payload_length_;
 		}
 		packet& operator=(packet const& other) {
-			tmpBuffer = NULL;
 			payload_ = other.payload_;
 			type_ = other.type_;
 			version_ = other.version_;
@@ -144,9 +205,6 @@ namespace nrpe {
 			return packet(nrpe::data::responsePacket, nrpe::data::version2, 3, message, 0);
 		}
 
-		~packet() {
-			delete[] tmpBuffer;
-		}
 		static packet make_request(std::string payload, unsigned int buffer_length) {
 			return packet(nrpe::data::queryPacket, nrpe::data::version2, -1, payload, buffer_length);
 		}
@@ -156,71 +214,42 @@ namespace nrpe {
 		static const char* payload_offset(const nrpe::data::packet *p) {
 			return &reinterpret_cast<const char*>(p)[nrpe::data::buffer_offset];
 		}
-		static void update_payload(nrpe::data::packet *p, const std::string &payload) {
-			char *data = payload_offset(p);
-			strncpy(data, payload.c_str(), payload.length());
-			data[payload.length()] = 0;
-		}
-		static std::string fetch_payload(const nrpe::data::packet *p) {
-			const char *data = payload_offset(p);
-			return std::string(data);
+
+		/**
+		 * Encode the packet into buffer (which is resized to the packet length, reusing its capacity).
+		 */
+		void write_to(std::vector<char> &buffer) {
+			buffer.resize(get_packet_length());
+			crc32_ = frame::encode(&buffer[0], payload_length_, type_, version_, result_, payload_.c_str(), payload_.length());
 		}
 
 		const char* create_buffer() {
-			delete[] tmpBuffer;
-			unsigned int packet_length = nrpe::length::get_packet_length(payload_length_);
-			tmpBuffer = new char[packet_length + 1];
-			memset(tmpBuffer, 0, packet_length + 1);
-			nrpe::data::packet *p = reinterpret_cast<nrpe::data::packet*>(tmpBuffer);
-			p->result_code = swap_bytes::hton<int16_t>(result_);
-			p->packet_type = swap_bytes::hton<int16_t>(type_);
-			p->packet_version = swap_bytes::hton<int16_t>(version_);
-			if (payload_.length() >= payload_length_)
-				throw nrpe::nrpe_exception("To much data cant create return packet (truncate data)");
-			update_payload(p, payload_);
-			p->crc32_value = 0;
-			crc32_ = p->crc32_value = swap_bytes::hton<u_int32_t>(calculate_crc32(tmpBuffer, packet_length));
-			return tmpBuffer;
+			write_to(buffer_);
+			return &buffer_[0];
 		}
 
 		std::vector<char> get_buffer() {
-			const char *c = create_buffer();
-			std::vector<char> buf(c, c + get_packet_length());
+			std::vector<char> buf;
+			write_to(buf);
 			return buf;
 		}
 
 		void readFrom(const char *buffer, std::size_t length) {
-			if (buffer == NULL)
-				throw nrpe::nrpe_exception("No buffer.");
-			if (length != get_packet_length())
-				throw nrpe::nrpe_exception("Invalid packet length: " + strEx::s::xtos(length) + " != " + strEx::s::xtos(get_packet_length()) + " configured payload is: " + strEx::s::xtos(get_payload_length()));
-			const nrpe::data::packet *p = reinterpret_cast<const nrpe::data::packet*>(buffer);
-			type_ = swap_bytes::ntoh<int16_t>(p->packet_type);
-			if (type_ != nrpe::data::queryPacket && type_ != nrpe::data::responsePacket  && type_ != nrpe::data::moreResponsePacket)
-				throw nrpe::nrpe_exception("Invalid packet type: " + strEx::s::xtos(type_));
-			version_ = swap_bytes::ntoh<int16_t>(p->packet_version);
-			if (version_ != nrpe::data::version2)
-				throw nrpe::nrpe_exception("Invalid packet version." + strEx::s::xtos(version_));
-			crc32_ = swap_bytes::ntoh<u_int32_t>(p->crc32_value);
-			// Verify CRC32
-			// @todo Fix this, currently we need a const buffer so we cannot change the CRC to 0.
-			char * tb = new char[length + 1];
-			memcpy(tb, buffer, length);
-			nrpe::data::packet *p2 = reinterpret_cast<nrpe::data::packet*>(tb);
-			p2->crc32_value = 0;
-			calculatedCRC32_ = calculate_crc32(tb, get_packet_length());
-			delete[] tb;
-			if (crc32_ != calculatedCRC32_)
-				throw nrpe::nrpe_exception("Invalid checksum in NRPE packet: " + strEx::s::xtos(crc32_) + "!=" + strEx::s::xtos(calculatedCRC32_));
-			// Verify CRC32 end
-			result_ = swap_bytes::ntoh<int16_t>(p->result_code);
-			payload_ = fetch_payload(p);
+			read_from(frame::parse(buffer, length, payload_length_));
+		}
+		void read_from(const packet_view &view) {
+			type_ = view.type;
+			version_ = view.version;
+			result_ = view.result;
+			payload_.assign(view.payload, view.payload_size);
+			crc32_ = calculatedCRC32_ = view.crc32;
 		}
 
 		unsigned short getVersion() const { return version_; }
 		unsigned short getType() const { return type_; }
 		unsigned short getResult() const { return result_; }
 		std::string getPayload() const { return payload_; }
+		const std::string& get_payload() const { return payload_; }
 		bool verifyCRC() { return calculatedCRC32_ == crc32_; }
 		unsigned int get_packet_length() const { return nrpe::length::get_packet_length(payload_length_); }
 		unsigned int get_payload_length() const { return payload_length_; }
@@ -0,0 +1,212 @@
+/*
+ * Copyright 2004-2016 The NSClient++ Authors - https://nsclient.org
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <deque>
+#include <map>
+#include <string>
+
+#include <boost/cstdint.hpp>
+#include <boost/function.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/thread.hpp>
+#include <boost/date_time/posix_time/posix_time.hpp>
+
+namespace nrpe {
+	namespace server {
+
+		/**
+		 * Bounded pool of threads executing checks outside of the socket I/O threads.
+		 * Jobs are queued up to queue_size and each client can have at most per_client jobs queued or
+		 * running at any time (0 means no limit), further jobs are rejected so the caller can respond right away.
+		 */
+		class check_pool : public boost::noncopyable {
+		public:
+			typedef boost::function<void()> job_type;
+			enum submit_result {
+				accepted,
+				queue_full,
+				client_limit,
+				stopped
+			};
+			struct metrics {
+				std::size_t queue_depth;
+				std::size_t active;
+				boost::uint64_t executed;
+				boost::uint64_t rejected;
+				boost::uint64_t wait_total_ms;
+				boost::uint64_t wait_avg_ms;
+				boost::uint64_t wait_max_ms;
+				metrics() : queue_depth(0), active(0), executed(0), rejected(0), wait_total_ms(0), wait_avg_ms(0), wait_max_ms(0) {}
+			};
+
+		private:
+			struct item {
+				std::string client;
+				job_type job;
+				job_type dropped;
+				boost::posix_time::ptime queued;
+			};
+			typedef std::map<std::string, std::size_t> client_map;
+
+			std::size_t queue_size_;
+			std::size_t per_client_;
+			bool running_;
+			std::deque<item> queue_;
+			client_map clients_;
+			std::size_t active_;
+			boost::uint64_t executed_;
+			boost::uint64_t rejected_;
+			boost::uint64_t wait_total_us_;
+			boost::uint64_t wait_count_;
+			boost::uint64_t wait_max_us_;
+
+			mutable boost::mutex mutex_;
+			boost::condition_variable cond_;
+			boost::thread_group threads_;
+
+		public:
+			check_pool()
+				: queue_size_(0)
+				, per_client_(0)
+				, running_(false)
+				, active_(0)
+				, executed_(0)
+				, rejected_(0)
+				, wait_total_us_(0)
+				, wait_count_(0)
+				, wait_max_us_(0) {}
+			~check_pool() {
+				stop();
+			}
+
+			void start(std::size_t threads, std::size_t queue_size, std::size_t per_client) {
+				stop();
+				{
+					boost::unique_lock<boost::mutex> lock(mutex_);
+					queue_size_ = queue_size;
+					per_client_ = per_client;
+					running_ = true;
+				}
+				for (std::size_t i = 0; i < threads; i++)
+					threads_.create_thread(boost::bind(&check_pool::thread_proc, this));
+			}
+
+			/**
+			 * Stop all threads, queued jobs are dropped and their dropped handler is called instead
+			 * (so the client still gets an answer). Running jobs are allowed to finish.
+			 */
+			void stop() {
+				std::deque<item> dropped;
+				{
+					boost::unique_lock<boost::mutex> lock(mutex_);
+					if (!running_)
+						return;
+					running_ = false;
+					dropped.swap(queue_);
+					clients_.clear();
+				}
+				cond_.notify_all();
+				for (std::deque<item>::const_iterator it = dropped.begin(); it != dropped.end(); ++it) {
+					try {
+						if (it->dropped)
+							it->dropped();
+					} catch (...) {}
+				}
+				threads_.join_all();
+			}
+
+			/**
+			 * Queue job for client, if the pool is stopped before the job has started dropped is called instead.
+			 */
+			submit_result submit(const std::string &client, job_type job, job_type dropped = job_type()) {
+				{
+					boost::unique_lock<boost::mutex> lock(mutex_);
+					if (!running_)
+						return stopped;
+					if (queue_size_ > 0 && queue_.size() >= queue_size_) {
+						rejected_++;
+						return queue_full;
+					}
+					std::size_t &count = clients_[client];
+					if (per_client_ > 0 && count >= per_client_) {
+						rejected_++;
+						return client_limit;
+					}
+					count++;
+					item i;
+					i.client = client;
+					i.job = job;
+					i.dropped = dropped;
+					i.queued = boost::posix_time::microsec_clock::universal_time();
+					queue_.push_back(i);
+				}
+				cond_.notify_one();
+				return accepted;
+			}
+
+			/**
+			 * Fetch the current state, all counters (including the wait times) are cumulative since start.
+			 */
+			metrics get_metrics() const {
+				boost::unique_lock<boost::mutex> lock(mutex_);
+				metrics ret;
+				ret.queue_depth = queue_.size();
+				ret.active = active_;
+				ret.executed = executed_;
+				ret.rejected = rejected_;
+				ret.wait_total_ms = wait_total_us_ / 1000;
+				ret.wait_avg_ms = wait_count_ == 0 ? 0 : wait_total_us_ / wait_count_ / 1000;
+				ret.wait_max_ms = wait_max_us_ / 1000;
+				return ret;
+			}
+
+		private:
+			void thread_proc() {
+				while (true) {
+					item i;
+					{
+						boost::unique_lock<boost::mutex> lock(mutex_);
+						while (running_ && queue_.empty())
+							cond_.wait(lock);
+						if (!running_)
+							return;
+						i = queue_.front();
+						queue_.pop_front();
+						active_++;
+						boost::uint64_t wait = (boost::posix_time::microsec_clock::universal_time() - i.queued).total_microseconds();
+						wait_total_us_ += wait;
+						wait_count_++;
+						if (wait > wait_max_us_)
+							wait_max_us_ = wait;
+					}
+					try {
+						i.job();
+					} catch (...) {}
+					{
+						boost::unique_lock<boost::mutex> lock(mutex_);
+						active_--;
+						executed_++;
+						client_map::iterator it = clients_.find(i.client);
+						if (it != clients_.end() && --it->second == 0)
+							clients_.erase(it);
+					}
+				}
+			}
+		};
+	}
+}
@@ -18,12 +18,19 @@
 
 #include <nrpe/packet.hpp>
 #include <boost/tuple/tuple.hpp>
+#include <boost/function.hpp>
 
 namespace nrpe {
 	namespace server {
 		class handler : boost::noncopyable {
 		public:
-			virtual std::list<nrpe::packet> handle(nrpe::packet packet) = 0;
+			typedef boost::function<void(const std::list<nrpe::packet> &)> callback_type;
+
+			virtual std::list<nrpe::packet> handle(const nrpe::packet &packet) = 0;
+			/**
+			 * Queue the request for execution, callback is called (from any thread) with the responses.
+			 */
+			virtual void handle_async(const nrpe::packet &packet, const std::string &client, callback_type callback) = 0;
 			virtual void log_debug(std::string module, std::string file, int line, std::string msg) const = 0;
 			virtual void log_error(std::string module, std::string file, int line, std::string msg) const = 0;
 			virtual nrpe::packet create_error(std::string msg) = 0;
@@ -16,6 +16,8 @@
 
 #pragma once
 
+#include <algorithm>
+
 #include <nrpe/packet.hpp>
 #include <boost/tuple/tuple.hpp>
 #include <boost/noncopyable.hpp>
@@ -24,30 +26,54 @@
 
 namespace nrpe {
 	namespace server {
+		/**
+		 * Reassembles request packets from the socket reads.
+		 * A packet which arrives in a single read is parsed directly from the read buffer, otherwise it
+		 * is collected in a buffer which is allocated once per connection.
+		 */
 		class parser : public boost::noncopyable {
 			unsigned int payload_length_;
 			unsigned int packet_length_;
 			std::vector<char> buffer_;
+			const char *in_place_;
+			nrpe::packet packet_;
 		public:
 			parser(unsigned int payload_length)
 				: payload_length_(payload_length)
-				, packet_length_(nrpe::length::get_packet_length(payload_length)) {}
+				, packet_length_(nrpe::length::get_packet_length(payload_length))
+				, in_place_(NULL)
+				, packet_(payload_length) {
+				buffer_.reserve(packet_length_);
+			}
 
-			template <typename InputIterator>
-			boost::tuple<bool, InputIterator> digest(InputIterator begin, InputIterator end) {
-				int count = packet_length_ - buffer_.size();
-				for (; count > 0 && begin != end; ++begin, --count)
-					buffer_.push_back(*begin);
-				return boost::make_tuple(buffer_.size() >= packet_length_, begin);
+			boost::tuple<bool, char*> digest(char *begin, char *end) {
+				if (buffer_.size() >= packet_length_)
+					buffer_.clear();
+				std::size_t available = end - begin;
+				if (buffer_.empty() && available >= packet_length_) {
+					in_place_ = begin;
+					return boost::make_tuple(true, begin + packet_length_);
+				}
+				std::size_t count = std::min<std::size_t>(packet_length_ - buffer_.size(), available);
+				buffer_.insert(buffer_.end(), begin, begin + count);
+				return boost::make_tuple(buffer_.size() >= packet_length_, begin + count);
 			}
 
-			nrpe::packet parse() {
-				nrpe::packet packet(buffer_, payload_length_);
-				buffer_.clear();
-				return packet;
+			/**
+			 * Parse the packet returned by digest, the view is valid until the next call to digest.
+			 */
+			nrpe::packet_view parse_view() {
+				const char *data = in_place_ != NULL ? in_place_ : &buffer_[0];
+				in_place_ = NULL;
+				return nrpe::frame::parse(data, packet_length_, payload_length_);
+			}
+			const nrpe::packet& parse() {
+				packet_.read_from(parse_view());
+				return packet_;
 			}
 			void reset() {
 				buffer_.clear();
+				in_place_ = NULL;
 			}
 		};
 	}// namespace server
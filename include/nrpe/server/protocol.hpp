@@ -44,7 +44,7 @@ namespace nrpe {
 	// on_write		-> done
 
 	static const int socket_bufer_size = 8096;
-	struct read_protocol : public boost::noncopyable {
+	struct read_protocol : public boost::noncopyable, public socket_helpers::server::async_protocol {
 		static const bool debug_trace = false;
 
 		typedef std::vector<char> outbound_buffer_type;
@@ -115,8 +115,14 @@ namespace nrpe {
 				boost::tie(result, begin) = parser_.digest(begin, end);
 				if (result) {
 					try {
-						nrpe::packet request = parser_.parse();
-						responses_ = handler_->handle(request);
+						resume_type resume = get_resume_handler();
+						if (resume) {
+							// The check is executed by the handler's pool, the connection resumes once the responses are set.
+							handler_->handle_async(parser_.parse(), get_remote(), boost::bind(&read_protocol::on_response, resume, this, _1));
+							begin_async();
+							return true;
+						}
+						responses_ = handler_->handle(parser_.parse());
 					} catch (const std::exception &e) {
 						responses_.push_back(handler_->create_error("Exception processing request: " + utf8::utf8_from_native(e.what())));
 					} catch (...) {
@@ -131,12 +137,19 @@ namespace nrpe {
 			}
 			return true;
 		}
+		static void on_response(resume_type resume, read_protocol *self, const std::list<nrpe::packet> &responses) {
+			resume(boost::bind(&read_protocol::set_responses, self, responses));
+		}
+		void set_responses(const std::list<nrpe::packet> &responses) {
+			responses_ = responses;
+			queue_next();
+		}
 		bool has_more_response() const {
 			return !responses_.empty();
 		}
 		void queue_next() {
 			try {
-				data_ = responses_.front().get_buffer();
+				responses_.front().write_to(data_);
 				responses_.pop_front();
 				if (has_more_response())
 					set_state(has_more);
@@ -152,7 +165,7 @@ namespace nrpe {
 			else
 				queue_next();
 		}
-		std::vector<char> get_outbound() const {
+		const outbound_buffer_type& get_outbound() const {
 			return data_;
 		}
 
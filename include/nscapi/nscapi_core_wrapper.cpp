@@ -48,6 +48,7 @@ nscapi::core_wrapper::core_wrapper()
 	, fNSAPIExpandPath(NULL)
 	, fNSAPIGetLoglevel(NULL)
 	, fNSAPIRegistryQuery(NULL)
+	, fNSAPIFetchMetrics(NULL)
 	, fNSCAPIJson2Protobuf(NULL)
 	, fNSCAPIProtobuf2Json(NULL)
 	, fNSCAPIEmitEvent(NULL)
@@ -258,6 +259,18 @@ bool nscapi::core_wrapper::registry_query(const std::string request, std::string
 	DestroyBuffer(&buffer);
 	return retC;
 }
+bool nscapi::core_wrapper::fetch_metrics(std::string &response) const {
+	if (!fNSAPIFetchMetrics)
+		throw nscapi::nscapi_exception("NSCore has not been initiated...");
+	char *buffer = NULL;
+	unsigned int buffer_size = 0;
+	bool retC = NSCAPI::api_ok(fNSAPIFetchMetrics(&buffer, &buffer_size));
+	if (buffer_size > 0 && buffer != NULL) {
+		response = std::string(buffer, buffer_size);
+	}
+	DestroyBuffer(&buffer);
+	return retC;
+}
 
 bool nscapi::core_wrapper::json_to_protobuf(const std::string &request, std::string &response) const {
 	char *buffer = NULL;
@@ -360,6 +373,7 @@ bool nscapi::core_wrapper::load_endpoints(nscapi::core_api::lpNSAPILoader f) {
 
 	fNSAPISettingsQuery = (nscapi::core_api::lpNSAPISettingsQuery)f("NSAPISettingsQuery");
 	fNSAPIRegistryQuery = (nscapi::core_api::lpNSAPIRegistryQuery)f("NSAPIRegistryQuery");
+	fNSAPIFetchMetrics = (nscapi::core_api::lpNSAPIFetchMetrics)f("NSAPIFetchMetrics");
 	fNSAPIExpandPath = (nscapi::core_api::lpNSAPIExpandPath)f("NSAPIExpandPath");
 
 	fNSAPIGetLoglevel = (nscapi::core_api::lpNSAPIGetLoglevel)f("NSAPIGetLoglevel");
@@ -41,6 +41,7 @@ namespace nscapi {
 		nscapi::core_api::lpNSAPIExpandPath fNSAPIExpandPath;
 		nscapi::core_api::lpNSAPIGetLoglevel fNSAPIGetLoglevel;
 		nscapi::core_api::lpNSAPIRegistryQuery fNSAPIRegistryQuery;
+		nscapi::core_api::lpNSAPIFetchMetrics fNSAPIFetchMetrics;
 		nscapi::core_api::lpNSCAPIJson2Protobuf fNSCAPIJson2Protobuf;
 		nscapi::core_api::lpNSCAPIProtobuf2Json fNSCAPIProtobuf2Json;
 		nscapi::core_api::lpNSCAPIEmitEvent fNSCAPIEmitEvent;
@@ -84,6 +85,7 @@ namespace nscapi {
 
 		NSCAPI::errorReturn registry_query(const char *request, const unsigned int request_len, char **response, unsigned int *response_len) const;
 		bool registry_query(const std::string request, std::string &response) const;
+		bool fetch_metrics(std::string &response) const;
 
 		bool load_endpoints(nscapi::core_api::lpNSAPILoader f);
 		void set_alias(const std::string default_alias, const std::string alias);
@@ -16,6 +16,10 @@
 
 #include <nscapi/nscapi_protobuf_functions.hpp>
 
+#include <cstdio>
+#include <cstring>
+#include <clocale>
+
 #define THROW_INVALID_SIZE(size) \
 	throw nscapi_exception(std::string("Whoops, invalid payload size: ") + strEx::s::xtos(size) + " != 1 at line " + strEx::s::xtos(__LINE__));
 
@@ -602,155 +606,231 @@ namespace nscapi {
 			return "unknown";
 		}
 
-		void functions::parse_performance_data(Plugin::QueryResponseMessage::Response::Line *payload, const std::string &perff) {
-			std::string perf = perff;
-			// TODO: make this work with const!
-
-			const std::string perf_separator = " ";
-			const std::string perf_lable_enclosure = "'";
-			const std::string perf_equal_sign = "=";
-			const std::string perf_item_splitter = ";";
-			const std::string perf_valid_number = "0123456789,.-";
-
-			while (true) {
-				if (perf.size() == 0)
-					return;
-				std::string::size_type p = 0;
-				p = perf.find_first_not_of(perf_separator, p);
-				if (p != 0)
-					perf = perf.substr(p);
-				if (perf[0] == perf_lable_enclosure[0]) {
-					p = perf.find(perf_lable_enclosure[0], 1) + 1;
-					if (p == std::string::npos)
+		namespace perf_data {
+			const char separator = ' ';
+			const char label_enclosure = '\'';
+			const char equal_sign = '=';
+			const char item_splitter = ';';
+
+			inline bool is_number(char c) {
+				return (c >= '0' && c <= '9') || c == ',' || c == '.' || c == '-';
+			}
+			inline const char* find(const char *begin, const char *end, char c) {
+				while (begin != end && *begin != c)
+					++begin;
+				return begin;
+			}
+
+			// Same result as trim_to_double(std::string(begin, end)) without the temporary strings.
+			// Numbers with at most 15 digits and 22 decimals are exact as a single division, the rest
+			// go through the lexical_cast based version.
+			double to_double(const char *begin, const char *end) {
+				static const double pow10[] = { 1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+					1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22 };
+				const char *p = begin;
+				while (p != end && is_number(*p))
+					++p;
+				end = p;
+				p = begin;
+				bool negative = p != end && *p == '-';
+				if (negative)
+					++p;
+				unsigned long long mantissa = 0;
+				int digits = 0, decimals = 0;
+				bool dot = false, any = false;
+				for (; p != end; ++p) {
+					if (*p == '.' || *p == ',') {
+						if (dot)
+							return 0.0;
+						dot = true;
+					} else if (*p == '-') {
+						return 0.0;
+					} else {
+						any = true;
+						if (mantissa == 0 && *p == '0') {
+							if (dot)
+								decimals++;
+							continue;
+						}
+						if (++digits > 15)
+							return trim_to_double(std::string(begin, end));
+						mantissa = mantissa * 10 + (*p - '0');
+						if (dot)
+							decimals++;
+					}
+				}
+				if (!any)
+					return 0.0;
+				if (decimals > 22)
+					return trim_to_double(std::string(begin, end));
+				double value = static_cast<double>(mantissa) / pow10[decimals];
+				return negative ? -value : value;
+			}
+
+			void parse_item(Plugin::QueryResponseMessage::Response::Line *payload, const char *begin, const char *end) {
+				const char *item_end = find(begin, end, item_splitter);
+				const char *alias_end = find(begin, item_end, equal_sign);
+				const char *value = alias_end == item_end ? item_end : alias_end + 1;
+
+				const char *alias = begin;
+				if (alias != alias_end && *alias == label_enclosure && *(alias_end - 1) == label_enclosure) {
+					if (alias_end - alias < 2)
 						return;
+					++alias;
+					--alias_end;
 				}
-				p = perf.find(perf_separator, p);
-				if (p == 0)
+				if (alias == alias_end)
 					return;
-				std::string chunk;
-				if (p == std::string::npos) {
-					chunk = perf;
-					perf = std::string();
-				} else {
-					chunk = perf.substr(0, p);
-					p = perf.find_first_not_of(perf_separator, p);
-					if (p == std::string::npos)
-						perf = std::string();
-					else
-						perf = perf.substr(p);
-				}
-				std::vector<std::string> items;
-				strEx::split(items, chunk, perf_item_splitter);
-				if (items.size() < 1) {
-					Plugin::Common::PerformanceData* perfData = payload->add_perf();
-					std::pair<std::string, std::string> fitem = strEx::split("", perf_equal_sign);
-					perfData->set_alias("invalid");
-					Plugin::Common_PerformanceData_StringValue* stringPerfData = perfData->mutable_string_value();
-					stringPerfData->set_value("invalid performance data");
-					break;
-				}
-
-				std::pair<std::string, std::string> fitem = strEx::split(items[0], perf_equal_sign);
-				std::string alias = fitem.first;
-				if (alias.size() > 0 && alias[0] == perf_lable_enclosure[0] && alias[alias.size() - 1] == perf_lable_enclosure[0])
-					alias = alias.substr(1, alias.size() - 2);
-
-				if (alias.empty())
-					continue;
 				Plugin::Common::PerformanceData* perfData = payload->add_perf();
-				perfData->set_alias(alias);
+				perfData->set_alias(alias, alias_end - alias);
 				Plugin::Common_PerformanceData_FloatValue* floatPerfData = perfData->mutable_float_value();
 
-				std::string::size_type pstart = fitem.second.find_first_of(perf_valid_number);
-				if (pstart == std::string::npos) {
+				while (value != item_end && !is_number(*value))
+					++value;
+				if (value == item_end) {
 					floatPerfData->set_value(0);
-					continue;
+					return;
 				}
-				if (pstart != 0)
-					fitem.second = fitem.second.substr(pstart);
-				std::string::size_type pend = fitem.second.find_first_not_of(perf_valid_number);
-				if (pend == std::string::npos) {
-					floatPerfData->set_value(trim_to_double(fitem.second));
-				} else {
-					floatPerfData->set_value(trim_to_double(fitem.second.substr(0, pend)));
-					floatPerfData->set_unit(fitem.second.substr(pend));
+				const char *unit = value;
+				while (unit != item_end && is_number(*unit))
+					++unit;
+				floatPerfData->set_value(to_double(value, unit));
+				if (unit != item_end)
+					floatPerfData->set_unit(unit, item_end - unit);
+
+				for (int i = 1; i < 5 && item_end != end; i++) {
+					const char *item = item_end + 1;
+					item_end = find(item, end, item_splitter);
+					if (item == item_end)
+						continue;
+					double d = to_double(item, item_end);
+					if (i == 1)
+						floatPerfData->set_warning(d);
+					else if (i == 2)
+						floatPerfData->set_critical(d);
+					else if (i == 3)
+						floatPerfData->set_minimum(d);
+					else
+						floatPerfData->set_maximum(d);
 				}
-				if (items.size() >= 2 && items[1].size() > 0)
-					floatPerfData->set_warning(trim_to_double(items[1]));
-				if (items.size() >= 3 && items[2].size() > 0)
-					floatPerfData->set_critical(trim_to_double(items[2]));
-				if (items.size() >= 4 && items[3].size() > 0)
-					floatPerfData->set_minimum(trim_to_double(items[3]));
-				if (items.size() >= 5 && items[4].size() > 0)
-					floatPerfData->set_maximum(trim_to_double(items[4]));
+			}
+
+			// Same output as strEx::s::xtos_non_sci(double) appended to the buffer.
+			void append_double(std::string &buffer, double value) {
+				// Worst case is -DBL_MAX with 20 decimals (~330 characters)
+				char tmp[400];
+				int len = std::sprintf(tmp, "%.*f", value < 10 ? 20 : 6, value);
+				if (len <= 0)
+					return;
+				// iostreams always format using the "C" locale.
+				const char *dp = std::localeconv()->decimal_point;
+				if (dp != NULL && dp[0] != '.' && dp[0] != '\0') {
+					std::size_t dp_len = std::strlen(dp);
+					char *pos = std::strstr(tmp, dp);
+					if (pos != NULL) {
+						*pos = '.';
+						std::memmove(pos + 1, pos + dp_len, tmp + len - (pos + dp_len) + 1);
+						len -= static_cast<int>(dp_len) - 1;
+					}
+				}
+				const char *dot = static_cast<const char*>(std::memchr(tmp, '.', len));
+				if (dot == NULL) {
+					buffer.append(tmp, len);
+					return;
+				}
+				const char *end = tmp + len;
+				if (end - dot > 6)
+					end = dot + 6;
+				while (end - 1 > dot && *(end - 1) == '0')
+					--end;
+				if (end - 1 == dot)
+					--end;
+				buffer.append(tmp, end - tmp);
+			}
+			void append_int(std::string &buffer, long long value) {
+				char tmp[24];
+				char *p = tmp + sizeof(tmp);
+				unsigned long long v = value < 0 ? 0ull - static_cast<unsigned long long>(value) : static_cast<unsigned long long>(value);
+				do {
+					*--p = static_cast<char>('0' + v % 10);
+					v /= 10;
+				} while (v != 0);
+				if (value < 0)
+					*--p = '-';
+				buffer.append(p, tmp + sizeof(tmp) - p);
+			}
+
+			template<class value_type, class appender_type>
+			void append_thresholds(std::string &buffer, const value_type &val, appender_type append) {
+				if (!val.has_warning() && !val.has_critical() && !val.has_minimum() && !val.has_maximum())
+					return;
+				buffer += item_splitter;
+				if (val.has_warning())
+					append(buffer, val.warning());
+				if (!val.has_critical() && !val.has_minimum() && !val.has_maximum())
+					return;
+				buffer += item_splitter;
+				if (val.has_critical())
+					append(buffer, val.critical());
+				if (!val.has_minimum() && !val.has_maximum())
+					return;
+				buffer += item_splitter;
+				if (val.has_minimum())
+					append(buffer, val.minimum());
+				if (!val.has_maximum())
+					return;
+				buffer += item_splitter;
+				append(buffer, val.maximum());
 			}
 		}
 
-		std::string functions::build_performance_data(Plugin::QueryResponseMessage::Response::Line const &payload) {
-			std::stringstream ss;
-			ss.precision(5);
+		void functions::parse_performance_data(Plugin::QueryResponseMessage::Response::Line *payload, const std::string &perf) {
+			const char *p = perf.data();
+			const char *end = p + perf.size();
+			while (true) {
+				while (p != end && *p == perf_data::separator)
+					++p;
+				if (p == end)
+					return;
+				// Quoted labels can contain spaces: start looking for the separator after the closing quote.
+				const char *item_end = p;
+				if (*p == perf_data::label_enclosure) {
+					const char *quote = perf_data::find(p + 1, end, perf_data::label_enclosure);
+					if (quote != end)
+						item_end = quote + 1;
+				}
+				item_end = perf_data::find(item_end, end, perf_data::separator);
+				perf_data::parse_item(payload, p, item_end);
+				p = item_end;
+			}
+		}
 
-			bool first = true;
+		std::string functions::build_performance_data(Plugin::QueryResponseMessage::Response::Line const &payload) {
+			std::string buffer;
+			buffer.reserve(payload.perf_size() * 48);
 			for (int i = 0; i < payload.perf_size(); i++) {
-				Plugin::Common::PerformanceData perfData = payload.perf(i);
-				if (!first)
-					ss << " ";
-				first = false;
-				ss << '\'' << perfData.alias() << "'=";
+				const Plugin::Common::PerformanceData &perfData = payload.perf(i);
+				if (i > 0)
+					buffer += perf_data::separator;
+				buffer += perf_data::label_enclosure;
+				buffer += perfData.alias();
+				buffer += perf_data::label_enclosure;
+				buffer += perf_data::equal_sign;
 				if (perfData.has_float_value()) {
-					Plugin::Common_PerformanceData_FloatValue fval = perfData.float_value();
-
-					ss << strEx::s::xtos_non_sci(fval.value());
+					const Plugin::Common_PerformanceData_FloatValue &fval = perfData.float_value();
+					perf_data::append_double(buffer, fval.value());
 					if (fval.has_unit())
-						ss << fval.unit();
-					if (!fval.has_warning() && !fval.has_critical() && !fval.has_minimum() && !fval.has_maximum())
-						continue;
-					ss << ";";
-					if (fval.has_warning())
-						ss << strEx::s::xtos_non_sci(fval.warning());
-					if (!fval.has_critical() && !fval.has_minimum() && !fval.has_maximum())
-						continue;
-					ss << ";";
-					if (fval.has_critical())
-						ss << strEx::s::xtos_non_sci(fval.critical());
-					if (!fval.has_minimum() && !fval.has_maximum())
-						continue;
-					ss << ";";
-					if (fval.has_minimum())
-						ss << strEx::s::xtos_non_sci(fval.minimum());
-					if (!fval.has_maximum())
-						continue;
-					ss << ";";
-					if (fval.has_maximum())
-						ss << strEx::s::xtos_non_sci(fval.maximum());
+						buffer += fval.unit();
+					perf_data::append_thresholds(buffer, fval, &perf_data::append_double);
 				} else if (perfData.has_int_value()) {
-					Plugin::Common_PerformanceData_IntValue fval = perfData.int_value();
-					ss << fval.value();
-					if (fval.has_unit())
-						ss << fval.unit();
-					if (!fval.has_warning() && !fval.has_critical() && !fval.has_minimum() && !fval.has_maximum())
-						continue;
-					ss << ";";
-					if (fval.has_warning())
-						ss << fval.warning();
-					if (!fval.has_critical() && !fval.has_minimum() && !fval.has_maximum())
-						continue;
-					ss << ";";
-					if (fval.has_critical())
-						ss << fval.critical();
-					if (!fval.has_minimum() && !fval.has_maximum())
-						continue;
-					ss << ";";
-					if (fval.has_minimum())
-						ss << fval.minimum();
-					if (!fval.has_maximum())
-						continue;
-					ss << ";";
-					if (fval.has_maximum())
-						ss << fval.maximum();
+					const Plugin::Common_PerformanceData_IntValue &ival = perfData.int_value();
+					perf_data::append_int(buffer, ival.value());
+					if (ival.has_unit())
+						buffer += ival.unit();
+					perf_data::append_thresholds(buffer, ival, &perf_data::append_int);
 				}
 			}
-			return ss.str();
+			return buffer;
 		}
 
 		Plugin::Common::ResultCode functions::nagios_status_to_gpb(int ret) {
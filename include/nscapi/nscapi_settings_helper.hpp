@@ -27,6 +27,8 @@
 #include <boost/foreach.hpp>
 #include <boost/filesystem/path.hpp>
 #include <boost/lexical_cast.hpp>
+#include <boost/tuple/tuple.hpp>
+#include <boost/tuple/tuple_comparison.hpp>
 
 #include <utf8.hpp>
 
@@ -364,10 +366,14 @@ namespace nscapi {
 
 			virtual void notify(settings_impl_interface_ptr core_, std::string path) const {
 				if (store_to_) {
-					std::list<std::string> list = core_->get_keys(path);
+					settings_impl_interface::batch_query_list queries;
+					BOOST_FOREACH(std::string key, core_->get_keys(path)) {
+						queries.push_back(settings_impl_interface::batch_query(path, key, NSCAPI::key_string));
+					}
+					core_->get_batch(queries);
 					map_type result;
-					BOOST_FOREACH(std::string key, list) {
-						result[utf8::cvt<T>(key)] = utf8::cvt<T>(core_->get_string(path, key, ""));
+					BOOST_FOREACH(const settings_impl_interface::batch_query &q, queries) {
+						result[utf8::cvt<T>(q.key)] = utf8::cvt<T>(q.string_value);
 					}
 					*store_to_ = result;
 				}
@@ -384,12 +390,15 @@ namespace nscapi {
 
 			virtual void notify(settings_impl_interface_ptr core_, std::string path) const {
 				if (callback_) {
-					std::list<std::string> list = core_->get_keys(path);
-					BOOST_FOREACH(std::string key, list) {
-						std::string val = core_->get_string(path, key, "");
-						callback_(utf8::cvt<T>(key), utf8::cvt<T>(val));
+					settings_impl_interface::batch_query_list queries;
+					BOOST_FOREACH(std::string key, core_->get_keys(path)) {
+						queries.push_back(settings_impl_interface::batch_query(path, key, NSCAPI::key_string));
 					}
-					list = core_->get_sections(path);
+					core_->get_batch(queries);
+					BOOST_FOREACH(const settings_impl_interface::batch_query &q, queries) {
+						callback_(utf8::cvt<T>(q.key), utf8::cvt<T>(q.string_value));
+					}
+					std::list<std::string> list = core_->get_sections(path);
 					BOOST_FOREACH(std::string key, list) {
 						callback_(utf8::cvt<T>(key), T());
 					}
@@ -706,6 +715,106 @@ namespace nscapi {
 			std::string parent_;
 		};
 
+		//////////////////////////////////////////////////////////////////////////
+		/// Serves typed lookups from values fetched up front with get_batch.
+		/// Anything not prefetched (or any other call) is passed on to the wrapped instance.
+		class settings_read_cache : public settings_impl_interface {
+			typedef boost::tuple<std::string, std::string, NSCAPI::settings_type> cache_key;
+			typedef std::map<cache_key, batch_query> cache_type;
+			settings_impl_interface_ptr core_;
+			cache_type cache_;
+
+		public:
+			settings_read_cache(settings_impl_interface_ptr core) : core_(core) {}
+
+			void prefetch(batch_query_list &queries) {
+				core_->get_batch(queries);
+				BOOST_FOREACH(const batch_query &q, queries) {
+					cache_.insert(cache_type::value_type(cache_key(q.path, q.key, q.type), q));
+				}
+			}
+
+			virtual void register_path(std::string path, std::string title, std::string description, bool advanced, bool sample) {
+				core_->register_path(path, title, description, advanced, sample);
+			}
+			virtual void register_key(std::string path, std::string key, int type, std::string title, std::string description, std::string defValue, bool advanced, bool sample) {
+				core_->register_key(path, key, type, title, description, defValue, advanced, sample);
+			}
+			virtual void register_tpl(std::string path, std::string title, std::string icon, std::string description, std::string fields) {
+				core_->register_tpl(path, title, icon, description, fields);
+			}
+			virtual void begin_batch() {
+				core_->begin_batch();
+			}
+			virtual void end_batch() {
+				core_->end_batch();
+			}
+			virtual void get_batch(batch_query_list &queries) {
+				core_->get_batch(queries);
+			}
+
+			virtual std::string get_string(std::string path, std::string key, std::string def) {
+				const batch_query *q = find(path, key, NSCAPI::key_string);
+				if (q == NULL)
+					return core_->get_string(path, key, def);
+				return q->found ? q->string_value : def;
+			}
+			virtual void set_string(std::string path, std::string key, std::string value) {
+				cache_.erase(cache_key(path, key, NSCAPI::key_string));
+				core_->set_string(path, key, value);
+			}
+			virtual int get_int(std::string path, std::string key, int def) {
+				const batch_query *q = find(path, key, NSCAPI::key_integer);
+				if (q == NULL)
+					return core_->get_int(path, key, def);
+				return q->found ? q->int_value : def;
+			}
+			virtual void set_int(std::string path, std::string key, int value) {
+				cache_.erase(cache_key(path, key, NSCAPI::key_integer));
+				core_->set_int(path, key, value);
+			}
+			virtual bool get_bool(std::string path, std::string key, bool def) {
+				const batch_query *q = find(path, key, NSCAPI::key_bool);
+				if (q == NULL)
+					return core_->get_bool(path, key, def);
+				return q->found ? q->bool_value : def;
+			}
+			virtual void set_bool(std::string path, std::string key, bool value) {
+				cache_.erase(cache_key(path, key, NSCAPI::key_bool));
+				core_->set_bool(path, key, value);
+			}
+			virtual string_list get_sections(std::string path) {
+				return core_->get_sections(path);
+			}
+			virtual string_list get_keys(std::string path) {
+				return core_->get_keys(path);
+			}
+			virtual std::string expand_path(std::string key) {
+				return core_->expand_path(key);
+			}
+
+			virtual void err(const char* file, int line, std::string message) {
+				core_->err(file, line, message);
+			}
+			virtual void warn(const char* file, int line, std::string message) {
+				core_->warn(file, line, message);
+			}
+			virtual void info(const char* file, int line, std::string message) {
+				core_->info(file, line, message);
+			}
+			virtual void debug(const char* file, int line, std::string message) {
+				core_->debug(file, line, message);
+			}
+
+		private:
+			const batch_query* find(const std::string &path, const std::string &key, NSCAPI::settings_type type) const {
+				cache_type::const_iterator it = cache_.find(cache_key(path, key, type));
+				if (it == cache_.end())
+					return NULL;
+				return &it->second;
+			}
+		};
+
 		class settings_registry {
 			typedef std::list<boost::shared_ptr<key_info> > key_list;
 			typedef std::list<boost::shared_ptr<path_info> > path_list;
@@ -781,6 +890,13 @@ namespace nscapi {
 				core_->register_key(path, key, type, title, description, defaultValue, advanced, false);
 			}
 			void register_all() {
+				// Sub keys are looked up before the batch starts as lookups are not queued.
+				std::map<std::string, settings_impl_interface::string_list> subkeys;
+				BOOST_FOREACH(path_list::value_type v, paths_) {
+					if (!v->subkey_description.title.empty())
+						subkeys[v->path_name] = core_->get_keys(v->path_name);
+				}
+				core_->begin_batch();
 				BOOST_FOREACH(key_list::value_type v, keys_) {
 					if (v->key) {
 						if (v->has_parent()) {
@@ -795,13 +911,14 @@ namespace nscapi {
 				BOOST_FOREACH(path_list::value_type v, paths_) {
 					core_->register_path(v->path_name, v->description.title, v->description.description, v->description.advanced, v->is_sample);
 					if (!v->subkey_description.title.empty()) {
-						BOOST_FOREACH(const std::string &s, core_->get_keys(v->path_name))
+						BOOST_FOREACH(const std::string &s, subkeys[v->path_name])
 							core_->register_key(v->path_name, s, NSCAPI::key_string, v->subkey_description.title, v->subkey_description.description, "", v->description.advanced, v->is_sample);
 					}
 				}
 				BOOST_FOREACH(tpl_list_type::value_type v, tpl_) {
 					core_->register_tpl(v->path_name, v->description.title, v->description.icon, v->description.description, v->fields);
 				}
+				core_->end_batch();
 			}
 			void clear() {
 				keys_.clear();
@@ -813,13 +930,24 @@ namespace nscapi {
 			}
 
 			void notify() {
+				// Fetch all key values in one request and let the keys read them from the cache.
+				boost::shared_ptr<settings_read_cache> cache(new settings_read_cache(core_));
+				settings_impl_interface::batch_query_list queries;
+				BOOST_FOREACH(key_list::value_type v, keys_) {
+					if (v->key) {
+						if (v->has_parent())
+							queries.push_back(settings_impl_interface::batch_query(v->parent, v->key_name, v->key->get_type()));
+						queries.push_back(settings_impl_interface::batch_query(v->path, v->key_name, v->key->get_type()));
+					}
+				}
+				cache->prefetch(queries);
 				BOOST_FOREACH(key_list::value_type v, keys_) {
 					try {
 						if (v->key) {
 							if (v->has_parent())
-								v->key->notify(core_, v->parent, v->path, v->key_name);
+								v->key->notify(cache, v->parent, v->path, v->key_name);
 							else
-								v->key->notify(core_, v->path, v->key_name);
+								v->key->notify(cache, v->path, v->key_name);
 						}
 					} catch (const std::exception &e) {
 						core_->err(__FILE__, __LINE__, "Failed to notify " + v->key_name + ": " + utf8::utf8_from_native(e.what()));
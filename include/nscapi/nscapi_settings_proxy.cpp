@@ -18,6 +18,8 @@
 #include <nscapi/nscapi_protobuf_functions.hpp>
 #include <nscapi/nscapi_protobuf.hpp>
 
+#include <boost/foreach.hpp>
+
 template<class T>
 void report_errors(const T &response, nscapi::core_wrapper* core, const std::string &action) {
 	for (int i = 0; i < response.payload_size(); i++) {
@@ -26,30 +28,20 @@ void report_errors(const T &response, nscapi::core_wrapper* core, const std::str
 	}
 }
 void nscapi::settings_proxy::register_path(std::string path, std::string title, std::string description, bool advanced, bool sample) {
-	Plugin::SettingsRequestMessage request;
-	nscapi::protobuf::functions::create_simple_header(request.mutable_header());
-	Plugin::SettingsRequestMessage::Request *payload = request.add_payload();
-	payload->set_plugin_id(plugin_id_);
-	Plugin::SettingsRequestMessage::Request::Registration *regitem = payload->mutable_registration();
+	Plugin::SettingsRequestMessage::Request payload;
+	payload.set_plugin_id(plugin_id_);
+	Plugin::SettingsRequestMessage::Request::Registration *regitem = payload.mutable_registration();
 	regitem->mutable_node()->set_path(path);
 	regitem->mutable_info()->set_title(title);
 	regitem->mutable_info()->set_description(description);
 	regitem->mutable_info()->set_advanced(advanced);
 	regitem->mutable_info()->set_sample(sample);
-	std::string response_string;
-	core_->settings_query(request.SerializeAsString(), response_string);
-	Plugin::SettingsResponseMessage response;
-	if (!response.ParseFromString(response_string)) {
-		core_->log(NSCAPI::log_level::error, __FILE__, __LINE__, "Failed to de-serialize the payload for " + path);
-	}
-	report_errors(response, core_, "register" + path);
+	send_registration(payload, "register" + path);
 }
 void nscapi::settings_proxy::register_key(std::string path, std::string key, int type, std::string title, std::string description, std::string defValue, bool advanced, bool sample) {
-	Plugin::SettingsRequestMessage request;
-	nscapi::protobuf::functions::create_simple_header(request.mutable_header());
-	Plugin::SettingsRequestMessage::Request *payload = request.add_payload();
-	payload->set_plugin_id(plugin_id_);
-	Plugin::SettingsRequestMessage::Request::Registration *regitem = payload->mutable_registration();
+	Plugin::SettingsRequestMessage::Request payload;
+	payload.set_plugin_id(plugin_id_);
+	Plugin::SettingsRequestMessage::Request::Registration *regitem = payload.mutable_registration();
 	regitem->mutable_node()->set_key(key);
 	regitem->mutable_node()->set_path(path);
 	regitem->mutable_info()->set_title(title);
@@ -57,19 +49,13 @@ void nscapi::settings_proxy::register_key(std::string path, std::string key, int
 	regitem->mutable_info()->mutable_default_value()->set_string_data(defValue);
 	regitem->mutable_info()->set_advanced(advanced);
 	regitem->mutable_info()->set_sample(sample);
-	std::string response_string;
-	core_->settings_query(request.SerializeAsString(), response_string);
-	Plugin::SettingsResponseMessage response;
-	response.ParseFromString(response_string);
-	report_errors(response, core_, "register" + path + "." + key);
+	send_registration(payload, "register" + path + "." + key);
 }
 
 void nscapi::settings_proxy::register_tpl(std::string path, std::string title, std::string icon, std::string description, std::string fields) {
-	Plugin::SettingsRequestMessage request;
-	nscapi::protobuf::functions::create_simple_header(request.mutable_header());
-	Plugin::SettingsRequestMessage::Request *payload = request.add_payload();
-	payload->set_plugin_id(plugin_id_);
-	Plugin::SettingsRequestMessage::Request::Registration *regitem = payload->mutable_registration();
+	Plugin::SettingsRequestMessage::Request payload;
+	payload.set_plugin_id(plugin_id_);
+	Plugin::SettingsRequestMessage::Request::Registration *regitem = payload.mutable_registration();
 	regitem->mutable_node()->set_path(path);
 	regitem->mutable_info()->set_icon(icon);
 	regitem->mutable_info()->set_title(title);
@@ -77,13 +63,114 @@ void nscapi::settings_proxy::register_tpl(std::string path, std::string title, s
 	regitem->mutable_info()->set_advanced(false);
 	regitem->mutable_info()->set_sample(false);
 	regitem->set_fields(fields);
+	send_registration(payload, "register::tpl" + path);
+}
+
+void nscapi::settings_proxy::send_registration(Plugin::SettingsRequestMessage::Request &payload, const std::string &action) {
+	{
+		boost::mutex::scoped_lock lock(batch_mutex_);
+		if (batch_depth_ > 0) {
+			if (!batch_)
+				batch_.reset(new Plugin::SettingsRequestMessage());
+			batch_->add_payload()->Swap(&payload);
+			return;
+		}
+	}
+	Plugin::SettingsRequestMessage request;
+	nscapi::protobuf::functions::create_simple_header(request.mutable_header());
+	request.add_payload()->Swap(&payload);
 	std::string response_string;
 	core_->settings_query(request.SerializeAsString(), response_string);
 	Plugin::SettingsResponseMessage response;
-	response.ParseFromString(response_string);
-	report_errors(response, core_, "register::tpl" + path);
+	if (!response.ParseFromString(response_string)) {
+		core_->log(NSCAPI::log_level::error, __FILE__, __LINE__, "Failed to de-serialize the payload for " + action);
+	}
+	report_errors(response, core_, action);
+}
+
+void nscapi::settings_proxy::begin_batch() {
+	boost::mutex::scoped_lock lock(batch_mutex_);
+	batch_depth_++;
+}
+
+void nscapi::settings_proxy::end_batch() {
+	boost::shared_ptr<Plugin::SettingsRequestMessage> request;
+	{
+		boost::mutex::scoped_lock lock(batch_mutex_);
+		if (batch_depth_ == 0 || --batch_depth_ > 0)
+			return;
+		request.swap(batch_);
+	}
+	if (request && request->payload_size() > 0)
+		send_batch(*request);
 }
 
+void nscapi::settings_proxy::send_batch(Plugin::SettingsRequestMessage &request) {
+	nscapi::protobuf::functions::create_simple_header(request.mutable_header());
+	std::string response_string;
+	core_->settings_query(request.SerializeAsString(), response_string);
+	Plugin::SettingsResponseMessage response;
+	if (!response.ParseFromString(response_string)) {
+		core_->log(NSCAPI::log_level::error, __FILE__, __LINE__, "Failed to de-serialize the batched registration");
+		return;
+	}
+	report_errors(response, core_, "register batch");
+	// Older cores only handle the first payload of a request so anything not answered is sent again one by one.
+	for (int i = response.payload_size(); i < request.payload_size(); i++) {
+		Plugin::SettingsRequestMessage::Request *payload = request.mutable_payload(i);
+		send_registration(*payload, "register" + payload->registration().node().path());
+	}
+}
+
+void nscapi::settings_proxy::get_batch(batch_query_list &queries) {
+	if (queries.empty())
+		return;
+	// Every key is queried twice with different defaults: if both answers agree the key exists.
+	Plugin::SettingsRequestMessage request;
+	nscapi::protobuf::functions::create_simple_header(request.mutable_header());
+	BOOST_FOREACH(const batch_query &q, queries) {
+		for (int i = 0; i < 2; i++) {
+			Plugin::SettingsRequestMessage::Request *payload = request.add_payload();
+			payload->set_plugin_id(plugin_id_);
+			Plugin::SettingsRequestMessage::Request::Query *item = payload->mutable_query();
+			item->mutable_node()->set_key(q.key);
+			item->mutable_node()->set_path(q.path);
+			item->set_recursive(false);
+			if (q.type == NSCAPI::key_integer) {
+				item->set_type(Plugin::Common_DataType_INT);
+				item->mutable_default_value()->set_int_data(i == 0 ? -1 : -2);
+			} else if (q.type == NSCAPI::key_bool) {
+				item->set_type(Plugin::Common_DataType_BOOL);
+				item->mutable_default_value()->set_bool_data(i == 0);
+			} else {
+				item->set_type(Plugin::Common_DataType_STRING);
+				item->mutable_default_value()->set_string_data(i == 0 ? "" : "$$DUMMY_VALUE_DO_NOT_USE$$");
+			}
+		}
+	}
+
+	std::string response_string;
+	core_->settings_query(request.SerializeAsString(), response_string);
+	Plugin::SettingsResponseMessage response;
+	if (!response.ParseFromString(response_string) || response.payload_size() != request.payload_size())
+		return settings_impl_interface::get_batch(queries);
+
+	int i = 0;
+	BOOST_FOREACH(batch_query &q, queries) {
+		const Plugin::Common::AnyDataType &v1 = response.payload(i++).query().value();
+		const Plugin::Common::AnyDataType &v2 = response.payload(i++).query().value();
+		if (q.type == NSCAPI::key_integer) {
+			q.found = v1.int_data() == v2.int_data();
+			q.int_value = v1.int_data();
+		} else if (q.type == NSCAPI::key_bool) {
+			q.found = v1.bool_data() == v2.bool_data();
+			q.bool_value = v1.bool_data();
+		} else {
+			q.found = v1.string_data() == v2.string_data();
+			q.string_value = v1.string_data();
+		}
+	}
+}
 
 std::string nscapi::settings_proxy::get_string(std::string path, std::string key, std::string def) {
 	Plugin::SettingsRequestMessage request;
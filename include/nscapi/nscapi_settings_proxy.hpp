@@ -18,6 +18,9 @@
 
 #include <list>
 
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/mutex.hpp>
+
 #include <settings/settings_core.hpp>
 #include <settings/client/settings_client_interface.hpp>
 
@@ -25,14 +28,23 @@
 
 #include <nscapi/dll_defines.hpp>
 
+namespace Plugin {
+	class SettingsRequestMessage;
+	class SettingsRequestMessage_Request;
+}
+
 namespace nscapi {
 	class NSCAPI_EXPORT settings_proxy : public nscapi::settings_helper::settings_impl_interface {
 	private:
 		unsigned int plugin_id_;
 		nscapi::core_wrapper* core_;
 
+		boost::mutex batch_mutex_;
+		int batch_depth_;
+		boost::shared_ptr<Plugin::SettingsRequestMessage> batch_;
+
 	public:
-		settings_proxy(unsigned int plugin_id, nscapi::core_wrapper* core) : plugin_id_(plugin_id), core_(core) {}
+		settings_proxy(unsigned int plugin_id, nscapi::core_wrapper* core) : plugin_id_(plugin_id), core_(core), batch_depth_(0) {}
 
 		typedef std::list<std::string> string_list;
 
@@ -40,6 +52,10 @@ namespace nscapi {
 		virtual void register_key(std::string path, std::string key, int type, std::string title, std::string description, std::string defValue, bool advanced, bool sample);
 		virtual void register_tpl(std::string path, std::string title, std::string icon, std::string description, std::string fields);
 
+		virtual void begin_batch();
+		virtual void end_batch();
+		virtual void get_batch(batch_query_list &queries);
+
 		virtual std::string get_string(std::string path, std::string key, std::string def);
 		virtual void set_string(std::string path, std::string key, std::string value);
 		virtual int get_int(std::string path, std::string key, int def);
@@ -55,5 +71,9 @@ namespace nscapi {
 		virtual void info(const char* file, int line, std::string message);
 		virtual void debug(const char* file, int line, std::string message);
 		void save(const std::string context = "");
+
+	private:
+		void send_registration(Plugin::SettingsRequestMessage_Request &payload, const std::string &action);
+		void send_batch(Plugin::SettingsRequestMessage &request);
 	};
 }
\ No newline at end of file
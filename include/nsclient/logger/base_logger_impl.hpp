@@ -53,6 +53,8 @@ namespace nsclient {
 				is_running_ = true;
 				return true;
 			}
+			virtual void flush() {}
+			virtual void fetch_metrics(log_metrics_type &) const {}
 			bool is_started() const {
 				return is_running_;
 			}
@@ -142,6 +144,7 @@ namespace nsclient {
 			void raw(const std::string &message) {
 				do_log(message);
 			}
+			virtual void fetch_metrics(std::map<std::string, long long> &) const {}
 
 			virtual void do_log(const std::string data) = 0;
 		};
@@ -20,17 +20,20 @@
 
 #include <boost/shared_ptr.hpp>
 
+#include <map>
 #include <string>
 
 namespace nsclient {
 	namespace logging {
 
+		typedef std::map<std::string, long long> log_metrics_type;
 
 		struct log_driver_interface {
 
 			log_driver_interface() {}
 			virtual ~log_driver_interface() {}
 			virtual void do_log(const std::string data) = 0;
+			virtual void flush() = 0;
 			virtual void synch_configure() = 0;
 			virtual void asynch_configure() = 0;
 
@@ -42,6 +45,7 @@ namespace nsclient {
 			virtual bool is_oneline() const = 0;
 			virtual bool is_no_std_err() const = 0;
 			virtual bool is_started() const = 0;
+			virtual void fetch_metrics(log_metrics_type &metrics) const = 0;
 
 		};
 
@@ -18,6 +18,7 @@
 
 #include <boost/shared_ptr.hpp>
 
+#include <map>
 #include <string>
 
 #define LOG_CRITICAL_CORE(msg) { get_logger()->critical("core", __FILE__, __LINE__, msg);}
@@ -72,6 +73,7 @@ namespace nsclient {
 			virtual std::string get_log_level() const = 0;
 
 			virtual void set_backend(std::string backend) = 0;
+			virtual void fetch_metrics(std::map<std::string, long long> &metrics) const = 0;
 		};
 		typedef boost::shared_ptr<logger> logger_instance;
 	}
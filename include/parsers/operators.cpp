@@ -15,8 +15,11 @@
  */
 
 #include <iostream>
+#include <list>
 
 #include <boost/regex.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/unordered_map.hpp>
 #include <boost/foreach.hpp>
 #include <boost/optional.hpp>
 #include <boost/make_shared.hpp>
@@ -25,6 +28,7 @@
 #include <parsers/operators.hpp>
 #include <parsers/helpers.hpp>
 #include <parsers/where/helpers.hpp>
+#include <parsers/where/value_node.hpp>
 
 namespace parsers {
 	namespace where {
@@ -261,37 +265,54 @@ namespace parsers {
 					return value_container::create_int(s2.find(s1) != std::string::npos, lhs.is_unsure || rhs.is_unsure);
 				}
 			};
-			struct operator_regexp : public simple_bool_binary_operator_impl {
-				value_container eval_int(value_type type, evaluation_context errors, const node_type left, const node_type right) const {
-					errors->error("Like not supported on numbers...");
-					return value_container::create_nil();
-				};
-				value_container eval_float(value_type type, evaluation_context errors, const node_type left, const node_type right) const {
-					errors->error("Like not supported on numbers...");
-					return value_container::create_nil();
-				};
-				value_container eval_string(value_type type, evaluation_context errors, const node_type left, const node_type right) const {
-					value_container lhs = left->get_value(errors, type_string);
-					value_container rhs = right->get_value(errors, type_string);
-					if (!lhs.is(type_string) || !rhs.is(type_string)) {
-						errors->error("invalid type");
-						return value_container::create_nil();
+			// Bounded LRU cache of compiled expressions used when the pattern is not a constant.
+			class regexp_cache {
+				typedef boost::shared_ptr<boost::regex> regex_type;
+				typedef std::list<std::pair<std::string, regex_type> > lru_type;
+				typedef boost::unordered_map<std::string, lru_type::iterator> index_type;
+				static const std::size_t max_size = 32;
+
+				lru_type lru_;
+				index_type index_;
+				boost::mutex mutex_;
+			public:
+				regex_type get(const std::string &pattern) {
+					boost::mutex::scoped_lock lock(mutex_);
+					index_type::iterator it = index_.find(pattern);
+					if (it != index_.end()) {
+						lru_.splice(lru_.begin(), lru_, it->second);
+						return it->second->second;
 					}
-					std::string str = lhs.get_string();
-					std::string regexp = rhs.get_string();
+					regex_type re = boost::make_shared<boost::regex>(pattern);
+					lru_.push_front(std::make_pair(pattern, re));
+					index_[pattern] = lru_.begin();
+					if (lru_.size() > max_size) {
+						index_.erase(lru_.back().first);
+						lru_.pop_back();
+					}
+					return re;
+				}
+			};
+
+			struct operator_regexp_base : public simple_bool_binary_operator_impl {
+				bool negate_;
+				boost::optional<std::string> constant_;
+				boost::optional<boost::regex> compiled_;
+				mutable regexp_cache cache_;
+
+				// Constant patterns are compiled once here when the operator is bound.
+				operator_regexp_base(bool negate, const node_type right) : negate_(negate) {
+					boost::shared_ptr<string_value> str = boost::dynamic_pointer_cast<string_value>(right);
+					if (!str)
+						return;
+					constant_ = str->value_;
 					try {
-						boost::regex re(regexp);
-						return value_container::create_int(boost::regex_match(str, re), lhs.is_unsure || rhs.is_unsure);
-					} catch (const boost::bad_expression e) {
-						errors->error("Invalid syntax in regular expression:" + regexp);
-						return value_container::create_nil();
+						compiled_ = boost::regex(*constant_);
 					} catch (...) {
-						errors->error("Invalid syntax in regular expression:" + regexp);
-						return value_container::create_nil();
+						// Reported on evaluation
 					}
 				}
-			};
-			struct operator_not_regexp : public simple_bool_binary_operator_impl {
+
 				value_container eval_int(value_type type, evaluation_context errors, const node_type left, const node_type right) const {
 					errors->error("Like not supported on numbers...");
 					return value_container::create_nil();
@@ -302,25 +323,39 @@ namespace parsers {
 				};
 				value_container eval_string(value_type type, evaluation_context errors, const node_type left, const node_type right) const {
 					value_container lhs = left->get_value(errors, type_string);
+					if (!lhs.is(type_string)) {
+						errors->error("invalid type");
+						return value_container::create_nil();
+					}
+					if (constant_) {
+						if (!compiled_) {
+							errors->error("Invalid syntax in regular expression:" + *constant_);
+							return value_container::create_nil();
+						}
+						return value_container::create_int(boost::regex_match(*lhs.s_value, *compiled_) != negate_, lhs.is_unsure);
+					}
 					value_container rhs = right->get_value(errors, type_string);
-					if (!lhs.is(type_string) || !rhs.is(type_string)) {
+					if (!rhs.is(type_string)) {
 						errors->error("invalid type");
 						return value_container::create_nil();
 					}
-					std::string str = lhs.get_string();
-					std::string regexp = rhs.get_string();
 					try {
-						boost::regex re(regexp);
-						return value_container::create_int(!boost::regex_match(str, re), lhs.is_unsure || rhs.is_unsure);
+						return value_container::create_int(boost::regex_match(*lhs.s_value, *cache_.get(*rhs.s_value)) != negate_, lhs.is_unsure || rhs.is_unsure);
 					} catch (const boost::bad_expression e) {
-						errors->error("Invalid syntax in regular expression:" + regexp);
+						errors->error("Invalid syntax in regular expression:" + *rhs.s_value);
 						return value_container::create_nil();
 					} catch (...) {
-						errors->error("Invalid syntax in regular expression:" + regexp);
+						errors->error("Invalid syntax in regular expression:" + *rhs.s_value);
 						return value_container::create_nil();
 					}
 				}
 			};
+			struct operator_regexp : public operator_regexp_base {
+				operator_regexp(const node_type right) : operator_regexp_base(false, right) {}
+			};
+			struct operator_not_regexp : public operator_regexp_base {
+				operator_not_regexp(const node_type right) : operator_regexp_base(true, right) {}
+			};
 			struct operator_not_like : public simple_bool_binary_operator_impl {
 				value_container eval_int(value_type type, evaluation_context errors, const node_type left, const node_type right) const {
 					errors->error("Like not supported on numbers...");
@@ -536,7 +571,7 @@ namespace parsers {
 			};
 		}
 
-		op_factory::bin_op_type op_factory::get_binary_operator(operators op, const node_type, const node_type) {
+		op_factory::bin_op_type op_factory::get_binary_operator(operators op, const node_type, const node_type right) {
 			// op_in, op_nin
 			if (op == op_eq)
 				return op_factory::bin_op_type(new operator_impl::operator_eq());
@@ -555,9 +590,9 @@ namespace parsers {
 			if (op == op_not_like)
 				return op_factory::bin_op_type(new operator_impl::operator_not_like());
 			if (op == op_regexp)
-				return op_factory::bin_op_type(new operator_impl::operator_regexp());
+				return op_factory::bin_op_type(new operator_impl::operator_regexp(right));
 			if (op == op_not_regexp)
-				return op_factory::bin_op_type(new operator_impl::operator_not_regexp());
+				return op_factory::bin_op_type(new operator_impl::operator_not_regexp(right));
 
 			if (op == op_and)
 				return op_factory::bin_op_type(new operator_impl::operator_and());
@@ -26,15 +26,19 @@ namespace parsers {
 			return true;
 		}
 		node_type binary_op::evaluate(evaluation_context errors) const {
-			op_factory::bin_op_type impl = op_factory::get_binary_operator(op, left, right);
 			if (is_int() || is_string()) {
-				return impl->evaluate(errors, left, right);
+				if (impl)
+					return impl->evaluate(errors, left, right);
+				return op_factory::get_binary_operator(op, left, right)->evaluate(errors, left, right);
 			}
 			errors->error("Missing operator implementation");
 			return factory::create_false();
 		}
 		bool binary_op::bind(object_converter errors) {
-			return left->bind(errors) && right->bind(errors);
+			bool ret = left->bind(errors) && right->bind(errors);
+			// The operator is resolved once here so it can prepare itself (i.e. compile constant expressions)
+			impl = op_factory::get_binary_operator(op, left, right);
+			return ret;
 		}
 
 		value_container binary_op::get_value(evaluation_context errors, value_type type) const {
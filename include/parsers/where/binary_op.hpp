@@ -41,11 +41,16 @@ namespace parsers {
 			virtual bool static_evaluate(evaluation_context contxt) const;
 			virtual bool require_object(evaluation_context contxt) const;
 
+			operators get_op() const { return op; }
+			node_type get_left() const { return left; }
+			node_type get_right() const { return right; }
+
 		private:
 			binary_op() {}
 			operators op;
 			node_type left;
 			node_type right;
+			boost::shared_ptr<binary_operator_impl> impl;
 		};
 	}
 }
\ No newline at end of file
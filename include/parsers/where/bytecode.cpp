@@ -0,0 +1,430 @@
+/*
+ * Copyright 2004-2016 The NSClient++ Authors - https://nsclient.org
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <sstream>
+
+#include <boost/algorithm/string/case_conv.hpp>
+
+#include <strEx.h>
+
+#include <parsers/where/bytecode.hpp>
+#include <parsers/where/binary_op.hpp>
+#include <parsers/where/unary_op.hpp>
+#include <parsers/where/value_node.hpp>
+#include <parsers/where/helpers.hpp>
+
+namespace parsers {
+	namespace where {
+		void bytecode_program::slot::set(const value_container &v) {
+			has_i = v.i_value.is_initialized();
+			if (has_i)
+				i = *v.i_value;
+			has_f = v.f_value.is_initialized();
+			if (has_f)
+				f = *v.f_value;
+			has_s = v.s_value.is_initialized();
+			if (has_s)
+				s.assign(*v.s_value);
+			is_unsure = v.is_unsure;
+		}
+		value_container bytecode_program::slot::get() const {
+			value_container ret(is_unsure);
+			if (has_i)
+				ret.set_int(i);
+			if (has_f)
+				ret.set_float(f);
+			if (has_s)
+				ret.set_string(s);
+			return ret;
+		}
+		long long bytecode_program::slot::get_int() const {
+			if (has_i)
+				return i;
+			if (has_f)
+				return static_cast<long long>(f);
+			throw filter_exception("Type is not int");
+		}
+		double bytecode_program::slot::get_float() const {
+			if (has_i)
+				return static_cast<double>(i);
+			if (has_f)
+				return f;
+			throw filter_exception("Type is not float");
+		}
+
+		void bytecode_program::clear() {
+			code_.clear();
+			constants_.clear();
+			stack_.clear();
+			depth_ = 0;
+			max_depth_ = 0;
+		}
+
+		bool bytecode_program::compile(node_type root, evaluation_context context) {
+			clear();
+			try {
+				emit(root, type_int, context);
+			} catch (const std::exception &e) {
+				context->error(std::string("Failed to compile filter: ") + e.what());
+			} catch (...) {
+				context->error("Failed to compile filter");
+			}
+			if (context->has_error() || depth_ != 1) {
+				clear();
+				return false;
+			}
+			stack_.resize(max_depth_);
+			return true;
+		}
+
+		value_container bytecode_program::evaluate(evaluation_context context) {
+			try {
+				if (execute(context, stack_, 0, code_.size()) == 1)
+					return stack_[0].get();
+				context->error("Evaluate exception: invalid program");
+			} catch (const std::exception &e) {
+				context->error(std::string("Evaluate exception: ") + e.what());
+			} catch (...) {
+				context->error("Evaluate exception");
+			}
+			return value_container::create_nil();
+		}
+
+		void bytecode_program::push(const instruction &i, int stack_delta) {
+			code_.push_back(i);
+			depth_ += stack_delta;
+			if (depth_ > max_depth_)
+				max_depth_ = depth_;
+		}
+
+		void bytecode_program::emit_load(node_type node, value_type type) {
+			instruction i(code_load);
+			i.node = node;
+			i.type = type;
+			push(i, 1);
+		}
+
+		// Emit code leaving the value of node (as type) on the stack, returns true if the result is a single constant.
+		bool bytecode_program::emit(node_type node, value_type type, evaluation_context context) {
+			if (boost::dynamic_pointer_cast<string_value>(node) || boost::dynamic_pointer_cast<int_value>(node) || boost::dynamic_pointer_cast<float_value>(node)) {
+				value_container v = node->get_value(context, type);
+				if (context->has_error()) {
+					// Conversion errors are reported on evaluation
+					context->clear();
+					emit_load(node, type);
+					return false;
+				}
+				slot c;
+				c.set(v);
+				constants_.push_back(c);
+				instruction i(code_const);
+				i.arg = constants_.size() - 1;
+				push(i, 1);
+				return true;
+			}
+			boost::shared_ptr<binary_op> bop = boost::dynamic_pointer_cast<binary_op>(node);
+			if (bop && (node->is_int() || node->is_string())) {
+				operators op = bop->get_op();
+				if (op == op_eq || op == op_ne || op == op_lt || op == op_le || op == op_gt || op == op_ge || op == op_like || op == op_not_like) {
+					return emit_compare(node, op, bop->get_left(), bop->get_right(), type, context);
+				}
+				if (op == op_and || op == op_or)
+					return emit_logic(node, op, bop->get_left(), bop->get_right(), type, context);
+			}
+			boost::shared_ptr<unary_op> uop = boost::dynamic_pointer_cast<unary_op>(node);
+			if (uop && uop->get_op() == op_not && uop->get_subject()->get_type() == type_bool) {
+				std::size_t start = code_.size();
+				bool is_const = emit(uop->get_subject(), type_int, context);
+				push(instruction(code_not), 0);
+				return emit_convert(start, type, is_const, context);
+			}
+			emit_load(node, type);
+			return false;
+		}
+
+		bool bytecode_program::emit_compare(node_type node, operators op, node_type left, node_type right, value_type type, evaluation_context context) {
+			// Same type resolution as the operator implementations
+			value_type ltype = left->get_type();
+			value_type rtype = right->get_type();
+			value_type mode = type_invalid;
+			if (helpers::type_is_int(ltype) && helpers::type_is_int(rtype))
+				mode = type_int;
+			else if (helpers::type_is_float(ltype) && helpers::type_is_float(rtype))
+				mode = type_float;
+			else if (ltype != rtype && rtype != type_tbd)
+				mode = type_invalid;
+			else if (helpers::type_is_int(ltype))
+				mode = type_int;
+			else if (helpers::type_is_float(ltype))
+				mode = type_float;
+			else if (ltype == type_string)
+				mode = type_string;
+			bool is_like = op == op_like || op == op_not_like;
+			if (mode == type_invalid || (is_like && mode != type_string)) {
+				emit_load(node, type);
+				return false;
+			}
+
+			std::size_t start = code_.size();
+			bool lhs_const = emit(left, mode, context);
+			bool rhs_const = emit(right, mode, context);
+			instruction i(is_like ? code_like : code_compare);
+			i.op = op;
+			i.type = mode;
+			int delta = -1;
+			if (rhs_const) {
+				i.arg = code_.back().arg;
+				code_.pop_back();
+				depth_--;
+				delta = 0;
+				if (is_like)
+					boost::algorithm::to_lower(constants_[i.arg].s);
+			}
+			push(i, delta);
+			return emit_convert(start, type, lhs_const && rhs_const, context);
+		}
+
+		bool bytecode_program::emit_logic(node_type node, operators op, node_type left, node_type right, value_type type, evaluation_context context) {
+			if (!helpers::type_is_int(left->get_type()) || !helpers::type_is_int(right->get_type())) {
+				emit_load(node, type);
+				return false;
+			}
+			std::size_t start = code_.size();
+			bool lhs_const = emit(left, type_int, context);
+			instruction jump(code_jump);
+			jump.op = op;
+			push(jump, 0);
+			std::size_t jump_pos = code_.size() - 1;
+			bool rhs_const = emit(right, type_int, context);
+			instruction logic(code_logic);
+			logic.op = op;
+			push(logic, -1);
+			code_[jump_pos].arg = code_.size();
+			return emit_convert(start, type, lhs_const && rhs_const, context);
+		}
+
+		// Operators produce int values, convert them as the (int) node returned by the tree would be converted.
+		bool bytecode_program::emit_convert(std::size_t start, value_type type, bool is_const, evaluation_context context) {
+			if (type != type_int) {
+				instruction i(code_convert);
+				i.type = type;
+				push(i, 0);
+			}
+			if (is_const)
+				return fold(start, context);
+			return false;
+		}
+
+		// Replace the code from start (which only depends on constants) with its result.
+		bool bytecode_program::fold(std::size_t start, evaluation_context context) {
+			std::vector<slot> stack(max_depth_ + 1);
+			try {
+				std::size_t sp = execute(context, stack, start, code_.size());
+				if (sp == 1 && !context->has_error() && !context->has_warn()) {
+					code_.erase(code_.begin() + start, code_.end());
+					constants_.push_back(stack[0]);
+					instruction i(code_const);
+					i.arg = constants_.size() - 1;
+					code_.push_back(i);
+					return true;
+				}
+			} catch (...) {}
+			context->clear();
+			return false;
+		}
+
+		void bytecode_program::compare(const instruction &i, slot &lhs, const slot &rhs, evaluation_context context) const {
+			bool unsure = lhs.is_unsure | rhs.is_unsure;
+			bool result = false;
+			if (i.type == type_int) {
+				if (!lhs.has_i || !rhs.has_i) {
+					context->error("invalid type");
+					lhs.set_int(0, false);
+					return;
+				}
+				long long l = lhs.get_int(), r = rhs.get_int();
+				result = i.op == op_eq ? l == r : i.op == op_ne ? l != r : i.op == op_lt ? l < r : i.op == op_le ? l <= r : i.op == op_gt ? l > r : l >= r;
+			} else if (i.type == type_float) {
+				if (!lhs.has_f || !rhs.has_f) {
+					context->error("invalid type");
+					lhs.set_int(0, false);
+					return;
+				}
+				double l = lhs.get_float(), r = rhs.get_float();
+				result = i.op == op_eq ? l == r : i.op == op_ne ? l != r : i.op == op_lt ? l < r : i.op == op_le ? l <= r : i.op == op_gt ? l > r : l >= r;
+				if (i.op == op_lt && !result)
+					unsure = rhs.is_unsure;
+			} else {
+				if (!lhs.has_s || !rhs.has_s) {
+					context->error("invalid type");
+					lhs.set_int(0, false);
+					return;
+				}
+				const std::string &l = lhs.s, &r = rhs.s;
+				result = i.op == op_eq ? l == r : i.op == op_ne ? l != r : i.op == op_lt ? l < r : i.op == op_le ? l <= r : i.op == op_gt ? l > r : l >= r;
+			}
+			lhs.set_int(result ? 1 : 0, unsure);
+		}
+
+		void bytecode_program::like(const instruction &i, slot &lhs, const slot &rhs, evaluation_context context) {
+			if (!lhs.has_s || !rhs.has_s) {
+				context->error("invalid type");
+				lhs.set_int(0, false);
+				return;
+			}
+			bool unsure = lhs.is_unsure || rhs.is_unsure;
+			lhs_buffer_.assign(lhs.s);
+			boost::algorithm::to_lower(lhs_buffer_);
+			const std::string *s2 = &rhs.s;
+			if (i.arg == no_arg) {
+				rhs_buffer_.assign(rhs.s);
+				boost::algorithm::to_lower(rhs_buffer_);
+				s2 = &rhs_buffer_;
+			}
+			const std::string &s1 = lhs_buffer_;
+			bool found;
+			if (s1.empty() && s2->empty())
+				found = true;
+			else if (s1.empty() || s2->empty())
+				found = false;
+			else if (s1.size() > s2->size())
+				found = s1.find(*s2) != std::string::npos;
+			else
+				found = s2->find(s1) != std::string::npos;
+			if (i.op == op_not_like)
+				found = !found;
+			lhs.set_int(found ? 1 : 0, unsure);
+		}
+
+		std::size_t bytecode_program::execute(evaluation_context context, std::vector<slot> &stack, std::size_t begin, std::size_t end) {
+			std::size_t sp = 0;
+			std::size_t pc = begin;
+			while (pc < end) {
+				const instruction &i = code_[pc++];
+				switch (i.code) {
+				case code_const:
+					stack[sp++] = constants_[i.arg];
+					break;
+				case code_load:
+					stack[sp++].set(i.node->get_value(context, i.type));
+					break;
+				case code_compare:
+				case code_like:
+					{
+						const slot *rhs = i.arg == no_arg ? &stack[--sp] : &constants_[i.arg];
+						if (i.code == code_compare)
+							compare(i, stack[sp - 1], *rhs, context);
+						else
+							like(i, stack[sp - 1], *rhs, context);
+					}
+					break;
+				case code_jump:
+					{
+						slot &top = stack[sp - 1];
+						long long v = top.get_int();
+						if (i.op == op_and && !v && !top.is_unsure) {
+							top.set_int(0, false);
+							pc = i.arg;
+						} else if (i.op == op_or && v && !top.is_unsure) {
+							top.set_int(1, false);
+							pc = i.arg;
+						}
+					}
+					break;
+				case code_logic:
+					{
+						const slot &rhs = stack[--sp];
+						slot &lhs = stack[sp - 1];
+						long long r = rhs.get_int();
+						if (i.op == op_and) {
+							if (!r && !rhs.is_unsure)
+								lhs.set_int(0, false);
+							else
+								lhs.set_int(lhs.get_int() && r ? 1 : 0, lhs.is_unsure | rhs.is_unsure);
+						} else {
+							if (r && !rhs.is_unsure)
+								lhs.set_int(1, false);
+							else
+								lhs.set_int(lhs.get_int() || r ? 1 : 0, lhs.is_unsure | rhs.is_unsure);
+						}
+					}
+					break;
+				case code_not:
+					{
+						slot &top = stack[sp - 1];
+						long long v = top.has_i ? top.i : top.has_f ? static_cast<long long>(top.f) : 0;
+						top.set_int(v ? 0 : 1, false);
+					}
+					break;
+				case code_convert:
+					{
+						slot &top = stack[sp - 1];
+						if (i.type == type_float) {
+							top.f = static_cast<double>(top.i);
+							top.has_f = true;
+							top.has_i = false;
+						} else if (i.type == type_string) {
+							top.s = strEx::s::xtos(top.i);
+							top.has_s = true;
+							top.has_i = false;
+						} else {
+							context->error("Failed to convert int to ?: " + helpers::type_to_string(i.type));
+							top.has_i = false;
+						}
+					}
+					break;
+				}
+			}
+			return sp;
+		}
+
+		std::string bytecode_program::to_string() const {
+			std::stringstream ss;
+			for (std::size_t pc = 0; pc < code_.size(); pc++) {
+				const instruction &i = code_[pc];
+				if (pc > 0)
+					ss << ", ";
+				switch (i.code) {
+				case code_const:
+					ss << "const " << constants_[i.arg].get().get_string("nil");
+					break;
+				case code_load:
+					ss << "load " << i.node->to_string();
+					break;
+				case code_compare:
+				case code_like:
+					ss << helpers::operator_to_string(i.op) << ":" << helpers::type_to_string(i.type);
+					if (i.arg != no_arg)
+						ss << " " << constants_[i.arg].get().get_string("nil");
+					break;
+				case code_jump:
+					ss << "jump-" << helpers::operator_to_string(i.op) << " " << i.arg;
+					break;
+				case code_logic:
+					ss << helpers::operator_to_string(i.op);
+					break;
+				case code_not:
+					ss << "not";
+					break;
+				case code_convert:
+					ss << "convert " << helpers::type_to_string(i.type);
+					break;
+				}
+			}
+			return ss.str();
+		}
+	}
+}
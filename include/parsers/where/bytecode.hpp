@@ -0,0 +1,118 @@
+/*
+ * Copyright 2004-2016 The NSClient++ Authors - https://nsclient.org
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include <parsers/where/node.hpp>
+#include <parsers/where/dll_defines.hpp>
+
+namespace parsers {
+	namespace where {
+		/**
+		 * A bound expression tree lowered into a flat list of typed instructions.
+		 * Comparisons, like and the logical operators are executed directly on a
+		 * small pre-allocated value stack (with short-circuit jumps for and/or)
+		 * and sub trees with only constants are folded when compiling.
+		 * Everything else (variables, functions, regular expressions, lists) is
+		 * evaluated through the node itself so the result is always the same as
+		 * when evaluating the tree.
+		 * A program keeps its stack between evaluations and is thus not thread safe.
+		 */
+		struct NSCAPI_EXPORT bytecode_program {
+			enum opcode_type {
+				code_const,		// push constants[arg]
+				code_load,		// push node->get_value(type)
+				code_compare,	// pop rhs (or use constants[arg]), compare with top using op in type mode
+				code_like,		// pop rhs (or use constants[arg]), (not) like with top
+				code_jump,		// short-circuit for op (and/or): if top decides the result jump to arg
+				code_logic,		// pop rhs and combine with top using op (and/or)
+				code_not,		// boolean not of top
+				code_convert	// convert the (int) top to type
+			};
+			static const std::size_t no_arg = static_cast<std::size_t>(-1);
+
+			struct instruction {
+				opcode_type code;
+				operators op;
+				value_type type;
+				std::size_t arg;
+				node_type node;
+				instruction(opcode_type code) : code(code), op(op_eq), type(type_int), arg(no_arg) {}
+			};
+
+			struct slot {
+				long long i;
+				double f;
+				std::string s;
+				bool has_i;
+				bool has_f;
+				bool has_s;
+				bool is_unsure;
+				slot() : i(0), f(0.0), has_i(false), has_f(false), has_s(false), is_unsure(false) {}
+
+				void set_int(long long value, bool unsure) {
+					i = value;
+					has_i = true;
+					has_f = has_s = false;
+					is_unsure = unsure;
+				}
+				void set(const value_container &v);
+				value_container get() const;
+				long long get_int() const;
+				double get_float() const;
+			};
+
+		private:
+			std::vector<instruction> code_;
+			std::vector<slot> constants_;
+			std::vector<slot> stack_;
+			std::size_t depth_;
+			std::size_t max_depth_;
+			std::string lhs_buffer_;
+			std::string rhs_buffer_;
+
+		public:
+			bytecode_program() : depth_(0), max_depth_(0) {}
+
+			/**
+			 * Compile a bound (and statically evaluated) tree.
+			 * On failure the program is left empty and the tree should be used instead.
+			 */
+			bool compile(node_type root, evaluation_context context);
+			value_container evaluate(evaluation_context context);
+			bool empty() const {
+				return code_.empty();
+			}
+			void clear();
+			std::string to_string() const;
+
+		private:
+			bool emit(node_type node, value_type type, evaluation_context context);
+			void emit_load(node_type node, value_type type);
+			bool emit_compare(node_type node, operators op, node_type left, node_type right, value_type type, evaluation_context context);
+			bool emit_logic(node_type node, operators op, node_type left, node_type right, value_type type, evaluation_context context);
+			bool emit_convert(std::size_t start, value_type type, bool is_const, evaluation_context context);
+			bool fold(std::size_t start, evaluation_context context);
+			void push(const instruction &i, int stack_delta);
+			void compare(const instruction &i, slot &lhs, const slot &rhs, evaluation_context context) const;
+			void like(const instruction &i, slot &lhs, const slot &rhs, evaluation_context context);
+			std::size_t execute(evaluation_context context, std::vector<slot> &stack, std::size_t begin, std::size_t end);
+		};
+	}
+}
@@ -53,6 +53,13 @@ namespace parsers {
 			if (error->is_debug())
 				error->log_debug("Static evaluation succeeded: " + ast_parser.result_as_tree());
 
+			if (!program.compile(ast_parser.resulting_tree, context)) {
+				if (error->is_debug())
+					error->log_debug("Compilation failed (using the tree instead): " + context->get_error());
+				context->clear();
+			} else if (error->is_debug())
+				error->log_debug("Compilation succeeded: " + program.to_string());
+
 			if (perf_collection) {
 				if (!ast_parser.collect_perfkeys(context, boundries) || context->has_error()) {
 					error->log_error("Collection of perfkeys failed: " + context->get_error());
@@ -74,7 +81,7 @@ namespace parsers {
 				return false;
 			if (!expect_object && require_object(context))
 				return false;
-			value_container v = ast_parser.evaluate(context);
+			value_container v = program.empty() ? ast_parser.evaluate(context) : program.evaluate(context);
 			if (context->has_error()) {
 				error->log_error(context->get_error() + ": " + ast_parser.result_as_tree(context));
 			}
@@ -17,6 +17,7 @@
 #pragma once
 
 #include <parsers/where/node.hpp>
+#include <parsers/where/bytecode.hpp>
 #include <parsers/where.hpp>
 #include <parsers/where/dll_defines.hpp>
 
@@ -37,6 +38,7 @@ namespace parsers {
 			typedef boost::shared_ptr<error_handler_interface> error_handler;
 			typedef parsers::where::evaluation_context execution_context_type;
 			parsers::where::parser ast_parser;
+			parsers::where::bytecode_program program;
 			std::string filter_string;
 			boost::optional<bool> requires_object;
 
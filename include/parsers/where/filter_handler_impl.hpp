@@ -18,6 +18,7 @@
 
 #include <map>
 #include <vector>
+#include <set>
 
 #include <boost/function.hpp>
 #include <boost/shared_ptr.hpp>
@@ -562,6 +563,16 @@ namespace parsers {
 			typedef function_registry<object_type> registry_type;
 
 			registry_type registry_;
+			// Variables and functions which have been bound by expressions or templates using this context
+			std::set<std::string> used_variables_;
+			std::set<std::string> used_functions_;
+
+			bool uses_variable(const std::string &name) const {
+				return used_variables_.find(name) != used_variables_.end();
+			}
+			bool uses_function(const std::string &name) const {
+				return used_functions_.find(name) != used_functions_.end();
+			}
 
 			std::string get_filter_syntax() const {
 				std::stringstream ss;
@@ -589,6 +600,7 @@ namespace parsers {
 				if (registry_.has_variable(name)) {
 					boost::shared_ptr<filter_variable<object_type> > var = registry_.get_variable(name, human_readable);
 					if (var) {
+						used_variables_.insert(name);
 						if (var->f_function) {
 							if (var->float_perf.empty() && var->add_default_perf) {
 								typename filter_variable<object_type>::float_perf_generator_type gen(new parsers::where::simple_number_performance_generator<object_type, double>("", "", "_" + var->name));
@@ -631,6 +643,7 @@ namespace parsers {
 					return parsers::where::factory::create_false();
 				boost::shared_ptr<filter_function> var = registry_.get_function(name);
 				if (var) {
+					used_functions_.insert(name);
 					if (helpers::type_is_int(var->type)) {
 						if (var->function)
 							return node_type(new custom_function_node(name, var->function, subject, var->type));
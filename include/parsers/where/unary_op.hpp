@@ -38,6 +38,9 @@ namespace parsers {
 			virtual bool static_evaluate(evaluation_context context) const;
 			virtual bool require_object(evaluation_context context) const;
 
+			operators get_op() const { return op; }
+			node_type get_subject() const { return subject; }
+
 		private:
 			unary_op() {}
 			operators op;
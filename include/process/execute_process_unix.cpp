@@ -15,76 +15,234 @@
  */
 
 #include <string>
+#include <set>
 #include <NSCAPI.h>
 #include <sys/types.h>
 #include <sys/wait.h>
 #include <unistd.h>
 #include <fcntl.h>
+#include <poll.h>
+#include <spawn.h>
 #include <signal.h>
-#include <stdio.h>
-#include <stdlib.h> 
 #include <errno.h>
+#include <string.h>
+
+#include <boost/thread/mutex.hpp>
+#include <boost/foreach.hpp>
+#include <boost/date_time/posix_time/posix_time_types.hpp>
 
 #include <process/execute_process.hpp>
-#include <buffer.hpp>
+#include <strEx.h>
+
+extern char **environ;
+
+#define BUFFER_SIZE 65536
+// Output beyond this is read (so the child does not block) but discarded
+#define MAX_OUTPUT_SIZE (1024*1024)
+// Time from SIGTERM until the process group is killed
+#define KILL_GRACE_MS 1000
 
-#define BUFFER_SIZE 4096
+namespace {
+	boost::mutex mutex_;
+	std::set<pid_t> groups_;
+
+	void register_group(pid_t pid) {
+		boost::mutex::scoped_lock lock(mutex_);
+		groups_.insert(pid);
+	}
+	void remove_group(pid_t pid) {
+		boost::mutex::scoped_lock lock(mutex_);
+		groups_.erase(pid);
+	}
 
-bool early_timeout = false;
-typedef hlp::buffer<char> buffer_type;
+	struct pipe_handle {
+		int fd[2];
+		pipe_handle() {
+			fd[0] = fd[1] = -1;
+		}
+		~pipe_handle() {
+			close_read();
+			close_write();
+		}
+		bool open() {
+			if (pipe(fd) != 0)
+				return false;
+			fcntl(fd[0], F_SETFD, FD_CLOEXEC);
+			fcntl(fd[1], F_SETFD, FD_CLOEXEC);
+			fcntl(fd[0], F_SETFL, fcntl(fd[0], F_GETFL) | O_NONBLOCK);
+			return true;
+		}
+		void close_read() {
+			if (fd[0] != -1)
+				close(fd[0]);
+			fd[0] = -1;
+		}
+		void close_write() {
+			if (fd[1] != -1)
+				close(fd[1]);
+			fd[1] = -1;
+		}
+	};
+
+	struct spawn_attributes {
+		posix_spawnattr_t attr;
+		posix_spawn_file_actions_t actions;
+		spawn_attributes() {
+			posix_spawnattr_init(&attr);
+			posix_spawn_file_actions_init(&actions);
+			// Run in a new process group (so we can kill everything the script starts) with default signal handling
+			sigset_t mask;
+			sigemptyset(&mask);
+			posix_spawnattr_setsigmask(&attr, &mask);
+			sigset_t def;
+			sigemptyset(&def);
+			sigaddset(&def, SIGPIPE);
+			sigaddset(&def, SIGCHLD);
+			sigaddset(&def, SIGTERM);
+			sigaddset(&def, SIGINT);
+			sigaddset(&def, SIGHUP);
+			posix_spawnattr_setsigdefault(&attr, &def);
+			posix_spawnattr_setpgroup(&attr, 0);
+			posix_spawnattr_setflags(&attr, POSIX_SPAWN_SETPGROUP | POSIX_SPAWN_SETSIGMASK | POSIX_SPAWN_SETSIGDEF);
+		}
+		~spawn_attributes() {
+			posix_spawn_file_actions_destroy(&actions);
+			posix_spawnattr_destroy(&attr);
+		}
+	};
+
+	pid_t spawn_shell(spawn_attributes &sa, const std::string &command) {
+		std::string sh = "/bin/sh", opt = "-c";
+		std::vector<char> cmd(command.begin(), command.end());
+		cmd.push_back(0);
+		char *argv[] = { &sh[0], &opt[0], &cmd[0], NULL };
+		pid_t pid;
+		int err = posix_spawn(&pid, "/bin/sh", &sa.actions, &sa.attr, argv, environ);
+		if (err != 0) {
+			errno = err;
+			return -1;
+		}
+		return pid;
+	}
 
-//extern int errno;
+	bool read_available(int fd, std::string &output, char *buffer) {
+		while (true) {
+			ssize_t count = read(fd, buffer, BUFFER_SIZE);
+			if (count > 0) {
+				if (output.size() < MAX_OUTPUT_SIZE)
+					output.append(buffer, std::min<std::size_t>(count, MAX_OUTPUT_SIZE - output.size()));
+				continue;
+			}
+			if (count == 0)
+				return false;
+			if (errno == EINTR)
+				continue;
+			return errno == EAGAIN || errno == EWOULDBLOCK;
+		}
+	}
 
-/* handle timeouts when executing commands via my_system() */
-void my_system_sighandler(int sig) {
-	//exit(NSCAPI::returnUNKNOWN);
-	printf("\n\n\nTIMEOUT TIMEOUT TIMEOUT\n\n\n");
+	long long ms_left(boost::posix_time::ptime deadline) {
+		return (deadline - boost::posix_time::microsec_clock::universal_time()).total_milliseconds();
+	}
 }
 
 void process::kill_all() {
-	// TODO: Fixme
+	boost::mutex::scoped_lock lock(mutex_);
+	BOOST_FOREACH(pid_t pid, groups_) {
+		kill(-pid, SIGKILL);
+	}
 }
 
-
 int process::execute_process(process::exec_arguments args, std::string &output) {
-	NSCAPI::nagiosReturn result;
-	int fd[2];
-	std::size_t bytes_read=0;
-	early_timeout=false;
-
-	pipe(fd);
-	//fcntl(fd[0],F_SETFL,O_NONBLOCK);
-	//fcntl(fd[1],F_SETFL,O_NONBLOCK);
-
-
-	//time(&start_time);
-
-	//signal(SIGALRM, my_system_sighandler);
-	//alarm(args.timeout);
+	spawn_attributes sa;
+	if (args.fork) {
+		// Let the shell background the command and exit at once so it is re-parented and we do not have to reap it
+		posix_spawn_file_actions_addopen(&sa.actions, 0, "/dev/null", O_RDONLY, 0);
+		posix_spawn_file_actions_addopen(&sa.actions, 1, "/dev/null", O_WRONLY, 0);
+		posix_spawn_file_actions_adddup2(&sa.actions, 1, 2);
+		pid_t pid = spawn_shell(sa, "(" + args.command + ") &");
+		if (pid == -1) {
+			output = "Failed to execute " + args.alias + ": " + strerror(errno);
+			return NSCAPI::query_return_codes::returnUNKNOWN;
+		}
+		int status;
+		while (waitpid(pid, &status, 0) == -1 && errno == EINTR);
+		output = "Command started successfully";
+		return NSCAPI::query_return_codes::returnOK;
+	}
 
-	FILE *fp = popen(args.command.c_str(), "r");
-	close(fd[1]);
-	if (fp == NULL) {
-		close(fd[0]);
-		output = "NRPE: Call to popen() failed";
+	pipe_handle out;
+	if (!out.open()) {
+		output = "Failed to create pipe for " + args.alias + ": " + strerror(errno);
 		return NSCAPI::query_return_codes::returnUNKNOWN;
-	} else {
-		buffer_type buffer(BUFFER_SIZE);
-		while ( (bytes_read=fread(buffer.get(),1,buffer.size()-1,fp)) >0 ) {
-			if (bytes_read > 0 && bytes_read < BUFFER_SIZE) {
-				buffer[bytes_read] = 0;
-				output += std::string(buffer.get());
-			}
+	}
+	// Only stdout is plugin output (as with popen), stderr is discarded so warnings do not end up in the message or performance data
+	posix_spawn_file_actions_addopen(&sa.actions, 0, "/dev/null", O_RDONLY, 0);
+	posix_spawn_file_actions_adddup2(&sa.actions, out.fd[1], 1);
+	posix_spawn_file_actions_addopen(&sa.actions, 2, "/dev/null", O_WRONLY, 0);
+
+	pid_t pid = spawn_shell(sa, args.command);
+	if (pid == -1) {
+		output = "Failed to execute " + args.alias + ": " + strerror(errno);
+		return NSCAPI::query_return_codes::returnUNKNOWN;
+	}
+	register_group(pid);
+	out.close_write();
+
+	boost::posix_time::ptime deadline = boost::posix_time::microsec_clock::universal_time() + boost::posix_time::seconds(args.timeout);
+	std::vector<char> buffer(BUFFER_SIZE);
+	bool exited = false, timed_out = false;
+	int status = 0;
+
+	// Read stdout until it is closed or the process has exited (a background child might keep the pipe open)
+	while (out.fd[0] != -1) {
+		long long left = ms_left(deadline);
+		if (left <= 0) {
+			timed_out = true;
+			break;
+		}
+		struct pollfd fds;
+		fds.fd = out.fd[0];
+		fds.events = POLLIN;
+		fds.revents = 0;
+		int ret = poll(&fds, 1, static_cast<int>(std::min<long long>(left, exited ? 0 : 100)));
+		if (ret < 0 && errno != EINTR)
+			break;
+		if (ret > 0 && fds.revents != 0) {
+			if (!read_available(fds.fd, output, &buffer[0]))
+				out.close_read();
 		}
+		if (exited)
+			break;
+		if (!exited && waitpid(pid, &status, WNOHANG) == pid)
+			exited = true;
+	}
 
-		int status = pclose(fp);
-		if (status == -1 || !WIFEXITED(status))
-			result = NSCAPI::query_return_codes::returnUNKNOWN;
+	while (!exited && !timed_out) {
+		pid_t ret = waitpid(pid, &status, WNOHANG);
+		if (ret == pid || (ret == -1 && errno != EINTR)) {
+			exited = ret == pid;
+			break;
+		}
+		if (ms_left(deadline) <= 0)
+			timed_out = true;
 		else
-			result=WEXITSTATUS(status);
+			usleep(10000);
 	}
-	close(fd[0]);
-	//alarm(0);
-	return result;
-}
 
+	if (timed_out) {
+		kill(-pid, SIGTERM);
+		boost::posix_time::ptime kill_deadline = boost::posix_time::microsec_clock::universal_time() + boost::posix_time::milliseconds(KILL_GRACE_MS);
+		while (waitpid(pid, &status, WNOHANG) == 0 && ms_left(kill_deadline) > 0)
+			usleep(10000);
+		kill(-pid, SIGKILL);
+		while (waitpid(pid, &status, 0) == -1 && errno == EINTR);
+		remove_group(pid);
+		output = "Command " + args.alias + " didn't terminate within the timeout period " + strEx::s::xtos(args.timeout) + "s";
+		return NSCAPI::query_return_codes::returnUNKNOWN;
+	}
+	remove_group(pid);
+	if (!exited || !WIFEXITED(status))
+		return NSCAPI::query_return_codes::returnUNKNOWN;
+	return WEXITSTATUS(status);
+}
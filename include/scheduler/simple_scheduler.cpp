@@ -17,6 +17,7 @@
 #include <scheduler/simple_scheduler.hpp>
 
 #include <boost/bind.hpp>
+#include <boost/foreach.hpp>
 #include <nscp_string.hpp>
 #include <utf8.hpp>
 
@@ -42,8 +43,15 @@ namespace simple_scheduler {
 	volatile int metric_errors = 0;
 	int atomic_inc32(volatile int *i) { return 0;  }
 	int atomic_read32(volatile int *i) { return 0; }
+	int atomic_inc32(volatile boost::uint32_t *i) { return 0; }
+	int atomic_dec32(volatile boost::uint32_t *i) { return 0; }
+	int atomic_read32(volatile boost::uint32_t *i) { return 0; }
 #endif
 
+	// Upper bounds (in milliseconds) of the lateness histogram buckets, the last bucket is unbounded.
+	const int lateness_limits[] = { 10, 100, 1000, 5000, 30000 };
+	const char* lateness_keys[] = { "lateness.10ms", "lateness.100ms", "lateness.1s", "lateness.5s", "lateness.30s", "lateness.more" };
+
 	bool scheduler::has_metrics() const {
 #if BOOST_VERSION >= 105300
 		return true;
@@ -66,8 +74,126 @@ namespace simple_scheduler {
 		return thread_count_;
 	}
 	std::size_t scheduler::get_metric_ql() {
+		if (engine_ == engine_wheel) {
+			boost::mutex::scoped_lock l(wheel_mutex_);
+			return wheel_.size() + atomic_read32(&ready_count_);
+		}
 		return queue_.size();
 	}
+	scheduler::histogram_type scheduler::get_metric_lateness() const {
+		histogram_type ret;
+		for (int i = 0; i < lateness_bucket_count; i++)
+			ret.push_back(std::make_pair(std::string(lateness_keys[i]), static_cast<boost::int64_t>(atomic_read32(const_cast<volatile boost::uint32_t*>(&metric_lateness_[i])))));
+		return ret;
+	}
+	void scheduler::record_lateness(boost::posix_time::time_duration off) {
+		boost::int64_t ms = off.total_milliseconds();
+		int i = 0;
+		while (i < lateness_bucket_count - 1 && ms >= lateness_limits[i])
+			i++;
+		atomic_inc32(&metric_lateness_[i]);
+	}
+
+	scheduler::histogram_type scheduler::get_metric_starts() const {
+		histogram_type ret;
+		boost::int64_t now_sec = (boost::get_system_time() - boost::posix_time::ptime(boost::gregorian::date(1970, 1, 1))).total_seconds();
+		boost::uint32_t total = 0, peak = 0;
+		boost::mutex::scoped_lock l(start_mutex_);
+		for (int i = 0; i < start_history; i++) {
+			if (start_seconds_[i] < 0 || now_sec - start_seconds_[i] >= start_history)
+				continue;
+			total += start_counts_[i];
+			if (start_counts_[i] > peak)
+				peak = start_counts_[i];
+		}
+		ret.push_back(std::make_pair(std::string("starts.last_minute"), static_cast<boost::int64_t>(total)));
+		ret.push_back(std::make_pair(std::string("starts.peak_second"), static_cast<boost::int64_t>(peak)));
+		ret.push_back(std::make_pair(std::string("starts.throttled"), static_cast<boost::int64_t>(metric_throttled_)));
+		ret.push_back(std::make_pair(std::string("starts.throttled_ms"), static_cast<boost::int64_t>(metric_throttled_ms_)));
+		return ret;
+	}
+	void scheduler::record_start(boost::posix_time::ptime time) {
+		boost::int64_t sec = (time - boost::posix_time::ptime(boost::gregorian::date(1970, 1, 1))).total_seconds();
+		int i = static_cast<int>(sec % start_history);
+		boost::mutex::scoped_lock l(start_mutex_);
+		if (start_seconds_[i] != sec) {
+			start_seconds_[i] = sec;
+			start_counts_[i] = 0;
+		}
+		start_counts_[i]++;
+	}
+
+	void scheduler::set_max_starts(int per_second) {
+		boost::mutex::scoped_lock l(start_mutex_);
+		max_starts_ = per_second > 0 ? per_second : 0;
+		start_tokens_ = max_starts_;
+		start_refill_ = now();
+	}
+	// Token bucket (allowing a burst of one second): each start takes a token and if there are none
+	// left the token is reserved and the task is rescheduled to when it has been refilled (so the
+	// worker is free to run other tasks). The rescheduled run starts with the reserved token and
+	// reports lateness from when it was originally due.
+	bool scheduler::throttle_start(const schedule_instance &instance, boost::posix_time::ptime now_time, boost::posix_time::ptime &due) {
+		boost::posix_time::time_duration delay;
+		{
+			boost::mutex::scoped_lock l(start_mutex_);
+			boost::unordered_map<int, boost::posix_time::ptime>::iterator it = start_delayed_.find(instance.schedule_id);
+			if (it != start_delayed_.end()) {
+				due = it->second;
+				start_delayed_.erase(it);
+				return true;
+			}
+			if (max_starts_ <= 0)
+				return true;
+			if (now_time > start_refill_) {
+				start_tokens_ += (now_time - start_refill_).total_microseconds() * max_starts_ / 1000000.0;
+				if (start_tokens_ > max_starts_)
+					start_tokens_ = max_starts_;
+				start_refill_ = now_time;
+			}
+			start_tokens_ -= 1.0;
+			if (start_tokens_ >= 0)
+				return true;
+			delay = boost::posix_time::microseconds(static_cast<boost::int64_t>(-start_tokens_ * 1000000.0 / max_starts_));
+			start_delayed_[instance.schedule_id] = instance.time;
+			metric_throttled_++;
+			metric_throttled_ms_ += delay.total_milliseconds();
+		}
+		reschedule_at(instance.schedule_id, now_time + delay);
+		return false;
+	}
+
+	void scheduler::set_engine(engine_type engine) {
+		if (running_) {
+			log_error(__FILE__, __LINE__, "Cannot change scheduler engine while running");
+			return;
+		}
+		if (engine_ != engine) {
+			boost::mutex::scoped_lock l(wheel_mutex_);
+			wheel_.clear();
+		}
+		engine_ = engine;
+	}
+	void scheduler::set_engine(std::string engine) {
+		if (engine == "wheel" || engine == "timer-wheel")
+			set_engine(engine_wheel);
+		else if (engine.empty() || engine == "queue")
+			set_engine(engine_queue);
+		else
+			log_error(__FILE__, __LINE__, "Invalid scheduler engine: " + engine + " (should be queue or wheel)");
+	}
+
+	timer_wheel::tick_type scheduler::to_tick(boost::posix_time::ptime time, bool round_up) const {
+		if (time <= wheel_epoch_)
+			return 0;
+		boost::int64_t ms = (time - wheel_epoch_).total_milliseconds();
+		if (round_up)
+			ms += wheel_resolution_ - 1;
+		return static_cast<timer_wheel::tick_type>(ms / wheel_resolution_);
+	}
+	boost::posix_time::ptime scheduler::from_tick(timer_wheel::tick_type tick) const {
+		return wheel_epoch_ + boost::posix_time::milliseconds(static_cast<boost::int64_t>(tick) * wheel_resolution_);
+	}
 
 
 	void scheduler::start() {
@@ -96,6 +222,7 @@ namespace simple_scheduler {
 
 	int scheduler::add_task(std::string tag, boost::posix_time::time_duration duration) {
 		task item(tag, duration);
+		item.set_splay(splay_seed_);
 		{
 			boost::mutex::scoped_lock l(mutex_);
 			item.id = ++schedule_id_;
@@ -115,9 +242,18 @@ namespace simple_scheduler {
 		return item.id;
 	}
 	void scheduler::remove_task(int id) {
-		boost::mutex::scoped_lock l(mutex_);
-		tasks_list_type::iterator it = tasks_.find(id);
-		tasks_.erase(it);
+		{
+			boost::mutex::scoped_lock l(mutex_);
+			tasks_list_type::iterator it = tasks_.find(id);
+			if (it != tasks_.end())
+				tasks_.erase(it);
+		}
+		{
+			boost::mutex::scoped_lock l(start_mutex_);
+			start_delayed_.erase(id);
+		}
+		boost::mutex::scoped_lock l(wheel_mutex_);
+		wheel_.cancel(id);
 	}
 	scheduler::op_task_object scheduler::get_task(int id) {
 		boost::mutex::scoped_lock l(mutex_);
@@ -128,8 +264,16 @@ namespace simple_scheduler {
 	}
 
 	void scheduler::clear_tasks() {
-		boost::mutex::scoped_lock l(mutex_);
-		tasks_.clear();
+		{
+			boost::mutex::scoped_lock l(mutex_);
+			tasks_.clear();
+		}
+		{
+			boost::mutex::scoped_lock l(start_mutex_);
+			start_delayed_.clear();
+		}
+		boost::mutex::scoped_lock l(wheel_mutex_);
+		wheel_.clear();
 	}
 
 
@@ -203,30 +347,66 @@ namespace simple_scheduler {
 					continue;
 				}
 
-				boost::posix_time::ptime now_time = now();
-				atomic_inc32(&metric_executed);
-				op_task_object item = get_task((*instance).schedule_id);
-				if (item) {
-					try {
-						bool to_reschedule = false;
-						if (handler_)
-							to_reschedule = handler_->handle_schedule(*item);
-						if (to_reschedule) {
-							reschedule(*item, now_time);
-							atomic_inc32(&metric_compleated);
-						} else {
-							atomic_inc32(&metric_errors);
-							log_trace(__FILE__, __LINE__, "Abandoning: " + item->to_string());
-						}
-					} catch (...) {
-						atomic_inc32(&metric_errors);
-						log_error(__FILE__, __LINE__, "UNKNOWN ERROR RUNING TASK: " + item->tag);
-						reschedule(*item, now_time);
-					}
+				execute(*instance);
+			}
+		} catch (const boost::thread_interrupted &e) {
+		} catch (const std::exception &e) {
+			atomic_inc32(&metric_errors);
+			log_error(__FILE__, __LINE__, "Exception in scheduler thread (thread will be killed): " + utf8::utf8_from_native(e.what()));
+		} catch (...) {
+			atomic_inc32(&metric_errors);
+			log_error(__FILE__, __LINE__, "Exception in scheduler thread (thread will be killed)");
+		}
+		log_trace(__FILE__, __LINE__, "Terminating thread: " + strEx::s::xtos(id));
+	}
+
+
+	void scheduler::execute(const schedule_instance &instance) {
+		boost::posix_time::ptime now_time = now();
+		boost::posix_time::ptime due = instance.time;
+		if (!throttle_start(instance, now_time, due))
+			return;
+		record_lateness(now_time - due);
+		record_start(now_time);
+		// Never compute the next run from before this one was due (or it would run again in the same slot)
+		if (now_time < instance.time)
+			now_time = instance.time;
+		atomic_inc32(&metric_executed);
+		op_task_object item = get_task(instance.schedule_id);
+		if (item) {
+			try {
+				bool to_reschedule = false;
+				if (handler_)
+					to_reschedule = handler_->handle_schedule(*item);
+				if (to_reschedule) {
+					reschedule(*item, now_time);
+					atomic_inc32(&metric_compleated);
 				} else {
 					atomic_inc32(&metric_errors);
-					log_error(__FILE__, __LINE__, "Task not found: " + strEx::s::xtos(instance->schedule_id));
+					log_trace(__FILE__, __LINE__, "Abandoning: " + item->to_string());
+				}
+			} catch (...) {
+				atomic_inc32(&metric_errors);
+				log_error(__FILE__, __LINE__, "UNKNOWN ERROR RUNING TASK: " + item->tag);
+				reschedule(*item, now_time);
+			}
+		} else {
+			atomic_inc32(&metric_errors);
+			log_error(__FILE__, __LINE__, "Task not found: " + strEx::s::xtos(instance.schedule_id));
+		}
+	}
+
+	void scheduler::wheel_thread_proc(int id) {
+		try {
+			schedule_instance instance;
+			while (!stop_requested_) {
+				ready_queue_.wait_and_pop(instance);
+				atomic_dec32(&ready_count_);
+				boost::posix_time::time_duration off = now() - instance.time;
+				if (off.total_seconds() > error_threshold_) {
+					log_error(__FILE__, __LINE__, "Ran scheduled item " + strEx::s::xtos(instance.schedule_id) + " " + strEx::s::xtos(off.total_seconds()) + " seconds to late from thread " + strEx::s::xtos(id));
 				}
+				execute(instance);
 			}
 		} catch (const boost::thread_interrupted &e) {
 		} catch (const std::exception &e) {
@@ -239,7 +419,34 @@ namespace simple_scheduler {
 		log_trace(__FILE__, __LINE__, "Terminating thread: " + strEx::s::xtos(id));
 	}
 
-
+	void scheduler::dispatcher(int id) {
+		while (!stop_requested_) {
+			try {
+				timer_wheel::slot_type ready;
+				{
+					boost::mutex::scoped_lock l(wheel_mutex_);
+					wheel_.advance(to_tick(now(), false), ready);
+				}
+				BOOST_FOREACH(const timer_wheel::entry &e, ready) {
+					schedule_instance instance;
+					instance.schedule_id = e.id;
+					instance.time = from_tick(e.due);
+					atomic_inc32(&ready_count_);
+					ready_queue_.push(instance);
+				}
+				boost::thread::sleep(boost::get_system_time() + boost::posix_time::milliseconds(wheel_resolution_));
+			} catch (const boost::thread_interrupted &e) {
+				break;
+			} catch (const std::exception &e) {
+				log_error(__FILE__, __LINE__, "Dispatcher issue: " + utf8::utf8_from_native(e.what()));
+				break;
+			} catch (...) {
+				log_error(__FILE__, __LINE__, "Dispatcher issue");
+				break;
+			}
+		}
+		log_trace(__FILE__, __LINE__, "Terminating thread: " + strEx::s::xtos(id));
+	}
 
 	void scheduler::reschedule(const task &item, boost::posix_time::ptime now_time) {
 		if (item.is_disabled()) {
@@ -249,6 +456,11 @@ namespace simple_scheduler {
 		}
 	}
 	void scheduler::reschedule_at(const int id, boost::posix_time::ptime new_time) {
+		if (engine_ == engine_wheel) {
+			boost::mutex::scoped_lock l(wheel_mutex_);
+			wheel_.insert(id, to_tick(new_time, true));
+			return;
+		}
 		schedule_instance instance;
 		instance.schedule_id = id;
 		instance.time = new_time;
@@ -267,13 +479,21 @@ namespace simple_scheduler {
 			missing_threads = thread_count_ - threads_.threadCount();
 		if (missing_threads > 0 && missing_threads <= thread_count_) {
 			for (std::size_t i = 0; i < missing_threads; i++) {
-				boost::function<void()> f = boost::bind(&scheduler::thread_proc, this, 100 + i);
+				boost::function<void()> f;
+				if (engine_ == engine_wheel)
+					f = boost::bind(&scheduler::wheel_thread_proc, this, 100 + i);
+				else
+					f = boost::bind(&scheduler::thread_proc, this, 100 + i);
 				threads_.createThread(f);
 			}
 		}
 		if (!has_watchdog_) {
 			has_watchdog_ = true;
-			boost::function<void()> f = boost::bind(&scheduler::watch_dog, this, 0);
+			boost::function<void()> f;
+			if (engine_ == engine_wheel)
+				f = boost::bind(&scheduler::dispatcher, this, 0);
+			else
+				f = boost::bind(&scheduler::watch_dog, this, 0);
 			threads_.createThread(f);
 		}
 	}
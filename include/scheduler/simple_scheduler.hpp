@@ -30,11 +30,30 @@
 #include <boost/function.hpp>
 
 #include <has-threads.hpp>
+#include <concurrent_queue.hpp>
+
+#include <scheduler/timer_wheel.hpp>
 
 #include <parsers/cron/cron_parser.hpp>
 
 namespace simple_scheduler {
 
+	/**
+	 * Offset (in milliseconds) of key within an interval.
+	 * Uses FNV-1a so the same key gets the same offset on every platform and after a restart.
+	 */
+	inline boost::int64_t splay_offset(const std::string &key, boost::int64_t interval_ms) {
+		if (interval_ms <= 0)
+			return 0;
+		boost::uint64_t hash = 14695981039346656037ULL;
+		for (std::string::const_iterator cit = key.begin(); cit != key.end(); ++cit) {
+			hash ^= static_cast<unsigned char>(*cit);
+			hash *= 1099511628211ULL;
+		}
+		hash ^= hash >> 32;
+		return static_cast<boost::int64_t>(hash % static_cast<boost::uint64_t>(interval_ms));
+	}
+
 	struct task {
 		int id;
 		std::string tag;
@@ -43,15 +62,26 @@ namespace simple_scheduler {
 		cron_parser::schedule schedule;
 		bool has_duration;
 		bool has_schedule;
+		boost::int64_t splay;
 
 	public:
-		task() : id(0), duration(boost::posix_time::seconds(0)), has_duration(false), has_schedule(false){}
-		task(std::string tag, boost::posix_time::time_duration duration) : id(0), tag(tag), duration(duration), has_duration(true), has_schedule(false){}
-		task(std::string tag, cron_parser::schedule schedule) : id(0), tag(tag), schedule(schedule), has_duration(false), has_schedule(true) {}
+		task() : id(0), duration(boost::posix_time::seconds(0)), has_duration(false), has_schedule(false), splay(0) {}
+		task(std::string tag, boost::posix_time::time_duration duration) : id(0), tag(tag), duration(duration), has_duration(true), has_schedule(false), splay(0) {}
+		task(std::string tag, cron_parser::schedule schedule) : id(0), tag(tag), schedule(schedule), has_duration(false), has_schedule(true), splay(0) {}
 
 		bool is_disabled() const {
 			return !has_duration && !has_schedule;
 		}
+		/**
+		 * Spread interval tasks over their interval based on the tag (and seed which should differ between hosts).
+		 */
+		void set_splay(const std::string &seed) {
+			if (has_duration)
+				splay = splay_offset(seed.empty() ? tag : seed + "/" + tag, duration.total_milliseconds());
+		}
+		boost::int64_t get_splay() const {
+			return splay;
+		}
 		std::string to_string() const {
 			std::stringstream ss;
 			ss << id << "[" << tag << "] = ";
@@ -63,9 +93,17 @@ namespace simple_scheduler {
 				ss << "disabled";
 			return ss.str();
 		}
+		/**
+		 * Interval tasks run at epoch + splay + n * interval (the first such time after now_time)
+		 * so every task keeps the same phase regardless of when it was started or how long it ran.
+		 */
 		boost::posix_time::ptime get_next(boost::posix_time::ptime now_time) const {
 			if (has_duration && duration.total_seconds() > 0) {
-				return now_time + boost::posix_time::seconds(rand() % duration.total_seconds());
+				static const boost::posix_time::ptime epoch(boost::gregorian::date(1970, 1, 1));
+				boost::int64_t interval = duration.total_milliseconds();
+				boost::int64_t since = (now_time - epoch).total_milliseconds() - splay;
+				boost::int64_t n = since >= 0 ? since / interval + 1 : 0;
+				return epoch + boost::posix_time::milliseconds(n * interval + splay);
 			} else if (has_duration) {
 				return now_time;
 			}
@@ -138,11 +176,21 @@ namespace simple_scheduler {
 	};
 
 	class scheduler : public boost::noncopyable {
+	public:
+		enum engine_type {
+			engine_queue,	// Priority queue where each worker sleeps until its item is due
+			engine_wheel	// Timer wheel with a single dispatcher handing due items to the workers
+		};
+		typedef std::list<std::pair<std::string, boost::int64_t> > histogram_type;
+
 	private:
 		typedef boost::unordered_map<int, task> tasks_list_type;
 		typedef boost::optional<task> op_task_object;
 		typedef safe_schedule_queue<schedule_instance> schedule_queue_type;
 
+		static const int lateness_bucket_count = 6;
+		static const int start_history = 60;
+
 		// thread variables
 		unsigned int schedule_id_;
 		volatile bool stop_requested_;
@@ -158,9 +206,41 @@ namespace simple_scheduler {
 		schedule_queue_type queue_;
 		boost::mutex idle_thread_mutex_;
 		boost::condition_variable idle_thread_cond_;
+
+		// timer wheel engine
+		engine_type engine_;
+		int wheel_resolution_;
+		boost::posix_time::ptime wheel_epoch_;
+		boost::mutex wheel_mutex_;
+		timer_wheel wheel_;
+		concurrent_queue<schedule_instance> ready_queue_;
+		volatile boost::uint32_t ready_count_;
+		volatile boost::uint32_t metric_lateness_[lateness_bucket_count];
+
+		// splay and start rate limiting
+		std::string splay_seed_;
+		int max_starts_;
+		mutable boost::mutex start_mutex_;
+		double start_tokens_;
+		boost::posix_time::ptime start_refill_;
+		boost::int64_t start_seconds_[start_history];
+		boost::uint32_t start_counts_[start_history];
+		boost::unordered_map<int, boost::posix_time::ptime> start_delayed_;
+		boost::uint32_t metric_throttled_;
+		boost::uint64_t metric_throttled_ms_;
+
 	public:
 
-		scheduler() : schedule_id_(0), stop_requested_(false), running_(false), has_watchdog_(false), thread_count_(10), handler_(NULL), error_threshold_(5) {}
+		scheduler() : schedule_id_(0), stop_requested_(false), running_(false), has_watchdog_(false), thread_count_(10), handler_(NULL), error_threshold_(5)
+			, engine_(engine_queue), wheel_resolution_(10), wheel_epoch_(boost::get_system_time()), ready_count_(0)
+			, max_starts_(0), start_tokens_(0), metric_throttled_(0), metric_throttled_ms_(0) {
+			for (int i = 0; i < lateness_bucket_count; i++)
+				metric_lateness_[i] = 0;
+			for (int i = 0; i < start_history; i++) {
+				start_seconds_[i] = -1;
+				start_counts_[i] = 0;
+			}
+		}
 		~scheduler() {}
 
 		void set_handler(handler* handler) {
@@ -179,8 +259,29 @@ namespace simple_scheduler {
 		int get_metric_errors() const;
 		std::size_t get_metric_threads() const;
 		std::size_t get_metric_ql();
+		histogram_type get_metric_lateness() const;
+		histogram_type get_metric_starts() const;
 		bool has_metrics() const;
 
+		void set_engine(engine_type engine);
+		void set_engine(std::string engine);
+		engine_type get_engine() const { return engine_; }
+		void set_wheel_resolution(int ms) {
+			if (ms > 0)
+				wheel_resolution_ = ms;
+		}
+
+		/**
+		 * Seed for spreading interval tasks (should be unique per host), only affects tasks added afterwards.
+		 */
+		void set_splay_seed(const std::string &seed) {
+			splay_seed_ = seed;
+		}
+		/**
+		 * Limit how many tasks can start per second (0 means no limit), tasks over the limit are rescheduled.
+		 */
+		void set_max_starts(int per_second);
+
 		int add_task(std::string tag, boost::posix_time::time_duration duration);
 		int add_task(std::string tag, cron_parser::schedule schedule);
 		void remove_task(int id);
@@ -201,7 +302,15 @@ namespace simple_scheduler {
 	private:
 
 		void watch_dog(int id);
+		void dispatcher(int id);
 		void thread_proc(int id);
+		void wheel_thread_proc(int id);
+		void execute(const schedule_instance &instance);
+		void record_lateness(boost::posix_time::time_duration off);
+		bool throttle_start(const schedule_instance &instance, boost::posix_time::ptime now_time, boost::posix_time::ptime &due);
+		void record_start(boost::posix_time::ptime time);
+		timer_wheel::tick_type to_tick(boost::posix_time::ptime time, bool round_up) const;
+		boost::posix_time::ptime from_tick(timer_wheel::tick_type tick) const;
 
 
 		void reschedule(const task &item, boost::posix_time::ptime now_time);
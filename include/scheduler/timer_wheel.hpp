@@ -0,0 +1,148 @@
+/*
+ * Copyright 2004-2016 The NSClient++ Authors - https://nsclient.org
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <list>
+
+#include <boost/cstdint.hpp>
+#include <boost/unordered_map.hpp>
+
+namespace simple_scheduler {
+
+	/**
+	 * Hierarchical timer wheel (4 levels of 256 slots).
+	 * Insert and cancel are O(1), advancing is O(1) per tick plus the cost of
+	 * cascading items from the higher levels when a lower level wraps.
+	 * The wheel is not thread safe, callers are expected to hold a lock.
+	 */
+	class timer_wheel {
+	public:
+		typedef boost::uint64_t tick_type;
+		struct entry {
+			int id;
+			tick_type due;
+			entry(int id, tick_type due) : id(id), due(due) {}
+		};
+		typedef std::list<entry> slot_type;
+
+	private:
+		static const int level_bits = 8;
+		static const int level_count = 4;
+		static const tick_type slot_count = 1 << level_bits;
+		static const tick_type slot_mask = slot_count - 1;
+
+		struct locator {
+			int level;
+			int slot;
+			slot_type::iterator it;
+		};
+		typedef boost::unordered_map<int, locator> index_type;
+
+		slot_type levels_[level_count][slot_count];
+		index_type index_;
+		tick_type current_;
+
+	public:
+		timer_wheel(tick_type start = 0) : current_(start) {}
+
+		tick_type current() const {
+			return current_;
+		}
+		std::size_t size() const {
+			return index_.size();
+		}
+		bool empty() const {
+			return index_.empty();
+		}
+
+		void insert(int id, tick_type due) {
+			cancel(id);
+			slot_type tmp;
+			tmp.push_back(entry(id, due));
+			place(tmp, tmp.begin());
+		}
+
+		bool cancel(int id) {
+			index_type::iterator it = index_.find(id);
+			if (it == index_.end())
+				return false;
+			levels_[it->second.level][it->second.slot].erase(it->second.it);
+			index_.erase(it);
+			return true;
+		}
+
+		void clear() {
+			for (int l = 0; l < level_count; l++) {
+				for (tick_type s = 0; s < slot_count; s++)
+					levels_[l][s].clear();
+			}
+			index_.clear();
+		}
+
+		/**
+		 * Process all ticks up to and including now and move all expired entries to ready.
+		 */
+		void advance(tick_type now, slot_type &ready) {
+			while (current_ <= now) {
+				int idx = static_cast<int>(current_ & slot_mask);
+				if (idx == 0) {
+					for (int l = 1; l < level_count; l++) {
+						if (cascade(l, static_cast<int>((current_ >> (l*level_bits)) & slot_mask)) != 0)
+							break;
+					}
+				}
+				++current_;
+				slot_type &slot = levels_[0][idx];
+				for (slot_type::const_iterator cit = slot.begin(); cit != slot.end(); ++cit)
+					index_.erase(cit->id);
+				ready.splice(ready.end(), slot);
+			}
+		}
+
+	private:
+		// Move the element at it (owned by source) into the slot matching its due tick.
+		void place(slot_type &source, slot_type::iterator it) {
+			tick_type due = it->due;
+			if (due < current_)
+				due = current_;
+			tick_type delta = due - current_;
+			int level = 0;
+			while (level < level_count - 1 && delta >= (tick_type(1) << ((level + 1)*level_bits)))
+				level++;
+			if (level == level_count - 1) {
+				tick_type max_delta = (tick_type(1) << (level_count*level_bits)) - 1;
+				if (delta > max_delta)
+					due = current_ + max_delta;
+			}
+			int slot = static_cast<int>((due >> (level*level_bits)) & slot_mask);
+			slot_type &target = levels_[level][slot];
+			target.splice(target.end(), source, it);
+			locator &l = index_[it->id];
+			l.level = level;
+			l.slot = slot;
+			l.it = it;
+		}
+
+		int cascade(int level, int slot) {
+			slot_type tmp;
+			tmp.swap(levels_[level][slot]);
+			while (!tmp.empty())
+				place(tmp, tmp.begin());
+			return slot;
+		}
+	};
+}
@@ -23,6 +23,7 @@
 #include <boost/shared_ptr.hpp>
 #include <boost/optional.hpp>
 #include <boost/foreach.hpp>
+#include <boost/thread/mutex.hpp>
 
 #include <NSCAPI.h>
 
@@ -164,6 +165,8 @@ namespace scripts {
 		typedef std::map<std::string, command_definition<script_trait> > command_list_type;
 		script_list_type scripts_;
 		command_list_type commands;
+		// Guards scripts_ which is read from the metrics thread
+		mutable boost::mutex scripts_mutex_;
 
 	public:
 
@@ -181,6 +184,7 @@ namespace scripts {
 			info->script_alias = alias;
 			info->script_id = script_id++;
 			script_runtime->create_user_data(info);
+			boost::mutex::scoped_lock lock(scripts_mutex_);
 			scripts_[info->script_id] = info;
 			return info;
 		}
@@ -192,19 +196,22 @@ namespace scripts {
 		}
 
 		void load_all() {
-			// TODO: locked
-			BOOST_FOREACH(typename script_list_type::value_type &entry, scripts_) {
-				script_runtime->load(entry.second);
+			// Loading registers commands so it runs outside of the lock
+			BOOST_FOREACH(script_information<script_trait> *info, get_scripts()) {
+				script_runtime->load(info);
 			}
 		}
 		void unload_all() {
-			// TODO: locked
-			BOOST_FOREACH(typename script_list_type::value_type &entry, scripts_) {
+			script_list_type scripts;
+			{
+				boost::mutex::scoped_lock lock(scripts_mutex_);
+				scripts.swap(scripts_);
+			}
+			BOOST_FOREACH(typename script_list_type::value_type &entry, scripts) {
 				script_information<script_trait> * info = entry.second;
 				script_runtime->unload(info);
 				delete info;
 			}
-			scripts_.clear();
 		}
 
 		void register_command(script_information<script_trait> *information, const std::string type, const std::string &command, const std::string &description, typename script_trait::function_type function) {
@@ -234,7 +241,16 @@ namespace scripts {
 				}
 		*/
 		bool empty() const {
+			boost::mutex::scoped_lock lock(scripts_mutex_);
 			return scripts_.empty();
 		}
+		std::list<script_information<script_trait>*> get_scripts() const {
+			boost::mutex::scoped_lock lock(scripts_mutex_);
+			std::list<script_information<script_trait>*> ret;
+			BOOST_FOREACH(const typename script_list_type::value_type &entry, scripts_) {
+				ret.push_back(entry.second);
+			}
+			return ret;
+		}
 	};
 }
\ No newline at end of file
@@ -18,6 +18,9 @@
 
 #include <map>
 #include <list>
+#include <string>
+
+#include <NSCAPI.h>
 
 namespace nscapi {
 	namespace settings_helper {
@@ -26,6 +29,57 @@ namespace nscapi {
 		public:
 			typedef std::list<std::string> string_list;
 
+			//////////////////////////////////////////////////////////////////////////
+			/// A single typed lookup used by get_batch.
+			/// found is set when the key exists in which case the value matching type is set.
+			struct batch_query {
+				std::string path;
+				std::string key;
+				NSCAPI::settings_type type;
+				bool found;
+				std::string string_value;
+				int int_value;
+				bool bool_value;
+				batch_query(std::string path, std::string key, NSCAPI::settings_type type) : path(path), key(key), type(type), found(false), int_value(0), bool_value(false) {}
+			};
+			typedef std::list<batch_query> batch_query_list;
+
+			virtual ~settings_impl_interface() {}
+
+			//////////////////////////////////////////////////////////////////////////
+			/// Start queuing registrations instead of sending them one by one.
+			/// Batches can be nested, queued items are sent when the outermost batch ends.
+			virtual void begin_batch() {}
+			//////////////////////////////////////////////////////////////////////////
+			/// End a batch started with begin_batch and send all queued registrations.
+			virtual void end_batch() {}
+			//////////////////////////////////////////////////////////////////////////
+			/// Look up a list of keys in one go.
+			/// The default implementation issues one lookup per key, implementations
+			/// which talk to the core override this to use a single request.
+			///
+			/// @param queries The keys to look up, results are written back in place
+			virtual void get_batch(batch_query_list &queries) {
+				for (batch_query_list::iterator it = queries.begin(); it != queries.end(); ++it) {
+					if (it->type == NSCAPI::key_integer) {
+						int v1 = get_int(it->path, it->key, -1);
+						int v2 = get_int(it->path, it->key, -2);
+						it->found = v1 == v2;
+						it->int_value = v1;
+					} else if (it->type == NSCAPI::key_bool) {
+						bool v1 = get_bool(it->path, it->key, true);
+						bool v2 = get_bool(it->path, it->key, false);
+						it->found = v1 == v2;
+						it->bool_value = v1;
+					} else {
+						std::string v1 = get_string(it->path, it->key, "");
+						std::string v2 = get_string(it->path, it->key, "$$DUMMY_VALUE_DO_NOT_USE$$");
+						it->found = v1 == v2;
+						it->string_value = v1;
+					}
+				}
+			}
+
 			//////////////////////////////////////////////////////////////////////////
 			/// Register a path with the settings module.
 			/// A registered key or path will be nicely documented in some of the settings files when converted.
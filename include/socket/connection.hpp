@@ -18,9 +18,12 @@
 
 #include <boost/asio.hpp>
 #include <boost/array.hpp>
+#include <boost/bind.hpp>
 #include <boost/noncopyable.hpp>
 #include <boost/shared_ptr.hpp>
 #include <boost/enable_shared_from_this.hpp>
+#include <boost/function.hpp>
+#include <boost/weak_ptr.hpp>
 #ifdef USE_SSL
 #include <boost/asio/ssl/context.hpp>
 #endif
@@ -44,6 +47,62 @@ namespace socket_helpers {
 		// recv    | recv       | on_read    | true = read more, false = done reading
 		// ...
 		//         |            | is_done    | true = is done, disconnect, false (read/write loop)
+		//
+		// Protocols deriving from async_protocol can leave a request pending (after on_read) and complete it
+		// later from any thread, the connection then resumes the state machine on its strand.
+
+		class async_protocol {
+		public:
+			typedef boost::function<void()> completion_type;
+			typedef boost::function<void(completion_type)> resume_type;
+
+			async_protocol() : pending_(false) {}
+			virtual ~async_protocol() {}
+
+			void attach(resume_type resume, std::string remote) {
+				resume_ = resume;
+				remote_ = remote;
+			}
+			bool is_pending() const {
+				return pending_;
+			}
+			void complete(completion_type completion) {
+				pending_ = false;
+				completion();
+			}
+
+		protected:
+			void begin_async() {
+				pending_ = true;
+			}
+			// The returned handler can be called from any thread (also after the connection has been closed).
+			resume_type get_resume_handler() const {
+				return resume_;
+			}
+			const std::string& get_remote() const {
+				return remote_;
+			}
+
+		private:
+			bool pending_;
+			resume_type resume_;
+			std::string remote_;
+		};
+
+		inline void attach_protocol(void*, async_protocol::resume_type, std::string) {}
+		inline void attach_protocol(async_protocol *protocol, async_protocol::resume_type resume, std::string remote) {
+			protocol->attach(resume, remote);
+		}
+		inline bool is_protocol_pending(const void*) {
+			return false;
+		}
+		inline bool is_protocol_pending(const async_protocol *protocol) {
+			return protocol->is_pending();
+		}
+		inline void complete_protocol(void*, async_protocol::completion_type) {}
+		inline void complete_protocol(async_protocol *protocol, async_protocol::completion_type completion) {
+			protocol->complete(completion);
+		}
 
 		template<class protocol_type, std::size_t N>
 		class connection : public boost::enable_shared_from_this<connection<protocol_type, N> >, private boost::noncopyable {
@@ -68,6 +127,9 @@ namespace socket_helpers {
 			// High level connection start/stop
 			virtual void start() {
 				trace("start()");
+				boost::system::error_code ec;
+				std::string remote = get_socket().remote_endpoint(ec).address().to_string();
+				attach_protocol(protocol_.get(), boost::bind(&connection::resume, boost::weak_ptr<connection_type>(this->shared_from_this()), _1), remote);
 				if (protocol_->on_connect()) {
 					set_timeout(protocol_->get_info().timeout);
 					do_process();
@@ -121,13 +183,38 @@ namespace socket_helpers {
 				}
 			}
 
+			//////////////////////////////////////////////////////////////////////////
+			// Asynchronous completion (protocols deriving from async_protocol)
+
+			static void resume(boost::weak_ptr<connection_type> weak_self, async_protocol::completion_type completion) {
+				boost::shared_ptr<connection_type> self = weak_self.lock();
+				if (self)
+					self->strand_.post(boost::bind(&connection::handle_completion, self, completion));
+			}
+
+			void handle_completion(async_protocol::completion_type completion) {
+				trace("handle_completion()");
+				if (!is_active_)
+					return;
+				try {
+					complete_protocol(protocol_.get(), completion);
+				} catch (const std::exception &e) {
+					protocol_->log_error(__FILE__, __LINE__, "Failed to complete request: " + utf8::utf8_from_native(e.what()));
+					on_done(false);
+					return;
+				}
+				do_process();
+			}
+
 			//////////////////////////////////////////////////////////////////////////
 			// Socket state machine (assumed all sockets are simple connect-read-write-disconnect
 
 			void do_process() {
 				trace("s - do_process()");
 				try {
-					if (protocol_->wants_data()) {
+					if (is_protocol_pending(protocol_.get())) {
+						trace("s - is_pending() == true");
+					} else if (protocol_->wants_data()) {
 						if (is_active_)
 							start_read_request();
 					} else if (protocol_->has_data()) {
@@ -183,16 +270,17 @@ namespace socket_helpers {
 			//////////////////////////////////////////////////////////////////////////
 			// Internal functions and data
 
-			boost::asio::const_buffer buf(const typename protocol_type::outbound_buffer_type s) {
-				buffers_.push_back(s);
-				return boost::asio::buffer(buffers_.back());
+			// Only one write is outstanding at a time so a single buffer (reusing its capacity) is enough.
+			boost::asio::const_buffer buf(const typename protocol_type::outbound_buffer_type &s) {
+				outbound_ = s;
+				return boost::asio::buffer(outbound_);
 			}
 
 			bool is_active_;
 			boost::asio::io_service::strand strand_;
 			boost::array<char, N> buffer_;
 			boost::asio::deadline_timer timer_;
-			std::list<typename protocol_type::outbound_buffer_type> buffers_;
+			typename protocol_type::outbound_buffer_type outbound_;
 			boost::shared_ptr<protocol_type> protocol_;
 		};
 
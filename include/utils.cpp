@@ -16,54 +16,209 @@
 
 #include <utils.h>
 
-static unsigned long crc32_table[256];
-static bool hascrc32 = false;
-void generate_crc32_table(void) {
-	unsigned long crc, poly;
-	int i, j;
-	poly = 0xEDB88320L;
-	for (i = 0; i < 256; i++) {
-		crc = i;
-		for (j = 8; j > 0; j--) {
-			if (crc & 1)
-				crc = (crc >> 1) ^ poly;
-			else
-				crc >>= 1;
+#include <cstring>
+
+#include <boost/cstdint.hpp>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define NSCP_CRC32_PCLMUL
+#ifdef _MSC_VER
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#include <emmintrin.h>
+#include <wmmintrin.h>
+#endif
+
+namespace {
+	typedef boost::uint32_t crc_type;
+
+	const crc_type crc32_poly = 0xEDB88320;
+
+	// crc32_table[0] is the classic byte table, crc32_table[n] advances a byte n positions further (slice-by-8).
+	crc_type crc32_table[8][256];
+	bool has_pclmul = false;
+
+	bool detect_pclmul() {
+#ifdef NSCP_CRC32_PCLMUL
+#ifdef _MSC_VER
+		int info[4];
+		__cpuid(info, 1);
+		return (info[2] & (1 << 1)) != 0 && (info[3] & (1 << 26)) != 0;
+#else
+		unsigned int eax, ebx, ecx, edx;
+		if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx))
+			return false;
+		return (ecx & bit_PCLMUL) != 0 && (edx & bit_SSE2) != 0;
+#endif
+#else
+		return false;
+#endif
+	}
+
+	void build_tables() {
+		for (crc_type i = 0; i < 256; i++) {
+			crc_type crc = i;
+			for (int j = 0; j < 8; j++)
+				crc = (crc & 1) ? (crc >> 1) ^ crc32_poly : crc >> 1;
+			crc32_table[0][i] = crc;
 		}
-		crc32_table[i] = crc;
+		for (crc_type i = 0; i < 256; i++) {
+			for (int t = 1; t < 8; t++)
+				crc32_table[t][i] = (crc32_table[t - 1][i] >> 8) ^ crc32_table[0][crc32_table[t - 1][i] & 0xFF];
+		}
+		has_pclmul = detect_pclmul();
 	}
-	hascrc32 = true;
-}
-unsigned long calculate_crc32(const char *buffer, int buffer_size) {
-	if (!hascrc32)
-		generate_crc32_table();
-	register unsigned long crc;
-	int this_char;
-	int current_index;
 
-	crc = 0xFFFFFFFF;
+	// Build the tables when the library is loaded so the first call from a worker thread never races the initialization.
+	struct crc32_initializer {
+		crc32_initializer() {
+			build_tables();
+		}
+	} crc32_init;
 
-	for (current_index = 0; current_index < buffer_size; current_index++) {
-		this_char = (int)buffer[current_index];
-		crc = ((crc >> 8) & 0x00FFFFFF) ^ crc32_table[(crc ^ this_char) & 0xFF];
+	inline crc_type load_le32(const unsigned char *p) {
+		return static_cast<crc_type>(p[0]) | (static_cast<crc_type>(p[1]) << 8) | (static_cast<crc_type>(p[2]) << 16) | (static_cast<crc_type>(p[3]) << 24);
+	}
+
+	crc_type crc32_slice8(crc_type crc, const unsigned char *buffer, std::size_t len) {
+		while (len >= 8) {
+			crc_type one = load_le32(buffer) ^ crc;
+			crc_type two = load_le32(buffer + 4);
+			crc = crc32_table[7][one & 0xFF] ^ crc32_table[6][(one >> 8) & 0xFF] ^ crc32_table[5][(one >> 16) & 0xFF] ^ crc32_table[4][one >> 24]
+				^ crc32_table[3][two & 0xFF] ^ crc32_table[2][(two >> 8) & 0xFF] ^ crc32_table[1][(two >> 16) & 0xFF] ^ crc32_table[0][two >> 24];
+			buffer += 8;
+			len -= 8;
+		}
+		while (len-- > 0)
+			crc = (crc >> 8) ^ crc32_table[0][(crc ^ *buffer++) & 0xFF];
+		return crc;
 	}
 
-	return (crc ^ 0xFFFFFFFF);
+#ifdef NSCP_CRC32_PCLMUL
+	/**
+	 * Carry-less multiplication folding as described in Intel's "Fast CRC Computation for Generic
+	 * Polynomials Using PCLMULQDQ Instruction" using the bit-reflected constants for 0xEDB88320.
+	 * len has to be at least 64 and a multiple of 16.
+	 */
+#ifndef _MSC_VER
+	__attribute__((target("pclmul,sse2")))
+#endif
+	crc_type crc32_pclmul(crc_type crc, const unsigned char *buffer, std::size_t len) {
+		const __m128i k1k2 = _mm_set_epi32(0x00000001, 0xc6e41596, 0x00000001, 0x54442bd4);
+		const __m128i k3k4 = _mm_set_epi32(0x00000000, 0xccaa009e, 0x00000001, 0x751997d0);
+		const __m128i k5k0 = _mm_set_epi32(0x00000000, 0x00000000, 0x00000001, 0x63cd6124);
+		const __m128i poly = _mm_set_epi32(0x00000001, 0xf7011641, 0x00000001, 0xdb710641);
+		const __m128i mask32 = _mm_setr_epi32(~0, 0, ~0, 0);
+		__m128i x0, x1, x2, x3, x4, x5, x6, x7, x8;
+
+		x1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(buffer + 0x00));
+		x2 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(buffer + 0x10));
+		x3 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(buffer + 0x20));
+		x4 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(buffer + 0x30));
+		x1 = _mm_xor_si128(x1, _mm_cvtsi32_si128(static_cast<int>(crc)));
+		buffer += 64;
+		len -= 64;
+
+		// Fold four 128 bit lanes in parallel.
+		while (len >= 64) {
+			x5 = _mm_clmulepi64_si128(x1, k1k2, 0x00);
+			x6 = _mm_clmulepi64_si128(x2, k1k2, 0x00);
+			x7 = _mm_clmulepi64_si128(x3, k1k2, 0x00);
+			x8 = _mm_clmulepi64_si128(x4, k1k2, 0x00);
+			x1 = _mm_clmulepi64_si128(x1, k1k2, 0x11);
+			x2 = _mm_clmulepi64_si128(x2, k1k2, 0x11);
+			x3 = _mm_clmulepi64_si128(x3, k1k2, 0x11);
+			x4 = _mm_clmulepi64_si128(x4, k1k2, 0x11);
+			x1 = _mm_xor_si128(_mm_xor_si128(x1, x5), _mm_loadu_si128(reinterpret_cast<const __m128i*>(buffer + 0x00)));
+			x2 = _mm_xor_si128(_mm_xor_si128(x2, x6), _mm_loadu_si128(reinterpret_cast<const __m128i*>(buffer + 0x10)));
+			x3 = _mm_xor_si128(_mm_xor_si128(x3, x7), _mm_loadu_si128(reinterpret_cast<const __m128i*>(buffer + 0x20)));
+			x4 = _mm_xor_si128(_mm_xor_si128(x4, x8), _mm_loadu_si128(reinterpret_cast<const __m128i*>(buffer + 0x30)));
+			buffer += 64;
+			len -= 64;
+		}
+
+		// Fold the lanes into a single 128 bit value.
+		x0 = k3k4;
+		x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+		x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+		x1 = _mm_xor_si128(_mm_xor_si128(x1, x2), x5);
+		x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+		x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+		x1 = _mm_xor_si128(_mm_xor_si128(x1, x3), x5);
+		x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+		x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+		x1 = _mm_xor_si128(_mm_xor_si128(x1, x4), x5);
+
+		while (len >= 16) {
+			x2 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(buffer));
+			x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+			x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+			x1 = _mm_xor_si128(_mm_xor_si128(x1, x2), x5);
+			buffer += 16;
+			len -= 16;
+		}
+
+		// Fold 128 bits to 64 bits.
+		x2 = _mm_clmulepi64_si128(x1, x0, 0x10);
+		x1 = _mm_xor_si128(_mm_srli_si128(x1, 8), x2);
+		x2 = _mm_srli_si128(x1, 4);
+		x1 = _mm_and_si128(x1, mask32);
+		x1 = _mm_clmulepi64_si128(x1, k5k0, 0x00);
+		x1 = _mm_xor_si128(x1, x2);
+
+		// Barrett reduction to 32 bits.
+		x2 = _mm_and_si128(x1, mask32);
+		x2 = _mm_clmulepi64_si128(x2, poly, 0x10);
+		x2 = _mm_and_si128(x2, mask32);
+		x2 = _mm_clmulepi64_si128(x2, poly, 0x00);
+		x1 = _mm_xor_si128(x1, x2);
+		return static_cast<crc_type>(_mm_cvtsi128_si32(_mm_srli_si128(x1, 4)));
+	}
+#endif
+
+	crc_type crc32_update(crc_type crc, const unsigned char *buffer, std::size_t len) {
+#ifdef NSCP_CRC32_PCLMUL
+		if (has_pclmul && len >= 64) {
+			std::size_t chunk = len & ~static_cast<std::size_t>(15);
+			crc = crc32_pclmul(crc, buffer, chunk);
+			buffer += chunk;
+			len -= chunk;
+		}
+#endif
+		return crc32_slice8(crc, buffer, len);
+	}
+}
+
+void generate_crc32_table(void) {
+	build_tables();
+}
+
+unsigned long calculate_crc32(const char *buffer, int buffer_size) {
+	return calculate_crc32(reinterpret_cast<const unsigned char*>(buffer), buffer_size);
 }
 
 unsigned long calculate_crc32(const unsigned char *buffer, int buffer_size) {
-	if (!hascrc32)
-		generate_crc32_table();
-	register unsigned long crc;
-	int this_char;
-	int current_index;
+	return update_crc32(0, buffer, buffer_size);
+}
+
+unsigned long update_crc32(unsigned long crc, const char *buffer, int buffer_size) {
+	return update_crc32(crc, reinterpret_cast<const unsigned char*>(buffer), buffer_size);
+}
 
-	crc = 0xFFFFFFFF;
+unsigned long update_crc32(unsigned long crc, const unsigned char *buffer, int buffer_size) {
+	if (buffer_size <= 0)
+		return crc;
+	return crc32_update(static_cast<crc_type>(crc) ^ 0xFFFFFFFF, buffer, static_cast<std::size_t>(buffer_size)) ^ 0xFFFFFFFF;
+}
 
-	for (current_index = 0; current_index < buffer_size; current_index++) {
-		this_char = (int)buffer[current_index];
-		crc = ((crc >> 8) & 0x00FFFFFF) ^ crc32_table[(crc ^ this_char) & 0xFF];
-	}
+unsigned long calculate_crc32_slice8(const unsigned char *buffer, int buffer_size) {
+	if (buffer_size <= 0)
+		return 0;
+	return crc32_slice8(0xFFFFFFFF, buffer, static_cast<std::size_t>(buffer_size)) ^ 0xFFFFFFFF;
+}
 
-	return (crc ^ 0xFFFFFFFF);
-}
\ No newline at end of file
+bool crc32_has_pclmul() {
+	return has_pclmul;
+}
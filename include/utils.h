@@ -22,3 +22,9 @@
 void generate_crc32_table(void);
 unsigned long calculate_crc32(const char *buffer, int buffer_size);
 unsigned long calculate_crc32(const unsigned char *buffer, int buffer_size);
+// Continue a crc32 (as returned by calculate_crc32) over another buffer.
+unsigned long update_crc32(unsigned long crc, const char *buffer, int buffer_size);
+unsigned long update_crc32(unsigned long crc, const unsigned char *buffer, int buffer_size);
+// Table only variant of calculate_crc32 (used to verify and benchmark the PCLMUL path).
+unsigned long calculate_crc32_slice8(const unsigned char *buffer, int buffer_size);
+bool crc32_has_pclmul();
@@ -1,4 +1,5 @@
 #include <boost/optional.hpp>
+#include <boost/bind.hpp>
 
 #include <nscapi/functions.hpp>
 #include <nscapi/nscapi_helper_singleton.hpp>
@@ -8,6 +9,7 @@
 
 #include <lua/lua_cpp.hpp>
 #include <lua/lua_core.hpp>
+#include <scripts/script_nscp.hpp>
 
 void lua::lua_runtime::register_query(const std::string &command, const std::string &description) {
 	throw lua::lua_exception("The method or operation is not implemented(reg_query).");
@@ -18,7 +20,24 @@ void lua::lua_runtime::register_subscription(const std::string &channel, const s
 }
 
 void lua::lua_runtime::on_query(std::string command, script_information *information, lua::lua_traits::function_type function, bool simple, const Plugin::QueryRequestMessage::Request &request, Plugin::QueryResponseMessage::Response *response, const Plugin::QueryRequestMessage &request_message) {
-	lua_wrapper lua(prep_function(information, function));
+	boost::shared_ptr<lua_state_pool> pool = information->user_data.pool;
+	if (pool) {
+		lua_state_pool::lease state(*pool);
+		if (state) {
+			const lua::lua_traits::function_type *f = state->find_function(simple ? scripts::nscp::tags::simple_query_tag : scripts::nscp::tags::query_tag, command);
+			if (f != NULL)
+				return run_query(state->L, command, *f, simple, request, response, request_message);
+		} else {
+			NSC_DEBUG_MSG_STD("Failed to get a pooled state for " + information->script + ": " + state.get_error());
+		}
+	}
+	// Commands registered conditionally (or when pooling is disabled) run on the main state one at a time.
+	boost::unique_lock<boost::mutex> lock(information->user_data.mutex);
+	run_query(information->user_data.L, command, function, simple, request, response, request_message);
+}
+
+void lua::lua_runtime::run_query(lua_State *L, const std::string &command, const lua::lua_traits::function_type &function, bool simple, const Plugin::QueryRequestMessage::Request &request, Plugin::QueryResponseMessage::Response *response, const Plugin::QueryRequestMessage &request_message) {
+	lua_wrapper lua(prep_function(L, function));
 	int args = 2;
 	if (function.object_ref != 0)
 		args = 3;
@@ -62,6 +81,7 @@ void lua::lua_runtime::on_query(std::string command, script_information *informa
 }
 
 void lua::lua_runtime::exec_main(script_information *information, const std::vector<std::string> &opts, Plugin::ExecuteResponseMessage::Response *response) {
+	boost::unique_lock<boost::mutex> lock(information->user_data.mutex);
 	lua_wrapper lua(prep_function(information, "main"));
 	lua.push_array(opts);
 	if (lua.pcall(1, 2, 0) != 0)
@@ -79,6 +99,7 @@ void lua::lua_runtime::exec_main(script_information *information, const std::vec
 	nscapi::protobuf::functions::append_simple_exec_response_payload(response, "", ret, msg);
 }
 void lua::lua_runtime::on_exec(std::string command, script_information *information, lua::lua_traits::function_type function, bool simple, const Plugin::ExecuteRequestMessage::Request &request, Plugin::ExecuteResponseMessage::Response *response, const Plugin::ExecuteRequestMessage &request_message) {
+	boost::unique_lock<boost::mutex> lock(information->user_data.mutex);
 	lua_wrapper lua(prep_function(information, function));
 	int args = 2;
 	if (function.object_ref != 0)
@@ -129,12 +150,12 @@ void lua::lua_runtime::create_user_data(scripts::script_information<lua_traits>
 	info->user_data.base_path_ = base_path;
 }
 
-void lua::lua_runtime::load(scripts::script_information<lua_traits> *info) {
+void lua::lua_runtime::load_script(script_information *info, lua_State *L) {
 	std::string base_path = info->user_data.base_path_;
-	lua::lua_wrapper lua_instance(info->user_data.L);
+	lua::lua_wrapper lua_instance(L);
 	lua_instance.set_userdata(lua::lua_traits::user_data_tag, info);
 	lua_instance.openlibs();
-	lua::lua_script::luaopen(info->user_data.L);
+	lua::lua_script::luaopen(L);
 	BOOST_FOREACH(lua::lua_runtime_plugin_type &plugin, plugins) {
 		plugin->load(lua_instance);
 	}
@@ -144,11 +165,47 @@ void lua::lua_runtime::load(scripts::script_information<lua_traits> *info) {
 	if (lua_instance.pcall(0, 0, 0) != 0)
 		throw lua::lua_exception("Failed to execute script: " + info->script + ": " + lua_instance.pop_string());
 }
+
+void lua::lua_runtime::load_state(script_information *info, pooled_state &state) {
+	lua::lua_wrapper lua_instance(state.L);
+	lua_instance.set_userdata(lua::lua_traits::pooled_state_tag, &state);
+	load_script(info, state.L);
+}
+
+void lua::lua_runtime::unload_state(pooled_state &state) {
+	lua::lua_wrapper lua_instance(state.L);
+	BOOST_FOREACH(lua::lua_runtime_plugin_type &plugin, plugins) {
+		plugin->unload(lua_instance);
+	}
+	lua_instance.gc(LUA_GCCOLLECT, 0);
+	lua_instance.remove_userdata(lua::lua_traits::pooled_state_tag);
+	lua_instance.remove_userdata(lua::lua_traits::user_data_tag);
+}
+
+void lua::lua_runtime::load(scripts::script_information<lua_traits> *info) {
+	{
+		boost::unique_lock<boost::mutex> lock(info->user_data.mutex);
+		load_script(info, info->user_data.L);
+	}
+	if (max_pool_size > 0) {
+		info->user_data.pool.reset(new lua_state_pool(boost::bind(&lua_runtime::load_state, this, info, _1), boost::bind(&lua_runtime::unload_state, this, _1), max_pool_size));
+		try {
+			info->user_data.pool->prefill(pool_size);
+		} catch (const std::exception &e) {
+			NSC_LOG_ERROR_STD("Failed to load pooled state for " + info->script + ": " + e.what());
+		}
+	}
+}
 void lua::lua_runtime::unload(scripts::script_information<lua_traits> *info) {
+	if (info->user_data.pool) {
+		info->user_data.pool->close();
+		info->user_data.pool.reset();
+	}
+	boost::unique_lock<boost::mutex> lock(info->user_data.mutex);
 	lua::lua_wrapper lua_instance(info->user_data.L);
 	BOOST_FOREACH(lua::lua_runtime_plugin_type &plugin, plugins) {
 		plugin->unload(lua_instance);
 	}
 	lua_instance.gc(LUA_GCCOLLECT, 0);
 	lua_instance.remove_userdata(lua::lua_traits::user_data_tag);
-}
\ No newline at end of file
+}
@@ -15,8 +15,10 @@
 
 #include <lua/lua_cpp.hpp>
 #include <lua/lua_script.hpp>
+#include <lua/lua_state_pool.hpp>
 
 const std::string lua::lua_traits::user_data_tag = "nscp.userdata.info";
+const std::string lua::lua_traits::pooled_state_tag = "nscp.userdata.pooled_state";
 
 //////////////////////////////////////////////////////////////////////////
 // Core Wrapper
@@ -176,6 +178,15 @@ const Luna<lua::core_wrapper>::PropertyType lua::core_wrapper::Properties[] = {
 lua::registry_wrapper::registry_wrapper(lua_State *L, bool) : isExisting(false) {
 	lua::lua_wrapper instance(L);
 	info = instance.get_userdata<script_information*>(lua::lua_traits::user_data_tag);
+	state = instance.get_userdata<pooled_state*>(lua::lua_traits::pooled_state_tag);
+}
+
+void lua::registry_wrapper::add_command(const std::string &type, const std::string &command, const std::string &description, const lua::lua_traits::function &function) {
+	// Pooled states run the script again: keep their function references local instead of registering the command twice.
+	if (state != NULL)
+		state->add_function(type, command, function);
+	else
+		info->register_command(type, command, description, function);
 }
 
 boost::optional<int> read_registration(lua::lua_wrapper &lua_instance, std::string &command, lua::lua_traits::function &fun, std::string &description) {
@@ -210,7 +221,7 @@ int lua::registry_wrapper::register_function(lua_State *L) {
 
 	if (description.empty())
 		description = "Lua script: " + command;
-	info->register_command(scripts::nscp::tags::query_tag, command, description, fundata);
+	add_command(scripts::nscp::tags::query_tag, command, description, fundata);
 	return lua_instance.size();
 }
 int lua::registry_wrapper::register_simple_function(lua_State *L) {
@@ -224,7 +235,7 @@ int lua::registry_wrapper::register_simple_function(lua_State *L) {
 
 	if (description.empty())
 		description = "Lua script: " + command;
-	info->register_command(scripts::nscp::tags::simple_query_tag, command, description, fundata);
+	add_command(scripts::nscp::tags::simple_query_tag, command, description, fundata);
 	return lua_instance.size();
 }
 int lua::registry_wrapper::register_cmdline(lua_State *L) {
@@ -239,7 +250,7 @@ int lua::registry_wrapper::register_simple_cmdline(lua_State *L) {
 	boost::optional<int> error = read_registration(lua_instance, command, fundata, description);
 	if (error)
 		return *error;
-	info->register_command(scripts::nscp::tags::simple_exec_tag, command, description, fundata);
+	add_command(scripts::nscp::tags::simple_exec_tag, command, description, fundata);
 	return lua_instance.size();
 }
 int lua::registry_wrapper::subscription(lua_State *L) {
@@ -254,7 +265,7 @@ int lua::registry_wrapper::simple_subscription(lua_State *L) {
 	boost::optional<int> error = read_registration(lua_instance, command, fundata, description);
 	if (error)
 		return *error;
-	info->register_command("simple_submit", command, description, fundata);
+	add_command("simple_submit", command, description, fundata);
 	return lua_instance.size();
 }
 
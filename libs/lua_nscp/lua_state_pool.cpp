@@ -0,0 +1,132 @@
+/*
+ * Copyright 2004-2016 The NSClient++ Authors - https://nsclient.org
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <lua/lua_state_pool.hpp>
+
+#include <boost/foreach.hpp>
+#include <boost/date_time/posix_time/posix_time.hpp>
+
+lua::lua_state_pool::lua_state_pool(loader_type loader, loader_type unloader, std::size_t max_size)
+	: size_(0)
+	, max_size_(max_size == 0 ? 1 : max_size)
+	, closed_(false)
+	, loader_(loader)
+	, unloader_(unloader) {}
+
+lua::lua_state_pool::~lua_state_pool() {
+	close();
+}
+
+lua::pooled_state* lua::lua_state_pool::create() {
+	// Loading runs the script which can take a while so it is done without holding the lock.
+	pooled_state *state = new pooled_state();
+	try {
+		loader_(*state);
+	} catch (...) {
+		delete state;
+		boost::unique_lock<boost::mutex> lock(mutex_);
+		size_--;
+		cond_.notify_all();
+		throw;
+	}
+	boost::unique_lock<boost::mutex> lock(mutex_);
+	metrics_.created++;
+	return state;
+}
+
+void lua::lua_state_pool::prefill(std::size_t count) {
+	while (true) {
+		{
+			boost::unique_lock<boost::mutex> lock(mutex_);
+			if (closed_ || size_ >= count || size_ >= max_size_)
+				return;
+			size_++;
+		}
+		release(create());
+	}
+}
+
+lua::pooled_state* lua::lua_state_pool::acquire() {
+	boost::unique_lock<boost::mutex> lock(mutex_);
+	bool first = true;
+	boost::posix_time::ptime start;
+	while (true) {
+		if (closed_)
+			throw lua::lua_exception("The lua state pool has been closed");
+		if (!idle_.empty()) {
+			pooled_state *state = idle_.front();
+			idle_.pop_front();
+			if (first) {
+				metrics_.hits++;
+			} else {
+				unsigned long long waited = (boost::posix_time::microsec_clock::universal_time() - start).total_microseconds();
+				metrics_.wait_total_us += waited;
+				if (waited > metrics_.wait_max_us)
+					metrics_.wait_max_us = waited;
+			}
+			return state;
+		}
+		if (first)
+			metrics_.misses++;
+		if (size_ < max_size_) {
+			size_++;
+			lock.unlock();
+			return create();
+		}
+		if (first) {
+			metrics_.waits++;
+			start = boost::posix_time::microsec_clock::universal_time();
+			first = false;
+		}
+		cond_.wait(lock);
+	}
+}
+
+void lua::lua_state_pool::release(pooled_state *state) {
+	boost::unique_lock<boost::mutex> lock(mutex_);
+	// Most recently used first: keeps the working set of states (and their caches) small.
+	idle_.push_front(state);
+	cond_.notify_all();
+}
+
+void lua::lua_state_pool::close() {
+	std::list<pooled_state*> states;
+	{
+		boost::unique_lock<boost::mutex> lock(mutex_);
+		closed_ = true;
+		cond_.notify_all();
+		while (idle_.size() < size_)
+			cond_.wait(lock);
+		states.swap(idle_);
+		size_ = 0;
+	}
+	BOOST_FOREACH(pooled_state *state, states) {
+		try {
+			if (unloader_)
+				unloader_(*state);
+		} catch (...) {
+		}
+		delete state;
+	}
+}
+
+lua::lua_state_pool::pool_metrics lua::lua_state_pool::get_metrics() {
+	boost::unique_lock<boost::mutex> lock(mutex_);
+	pool_metrics ret = metrics_;
+	ret.size = size_;
+	ret.idle = idle_.size();
+	return ret;
+}
@@ -0,0 +1,216 @@
+/*
+ * Copyright 2004-2016 The NSClient++ Authors - https://nsclient.org
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <vector>
+#include <cstdio>
+#include <fstream>
+#include <stdexcept>
+
+#include <boost/bind.hpp>
+#include <boost/thread.hpp>
+#include <boost/atomic.hpp>
+
+#include <lua/lua_state_pool.hpp>
+#include <lua/lua_core.hpp>
+#include <scripts/script_nscp.hpp>
+#include <nscapi/macros.hpp>
+#include <nscapi/nscapi_helper_singleton.hpp>
+
+#include <gtest/gtest.h>
+
+nscapi::helper_singleton* nscapi::plugin_singleton = new nscapi::helper_singleton();
+
+const char *sum_script = "function sum(n)\n local s = 0\n for i = 1, n do s = s + i end\n return s\nend\n";
+
+void load_sum(lua::pooled_state &state) {
+	if (luaL_loadstring(state.L, sum_script) != 0 || lua_pcall(state.L, 0, 0, 0) != 0)
+		throw lua::lua_exception("Failed to load script");
+	lua::lua_traits::function f;
+	lua_getglobal(state.L, "sum");
+	f.function_ref = luaL_ref(state.L, LUA_REGISTRYINDEX);
+	f.object_ref = 0;
+	state.add_function("query", "sum", f);
+}
+
+void load_failing(lua::pooled_state &) {
+	throw lua::lua_exception("broken script");
+}
+
+long long call_sum(lua::pooled_state &state, int n) {
+	const lua::lua_traits::function *f = state.find_function("query", "sum");
+	if (f == NULL)
+		return -1;
+	lua_rawgeti(state.L, LUA_REGISTRYINDEX, f->function_ref);
+	lua_pushnumber(state.L, n);
+	if (lua_pcall(state.L, 1, 1, 0) != 0) {
+		lua_pop(state.L, 1);
+		return -1;
+	}
+	long long ret = static_cast<long long>(lua_tonumber(state.L, -1));
+	lua_pop(state.L, 1);
+	return ret;
+}
+
+void run_checks(lua::lua_state_pool *pool, int id, int calls, boost::atomic<int> *failures) {
+	for (int i = 0; i < calls; i++) {
+		int n = (id * 31 + i) % 200;
+		lua::lua_state_pool::lease state(*pool);
+		if (!state || call_sum(*state, n) != static_cast<long long>(n) * (n + 1) / 2)
+			(*failures)++;
+	}
+}
+
+TEST(lua_state_pool, prefill_loads_states) {
+	lua::lua_state_pool pool(&load_sum, lua::lua_state_pool::loader_type(), 4);
+	pool.prefill(2);
+	lua::lua_state_pool::pool_metrics m = pool.get_metrics();
+	EXPECT_EQ(2u, m.size);
+	EXPECT_EQ(2u, m.idle);
+	EXPECT_EQ(2u, m.created);
+}
+
+TEST(lua_state_pool, reuses_released_states) {
+	lua::lua_state_pool pool(&load_sum, lua::lua_state_pool::loader_type(), 4);
+	for (int i = 0; i < 10; i++) {
+		lua::lua_state_pool::lease state(pool);
+		ASSERT_TRUE(state);
+		EXPECT_EQ(55, call_sum(*state, 10));
+	}
+	lua::lua_state_pool::pool_metrics m = pool.get_metrics();
+	EXPECT_EQ(1u, m.size);
+	EXPECT_EQ(1u, m.misses);
+	EXPECT_EQ(9u, m.hits);
+}
+
+TEST(lua_state_pool, failed_load_is_reported) {
+	lua::lua_state_pool pool(&load_failing, lua::lua_state_pool::loader_type(), 4);
+	EXPECT_THROW(pool.prefill(1), lua::lua_exception);
+	lua::lua_state_pool::lease state(pool);
+	EXPECT_FALSE(state);
+	EXPECT_EQ("broken script", state.get_error());
+	EXPECT_EQ(0u, pool.get_metrics().size);
+}
+
+TEST(lua_state_pool, concurrent_checks) {
+	const int threads = 16;
+	const int calls = 500;
+	const std::size_t max_size = 4;
+	boost::atomic<int> failures(0);
+	lua::lua_state_pool pool(&load_sum, lua::lua_state_pool::loader_type(), max_size);
+	pool.prefill(1);
+
+	boost::thread_group group;
+	for (int i = 0; i < threads; i++)
+		group.create_thread(boost::bind(&run_checks, &pool, i, calls, &failures));
+	group.join_all();
+
+	EXPECT_EQ(0, failures);
+	lua::lua_state_pool::pool_metrics m = pool.get_metrics();
+	EXPECT_EQ(static_cast<unsigned long long>(threads * calls), m.hits + m.misses);
+	EXPECT_LE(m.size, max_size);
+	EXPECT_EQ(m.size, m.created);
+	EXPECT_EQ(m.size, m.idle);
+	EXPECT_LE(m.waits, m.misses);
+}
+
+// The script keeps a call counter in a global: every pooled state has its own copy.
+const char *check_script =
+	"calls = 0\n"
+	"function check_sum(command, args)\n"
+	" calls = calls + 1\n"
+	" local n = tonumber(args[0])\n"
+	" local s = 0\n"
+	" for i = 1, n do s = s + i end\n"
+	" return 'ok', command .. ': ' .. s, ''\n"
+	"end\n"
+	"local reg = nscp.Registry()\n"
+	"reg:simple_query('check_sum', check_sum, 'Sum all numbers up to the argument')\n";
+
+struct fake_nscp_runtime : public scripts::nscp_runtime_interface {
+	boost::mutex mutex;
+	std::list<std::string> registered;
+	void register_command(const std::string type, const std::string &command, const std::string &) {
+		boost::unique_lock<boost::mutex> lock(mutex);
+		registered.push_back(type + ":" + command);
+	}
+	boost::shared_ptr<scripts::settings_provider> get_settings_provider() {
+		return boost::shared_ptr<scripts::settings_provider>();
+	}
+	boost::shared_ptr<scripts::core_provider> get_core_provider() {
+		return boost::shared_ptr<scripts::core_provider>();
+	}
+};
+
+void run_queries(lua::lua_runtime *runtime, scripts::command_definition<lua::lua_traits> *cmd, int id, int calls, boost::atomic<int> *failures) {
+	for (int i = 0; i < calls; i++) {
+		int n = (id * 31 + i) % 200;
+		Plugin::QueryRequestMessage request_message;
+		Plugin::QueryRequestMessage::Request *request = request_message.add_payload();
+		request->set_command("check_sum");
+		request->add_arguments(strEx::s::xtos(n));
+		Plugin::QueryResponseMessage::Response response;
+		runtime->on_query("check_sum", cmd->information, cmd->function, true, *request, &response, request_message);
+		if (response.result() != Plugin::Common_ResultCode_OK || response.lines_size() != 1
+			|| response.lines(0).message() != "check_sum: " + strEx::s::xtos(static_cast<long long>(n) * (n + 1) / 2))
+			(*failures)++;
+	}
+}
+
+TEST(lua_runtime, concurrent_queries_on_pooled_states) {
+	const int threads = 16;
+	const int calls = 200;
+	const std::string script = "lua_state_pool_test_check.lua";
+	{
+		std::ofstream out(script.c_str());
+		out << check_script;
+	}
+	boost::shared_ptr<lua::lua_runtime> runtime(new lua::lua_runtime("."));
+	runtime->pool_size = 1;
+	runtime->max_pool_size = 4;
+	boost::shared_ptr<fake_nscp_runtime> nscp(new fake_nscp_runtime());
+	scripts::script_manager<lua::lua_traits> manager(runtime, nscp, 1, "lua");
+	scripts::script_information<lua::lua_traits> *info = manager.add_and_load("check", script);
+
+	// Only the main state registers the command, pooled states keep their own function references
+	ASSERT_EQ(1u, nscp->registered.size());
+	EXPECT_EQ(std::string(scripts::nscp::tags::simple_query_tag) + ":check_sum", nscp->registered.front());
+	boost::optional<scripts::command_definition<lua::lua_traits> > cmd = manager.find_command(scripts::nscp::tags::simple_query_tag, "check_sum");
+	ASSERT_TRUE(cmd);
+	ASSERT_TRUE(info->user_data.pool);
+	EXPECT_EQ(1u, info->user_data.pool->get_metrics().size);
+
+	boost::atomic<int> failures(0);
+	boost::thread_group group;
+	for (int i = 0; i < threads; i++)
+		group.create_thread(boost::bind(&run_queries, runtime.get(), &*cmd, i, calls, &failures));
+	group.join_all();
+
+	EXPECT_EQ(0, failures);
+	lua::lua_state_pool::pool_metrics m = info->user_data.pool->get_metrics();
+	EXPECT_EQ(static_cast<unsigned long long>(threads * calls), m.hits + m.misses);
+	EXPECT_LE(m.size, runtime->max_pool_size);
+	EXPECT_EQ(m.size, m.idle);
+	EXPECT_EQ(1u, nscp->registered.size());
+
+	// Nothing ran on the main state
+	lua::lua_wrapper main_state(info->user_data.L);
+	main_state.getglobal("calls");
+	EXPECT_EQ(0, static_cast<int>(lua_tonumber(info->user_data.L, -1)));
+	main_state.pop();
+
+	manager.unload_all();
+	std::remove(script.c_str());
+}
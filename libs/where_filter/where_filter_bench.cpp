@@ -0,0 +1,70 @@
+/*
+ * Copyright 2004-2016 The NSClient++ Authors - https://nsclient.org
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <iostream>
+#include <iomanip>
+
+#include <boost/foreach.hpp>
+#include <boost/date_time/posix_time/posix_time.hpp>
+
+#include "where_filter_fixture.hpp"
+
+// Compare the tree walking evaluator with the compiled bytecode on a few typical filters.
+// Usage: where_filter_bench [iterations]
+
+int lookups = 0;
+
+double run(compiled_filter &f, const std::vector<test_obj_type> &objects, int iterations, bool compiled, long long &matches) {
+	boost::posix_time::ptime start = boost::posix_time::microsec_clock::universal_time();
+	for (int i = 0; i < iterations; i++) {
+		BOOST_FOREACH(const test_obj_type &o, objects) {
+			matches += compiled ? f.evaluate_program(o) : f.evaluate_tree(o);
+		}
+	}
+	return (boost::posix_time::microsec_clock::universal_time() - start).total_microseconds() / 1000.0;
+}
+
+int main(int argc, char *argv[]) {
+	int iterations = argc > 1 ? strEx::s::stox<int>(argv[1]) : 100000;
+	const char *filters[] = {
+		"state = 'running'",
+		"cpu > 5 and handles > 100",
+		"state = 'running' and (cpu > 10 or handles < 100)",
+		"name like 'svc' or name like 'nscp'",
+		"name regexp '.*cp.*'",
+		"pid in (3, 4, 5)",
+		"not (pid > 10)",
+		"handles > 100 and 2 > 1",
+		NULL
+	};
+	std::vector<test_obj_type> objects = get_objects();
+	std::cout << std::setw(52) << std::left << "filter" << std::setw(12) << "tree (ms)" << std::setw(12) << "bytecode (ms)" << std::endl;
+	for (int i = 0; filters[i] != NULL; i++) {
+		compiled_filter f(filters[i]);
+		if (!f.validate()) {
+			std::cout << "Failed to validate: " << filters[i] << std::endl;
+			return 1;
+		}
+		long long tree_matches = 0, program_matches = 0;
+		double tree = run(f, objects, iterations, false, tree_matches);
+		double program = run(f, objects, iterations, true, program_matches);
+		std::cout << std::setw(52) << std::left << filters[i] << std::setw(12) << tree << std::setw(12) << program;
+		if (tree_matches != program_matches)
+			std::cout << " MISMATCH";
+		std::cout << std::endl;
+	}
+	return 0;
+}
@@ -0,0 +1,113 @@
+/*
+ * Copyright 2004-2016 The NSClient++ Authors - https://nsclient.org
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include <boost/bind.hpp>
+#include <boost/shared_ptr.hpp>
+
+#include <NSCAPI.h>
+#include <strEx.h>
+#include <nscapi/nscapi_helper.hpp>
+
+#include <parsers/where/engine.hpp>
+#include <parsers/where/filter_handler_impl.hpp>
+
+struct test_obj {
+	std::string name;
+	std::string state;
+	long long pid;
+	long long handles;
+	double cpu;
+	test_obj(std::string name, std::string state, long long pid, long long handles, double cpu) : name(name), state(state), pid(pid), handles(handles), cpu(cpu) {}
+
+	std::string get_name() const { return name; }
+	std::string get_state() const { return state; }
+	long long get_pid() const { return pid; }
+	long long get_handles() const { return handles; }
+	double get_cpu() const { return cpu; }
+};
+typedef boost::shared_ptr<test_obj> test_obj_type;
+
+extern int lookups;
+inline long long count_lookup(test_obj_type) {
+	return ++lookups;
+}
+
+struct test_handler : public parsers::where::filter_handler_impl<test_obj_type> {
+	test_handler() {
+		registry_.add_string()
+			("name", boost::bind(&test_obj::get_name, _1), "The name")
+			("state", boost::bind(&test_obj::get_state, _1), "The state")
+			;
+		registry_.add_int()
+			("pid", boost::bind(&test_obj::get_pid, _1), "The pid")
+			("handles", boost::bind(&test_obj::get_handles, _1), "The handles")
+			("lookups", boost::bind(&count_lookup, _1), "Number of times this has been evaluated")
+			;
+		registry_.add_float()
+			("cpu", boost::bind(&test_obj::get_cpu, _1), "The cpu")
+			;
+	}
+};
+
+struct null_error_handler : public parsers::where::error_handler_interface {
+	void log_error(const std::string) {}
+	void log_warning(const std::string) {}
+	void log_debug(const std::string) {}
+	bool is_debug() const { return false; }
+	void set_debug(bool) {}
+};
+
+struct compiled_filter {
+	boost::shared_ptr<test_handler> handler;
+	parsers::where::engine engine;
+
+	compiled_filter(const std::string &filter)
+		: handler(new test_handler())
+		, engine(std::vector<std::string>(1, filter), boost::shared_ptr<null_error_handler>(new null_error_handler())) {}
+
+	bool validate() {
+		return engine.validate(handler);
+	}
+	parsers::where::engine_filter& get() {
+		return engine.filters_.front();
+	}
+	long long evaluate_tree(test_obj_type obj) {
+		handler->set_object(obj);
+		long long ret = get().ast_parser.evaluate(handler).get_int(-1);
+		handler->clear();
+		return ret;
+	}
+	long long evaluate_program(test_obj_type obj) {
+		handler->set_object(obj);
+		long long ret = get().program.evaluate(handler).get_int(-1);
+		handler->clear();
+		return ret;
+	}
+};
+
+inline std::vector<test_obj_type> get_objects() {
+	std::vector<test_obj_type> ret;
+	ret.push_back(test_obj_type(new test_obj("svchost.exe", "running", 4, 1200, 12.5)));
+	ret.push_back(test_obj_type(new test_obj("nscp.exe", "running", 1024, 90, 0.5)));
+	ret.push_back(test_obj_type(new test_obj("backup.exe", "stopped", 77, 0, 0.0)));
+	ret.push_back(test_obj_type(new test_obj("", "hung", 3, 5000, 99.9)));
+	return ret;
+}
\ No newline at end of file
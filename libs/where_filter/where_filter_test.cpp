@@ -0,0 +1,68 @@
+/*
+ * Copyright 2004-2016 The NSClient++ Authors - https://nsclient.org
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <boost/foreach.hpp>
+
+#include "where_filter_fixture.hpp"
+
+#include <gtest/gtest.h>
+
+int lookups = 0;
+
+void check_same(const std::string &filter) {
+	compiled_filter f(filter);
+	ASSERT_TRUE(f.validate()) << filter;
+	ASSERT_FALSE(f.get().program.empty()) << filter;
+	BOOST_FOREACH(test_obj_type o, get_objects()) {
+		EXPECT_EQ(f.evaluate_tree(o), f.evaluate_program(o)) << filter << " for " << o->name << ": " << f.get().program.to_string();
+	}
+}
+
+TEST(WhereFilterBytecode, same_result_as_tree) {
+	check_same("state = 'running'");
+	check_same("state != 'running'");
+	check_same("pid < 100");
+	check_same("pid >= 1024 or handles <= 0");
+	check_same("cpu > 5 and handles > 100");
+	check_same("cpu < 1.5");
+	check_same("name like 'SVC'");
+	check_same("name not like 'exe'");
+	check_same("name regexp '.*cp.*'");
+	check_same("pid in (3, 4, 5)");
+	check_same("state not in ('running', 'stopped')");
+	check_same("not (pid > 10)");
+	check_same("(state = 'running' and (cpu > 10 or handles < 100)) or (state = 'hung' and pid != 0)");
+}
+
+TEST(WhereFilterBytecode, constant_folding) {
+	compiled_filter f("1 = 1 and 'a' != 'b'");
+	ASSERT_TRUE(f.validate());
+	EXPECT_EQ("const 1", f.get().program.to_string());
+	EXPECT_EQ(1, f.evaluate_program(get_objects().front()));
+}
+
+TEST(WhereFilterBytecode, short_circuit) {
+	compiled_filter f("pid > 100000 and lookups > 0");
+	ASSERT_TRUE(f.validate());
+	lookups = 0;
+	EXPECT_EQ(0, f.evaluate_program(get_objects().front()));
+	EXPECT_EQ(0, lookups);
+
+	compiled_filter f2("pid < 100000 or lookups > 0");
+	ASSERT_TRUE(f2.validate());
+	EXPECT_EQ(1, f2.evaluate_program(get_objects().front()));
+	EXPECT_EQ(0, lookups);
+}
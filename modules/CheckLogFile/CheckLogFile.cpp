@@ -120,14 +120,16 @@ void CheckLogFile::check_logfile(const Plugin::QueryRequestMessage::Request &req
 	if (!filter_helper.build_filter(filter))
 		return;
 
+	// Columns are split on demand and the line is only copied if the filter actually uses it
+	bool text = filter.context->uses_text();
+	boost::shared_ptr<logfile_filter::filter_obj> record(new logfile_filter::filter_obj());
 	BOOST_FOREACH(const std::string &filename, file_list) {
 		std::ifstream file(filename.c_str());
 		if (file.is_open()) {
 			std::string line;
 			while (file.good()) {
 				std::getline(file, line, '\n');
-				std::list<std::string> chunks = strEx::s::splitEx(line, column_split);
-				boost::shared_ptr<logfile_filter::filter_obj> record(new logfile_filter::filter_obj(filename, line, chunks));
+				record->set_line(filename, line.data(), line.data() + (text ? line.size() : 0), column_split);
 				modern_filter::match_result ret = filter.match(record);
 			}
 			file.close();
@@ -62,4 +62,14 @@ logfile_filter::filter_obj_handler::filter_obj_handler() {
 	registry_.add_string_fun()
 		("column", &get_column_fun, "Fetch the value from the given column number.\nSyntax: column(<coulmn number>)")
 		;
+}
+
+bool logfile_filter::filter_obj_handler::uses_text() const {
+	if (uses_variable("line") || uses_function("column"))
+		return true;
+	for (int i = 1; i <= 9; i++) {
+		if (uses_variable("column" + strEx::s::xtos(i)))
+			return true;
+	}
+	return false;
 }
\ No newline at end of file
@@ -23,6 +23,7 @@
 #include <boost/optional.hpp>
 #include <boost/shared_ptr.hpp>
 #include <boost/bind.hpp>
+#include <boost/lexical_cast.hpp>
 
 #include <error.hpp>
 
@@ -33,21 +34,41 @@
 
 namespace logfile_filter {
 	struct filter_obj {
+		typedef std::pair<std::string::size_type, std::string::size_type> column_type;
 		std::string filename;
 		std::string line;
-		std::vector<std::string> chunks;
+		std::string split;
+		// Columns are split on demand and stored as (offset, length) into line
+		mutable std::vector<column_type> columns;
+		mutable std::string::size_type split_pos;
+		mutable bool split_done;
 		typedef parsers::where::node_type node_type;
-		filter_obj(std::string filename, std::string line, std::list<std::string> chunks) : filename(filename), line(line), chunks(chunks.begin(), chunks.end()) {}
+		filter_obj() : split_pos(0), split_done(false) {}
+		filter_obj(const std::string &filename, const std::string &line, const std::string &split) : filename(filename), line(line), split(split), split_pos(0), split_done(false) {}
+
+		// Re-use this object for a new line (keeps the allocated buffers)
+		void set_line(const std::string &file, const char *begin, const char *end, const std::string &column_split) {
+			if (filename != file)
+				filename = file;
+			if (split != column_split)
+				split = column_split;
+			line.assign(begin, end);
+			columns.clear();
+			split_pos = 0;
+			split_done = false;
+		}
 
 		std::string get_column(std::size_t col) const {
-			if (col >= 1 && col <= chunks.size())
-				return chunks[col - 1];
-			return "";
+			if (!has_column(col))
+				return "";
+			const column_type &c = columns[col - 1];
+			return line.substr(c.first, c.second);
 		}
 		long long get_column_number(std::size_t col) const {
-			if (col >= 1 && col <= chunks.size())
-				return strEx::s::stox<long long>(chunks[col - 1]);
-			return 0;
+			if (!has_column(col))
+				return 0;
+			const column_type &c = columns[col - 1];
+			return boost::lexical_cast<long long>(line.data() + c.first, c.second);
 		}
 		std::string get_filename() const {
 			return filename;
@@ -57,11 +78,35 @@ namespace logfile_filter {
 		}
 		node_type get_column_fun(parsers::where::value_type target_type, parsers::where::evaluation_context context, const node_type subject);
 		std::string to_string() const { return filename; }
+	private:
+		bool has_column(std::size_t col) const {
+			if (col < 1)
+				return false;
+			while (columns.size() < col && split_next()) {}
+			return col <= columns.size();
+		}
+		bool split_next() const {
+			if (split_done)
+				return false;
+			std::string::size_type pos = line.find(split, split_pos);
+			if (pos == std::string::npos) {
+				split_done = true;
+				if (split_pos >= line.size())
+					return false;
+				columns.push_back(column_type(split_pos, line.size() - split_pos));
+				return true;
+			}
+			columns.push_back(column_type(split_pos, pos - split_pos));
+			split_pos = pos + 1;
+			return true;
+		}
 	};
 
 	typedef parsers::where::filter_handler_impl<boost::shared_ptr<filter_obj> > native_context;
 	struct filter_obj_handler : public native_context {
 		filter_obj_handler();
+		// True if the bound expressions need the line text (line or any column)
+		bool uses_text() const;
 	};
 
 	typedef modern_filter::modern_filters<filter_obj, filter_obj_handler> filter;
@@ -0,0 +1,247 @@
+/*
+ * Copyright 2004-2016 The NSClient++ Authors - https://nsclient.org
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "log_tailer.hpp"
+
+#include <string.h>
+
+#ifdef WIN32
+#include <windows.h>
+#else
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#endif
+
+#define BLOCK_SIZE (256*1024)
+// Lines longer than this are split
+#define MAX_LINE_SIZE (4*1024*1024)
+
+#ifdef WIN32
+#define INVALID_HANDLE INVALID_HANDLE_VALUE
+#else
+#define INVALID_HANDLE -1
+#endif
+
+log_tailer::log_tailer(const boost::filesystem::path &file)
+	: file_(file)
+	, handle_(INVALID_HANDLE)
+	, offset_(0)
+	, buffer_(BLOCK_SIZE)
+	, pending_(0) {}
+
+log_tailer::~log_tailer() {
+	close();
+}
+
+bool log_tailer::is_open() const {
+	return handle_ != INVALID_HANDLE;
+}
+
+#ifdef WIN32
+bool log_tailer::open() {
+	close();
+	handle_ = CreateFileW(file_.wstring().c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (handle_ == INVALID_HANDLE)
+		return false;
+	BY_HANDLE_FILE_INFORMATION info;
+	if (!GetFileInformationByHandle(handle_, &info)) {
+		close();
+		return false;
+	}
+	id_.device = info.dwVolumeSerialNumber;
+	id_.index = (static_cast<boost::uint64_t>(info.nFileIndexHigh) << 32) | info.nFileIndexLow;
+	offset_ = 0;
+	pending_ = 0;
+	return true;
+}
+
+void log_tailer::close() {
+	if (handle_ != INVALID_HANDLE)
+		CloseHandle(handle_);
+	handle_ = INVALID_HANDLE;
+}
+
+bool log_tailer::stat_path(file_id &id, boost::uint64_t &size) const {
+	HANDLE h = CreateFileW(file_.wstring().c_str(), FILE_READ_ATTRIBUTES, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (h == INVALID_HANDLE_VALUE)
+		return false;
+	BY_HANDLE_FILE_INFORMATION info;
+	bool ok = GetFileInformationByHandle(h, &info) != FALSE;
+	CloseHandle(h);
+	if (!ok)
+		return false;
+	id.device = info.dwVolumeSerialNumber;
+	id.index = (static_cast<boost::uint64_t>(info.nFileIndexHigh) << 32) | info.nFileIndexLow;
+	size = (static_cast<boost::uint64_t>(info.nFileSizeHigh) << 32) | info.nFileSizeLow;
+	return true;
+}
+
+bool log_tailer::stat_handle(boost::uint64_t &size) const {
+	LARGE_INTEGER li;
+	if (!GetFileSizeEx(handle_, &li))
+		return false;
+	size = li.QuadPart;
+	return true;
+}
+
+long long log_tailer::read_block(char *target, std::size_t count, boost::uint64_t offset) {
+	OVERLAPPED ov;
+	memset(&ov, 0, sizeof(ov));
+	ov.Offset = static_cast<DWORD>(offset & 0xffffffff);
+	ov.OffsetHigh = static_cast<DWORD>(offset >> 32);
+	DWORD read = 0;
+	if (!ReadFile(handle_, target, static_cast<DWORD>(count), &read, &ov))
+		return GetLastError() == ERROR_HANDLE_EOF ? 0 : -1;
+	return read;
+}
+#else
+bool log_tailer::open() {
+	close();
+	handle_ = ::open(file_.string().c_str(), O_RDONLY);
+	if (handle_ == INVALID_HANDLE)
+		return false;
+	fcntl(handle_, F_SETFD, FD_CLOEXEC);
+	struct stat st;
+	if (fstat(handle_, &st) != 0) {
+		close();
+		return false;
+	}
+	id_.device = st.st_dev;
+	id_.index = st.st_ino;
+	offset_ = 0;
+	pending_ = 0;
+	return true;
+}
+
+void log_tailer::close() {
+	if (handle_ != INVALID_HANDLE)
+		::close(handle_);
+	handle_ = INVALID_HANDLE;
+}
+
+bool log_tailer::stat_path(file_id &id, boost::uint64_t &size) const {
+	struct stat st;
+	if (stat(file_.string().c_str(), &st) != 0)
+		return false;
+	id.device = st.st_dev;
+	id.index = st.st_ino;
+	size = st.st_size;
+	return true;
+}
+
+bool log_tailer::stat_handle(boost::uint64_t &size) const {
+	struct stat st;
+	if (fstat(handle_, &st) != 0)
+		return false;
+	size = st.st_size;
+	return true;
+}
+
+long long log_tailer::read_block(char *target, std::size_t count, boost::uint64_t offset) {
+	while (true) {
+		ssize_t ret = pread(handle_, target, count, static_cast<off_t>(offset));
+		if (ret >= 0 || errno != EINTR)
+			return ret;
+	}
+}
+#endif
+
+void log_tailer::seek_end() {
+	boost::uint64_t size;
+	if (open() && stat_handle(size))
+		offset_ = size;
+}
+
+bool log_tailer::has_changed() const {
+	file_id id;
+	boost::uint64_t size;
+	if (!stat_path(id, size)) {
+		// Rotated away and not yet re-created: anything left in the old file?
+		return is_open() && stat_handle(size) && size != offset_;
+	}
+	if (!is_open())
+		return size > 0;
+	return id != id_ || size != offset_;
+}
+
+std::size_t log_tailer::read_lines(const line_handler &handler) {
+	if (!is_open() && !open())
+		return 0;
+	file_id id;
+	boost::uint64_t size;
+	bool rotated = stat_path(id, size) && id != id_;
+	if (stat_handle(size) && size < offset_) {
+		// Truncated: start over
+		offset_ = 0;
+		pending_ = 0;
+	}
+	std::size_t count = drain(handler);
+	if (rotated) {
+		// The old file is complete, flush any unterminated line and follow the new one
+		count += split_lines(handler, pending_, true);
+		if (open())
+			count += drain(handler);
+	}
+	return count;
+}
+
+std::size_t log_tailer::drain(const line_handler &handler) {
+	std::size_t count = 0;
+	while (true) {
+		if (buffer_.size() - pending_ < BLOCK_SIZE / 2) {
+			if (buffer_.size() >= MAX_LINE_SIZE)
+				count += split_lines(handler, pending_, true);
+			else
+				buffer_.resize(buffer_.size() * 2);
+		}
+		long long read = read_block(&buffer_[pending_], buffer_.size() - pending_, offset_);
+		if (read <= 0)
+			break;
+		offset_ += read;
+		count += split_lines(handler, pending_ + static_cast<std::size_t>(read), false);
+	}
+	return count;
+}
+
+std::size_t log_tailer::split_lines(const line_handler &handler, std::size_t length, bool flush) {
+	std::size_t count = 0;
+	const char *data = &buffer_[0];
+	const char *end = data + length;
+	const char *begin = data;
+	while (begin < end) {
+		const char *eol = static_cast<const char*>(memchr(begin, '\n', end - begin));
+		if (eol == NULL) {
+			if (!flush)
+				break;
+			eol = end;
+		}
+		const char *line_end = eol;
+		if (line_end > begin && *(line_end - 1) == '\r')
+			line_end--;
+		if (line_end > begin) {
+			handler(begin, line_end);
+			count++;
+		}
+		begin = eol == end ? end : eol + 1;
+	}
+	pending_ = end - begin;
+	if (pending_ > 0 && begin != data)
+		memmove(&buffer_[0], begin, pending_);
+	return count;
+}
@@ -0,0 +1,97 @@
+/*
+ * Copyright 2004-2016 The NSClient++ Authors - https://nsclient.org
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <vector>
+
+#include <boost/cstdint.hpp>
+#include <boost/function.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/filesystem/path.hpp>
+
+/**
+ * Follows a single log file keeping the file open between reads.
+ * New data is read in large blocks from the last offset and split into lines
+ * in place, lines are handed to the caller as pointers into the internal buffer.
+ * The file identity (device/inode or volume/file index) is tracked so rotation
+ * (rename and re-create) and truncation are detected.
+ */
+class log_tailer : public boost::noncopyable {
+public:
+	typedef boost::function<void(const char *begin, const char *end)> line_handler;
+
+private:
+	struct file_id {
+		boost::uint64_t device;
+		boost::uint64_t index;
+		file_id() : device(0), index(0) {}
+		bool operator==(const file_id &other) const {
+			return device == other.device && index == other.index;
+		}
+		bool operator!=(const file_id &other) const {
+			return !(*this == other);
+		}
+	};
+#ifdef WIN32
+	typedef void* handle_type;
+#else
+	typedef int handle_type;
+#endif
+
+	boost::filesystem::path file_;
+	handle_type handle_;
+	file_id id_;
+	boost::uint64_t offset_;
+	std::vector<char> buffer_;
+	std::size_t pending_;
+
+public:
+	log_tailer(const boost::filesystem::path &file);
+	~log_tailer();
+
+	const boost::filesystem::path& get_file() const {
+		return file_;
+	}
+	bool is_open() const;
+
+	/**
+	 * Open the file and position at the end so only data written from now on is read.
+	 */
+	void seek_end();
+
+	/**
+	 * Check (without reading) if the file has grown, shrunk or been replaced.
+	 */
+	bool has_changed() const;
+
+	/**
+	 * Read all complete lines written since the last call.
+	 * A trailing line without line break is kept until it is completed, unless the
+	 * file has been rotated in which case it is flushed.
+	 * @return number of lines read
+	 */
+	std::size_t read_lines(const line_handler &handler);
+
+private:
+	bool open();
+	void close();
+	bool stat_path(file_id &id, boost::uint64_t &size) const;
+	bool stat_handle(boost::uint64_t &size) const;
+	long long read_block(char *target, std::size_t count, boost::uint64_t offset);
+	std::size_t drain(const line_handler &handler);
+	std::size_t split_lines(const line_handler &handler, std::size_t length, bool flush);
+};
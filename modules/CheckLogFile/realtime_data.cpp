@@ -17,6 +17,7 @@
 #include "realtime_data.hpp"
 
 #include <boost/foreach.hpp>
+#include <boost/bind.hpp>
 #include <boost/filesystem.hpp>
 
 #include <strEx.h>
@@ -24,19 +25,16 @@
 #include <nscapi/nscapi_helper_singleton.hpp>
 #include <nscapi/macros.hpp>
 
-void runtime_data::touch(boost::posix_time::ptime now) {
+void runtime_data::boot() {
+	// Only report lines written after we started
 	BOOST_FOREACH(file_container &fc, files) {
-		if (boost::filesystem::exists(fc.file)) {
-			fc.size = boost::filesystem::file_size(fc.file);
-		} else {
-			fc.size = 0;
-		}
+		fc.tailer->seek_end();
 	}
 }
 
 bool runtime_data::has_changed(transient_data_type) const {
 	BOOST_FOREACH(const file_container &fc, files) {
-		if (boost::filesystem::exists(fc.file) &&  fc.size != boost::filesystem::file_size(fc.file))
+		if (fc.tailer->has_changed())
 			return true;
 	}
 	return false;
@@ -45,42 +43,30 @@ bool runtime_data::has_changed(transient_data_type) const {
 void runtime_data::add_file(const boost::filesystem::path &path) {
 	try {
 		file_container fc;
-		if (boost::filesystem::exists(path)) {
-			fc.file = path;
-			fc.size = boost::filesystem::file_size(fc.file);
-		} else {
-			fc.file = path;
-			fc.size = 0;
-		}
+		fc.file = path.string();
+		fc.tailer.reset(new log_tailer(path));
 		files.push_back(fc);
 	} catch (std::exception &e) {
 		NSC_LOG_ERROR("Failed to add " + path.string() + ": " + utf8::utf8_from_native(e.what()));
 	}
 }
 
+void runtime_data::process_line(filter_type &filter, const std::string &file, bool text, const char *begin, const char *end, modern_filter::match_result &result) {
+	record->set_line(file, begin, text ? end : begin, column_split);
+	result.append(filter.match(record));
+}
+
 modern_filter::match_result runtime_data::process_item(filter_type &filter, transient_data_type) {
 	modern_filter::match_result ret;
+	if (!record)
+		record.reset(new logfile_filter::filter_obj());
+	bool text = filter.context->uses_text();
 	BOOST_FOREACH(file_container &c, files) {
-		boost::uintmax_t sz = boost::filesystem::file_size(c.file);
-		if (sz == c.size)
+		if (!c.tailer->has_changed())
 			continue;
-		std::ifstream file(c.file.string().c_str());
-		if (file.is_open()) {
-			std::string line;
-			if (sz > c.size)
-				file.seekg(c.size);
-			while (file.good()) {
-				std::getline(file, line, '\n');
-				if (!line.empty()) {
-					std::list<std::string> chunks = strEx::s::splitEx(line, utf8::cvt<std::string>(column_split));
-					boost::shared_ptr<logfile_filter::filter_obj> record(new logfile_filter::filter_obj(c.file.string(), line, chunks));
-					ret.append(filter.match(record));
-				}
-			}
-			file.close();
-		} else {
-			NSC_LOG_ERROR("Failed to open file: " + c.file.string());
-		}
+		c.tailer->read_lines(boost::bind(&runtime_data::process_line, this, boost::ref(filter), boost::cref(c.file), text, _1, _2, boost::ref(ret)));
+		if (!c.tailer->is_open())
+			NSC_LOG_ERROR("Failed to open file: " + c.file);
 	}
 	return ret;
 }
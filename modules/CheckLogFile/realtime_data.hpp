@@ -20,6 +20,7 @@
 #include <boost/filesystem/path.hpp>
 
 #include "filter.hpp"
+#include "log_tailer.hpp"
 
 struct runtime_data {
 	struct transient_data_impl {
@@ -31,19 +32,24 @@ struct runtime_data {
 	typedef boost::shared_ptr<transient_data_impl> transient_data_type;
 
 	struct file_container {
-		boost::filesystem::path file;
-		boost::uintmax_t size;
+		std::string file;
+		boost::shared_ptr<log_tailer> tailer;
 	};
 
 	std::list<file_container> files;
 	std::string column_split;
 	std::string line_split;
+	boost::shared_ptr<logfile_filter::filter_obj> record;
 
-	void boot() {}
-	void touch(boost::posix_time::ptime now);
+	void boot();
+	// The tailers keep track of how far each file has been read
+	void touch(boost::posix_time::ptime) {}
 	bool has_changed(transient_data_type) const;
 	modern_filter::match_result process_item(filter_type &filter, transient_data_type);
 	void set_split(std::string line, std::string column);
 
 	void add_file(const boost::filesystem::path &path);
+
+private:
+	void process_line(filter_type &filter, const std::string &file, bool text, const char *begin, const char *end, modern_filter::match_result &result);
 };
\ No newline at end of file
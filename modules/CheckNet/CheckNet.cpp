@@ -41,6 +41,7 @@ void CheckNet::check_ping(const Plugin::QueryRequestMessage::Request &request, P
 	bool total = false;
 	int count = 0;
 	int timeout = 0;
+	int interval = 0;
 
 	ping_filter::filter filter;
 	filter_helper.add_options("time > 60 or loss > 5%", "time > 100 or loss > 10%", "", filter.get_filter_syntax(), "unknown");
@@ -55,6 +56,8 @@ void CheckNet::check_ping(const Plugin::QueryRequestMessage::Request &request, P
 			"Number of packets to send.")
 		("timeout", po::value<int>(&timeout)->default_value(500),
 			"Timeout in milliseconds.")
+		("interval", po::value<int>(&interval)->default_value(100),
+			"Time in milliseconds between packets sent to the same host (all hosts are pinged at the same time).")
 		;
 
 	if (!filter_helper.parse_options())
@@ -65,6 +68,8 @@ void CheckNet::check_ping(const Plugin::QueryRequestMessage::Request &request, P
 
 	if (hosts.empty())
 		return nscapi::protobuf::functions::set_response_bad(*response, "No host specified");
+	if (interval <= 0)
+		return nscapi::protobuf::functions::set_response_bad(*response, "Invalid interval, must be greater than 0");
 	if (hosts.size() == 1)
 		filter_helper.show_all = true;
 
@@ -75,14 +80,13 @@ void CheckNet::check_ping(const Plugin::QueryRequestMessage::Request &request, P
 	if (total)
 		total_obj = ping_filter::filter_obj::get_total();
 
+	pinger ping(timeout, count, interval);
 	BOOST_FOREACH(const std::string &host, hosts) {
-		result_container result;
-		for (int i = 0; i < count; i++) {
-			boost::asio::io_service io_service;
-			pinger ping(io_service, result, host.c_str(), timeout);
-			ping.ping();
-			io_service.run();
-		}
+		ping.add_host(host);
+	}
+	ping.run();
+
+	BOOST_FOREACH(const result_container &result, ping.get_results()) {
 		boost::shared_ptr<ping_filter::filter_obj> obj = boost::make_shared<ping_filter::filter_obj>(result);
 		filter.match(obj);
 		if (total_obj)
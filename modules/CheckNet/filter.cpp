@@ -55,7 +55,10 @@ ping_filter::filter_obj_handler::filter_obj_handler() {
 		;
 	registry_.add_int()
 		("loss", type_custom_pct, &filter_obj::get_loss, "Packet loss")
-		("time", type_int, &filter_obj::get_time, "Round trip time in ms")
+		("time", type_int, &filter_obj::get_time, "Round trip time in ms (average of all replies)")
+		("min", type_int, &filter_obj::get_time_min, "Shortest round trip time in ms")
+		("max", type_int, &filter_obj::get_time_max, "Longest round trip time in ms")
+		("jitter", type_int, &filter_obj::get_jitter, "Average difference in ms between the round trip time of consecutive replies")
 		("sent", type_int, &filter_obj::get_sent, "Number of packets sent to the host")
 		("recv", type_int, &filter_obj::get_recv, "Number of packets received from the host")
 		("timeout", type_int, &filter_obj::get_timeout, "Number of packets which timed out from the host")
@@ -76,10 +79,7 @@ ping_filter::filter_obj_handler::filter_obj_handler() {
 void ping_filter::filter_obj::add(boost::shared_ptr<ping_filter::filter_obj> other) {
 	if (!other)
 		return;
-	result.num_send_ += other->result.num_send_;
-	result.num_replies_ += other->result.num_replies_;
-	result.num_timeouts_ += other->result.num_timeouts_;
-	result.time_ += other->result.time_;
+	result.add(other->result);
 }
 
 //////////////////////////////////////////////////////////////////////////
@@ -75,6 +75,9 @@ namespace ping_filter {
 			return result.num_timeouts_ * 100 / result.num_send_;
 		}
 		long long get_time(parsers::where::evaluation_context) { return result.time_; }
+		long long get_time_min(parsers::where::evaluation_context) { return result.time_min_; }
+		long long get_time_max(parsers::where::evaluation_context) { return result.time_max_; }
+		long long get_jitter(parsers::where::evaluation_context) { return result.jitter_; }
 
 		bool is_total_;
 		result_container result;
@@ -31,6 +31,7 @@
 #include <utils.h>
 #include <nscapi/nscapi_settings_helper.hpp>
 #include <nscapi/nscapi_program_options.hpp>
+#include <nscapi/nscapi_metrics_helper.hpp>
 #include <parsers/filter/cli_helper.hpp>
 
 #include "filter.hpp"
@@ -39,7 +40,6 @@ namespace sh = nscapi::settings_helper;
 namespace po = boost::program_options;
 
 #define UPTIME_FILE  "/proc/uptime"
-#define MEMINFO_FILE  "/proc/meminfo"
 
 
 
@@ -53,11 +53,28 @@ bool CheckSystem::loadModuleEx(std::string alias, NSCAPI::moduleLoadMode mode) {
 	sh::settings_registry settings(get_settings_proxy());
 	settings.set_alias("system", alias, "unix");
 	std::string counter_path = settings.alias().get_settings_path("counters");
+	int memory_cache = 1000;
+
+	settings.alias().add_path_to_settings()
+		("UNIX CHECK SYSTEM", "Section for system checks and system settings")
+		;
+
+	settings.alias().add_key_to_settings()
+		("memory cache", sh::int_key(&memory_cache, 1000),
+			"MEMORY CACHE", "Time in milliseconds a sample of /proc/meminfo is shared between memory checks and metrics (0 to read it on every check).", true)
+		;
+
+	settings.register_all();
+	settings.notify();
+	memory.set_ttl(memory_cache);
 
 //	collector.filters_path_ = settings.alias().get_settings_path("real-time/checks");
 
 	//filters::filter_config_handler::add_samples(get_settings_proxy(), collector.filters_path_);
-	
+
+	if (mode == NSCAPI::normalStart) {
+		collector.start();
+	}
 	return true;
 }
 
@@ -68,11 +85,107 @@ bool CheckSystem::loadModuleEx(std::string alias, NSCAPI::moduleLoadMode mode) {
  * @return true if successfully, false if not (if not things might be bad)
  */
 bool CheckSystem::unloadModule() {
+	if (!collector.stop()) {
+		NSC_LOG_ERROR_STD("Could not exit the thread, memory leak and potential corruption may be the result...");
+	}
 	return true;
 }
 
 void CheckSystem::check_cpu(const Plugin::QueryRequestMessage::Request &request, Plugin::QueryResponseMessage::Response *response) {
+	typedef check_cpu_filter::filter filter_type;
+	modern_filter::data_container data;
+	modern_filter::cli_helper<filter_type> filter_helper(request, response, data);
+	std::vector<std::string> times;
+
+	filter_type filter;
+	filter_helper.add_options("load > 80", "load > 90", "core = 'total'", filter.get_filter_syntax(), "ignored");
+	filter_helper.add_syntax("${status}: ${problem_list}", filter.get_filter_syntax(), "${time}: ${load}%", "${core} ${time}", "", "%(status): CPU load is ok.");
+	filter_helper.get_desc().add_options()
+		("time", po::value<std::vector<std::string> >(&times), "The time to check (can be given multiple times or as a comma separated list: time=1m,5m,15m)")
+		;
 
+	if (!filter_helper.parse_options())
+		return;
+
+	std::vector<std::string> all_times;
+	BOOST_FOREACH(const std::string &t, times) {
+		BOOST_FOREACH(const std::string &s, strEx::s::splitEx(t, std::string(","))) {
+			if (!s.empty())
+				all_times.push_back(s);
+		}
+	}
+	if (all_times.empty()) {
+		all_times.push_back("5m");
+		all_times.push_back("1m");
+		all_times.push_back("5s");
+	}
+
+	if (!filter_helper.build_filter(filter))
+		return;
+
+	BOOST_FOREACH(const std::string &time, all_times) {
+		std::map<std::string, system_info::load_entry> vals;
+		try {
+			vals = collector.get_cpu_load(format::decode_time<long>(time, 1));
+		} catch (const nscp_exception &e) {
+			return nscapi::protobuf::functions::set_response_bad(*response, "Failed to get cpu load for " + time + ": " + e.reason());
+		}
+		typedef std::map<std::string, system_info::load_entry>::value_type vt;
+		BOOST_FOREACH(const vt &v, vals) {
+			boost::shared_ptr<check_cpu_filter::filter_obj> record(new check_cpu_filter::filter_obj(time, v.first, v.second));
+			filter.match(record);
+		}
+	}
+	filter_helper.post_process(filter);
+}
+
+void CheckSystem::fetchMetrics(Plugin::MetricsMessage::Response *response) {
+	using namespace nscapi::metrics;
+
+	Plugin::Common::MetricsBundle *bundle = response->add_bundles();
+	bundle->set_key("system");
+	try {
+		Plugin::Common::MetricsBundle *section = bundle->add_children();
+		section->set_key("cpu");
+
+		std::map<std::string, system_info::load_entry> vals = collector.get_cpu_load(5);
+		typedef std::map<std::string, system_info::load_entry>::value_type vt;
+		BOOST_FOREACH(const vt &v, vals) {
+			add_metric(section, v.first + ".idle", v.second.idle);
+			add_metric(section, v.first + ".total", v.second.total);
+			add_metric(section, v.first + ".kernel", v.second.kernel);
+			add_metric(section, v.first + ".user", v.second.total - v.second.kernel);
+		}
+		unsigned long long samples = 0, errors = 0;
+		collector.get_metrics(samples, errors);
+		add_metric(section, "samples", samples);
+		add_metric(section, "errors", errors);
+	} catch (const nscp_exception &e) {
+		NSC_LOG_ERROR("Failed to fetch cpu metrics: " + e.reason());
+	}
+
+	try {
+		system_info::memory_usage mem = memory.get();
+		Plugin::Common::MetricsBundle *section = bundle->add_children();
+		section->set_key("mem");
+		add_metric(section, "physical.total", mem.mem_total);
+		add_metric(section, "physical.free", mem.mem_free);
+		add_metric(section, "physical.used", mem.mem_total - mem.mem_free);
+		add_metric(section, "physical.avail", mem.get_available());
+		add_metric(section, "buffers", mem.buffers);
+		add_metric(section, "cached", mem.cached);
+		add_metric(section, "slab", mem.slab);
+		add_metric(section, "swap.total", mem.swap_total);
+		add_metric(section, "swap.free", mem.swap_free);
+		add_metric(section, "swap.used", mem.swap_total - mem.swap_free);
+		add_metric(section, "committed.limit", mem.commit_limit);
+		add_metric(section, "committed.used", mem.committed_as);
+		add_metric(section, "hugepages.total", mem.hugepages_total);
+		add_metric(section, "hugepages.free", mem.hugepages_free);
+		add_metric(section, "hugepages.size", mem.hugepage_size);
+	} catch (const nscp_exception &e) {
+		NSC_LOG_ERROR("Failed to fetch memory metrics: " + e.reason());
+	}
 }
 
 
@@ -164,51 +277,17 @@ void CheckSystem::check_pagefile(const Plugin::QueryRequestMessage::Request &req
 
 }
 
-long long read_mem_line(std::stringstream &iss) {
-	std::string unit;
-	unsigned long long value;
-	iss >> value >> unit;
-	if (unit == "kB") {
-		value*=1024;
-	} else if (!unit.empty()) {
-		NSC_LOG_ERROR("Invalid memory unit: " + unit);
-	}
-	return value;
-}
-std::list<check_mem_filter::filter_obj> get_memory() {
+std::list<check_mem_filter::filter_obj> get_memory(const system_info::memory_usage &mem) {
 	std::list<check_mem_filter::filter_obj> ret;
-	check_mem_filter::filter_obj physical("physical", 0, 0);
-	check_mem_filter::filter_obj swap("swap", 0, 0);
-	long long cached = 0;
-
-	try {
-		std::locale mylocale("C");
-		std::ifstream file;
-		file.imbue(mylocale);
-		file.open(MEMINFO_FILE);
-		std::string line;
-		while (std::getline(file, line)) {
-			std::stringstream iss(line);
-			std::string tag;
-			iss >> tag;
-			if (tag == "MemTotal:")
-				physical.total = read_mem_line(iss);
-			else if (tag == "MemFree:")
-				physical.free = read_mem_line(iss);
-			else if (tag == "Buffers:" || tag == "Cached:")
-				cached += read_mem_line(iss);
-			else if (tag == "SwapTotal:")
-				swap.total += read_mem_line(iss);
-			else if (tag == "SwapFree:")
-				swap.free += read_mem_line(iss);
-		}
-		ret.push_back(physical);
-		ret.push_back(check_mem_filter::filter_obj("cached", physical.get_used()-cached, physical.total));
-		ret.push_back(swap);
-	} catch (const std::exception &e) {
-		return ret;
-	}
-    return ret;
+	check_mem_filter::filter_obj physical("physical", mem.mem_free, mem.mem_total);
+	ret.push_back(physical);
+	ret.push_back(check_mem_filter::filter_obj("cached", mem.get_free_with_cache(), mem.mem_total));
+	ret.push_back(check_mem_filter::filter_obj("swap", mem.swap_free, mem.swap_total));
+	ret.push_back(check_mem_filter::filter_obj("available", mem.get_available(), mem.mem_total));
+	ret.push_back(check_mem_filter::filter_obj("committed", mem.committed_as < mem.commit_limit ? mem.commit_limit - mem.committed_as : 0, mem.commit_limit));
+	ret.push_back(check_mem_filter::filter_obj("slab", mem.mem_total - mem.slab, mem.mem_total));
+	ret.push_back(check_mem_filter::filter_obj("hugepages", mem.hugepages_free * mem.hugepage_size, mem.hugepages_total * mem.hugepage_size));
+	return ret;
 }
 
 void CheckSystem::check_memory(const Plugin::QueryRequestMessage::Request &request, Plugin::QueryResponseMessage::Response *response) {
@@ -221,7 +300,7 @@ void CheckSystem::check_memory(const Plugin::QueryRequestMessage::Request &reque
 	filter_helper.add_options("used > 80%", "used > 90%", "", filter.get_filter_syntax(), "ignored");
 	filter_helper.add_syntax("${status}: ${list}", filter.get_filter_syntax(), "${type} = ${used}", "${type}", "", "");
 	filter_helper.get_desc().add_options()
-		("type", po::value<std::vector<std::string> >(&types), "The type of memory to check (physical = Physical memory (RAM), committed = total memory (RAM+PAGE)")
+		("type", po::value<std::vector<std::string> >(&types), "The type of memory to check (physical = Physical memory (RAM), cached = RAM used excluding buffers and cache, swap, available = RAM available for new applications, committed = committed memory against the commit limit, slab = kernel slab, hugepages)")
 		;
 
 	if (!filter_helper.parse_options())
@@ -238,7 +317,7 @@ void CheckSystem::check_memory(const Plugin::QueryRequestMessage::Request &reque
 
 	std::list<check_mem_filter::filter_obj> mem_data;
 	try {
-		mem_data = get_memory();
+		mem_data = get_memory(memory.get());
 	} catch (const std::exception &e) {
 		return nscapi::protobuf::functions::set_response_bad(*response, e.what());
 	}
@@ -263,5 +342,79 @@ void CheckSystem::check_memory(const Plugin::QueryRequestMessage::Request &reque
 
 
 void CheckSystem::check_process(const Plugin::QueryRequestMessage::Request &request, Plugin::QueryResponseMessage::Response *response) {
+	typedef check_proc_filter::filter filter_type;
+	modern_filter::data_container data;
+	modern_filter::cli_helper<filter_type> filter_helper(request, response, data);
+	std::vector<std::string> processes;
+	bool deep_scan = true;
+	bool total = false;
+
+	filter_type filter;
+	filter_helper.add_warn_option("state not in ('started')");
+	filter_helper.add_crit_option("state = 'stopped'", "count = 0");
+
+	filter_helper.add_options(filter.get_filter_syntax(), "unknown");
+	filter_helper.add_syntax("${status}: ${problem_list}", filter.get_filter_syntax(), "${exe}=${state}", "${exe}", "%(status): No processes found", "%(status): all processes are ok.");
+	filter_helper.get_desc().add_options()
+		("process", po::value<std::vector<std::string> >(&processes), "The process to check, set this to * to check all processes")
+		("scan-info", po::value<bool>(&deep_scan), "If all process metrics should be fetched (otherwise only status is fetched)")
+		("total", po::bool_switch(&total), "Include the total of all matching processes")
+		;
+
+	if (!filter_helper.parse_options())
+		return;
+
+	if (processes.empty()) {
+		processes.push_back("*");
+	}
+	if (!filter_helper.build_filter(filter))
+		return;
+
+	std::set<std::string> procs;
+	bool all = false;
+	BOOST_FOREACH(const std::string &process, processes) {
+		if (process == "*")
+			all = true;
+		else if (procs.count(process) == 0)
+			procs.insert(process);
+	}
+
+	process_helper::process_list list;
+	try {
+		boost::unique_lock<boost::mutex> lock(process_mutex);
+		list = proc_scanner.scan(deep_scan);
+	} catch (const nscp_exception &e) {
+		return nscapi::protobuf::functions::set_response_bad(*response, "Failed to enumerate processes: " + e.reason());
+	}
 
+	boost::shared_ptr<process_helper::process_info> total_obj;
+	if (total)
+		total_obj.reset(new process_helper::process_info("total"));
+
+	std::vector<std::string> matched;
+	BOOST_FOREACH(const process_helper::process_info &info, list) {
+		bool wanted = procs.count(info.exe) > 0;
+		if (all || wanted) {
+			boost::shared_ptr<process_helper::process_info> record(new process_helper::process_info(info));
+			modern_filter::match_result ret = filter.match(record);
+			if (total_obj && ret.matched_filter)
+				*total_obj += info;
+		}
+		if (wanted) {
+			matched.push_back(info.exe);
+		}
+	}
+	BOOST_FOREACH(const std::string &proc, matched) {
+		procs.erase(proc);
+	}
+
+	BOOST_FOREACH(const std::string &proc, procs) {
+		boost::shared_ptr<process_helper::process_info> record(new process_helper::process_info(proc));
+		filter.match(record);
+	}
+	if (total_obj) {
+		total_obj->started = true;
+		filter.match(total_obj);
+	}
+	filter_helper.post_process(filter);
 }
@@ -22,8 +22,16 @@
 #include <nscapi/nscapi_settings_object.hpp>
 
 #include "filter_config_object.hpp"
+#include "realtime_thread.hpp"
+#include "process_scanner.hpp"
 
 class CheckSystem : public nscapi::impl::simple_plugin {
+private:
+	pdh_thread collector;
+	system_info::memory_reader memory;
+	boost::mutex process_mutex;
+	process_helper::process_scanner proc_scanner;
+
 public:
 	CheckSystem() {}
 	virtual ~CheckSystem() {}
@@ -40,4 +48,6 @@ public:
 	void check_pagefile(const Plugin::QueryRequestMessage::Request &request, Plugin::QueryResponseMessage::Response *response);
 	void add_counter(boost::shared_ptr<nscapi::settings_proxy> proxy, std::string path, std::string key, std::string query);
 	void check_os_version(const Plugin::QueryRequestMessage::Request &request, Plugin::QueryResponseMessage::Response *response);
+
+	void fetchMetrics(Plugin::MetricsMessage::Response *response);
 };
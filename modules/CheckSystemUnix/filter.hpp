@@ -30,22 +30,26 @@
 #include <parsers/filter/modern_filter.hpp>
 #include <parsers/where/filter_handler_impl.hpp>
 
+#include "sysinfo.hpp"
+#include "process_scanner.hpp"
+
 namespace check_cpu_filter {
 
 	struct filter_obj {
 		std::string time;
 		std::string core;
+		system_info::load_entry value;
 
-		filter_obj(std::string time, std::string core) : time(time), core(core) {}
+		filter_obj(std::string time, std::string core, const system_info::load_entry &value) : time(time), core(core), value(value) {}
 
 		long long get_total() const {
-			return 0;
+			return static_cast<long long>(value.total);
 		}
 		long long get_idle() const {
-			return 0;
+			return static_cast<long long>(value.idle);
 		}
 		long long get_kernel() const {
-			return 0;
+			return static_cast<long long>(value.kernel);
 		}
 		std::string get_time() const {
 			return time;
@@ -57,7 +61,7 @@ namespace check_cpu_filter {
 			return boost::replace_all_copy(core, " ", "_");
 		}
 		long long get_core_i() const {
-			return 0;
+			return value.core;
 		}
 	};
 	typedef parsers::where::filter_handler_impl<boost::shared_ptr<filter_obj> > native_context;
@@ -110,7 +114,7 @@ namespace check_mem_filter {
 	};
 	typedef modern_filter::modern_filters<filter_obj, filter_obj_handler> filter;
 }
-/*
+
 namespace check_proc_filter {
 	typedef process_helper::process_info filter_obj;
 
@@ -120,7 +124,7 @@ namespace check_proc_filter {
 	};
 	typedef modern_filter::modern_filters<filter_obj, filter_obj_handler> filter;
 }
-*/
+
 namespace os_version_filter {
 
 	struct filter_obj {
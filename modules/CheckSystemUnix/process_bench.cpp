@@ -0,0 +1,134 @@
+/*
+ * Copyright 2004-2016 The NSClient++ Authors - https://nsclient.org
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <fstream>
+#include <sstream>
+#include <iostream>
+
+#include <unistd.h>
+
+#include <boost/filesystem.hpp>
+#include <boost/lexical_cast.hpp>
+#include <boost/date_time/posix_time/posix_time.hpp>
+
+#include "process_scanner.hpp"
+
+namespace fs = boost::filesystem;
+
+void create_tree(const fs::path &root, int count) {
+	fs::create_directories(root);
+	std::ofstream(fs::path(root / "stat").string().c_str()) << "cpu  1 2 3 4 5 6 7 8 0 0\nbtime 1500000000\n";
+	for (int i = 1; i <= count; i++) {
+		std::string pid = boost::lexical_cast<std::string>(i);
+		fs::path dir = root / pid;
+		fs::create_directories(dir);
+		std::ofstream(fs::path(dir / "stat").string().c_str())
+			<< pid << " (proc " << i % 100 << ") S 1 " << pid << " " << pid << " 0 -1 4194560 1000 0 0 0 "
+			<< i << " " << i * 2 << " 0 0 20 0 " << i % 8 + 1 << " 0 " << i * 100 << " " << i * 4096 << " " << i << " 18446744073709551615\n";
+		std::ofstream(fs::path(dir / "statm").string().c_str()) << i * 2 << " " << i << " " << i / 2 << " 10 0 100 0\n";
+		std::ofstream cmdline(fs::path(dir / "cmdline").string().c_str());
+		cmdline << "/usr/bin/proc" << i % 100 << '\0' << "--option" << '\0' << "value" << i << '\0';
+		if (::symlink(("/usr/bin/proc" + boost::lexical_cast<std::string>(i % 100)).c_str(), fs::path(dir / "exe").string().c_str()) != 0)
+			std::cout << "Failed to create link for " << pid << std::endl;
+	}
+	fs::create_directories(root / "self");
+	fs::create_directories(root / "sys");
+}
+
+// The straight forward way: a directory iterator and iostreams for every file.
+long long iostream_scan(const fs::path &root) {
+	long long checksum = 0;
+	for (fs::directory_iterator it(root); it != fs::directory_iterator(); ++it) {
+		std::string name = it->path().filename().string();
+		if (name.find_first_not_of("0123456789") != std::string::npos)
+			continue;
+		std::ifstream stat(fs::path(it->path() / "stat").string().c_str());
+		std::string line;
+		std::getline(stat, line);
+		std::stringstream ss(line.substr(line.rfind(')') + 2));
+		std::string field;
+		for (int i = 3; i <= 24 && ss >> field; i++) {
+			if (i == 14 || i == 15 || i == 20)
+				checksum += boost::lexical_cast<long long>(field);
+		}
+		std::ifstream statm(fs::path(it->path() / "statm").string().c_str());
+		long long size, resident;
+		statm >> size >> resident;
+		checksum += resident;
+		std::ifstream cmdline(fs::path(it->path() / "cmdline").string().c_str());
+		std::getline(cmdline, line);
+		checksum += fs::read_symlink(it->path() / "exe").string().size();
+	}
+	return checksum;
+}
+
+long long elapsed_us(const boost::posix_time::ptime &start) {
+	return (boost::posix_time::microsec_clock::local_time() - start).total_microseconds();
+}
+
+/**
+ * Scans a synthetic /proc tree: process_bench [processes] [iterations]
+ */
+int main(int argc, char *argv[]) {
+	int count = 10000;
+	int iterations = 10;
+	if (argc > 1)
+		count = boost::lexical_cast<int>(argv[1]);
+	if (argc > 2)
+		iterations = boost::lexical_cast<int>(argv[2]);
+
+	fs::path root = fs::temp_directory_path() / fs::unique_path("nscp-proc-%%%%%%%%");
+	std::cout << "Creating " << count << " processes in " << root.string() << std::endl;
+	create_tree(root, count);
+	int ret = 0;
+
+	boost::posix_time::ptime start = boost::posix_time::microsec_clock::local_time();
+	for (int i = 0; i < iterations; i++)
+		iostream_scan(root);
+	std::cout << "iostream scan:          " << elapsed_us(start) / iterations / 1000 << "ms" << std::endl;
+
+	process_helper::process_scanner scanner(root.string());
+	start = boost::posix_time::microsec_clock::local_time();
+	process_helper::process_list list = scanner.scan();
+	std::cout << "scanner (cold cache):   " << elapsed_us(start) / 1000 << "ms" << std::endl;
+
+	start = boost::posix_time::microsec_clock::local_time();
+	for (int i = 0; i < iterations; i++)
+		list = scanner.scan();
+	std::cout << "scanner (warm cache):   " << elapsed_us(start) / iterations / 1000 << "ms" << std::endl;
+
+	start = boost::posix_time::microsec_clock::local_time();
+	for (int i = 0; i < iterations; i++)
+		list = scanner.scan(false);
+	std::cout << "scanner (no scan-info): " << elapsed_us(start) / iterations / 1000 << "ms" << std::endl;
+
+	long long threads = 0;
+	for (process_helper::process_list::const_iterator it = list.begin(); it != list.end(); ++it) {
+		threads += it->threads;
+		if (it->exe != "proc" + boost::lexical_cast<std::string>(it->pid % 100) || it->user_time != it->pid / sysconf(_SC_CLK_TCK)) {
+			std::cout << "Invalid data for " << it->pid << ": " << it->exe << std::endl;
+			ret = 1;
+			break;
+		}
+	}
+	if (list.size() != static_cast<std::size_t>(count) || scanner.cache_size() != static_cast<std::size_t>(count)) {
+		std::cout << "Found " << list.size() << " processes (" << scanner.cache_size() << " cached), expected " << count << std::endl;
+		ret = 1;
+	}
+	std::cout << list.size() << " processes, " << threads << " threads" << std::endl;
+	fs::remove_all(root);
+	return ret;
+}
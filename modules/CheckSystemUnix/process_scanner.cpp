@@ -0,0 +1,345 @@
+/*
+ * Copyright 2004-2016 The NSClient++ Authors - https://nsclient.org
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "process_scanner.hpp"
+
+#include <cerrno>
+#include <cstring>
+
+#include <fcntl.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <sys/syscall.h>
+#else
+#include <cstdio>
+#endif
+
+#include <error.hpp>
+
+namespace process_helper {
+
+	namespace {
+		inline const char* next_field(const char *p, const char *end) {
+			while (p < end && *p != ' ')
+				++p;
+			while (p < end && *p == ' ')
+				++p;
+			return p;
+		}
+		inline unsigned long long read_number(const char *p, const char *end) {
+			unsigned long long value = 0;
+			while (p < end && *p >= '0' && *p <= '9')
+				value = value * 10 + (*p++ - '0');
+			return value;
+		}
+		inline long long read_signed(const char *p, const char *end) {
+			if (p < end && *p == '-')
+				return -static_cast<long long>(read_number(p + 1, end));
+			return static_cast<long long>(read_number(p, end));
+		}
+		std::string base_name(const std::string &path) {
+			std::string::size_type pos = path.find_last_of('/');
+			if (pos == std::string::npos)
+				return path;
+			return path.substr(pos + 1);
+		}
+#ifdef __linux__
+		// Layout of the records returned by getdents64 (not exposed by glibc headers)
+		struct linux_dirent64 {
+			unsigned long long d_ino;
+			long long d_off;
+			unsigned short d_reclen;
+			unsigned char d_type;
+			char d_name[1];
+		};
+
+		inline bool is_pid(const char *name) {
+			if (*name == '\0')
+				return false;
+			for (; *name; ++name) {
+				if (*name < '0' || *name > '9')
+					return false;
+			}
+			return true;
+		}
+		inline std::size_t make_path(char *buffer, const char *name, const char *file) {
+			std::size_t len = std::strlen(name);
+			std::memcpy(buffer, name, len);
+			buffer[len++] = '/';
+			std::size_t flen = std::strlen(file);
+			std::memcpy(buffer + len, file, flen + 1);
+			return len + flen;
+		}
+#endif
+	}
+
+	process_scanner::process_scanner(const std::string root)
+		: root_(root)
+		, root_fd_(-1)
+		, page_size_(::sysconf(_SC_PAGESIZE))
+		, ticks_per_second_(::sysconf(_SC_CLK_TCK))
+		, boot_time_(0)
+		, generation_(0)
+		, dirents_(32 * 1024)
+		, buffer_(4 * 1024) {
+		if (page_size_ <= 0)
+			page_size_ = 4096;
+		if (ticks_per_second_ <= 0)
+			ticks_per_second_ = 100;
+	}
+
+	process_scanner::~process_scanner() {
+		if (root_fd_ != -1)
+			::close(root_fd_);
+	}
+
+#ifdef __linux__
+	void process_scanner::open_root() {
+		root_fd_ = ::open(root_.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+		if (root_fd_ == -1)
+			throw nscp_exception("Failed to open " + root_ + ": " + std::strerror(errno));
+		long len = read_file("stat");
+		if (len > 0) {
+			const char *begin = &buffer_[0];
+			const char *end = begin + len;
+			for (const char *p = begin; p < end; ) {
+				const char *eol = static_cast<const char*>(std::memchr(p, '\n', end - p));
+				if (eol == NULL)
+					eol = end;
+				if (eol - p > 6 && std::memcmp(p, "btime ", 6) == 0) {
+					boot_time_ = static_cast<long long>(read_number(p + 6, eol));
+					break;
+				}
+				p = eol + 1;
+			}
+		}
+	}
+
+	long process_scanner::read_file(const char *path) {
+		int fd = ::openat(root_fd_, path, O_RDONLY | O_CLOEXEC);
+		if (fd == -1)
+			return -1;
+		std::size_t len = 0;
+		while (true) {
+			ssize_t r = ::read(fd, &buffer_[len], buffer_.size() - len);
+			if (r < 0) {
+				if (errno == EINTR)
+					continue;
+				::close(fd);
+				return -1;
+			}
+			if (r == 0)
+				break;
+			len += r;
+			if (len == buffer_.size())
+				buffer_.resize(buffer_.size() * 2);
+		}
+		::close(fd);
+		return static_cast<long>(len);
+	}
+
+	const process_scanner::static_info& process_scanner::get_static_info(long long pid, const char *name, unsigned long long start_ticks, const std::string &comm) {
+		cache_type::iterator it = cache_.find(pid);
+		if (it != cache_.end() && it->second.start_ticks == start_ticks) {
+			it->second.generation = generation_;
+			return it->second;
+		}
+		static_info &info = cache_[pid];
+		info.start_ticks = start_ticks;
+		info.generation = generation_;
+		info.filename.clear();
+		info.command_line.clear();
+
+		char path[64];
+		make_path(path, name, "exe");
+		char link[4096];
+		ssize_t len = ::readlinkat(root_fd_, path, link, sizeof(link));
+		if (len > 0)
+			info.filename.assign(link, len);
+
+		make_path(path, name, "cmdline");
+		long clen = read_file(path);
+		if (clen > 0) {
+			while (clen > 0 && buffer_[clen - 1] == '\0')
+				clen--;
+			std::string::size_type first = std::string::npos;
+			for (long i = 0; i < clen; i++) {
+				if (buffer_[i] == '\0') {
+					if (first == std::string::npos)
+						first = i;
+					buffer_[i] = ' ';
+				}
+			}
+			info.command_line.assign(&buffer_[0], clen);
+			if (info.filename.empty())
+				info.filename = info.command_line.substr(0, first);
+		}
+		// Kernel threads have neither an executable nor a command line, use the name the kernel reports.
+		info.exe = info.filename.empty() ? comm : base_name(info.filename);
+		return info;
+	}
+
+	bool process_scanner::read_process(long long pid, const char *name, bool deep, process_info &info) {
+		char path[64];
+		make_path(path, name, "stat");
+		long len = read_file(path);
+		if (len <= 0)
+			return false;
+		// pid (comm) state ppid ... the name can contain spaces and parentheses so look for the last ')'
+		const char *begin = &buffer_[0];
+		const char *end = begin + len;
+		const char *open = static_cast<const char*>(std::memchr(begin, '(', len));
+		const char *close = static_cast<const char*>(::memrchr(begin, ')', len));
+		if (open == NULL || close == NULL || close < open || close + 2 >= end)
+			return false;
+		std::string comm(open + 1, close);
+
+		// Fields are numbered as in proc(5), the state is field 3
+		const char *p = close + 2;
+		unsigned long long start_ticks = 0, rss = 0;
+		info.state = *p;
+		for (int field = 3; field <= 24 && p < end; field++, p = next_field(p, end)) {
+			switch (field) {
+			case 4:
+				info.ppid = read_signed(p, end);
+				break;
+			case 14:
+				info.user_time = read_number(p, end) / ticks_per_second_;
+				break;
+			case 15:
+				info.kernel_time = read_number(p, end) / ticks_per_second_;
+				break;
+			case 20:
+				info.threads = read_number(p, end);
+				break;
+			case 22:
+				start_ticks = read_number(p, end);
+				break;
+			case 23:
+				info.virtual_size = read_number(p, end);
+				break;
+			case 24:
+				rss = read_number(p, end);
+				break;
+			}
+		}
+		info.pid = pid;
+		info.start_time = boot_time_ + static_cast<long long>(start_ticks / ticks_per_second_);
+		info.working_set = rss * page_size_;
+
+		if (deep) {
+			make_path(path, name, "statm");
+			len = read_file(path);
+			if (len > 0) {
+				// size resident shared text lib data dt (in pages)
+				const char *q = &buffer_[0];
+				const char *qend = q + len;
+				q = next_field(q, qend);
+				info.working_set = read_number(q, qend) * page_size_;
+				q = next_field(q, qend);
+				info.shared = read_number(q, qend) * page_size_;
+			}
+		}
+
+		const static_info &si = get_static_info(pid, name, start_ticks, comm);
+		info.exe = si.exe;
+		info.filename = si.filename;
+		info.command_line = si.command_line;
+		return true;
+	}
+
+	process_list process_scanner::scan(bool deep) {
+		if (root_fd_ == -1)
+			open_root();
+		else if (::lseek(root_fd_, 0, SEEK_SET) == -1)
+			throw nscp_exception("Failed to rewind " + root_ + ": " + std::strerror(errno));
+
+		generation_++;
+		process_list ret;
+		while (true) {
+			long len = ::syscall(SYS_getdents64, root_fd_, &dirents_[0], dirents_.size());
+			if (len < 0)
+				throw nscp_exception("Failed to list " + root_ + ": " + std::strerror(errno));
+			if (len == 0)
+				break;
+			for (long pos = 0; pos < len; ) {
+				const linux_dirent64 *d = reinterpret_cast<const linux_dirent64*>(&dirents_[pos]);
+				pos += d->d_reclen;
+				if (!is_pid(d->d_name))
+					continue;
+				process_info info;
+				if (read_process(static_cast<long long>(read_number(d->d_name, d->d_name + std::strlen(d->d_name))), d->d_name, deep, info))
+					ret.push_back(info);
+			}
+		}
+
+		for (cache_type::iterator it = cache_.begin(); it != cache_.end(); ) {
+			if (it->second.generation != generation_)
+				it = cache_.erase(it);
+			else
+				++it;
+		}
+		return ret;
+	}
+#else
+	// Without a Linux style /proc (BSD, macOS, ...) ask ps, it reports what every platform's ps agrees on.
+	process_list process_scanner::scan(bool) {
+		FILE *ps = ::popen("ps -A -o pid= -o ppid= -o stat= -o vsz= -o rss= -o args=", "r");
+		if (ps == NULL)
+			throw nscp_exception(std::string("Failed to run ps: ") + std::strerror(errno));
+		process_list ret;
+		std::string line;
+		while (true) {
+			line.clear();
+			int c;
+			while ((c = std::fgetc(ps)) != EOF && c != '\n')
+				line.push_back(static_cast<char>(c));
+			if (line.empty() && c == EOF)
+				break;
+			// pid ppid state vsz rss command line (vsz and rss in KiB)
+			const char *p = line.c_str();
+			const char *end = p + line.size();
+			while (p < end && *p == ' ')
+				++p;
+			process_info info;
+			info.pid = read_signed(p, end);
+			p = next_field(p, end);
+			info.ppid = read_signed(p, end);
+			p = next_field(p, end);
+			if (p >= end || info.pid <= 0)
+				continue;
+			info.state = *p;
+			p = next_field(p, end);
+			info.virtual_size = static_cast<long long>(read_number(p, end)) * 1024;
+			p = next_field(p, end);
+			info.working_set = static_cast<long long>(read_number(p, end)) * 1024;
+			p = next_field(p, end);
+			info.command_line.assign(p, end);
+			// Kernel threads are listed as [name] without an executable
+			if (info.command_line.size() > 2 && info.command_line[0] == '[' && info.command_line[info.command_line.size() - 1] == ']') {
+				info.exe = info.command_line.substr(1, info.command_line.size() - 2);
+			} else {
+				info.filename = info.command_line.substr(0, info.command_line.find(' '));
+				info.exe = base_name(info.filename);
+			}
+			ret.push_back(info);
+		}
+		if (::pclose(ps) == -1 && ret.empty())
+			throw nscp_exception(std::string("Failed to run ps: ") + std::strerror(errno));
+		return ret;
+	}
+#endif
+}
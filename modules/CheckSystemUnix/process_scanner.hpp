@@ -0,0 +1,148 @@
+/*
+ * Copyright 2004-2016 The NSClient++ Authors - https://nsclient.org
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <list>
+#include <string>
+#include <vector>
+
+#include <boost/noncopyable.hpp>
+#include <boost/unordered_map.hpp>
+
+namespace process_helper {
+
+	struct process_info {
+		long long pid;
+		long long ppid;
+		std::string exe;
+		std::string filename;
+		std::string command_line;
+		char state;
+		bool started;
+		long long threads;
+		long long start_time;
+		long long user_time;
+		long long kernel_time;
+		long long virtual_size;
+		long long working_set;
+		long long shared;
+
+		process_info() : pid(0), ppid(0), state(0), started(true), threads(0), start_time(0), user_time(0), kernel_time(0), virtual_size(0), working_set(0), shared(0) {}
+		process_info(const std::string exe) : pid(0), ppid(0), exe(exe), state(0), started(false), threads(0), start_time(0), user_time(0), kernel_time(0), virtual_size(0), working_set(0), shared(0) {}
+
+		long long get_pid() const { return pid; }
+		long long get_ppid() const { return ppid; }
+		std::string get_exe() const { return exe; }
+		std::string get_filename() const { return filename; }
+		std::string get_command_line() const { return command_line; }
+		long long get_threads() const { return threads; }
+		long long get_creation_time() const { return start_time; }
+		long long get_user_time() const { return user_time; }
+		long long get_kernel_time() const { return kernel_time; }
+		long long get_total_time() const { return user_time + kernel_time; }
+		long long get_virtual_size() const { return virtual_size; }
+		long long get_working_set() const { return working_set; }
+		long long get_shared() const { return shared; }
+
+		std::string get_state_s() const {
+			if (!started)
+				return "stopped";
+			switch (state) {
+			case 'T':
+			case 't':
+				return "stopped";
+			case 'Z':
+			case 'X':
+			case 'x':
+				return "zombie";
+			}
+			// Uninterruptible sleep (D) is usually a short disk wait so it counts as started
+			return "started";
+		}
+		std::string get_legacy_state_s() const {
+			return started ? "Running" : "not running";
+		}
+		bool get_started() const {
+			return started && get_state_s() == "started";
+		}
+		bool get_stopped() const {
+			return !started;
+		}
+
+		process_info& operator += (const process_info &other) {
+			threads += other.threads;
+			user_time += other.user_time;
+			kernel_time += other.kernel_time;
+			virtual_size += other.virtual_size;
+			working_set += other.working_set;
+			shared += other.shared;
+			return *this;
+		}
+	};
+	typedef std::list<process_info> process_list;
+
+	/**
+	 * Enumerates processes by walking /proc.
+	 * The /proc directory is kept open and listed with getdents64, each process is read with openat
+	 * and stat/statm are parsed by hand. Data which does not change for the lifetime of a process
+	 * (executable and command line) is cached between scans keyed by pid and start time.
+	 * On platforms without a Linux style /proc the process list is read from ps instead, which
+	 * only reports pid, parent, state, memory and command line.
+	 * The scanner is not thread safe, callers are expected to hold a lock.
+	 */
+	class process_scanner : public boost::noncopyable {
+		struct static_info {
+			unsigned long long start_ticks;
+			unsigned long long generation;
+			std::string exe;
+			std::string filename;
+			std::string command_line;
+		};
+		typedef boost::unordered_map<long long, static_info> cache_type;
+
+		std::string root_;
+		int root_fd_;
+		long page_size_;
+		long ticks_per_second_;
+		long long boot_time_;
+		unsigned long long generation_;
+		cache_type cache_;
+		std::vector<char> dirents_;
+		std::vector<char> buffer_;
+
+	public:
+		process_scanner(const std::string root = "/proc");
+		~process_scanner();
+
+		/**
+		 * List all processes, if deep is false memory counters (statm) are not read.
+		 * Processes which vanish during the scan are silently skipped.
+		 * Throws nscp_exception if the /proc directory cannot be read.
+		 */
+		process_list scan(bool deep = true);
+
+		std::size_t cache_size() const {
+			return cache_.size();
+		}
+
+	private:
+		void open_root();
+		bool read_process(long long pid, const char *name, bool deep, process_info &info);
+		long read_file(const char *path);
+		const static_info& get_static_info(long long pid, const char *name, unsigned long long start_ticks, const std::string &comm);
+	};
+}
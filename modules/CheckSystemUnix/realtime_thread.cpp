@@ -22,12 +22,12 @@
 #include <parsers/filter/realtime_helper.hpp>
 #include "realtime_data.hpp"
 
+#include <boost/chrono.hpp>
+
 
 /**
-* Thread that collects the data every "CHECK_INTERVAL" seconds.
-*
-* @param lpParameter Not used
-* @return thread exit status
+* Thread that samples /proc/stat once a second and feeds the cpu history.
+* Runs until interrupted by stop().
 *
 * @author mickem
 *
@@ -38,20 +38,83 @@
 *
 */
 void pdh_thread::thread_proc() {
-
+	system_info::cpu_reader reader;
+	// Paced by a monotonic clock so changing the wall clock does not stall (or speed up) sampling
+	boost::chrono::steady_clock::time_point next = boost::chrono::steady_clock::now();
+	bool reported = false;
+	try {
+		while (true) {
+			system_info::cpu_load load;
+			bool has_load = false, failed = false;
+			try {
+				has_load = reader.read(load);
+				reported = false;
+			} catch (const nscp_exception &e) {
+				failed = true;
+				if (!reported)
+					NSC_LOG_ERROR("Failed to get cpu load: " + e.reason());
+				reported = true;
+			}
+			{
+				boost::unique_lock<boost::shared_mutex> writeLock(mutex_, boost::get_system_time() + boost::posix_time::seconds(5));
+				if (!writeLock.owns_lock()) {
+					NSC_LOG_ERROR("Failed to get mutex for writing");
+				} else if (has_load) {
+					cpu.push(load);
+					samples_++;
+				} else if (failed) {
+					errors_++;
+				}
+			}
+			// Sleep until the next whole second after the previous sample so slow reads do not make the history drift.
+			next += boost::chrono::seconds(1);
+			boost::chrono::steady_clock::time_point now = boost::chrono::steady_clock::now();
+			if (next < now)
+				next = now;
+			boost::this_thread::sleep_until(next);
+		}
+	} catch (const boost::thread_interrupted &) {
+	}
 }
 
+std::map<std::string, system_info::load_entry> pdh_thread::get_cpu_load(long seconds) {
+	std::map<std::string, system_info::load_entry> ret;
+	system_info::cpu_load load;
+	{
+		boost::shared_lock<boost::shared_mutex> readLock(mutex_, boost::get_system_time() + boost::posix_time::seconds(5));
+		if (!readLock.owns_lock()) {
+			NSC_LOG_ERROR("Failed to get Mutex for: cpu");
+			return ret;
+		}
+		load = cpu.get_average(seconds);
+	}
+	ret["total"] = load.total;
+	int i = 0;
+	BOOST_FOREACH(const system_info::load_entry &l, load.core)
+		ret["core " + strEx::s::xtos(i++)] = l;
+	return ret;
+}
 
+void pdh_thread::get_metrics(unsigned long long &samples, unsigned long long &errors) {
+	boost::shared_lock<boost::shared_mutex> readLock(mutex_, boost::get_system_time() + boost::posix_time::seconds(1));
+	if (!readLock.owns_lock()) {
+		NSC_LOG_ERROR("Failed to get Mutex for: metrics");
+		return;
+	}
+	samples = samples_;
+	errors = errors_;
+}
 
 bool pdh_thread::start() {
-//	stop_event_ = CreateEvent(NULL, TRUE, FALSE, _T("EventLogShutdown"));
 	thread_ = boost::shared_ptr<boost::thread>(new boost::thread(boost::bind(&pdh_thread::thread_proc, this)));
 	return true;
 }
 bool pdh_thread::stop() {
-//	SetEvent(stop_event_);
-	if (thread_)
+	if (thread_) {
+		thread_->interrupt();
 		thread_->join();
+		thread_.reset();
+	}
 	return true;
 }
 void pdh_thread::add_realtime_filter(boost::shared_ptr<nscapi::settings_proxy> proxy, std::string key, std::string query) {
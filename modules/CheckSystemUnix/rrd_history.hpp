@@ -0,0 +1,104 @@
+/*
+ * Copyright 2004-2016 The NSClient++ Authors - https://nsclient.org
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <boost/circular_buffer.hpp>
+
+#include <error.hpp>
+#include <strEx.h>
+
+/**
+ * Round robin history of samples: 60 seconds, 60 minutes and 24 hours.
+ * Each level keeps running sums of everything pushed so far, so the average over
+ * any window is a single subtraction regardless of the window size.
+ * T needs to implement add, subtract and normalize.
+ */
+template<class T>
+struct rrd_buffer {
+	typedef T value_type;
+
+	struct level {
+		// sums[i] is the sum of all values pushed up to and including value i
+		boost::circular_buffer<T> sums;
+		T total;
+		std::size_t count;
+
+		level(std::size_t size) : sums(size + 1), count(0) {}
+
+		std::size_t size() const {
+			return sums.capacity() - 1;
+		}
+		void push(const value_type &value) {
+			total.add(value);
+			sums.push_back(total);
+			count++;
+		}
+		// Sum of the last n values (fewer if fewer have been pushed), n is updated to the number of values summed.
+		value_type get_sum(std::size_t &n) const {
+			if (n > count)
+				n = count;
+			value_type ret = total;
+			if (n < count)
+				ret.subtract(sums[sums.size() - 1 - n]);
+			return ret;
+		}
+	};
+
+	level seconds;
+	level minutes;
+	level hours;
+
+public:
+	rrd_buffer() : seconds(60), minutes(60), hours(24) {}
+
+	value_type get_average(long time) const {
+		if (time <= 0)
+			throw nscp_exception("Invalid time: " + strEx::s::xtos(time));
+		if (seconds.count == 0)
+			throw nscp_exception("No samples collected yet");
+		if (time <= 60)
+			return get_average(seconds, time);
+		time /= 60;
+		// Until a coarser level has its first value the finer level holds everything we have, so average that instead.
+		if (time <= 60)
+			return minutes.count == 0 ? get_average(seconds, 60) : get_average(minutes, time);
+		time /= 60;
+		if (time > 24)
+			throw nscp_exception("Size larger than buffer");
+		if (hours.count > 0)
+			return get_average(hours, time);
+		return minutes.count == 0 ? get_average(seconds, 60) : get_average(minutes, 60);
+	}
+
+	void push(const value_type &value) {
+		seconds.push(value);
+		if (seconds.count % 60 == 0) {
+			minutes.push(get_average(seconds, 60));
+			if (minutes.count % 60 == 0)
+				hours.push(get_average(minutes, 60));
+		}
+	}
+
+private:
+	value_type get_average(const level &l, std::size_t time) const {
+		std::size_t n = time;
+		value_type ret = l.get_sum(n);
+		if (n > 0)
+			ret.normalize(static_cast<double>(n));
+		return ret;
+	}
+};
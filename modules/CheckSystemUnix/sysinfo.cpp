@@ -0,0 +1,229 @@
+/*
+ * Copyright 2004-2016 The NSClient++ Authors - https://nsclient.org
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "sysinfo.hpp"
+
+#include <cerrno>
+#include <cstring>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <error.hpp>
+
+namespace system_info {
+
+	namespace {
+		inline const char* skip_space(const char *p, const char *end) {
+			while (p < end && (*p == ' ' || *p == '\t'))
+				++p;
+			return p;
+		}
+		inline const char* read_number(const char *p, const char *end, unsigned long long &value) {
+			value = 0;
+			p = skip_space(p, end);
+			while (p < end && *p >= '0' && *p <= '9')
+				value = value * 10 + (*p++ - '0');
+			return p;
+		}
+		std::string last_error() {
+			return std::strerror(errno);
+		}
+	}
+
+	cpu_reader::cpu_reader(const std::string file) : file_(file), fd_(-1), buffer_(16 * 1024) {}
+
+	cpu_reader::~cpu_reader() {
+		if (fd_ != -1)
+			::close(fd_);
+	}
+
+	void cpu_reader::read_ticks() {
+		if (fd_ == -1) {
+			fd_ = ::open(file_.c_str(), O_RDONLY | O_CLOEXEC);
+			if (fd_ == -1)
+				throw nscp_exception("Failed to open " + file_ + ": " + last_error());
+		}
+		current_.clear();
+		while (true) {
+			ssize_t len = ::pread(fd_, &buffer_[0], buffer_.size(), 0);
+			if (len < 0) {
+				::close(fd_);
+				fd_ = -1;
+				throw nscp_exception("Failed to read " + file_ + ": " + last_error());
+			}
+			const char *p = &buffer_[0];
+			const char *end = p + len;
+			bool complete = false;
+			// The cpu lines always come first: "cpu  user nice system idle iowait irq softirq steal ..." followed by one "cpuN ..." per core.
+			while (p < end) {
+				const char *eol = static_cast<const char*>(std::memchr(p, '\n', end - p));
+				if (eol == NULL)
+					break;
+				if (end - p < 3 || std::memcmp(p, "cpu", 3) != 0) {
+					complete = true;
+					break;
+				}
+				p += 3;
+				while (p < eol && *p != ' ')
+					++p;
+				unsigned long long v[8] = { 0 };
+				for (int i = 0; i < 8 && p < eol; i++)
+					p = read_number(p, eol, v[i]);
+				ticks t;
+				t.idle = v[3] + v[4];
+				t.kernel = v[2] + v[5] + v[6];
+				t.total = v[0] + v[1] + v[2] + v[3] + v[4] + v[5] + v[6] + v[7];
+				current_.push_back(t);
+				p = eol + 1;
+			}
+			if (complete || static_cast<std::size_t>(len) < buffer_.size())
+				break;
+			// The buffer was too small to hold all cpu lines (very many cores): grow it and read again.
+			buffer_.resize(buffer_.size() * 2);
+			current_.clear();
+		}
+		if (current_.empty())
+			throw nscp_exception("No cpu counters found in " + file_);
+	}
+
+	bool cpu_reader::read(cpu_load &load) {
+		read_ticks();
+		bool has_previous = previous_.size() == current_.size();
+		if (has_previous) {
+			load.cores = current_.size() - 1;
+			load.core.resize(load.cores);
+			for (std::size_t i = 0; i < current_.size(); i++) {
+				load_entry &e = i == 0 ? load.total : load.core[i - 1];
+				const ticks &c = current_[i];
+				const ticks &p = previous_[i];
+				e.core = static_cast<int>(i) - 1;
+				if (c.total <= p.total) {
+					e.idle = 100.0;
+					e.total = e.kernel = 0.0;
+					continue;
+				}
+				double delta = static_cast<double>(c.total - p.total);
+				double idle = static_cast<double>(c.idle >= p.idle ? c.idle - p.idle : 0);
+				double kernel = static_cast<double>(c.kernel >= p.kernel ? c.kernel - p.kernel : 0);
+				e.idle = 100.0 * idle / delta;
+				e.total = 100.0 - e.idle;
+				e.kernel = 100.0 * kernel / delta;
+			}
+		}
+		previous_.swap(current_);
+		return has_previous;
+	}
+
+	namespace {
+		struct meminfo_key {
+			const char *key;
+			std::size_t length;
+			unsigned long long memory_usage::*field;
+		};
+#define MEMINFO_KEY(key, field) { key, sizeof(key) - 1, &memory_usage::field }
+		const meminfo_key meminfo_keys[] = {
+			MEMINFO_KEY("MemTotal", mem_total),
+			MEMINFO_KEY("MemFree", mem_free),
+			MEMINFO_KEY("MemAvailable", mem_available),
+			MEMINFO_KEY("Buffers", buffers),
+			MEMINFO_KEY("Cached", cached),
+			MEMINFO_KEY("SwapTotal", swap_total),
+			MEMINFO_KEY("SwapFree", swap_free),
+			MEMINFO_KEY("Slab", slab),
+			MEMINFO_KEY("CommitLimit", commit_limit),
+			MEMINFO_KEY("Committed_AS", committed_as),
+			MEMINFO_KEY("HugePages_Total", hugepages_total),
+			MEMINFO_KEY("HugePages_Free", hugepages_free),
+			MEMINFO_KEY("Hugepagesize", hugepage_size)
+		};
+#undef MEMINFO_KEY
+		const std::size_t meminfo_key_count = sizeof(meminfo_keys) / sizeof(meminfo_keys[0]);
+	}
+
+	memory_reader::memory_reader(const std::string file) : file_(file), fd_(-1), buffer_(8 * 1024), ttl_(1000) {}
+
+	memory_reader::~memory_reader() {
+		if (fd_ != -1)
+			::close(fd_);
+	}
+
+	void memory_reader::set_ttl(long ttl_ms) {
+		boost::mutex::scoped_lock lock(mutex_);
+		ttl_ = ttl_ms;
+	}
+
+	memory_usage memory_reader::get() {
+		boost::mutex::scoped_lock lock(mutex_);
+		boost::posix_time::ptime now = boost::posix_time::microsec_clock::universal_time();
+		if (sampled_.is_not_a_date_time() || ttl_ <= 0 || now - sampled_ >= boost::posix_time::milliseconds(ttl_) || now < sampled_) {
+			memory_usage usage;
+			read(usage);
+			sample_ = usage;
+			sampled_ = now;
+		}
+		return sample_;
+	}
+
+	void memory_reader::read(memory_usage &usage) {
+		if (fd_ == -1) {
+			fd_ = ::open(file_.c_str(), O_RDONLY | O_CLOEXEC);
+			if (fd_ == -1)
+				throw nscp_exception("Failed to open " + file_ + ": " + last_error());
+		}
+		ssize_t len = 0;
+		while (true) {
+			len = ::pread(fd_, &buffer_[0], buffer_.size(), 0);
+			if (len < 0) {
+				::close(fd_);
+				fd_ = -1;
+				throw nscp_exception("Failed to read " + file_ + ": " + last_error());
+			}
+			if (static_cast<std::size_t>(len) < buffer_.size())
+				break;
+			buffer_.resize(buffer_.size() * 2);
+		}
+		// Lines look like "MemTotal:        6147400 kB" or "HugePages_Total:       0"
+		const char *p = &buffer_[0];
+		const char *end = p + len;
+		while (p < end) {
+			const char *eol = static_cast<const char*>(std::memchr(p, '\n', end - p));
+			if (eol == NULL)
+				eol = end;
+			const char *colon = static_cast<const char*>(std::memchr(p, ':', eol - p));
+			if (colon != NULL) {
+				std::size_t length = colon - p;
+				for (std::size_t i = 0; i < meminfo_key_count; i++) {
+					const meminfo_key &k = meminfo_keys[i];
+					if (k.length == length && std::memcmp(k.key, p, length) == 0) {
+						unsigned long long value = 0;
+						const char *v = read_number(colon + 1, eol, value);
+						v = skip_space(v, eol);
+						if (eol - v >= 2 && v[0] == 'k' && v[1] == 'B')
+							value *= 1024;
+						usage.*k.field = value;
+						if (k.field == &memory_usage::mem_available)
+							usage.has_available = true;
+						break;
+					}
+				}
+			}
+			p = eol + 1;
+		}
+		if (usage.mem_total == 0)
+			throw nscp_exception("No memory counters found in " + file_);
+	}
+}
@@ -0,0 +1,176 @@
+/*
+ * Copyright 2004-2016 The NSClient++ Authors - https://nsclient.org
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include <boost/foreach.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/date_time/posix_time/posix_time.hpp>
+
+namespace system_info {
+
+	struct load_entry {
+		double idle;
+		double total;
+		double kernel;
+		int core;
+		load_entry() : idle(0.0), total(0.0), kernel(0.0), core(-1) {}
+		void add(const load_entry &other) {
+			idle += other.idle;
+			total += other.total;
+			kernel += other.kernel;
+		}
+		void subtract(const load_entry &other) {
+			idle -= other.idle;
+			total -= other.total;
+			kernel -= other.kernel;
+		}
+		void normalize(double value) {
+			idle /= value;
+			total /= value;
+			kernel /= value;
+		}
+	};
+
+	struct cpu_load {
+		std::size_t cores;
+		std::vector<load_entry> core;
+		load_entry total;
+		cpu_load() : cores(0) {}
+		void add(const cpu_load &n) {
+			total.add(n.total);
+			if (n.cores > cores) {
+				cores = n.cores;
+				core.resize(cores);
+			}
+			for (std::size_t i = 0; i < n.cores; ++i) {
+				core[i].add(n.core[i]);
+				core[i].core = static_cast<int>(i);
+			}
+		}
+		void subtract(const cpu_load &n) {
+			total.subtract(n.total);
+			for (std::size_t i = 0; i < n.cores && i < cores; ++i)
+				core[i].subtract(n.core[i]);
+		}
+		void normalize(double value) {
+			total.normalize(value);
+			BOOST_FOREACH(load_entry &c, core) {
+				c.normalize(value);
+			}
+		}
+	};
+
+	/**
+	 * Reads the cpu lines of /proc/stat and returns the load since the previous call.
+	 * The file is kept open and re-read with a single pread per sample, the lines are parsed in place.
+	 */
+	class cpu_reader : public boost::noncopyable {
+		struct ticks {
+			unsigned long long total;
+			unsigned long long idle;
+			unsigned long long kernel;
+			ticks() : total(0), idle(0), kernel(0) {}
+		};
+		std::string file_;
+		int fd_;
+		std::vector<char> buffer_;
+		std::vector<ticks> previous_;
+		std::vector<ticks> current_;
+
+	public:
+		cpu_reader(const std::string file = "/proc/stat");
+		~cpu_reader();
+
+		/**
+		 * Sample the counters and fill in the load (in percent) since the previous sample.
+		 * The first call only primes the counters and returns false.
+		 * Throws nscp_exception if the file cannot be read.
+		 */
+		bool read(cpu_load &load);
+
+	private:
+		void read_ticks();
+	};
+
+	/**
+	 * The values from /proc/meminfo we care about, all in bytes except the huge page counts.
+	 */
+	struct memory_usage {
+		unsigned long long mem_total;
+		unsigned long long mem_free;
+		unsigned long long mem_available;
+		unsigned long long buffers;
+		unsigned long long cached;
+		unsigned long long swap_total;
+		unsigned long long swap_free;
+		unsigned long long slab;
+		unsigned long long commit_limit;
+		unsigned long long committed_as;
+		unsigned long long hugepages_total;
+		unsigned long long hugepages_free;
+		unsigned long long hugepage_size;
+		bool has_available;
+
+		memory_usage() : mem_total(0), mem_free(0), mem_available(0), buffers(0), cached(0), swap_total(0), swap_free(0), slab(0)
+			, commit_limit(0), committed_as(0), hugepages_total(0), hugepages_free(0), hugepage_size(0), has_available(false) {}
+
+		// MemAvailable is missing on kernels before 3.14, estimate it the way free(1) used to.
+		unsigned long long get_available() const {
+			return has_available ? mem_available : mem_free + buffers + cached;
+		}
+		// Free memory when buffers and page cache are counted as free (the "cached" memory type).
+		unsigned long long get_free_with_cache() const {
+			unsigned long long free = mem_free + buffers + cached;
+			return free < mem_total ? free : mem_total;
+		}
+	};
+
+	/**
+	 * Shared reader for /proc/meminfo.
+	 * The file is kept open and read with a single pread into a preallocated buffer, lines are
+	 * matched against a fixed key table. A sample is reused for ttl milliseconds so concurrent
+	 * checks (and metrics) share one read. Safe to use from multiple threads.
+	 */
+	class memory_reader : public boost::noncopyable {
+		std::string file_;
+		int fd_;
+		std::vector<char> buffer_;
+		boost::mutex mutex_;
+		memory_usage sample_;
+		boost::posix_time::ptime sampled_;
+		long ttl_;
+
+	public:
+		memory_reader(const std::string file = "/proc/meminfo");
+		~memory_reader();
+
+		void set_ttl(long ttl_ms);
+
+		/**
+		 * Returns the current memory usage (possibly cached).
+		 * Throws nscp_exception if the file cannot be read.
+		 */
+		memory_usage get();
+
+	private:
+		void read(memory_usage &usage);
+	};
+}
@@ -0,0 +1,298 @@
+/*
+ * Copyright 2004-2016 The NSClient++ Authors - https://nsclient.org
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "sysinfo.hpp"
+#include "rrd_history.hpp"
+
+#include <fstream>
+
+#include <boost/filesystem.hpp>
+
+#include <gtest/gtest.h>
+
+namespace {
+	// A temporary file standing in for /proc/stat or /proc/meminfo, rewritten in place so readers keeping it open see new content.
+	struct fixture_file {
+		std::string path;
+		fixture_file() : path((boost::filesystem::temp_directory_path() / boost::filesystem::unique_path("nscp-%%%%-%%%%-%%%%")).string()) {}
+		~fixture_file() {
+			boost::system::error_code ec;
+			boost::filesystem::remove(path, ec);
+		}
+		void write(const std::string &data) {
+			std::ofstream out(path.c_str(), std::ios::out | std::ios::trunc | std::ios::binary);
+			out << data;
+		}
+	};
+
+	system_info::cpu_load make_load(double total) {
+		system_info::cpu_load load;
+		load.total.total = total;
+		load.total.idle = 100.0 - total;
+		return load;
+	}
+}
+
+TEST(rrd_buffer, empty_history_throws) {
+	rrd_buffer<system_info::cpu_load> buffer;
+	EXPECT_THROW(buffer.get_average(60), nscp_exception);
+	buffer.push(make_load(10.0));
+	EXPECT_THROW(buffer.get_average(0), nscp_exception);
+	EXPECT_THROW(buffer.get_average(25 * 60 * 60), nscp_exception);
+}
+
+TEST(rrd_buffer, averages_available_seconds) {
+	rrd_buffer<system_info::cpu_load> buffer;
+	buffer.push(make_load(10.0));
+	buffer.push(make_load(20.0));
+	buffer.push(make_load(60.0));
+	EXPECT_DOUBLE_EQ(60.0, buffer.get_average(1).total.total);
+	EXPECT_DOUBLE_EQ(40.0, buffer.get_average(2).total.total);
+	EXPECT_DOUBLE_EQ(30.0, buffer.get_average(60).total.total);
+}
+
+TEST(rrd_buffer, long_windows_before_first_minute) {
+	rrd_buffer<system_info::cpu_load> buffer;
+	for (int i = 0; i < 30; i++)
+		buffer.push(make_load(i < 15 ? 20.0 : 40.0));
+	EXPECT_DOUBLE_EQ(30.0, buffer.get_average(5 * 60).total.total);
+	EXPECT_DOUBLE_EQ(30.0, buffer.get_average(60 * 60).total.total);
+	EXPECT_DOUBLE_EQ(30.0, buffer.get_average(2 * 60 * 60).total.total);
+}
+
+TEST(rrd_buffer, seconds_wrap_around) {
+	rrd_buffer<system_info::cpu_load> buffer;
+	// 150 seconds: the last 60 are 90..149
+	for (int i = 0; i < 150; i++)
+		buffer.push(make_load(static_cast<double>(i)));
+	EXPECT_DOUBLE_EQ(149.0, buffer.get_average(1).total.total);
+	EXPECT_DOUBLE_EQ(147.0, buffer.get_average(5).total.total);
+	EXPECT_DOUBLE_EQ(119.5, buffer.get_average(60).total.total);
+}
+
+TEST(rrd_buffer, minute_averages) {
+	rrd_buffer<system_info::cpu_load> buffer;
+	// Minute m has a load of m*10%, the 30 seconds of the unfinished third minute are not part of the minute level yet.
+	for (int m = 0; m < 3; m++) {
+		for (int s = 0; s < (m == 2 ? 30 : 60); s++)
+			buffer.push(make_load(m * 10.0));
+	}
+	EXPECT_DOUBLE_EQ(20.0, buffer.get_average(30).total.total);
+	EXPECT_DOUBLE_EQ(10.0, buffer.get_average(60 + 30).total.total);
+	EXPECT_DOUBLE_EQ(5.0, buffer.get_average(2 * 60).total.total);
+	EXPECT_DOUBLE_EQ(5.0, buffer.get_average(5 * 60).total.total);
+	EXPECT_DOUBLE_EQ(5.0, buffer.get_average(2 * 60 * 60).total.total);
+}
+
+TEST(rrd_buffer, minutes_wrap_around) {
+	rrd_buffer<system_info::cpu_load> buffer;
+	// 90 minutes where minute m has a load of m%: the last 5 are 85..89, the last 60 are 30..89
+	for (int m = 0; m < 90; m++) {
+		for (int s = 0; s < 60; s++)
+			buffer.push(make_load(static_cast<double>(m)));
+	}
+	EXPECT_DOUBLE_EQ(89.0, buffer.get_average(60).total.total);
+	EXPECT_DOUBLE_EQ(87.0, buffer.get_average(5 * 60).total.total);
+	EXPECT_DOUBLE_EQ(59.5, buffer.get_average(60 * 60).total.total);
+	EXPECT_DOUBLE_EQ(29.5, buffer.get_average(60 * 60 + 60).total.total);
+}
+
+TEST(rrd_buffer, keeps_cores) {
+	rrd_buffer<system_info::cpu_load> buffer;
+	system_info::cpu_load load = make_load(50.0);
+	load.cores = 2;
+	load.core.resize(2);
+	load.core[0].total = 20.0;
+	load.core[1].total = 80.0;
+	buffer.push(load);
+	load.core[0].total = 40.0;
+	buffer.push(load);
+	system_info::cpu_load avg = buffer.get_average(60);
+	ASSERT_EQ(2u, avg.core.size());
+	EXPECT_DOUBLE_EQ(30.0, avg.core[0].total);
+	EXPECT_DOUBLE_EQ(80.0, avg.core[1].total);
+	EXPECT_EQ(1, avg.core[1].core);
+}
+
+TEST(cpu_reader, parses_proc_stat) {
+	fixture_file stat;
+	stat.write(
+		"cpu  100 0 50 800 50 0 0 0 0 0\n"
+		"cpu0 50 0 25 400 25 0 0 0 0 0\n"
+		"cpu1 50 0 25 400 25 0 0 0 0 0\n"
+		"intr 12345 1 2 3\n"
+		"ctxt 67890\n");
+	system_info::cpu_reader reader(stat.path);
+	system_info::cpu_load load;
+	EXPECT_FALSE(reader.read(load));
+
+	stat.write(
+		"cpu  130 0 60 850 60 0 0 0 0 0\n"
+		"cpu0 70 0 30 420 30 0 0 0 0 0\n"
+		"cpu1 60 0 30 430 30 0 0 0 0 0\n"
+		"intr 12350 1 2 3\n"
+		"ctxt 67990\n");
+	ASSERT_TRUE(reader.read(load));
+	EXPECT_DOUBLE_EQ(60.0, load.total.idle);
+	EXPECT_DOUBLE_EQ(40.0, load.total.total);
+	EXPECT_DOUBLE_EQ(10.0, load.total.kernel);
+	ASSERT_EQ(2u, load.cores);
+	ASSERT_EQ(2u, load.core.size());
+	EXPECT_EQ(0, load.core[0].core);
+	EXPECT_DOUBLE_EQ(50.0, load.core[0].idle);
+	EXPECT_DOUBLE_EQ(50.0, load.core[0].total);
+	EXPECT_DOUBLE_EQ(10.0, load.core[0].kernel);
+	EXPECT_EQ(1, load.core[1].core);
+	EXPECT_DOUBLE_EQ(70.0, load.core[1].idle);
+	EXPECT_DOUBLE_EQ(30.0, load.core[1].total);
+
+	// Counters that did not move (or went backwards) count as idle
+	ASSERT_TRUE(reader.read(load));
+	EXPECT_DOUBLE_EQ(100.0, load.total.idle);
+	EXPECT_DOUBLE_EQ(0.0, load.total.total);
+}
+
+TEST(cpu_reader, many_cores) {
+	// More cpu lines than fit in the initial read buffer
+	std::string first = "cpu  0 0 0 0 0 0 0 0\n", second = "cpu  0 0 0 0 0 0 0 0\n";
+	for (int i = 0; i < 1024; i++) {
+		std::string n = strEx::s::xtos(i);
+		first += "cpu" + n + " 0 0 0 0 0 0 0 0 0 0 0 0 0 0 0 0 0 0 0 0\n";
+		second += "cpu" + n + " 25 0 0 75 0 0 0 0 0 0 0 0 0 0 0 0 0 0 0 0\n";
+	}
+	fixture_file stat;
+	stat.write(first + "intr 1\n");
+	system_info::cpu_reader reader(stat.path);
+	system_info::cpu_load load;
+	EXPECT_FALSE(reader.read(load));
+	stat.write(second + "intr 2\n");
+	ASSERT_TRUE(reader.read(load));
+	ASSERT_EQ(1024u, load.cores);
+	EXPECT_DOUBLE_EQ(25.0, load.core[1023].total);
+	EXPECT_EQ(1023, load.core[1023].core);
+}
+
+TEST(cpu_reader, missing_file) {
+	system_info::cpu_reader reader("/nonexistent/proc/stat");
+	system_info::cpu_load load;
+	EXPECT_THROW(reader.read(load), nscp_exception);
+}
+
+namespace {
+	const char *meminfo_fixture =
+		"MemTotal:        8000000 kB\n"
+		"MemFree:         1000000 kB\n"
+		"MemAvailable:    5000000 kB\n"
+		"Buffers:          500000 kB\n"
+		"Cached:          2500000 kB\n"
+		"SwapCached:        10000 kB\n"
+		"Active:          3000000 kB\n"
+		"SwapTotal:       2000000 kB\n"
+		"SwapFree:        1500000 kB\n"
+		"Slab:             400000 kB\n"
+		"SReclaimable:     300000 kB\n"
+		"CommitLimit:     6000000 kB\n"
+		"Committed_AS:    4500000 kB\n"
+		"HugePages_Total:      16\n"
+		"HugePages_Free:        4\n"
+		"Hugepagesize:       2048 kB\n";
+}
+
+TEST(memory_reader, parses_proc_meminfo) {
+	fixture_file meminfo;
+	meminfo.write(meminfo_fixture);
+	system_info::memory_reader reader(meminfo.path);
+	system_info::memory_usage mem = reader.get();
+	EXPECT_EQ(8000000ull * 1024, mem.mem_total);
+	EXPECT_EQ(1000000ull * 1024, mem.mem_free);
+	EXPECT_EQ(500000ull * 1024, mem.buffers);
+	// SwapCached and SReclaimable must not be mistaken for Cached and Slab
+	EXPECT_EQ(2500000ull * 1024, mem.cached);
+	EXPECT_EQ(400000ull * 1024, mem.slab);
+	EXPECT_EQ(2000000ull * 1024, mem.swap_total);
+	EXPECT_EQ(1500000ull * 1024, mem.swap_free);
+	EXPECT_EQ(6000000ull * 1024, mem.commit_limit);
+	EXPECT_EQ(4500000ull * 1024, mem.committed_as);
+	// Huge page counts have no unit
+	EXPECT_EQ(16u, mem.hugepages_total);
+	EXPECT_EQ(4u, mem.hugepages_free);
+	EXPECT_EQ(2048ull * 1024, mem.hugepage_size);
+	EXPECT_TRUE(mem.has_available);
+	EXPECT_EQ(5000000ull * 1024, mem.get_available());
+}
+
+TEST(memory_reader, cached_memory) {
+	system_info::memory_usage mem;
+	mem.mem_total = 8000;
+	mem.mem_free = 1000;
+	mem.buffers = 500;
+	mem.cached = 2500;
+	// 7000 used of which 3000 is buffers and cache
+	EXPECT_EQ(4000u, mem.get_free_with_cache());
+	// Cache accounting can briefly exceed the total, never report more free than total
+	mem.cached = 8000;
+	EXPECT_EQ(8000u, mem.get_free_with_cache());
+}
+
+TEST(memory_reader, estimates_available_on_old_kernels) {
+	fixture_file meminfo;
+	meminfo.write(
+		"MemTotal:        8000000 kB\n"
+		"MemFree:         1000000 kB\n"
+		"Buffers:          500000 kB\n"
+		"Cached:          2500000 kB\n");
+	system_info::memory_reader reader(meminfo.path);
+	system_info::memory_usage mem = reader.get();
+	EXPECT_FALSE(mem.has_available);
+	EXPECT_EQ(4000000ull * 1024, mem.get_available());
+}
+
+TEST(memory_reader, sample_is_cached_for_ttl) {
+	fixture_file meminfo;
+	meminfo.write("MemTotal: 1000 kB\nMemFree: 100 kB\n");
+	system_info::memory_reader reader(meminfo.path);
+	reader.set_ttl(60 * 1000);
+	EXPECT_EQ(100u * 1024, reader.get().mem_free);
+	meminfo.write("MemTotal: 1000 kB\nMemFree: 200 kB\n");
+	EXPECT_EQ(100u * 1024, reader.get().mem_free);
+	// A ttl of 0 disables the cache
+	reader.set_ttl(0);
+	EXPECT_EQ(200u * 1024, reader.get().mem_free);
+	meminfo.write("MemTotal: 1000 kB\nMemFree: 300 kB\n");
+	EXPECT_EQ(300u * 1024, reader.get().mem_free);
+}
+
+TEST(memory_reader, large_file) {
+	// More than fits in the initial read buffer, the interesting lines last
+	std::string data;
+	for (int i = 0; i < 1000; i++)
+		data += "Padding" + strEx::s::xtos(i) + ":      12345 kB\n";
+	fixture_file meminfo;
+	meminfo.write(data + "MemTotal:        8000000 kB\nMemFree:         1000000 kB\n");
+	system_info::memory_reader reader(meminfo.path);
+	system_info::memory_usage mem = reader.get();
+	EXPECT_EQ(8000000ull * 1024, mem.mem_total);
+	EXPECT_EQ(1000000ull * 1024, mem.mem_free);
+}
+
+TEST(memory_reader, missing_counters) {
+	fixture_file meminfo;
+	meminfo.write("Nothing: 1 kB\n");
+	system_info::memory_reader reader(meminfo.path);
+	EXPECT_THROW(reader.get(), nscp_exception);
+	system_info::memory_reader missing("/nonexistent/proc/meminfo");
+	EXPECT_THROW(missing.get(), nscp_exception);
+}
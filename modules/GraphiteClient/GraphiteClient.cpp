@@ -34,7 +34,9 @@
  * Default c-tor
  * @return
  */
-GraphiteClient::GraphiteClient() : client_("graphite", boost::make_shared<graphite_client::graphite_client_handler>(), boost::make_shared<graphite_handler::options_reader_impl>()) {}
+GraphiteClient::GraphiteClient()
+	: handler_(boost::make_shared<graphite_client::graphite_client_handler>())
+	, client_("graphite", handler_, boost::make_shared<graphite_handler::options_reader_impl>()) {}
 
 /**
  * Default d-tor
@@ -166,6 +168,7 @@ void GraphiteClient::add_command(std::string key, std::string arg) {
  * @return true if successfully, false if not (if not things might be bad)
  */
 bool GraphiteClient::unloadModule() {
+	handler_->stop();
 	client_.clear();
 	return true;
 }
@@ -186,4 +189,10 @@ void GraphiteClient::handleNotification(const std::string &, const Plugin::Submi
 
 void GraphiteClient::submitMetrics(const Plugin::MetricsMessage &response) {
 	client_.do_metrics(response);
+}
+
+void GraphiteClient::fetchMetrics(Plugin::MetricsMessage::Response *response) {
+	Plugin::Common::MetricsBundle *bundle = response->add_bundles();
+	bundle->set_key("graphite");
+	handler_->fetch_metrics(bundle);
 }
\ No newline at end of file
@@ -23,6 +23,10 @@
 
 #include <client/command_line_parser.hpp>
 
+namespace graphite_client {
+	struct graphite_client_handler;
+}
+
 namespace po = boost::program_options;
 namespace sh = nscapi::settings_helper;
 
@@ -32,6 +36,7 @@ private:
 	std::string channel_;
 	std::string hostname_;
 
+	boost::shared_ptr<graphite_client::graphite_client_handler> handler_;
 	client::configuration client_;
 
 public:
@@ -46,6 +51,7 @@ public:
 	void handleNotification(const std::string &channel, const Plugin::SubmitRequestMessage &request_message, Plugin::SubmitResponseMessage *response_message);
 
 	void submitMetrics(const Plugin::MetricsMessage &response);
+	void fetchMetrics(Plugin::MetricsMessage::Response *response);
 
 private:
 	void add_command(std::string key, std::string args);
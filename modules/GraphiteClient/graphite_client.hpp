@@ -16,9 +16,15 @@
 
 #pragma once
 
+#include <map>
+
 #include <socket/socket_helpers.hpp>
 #include <nscapi/nscapi_helper_singleton.hpp>
 
+#include <boost/thread/mutex.hpp>
+
+#include "graphite_sender.hpp"
+
 namespace graphite_client {
 	struct connection_data : public socket_helpers::connection_info {
 		std::string ppath;
@@ -26,6 +32,9 @@ namespace graphite_client {
 		std::string sender_hostname;
 		bool send_perf;
 		bool send_status;
+		int flush_interval;
+		int flush_size;
+		int buffer_size;
 
 		connection_data(client::destination_container sender, client::destination_container target) {
 			address = target.address.host;
@@ -36,6 +45,9 @@ namespace graphite_client {
 			spath = target.get_string_data("status path");
 			send_perf = target.get_bool_data("send perfdata");
 			send_status = target.get_bool_data("send status");
+			flush_interval = target.get_int_data("flush interval", 1000);
+			flush_size = target.get_int_data("flush size", 1000);
+			buffer_size = target.get_int_data("buffer size", 100000);
 			if (sender.has_data("host"))
 				sender_hostname = sender.get_string_data("host");
 			else 
@@ -49,11 +61,6 @@ namespace graphite_client {
 		}
 	};
 
-	struct g_data {
-		std::string path;
-		std::string value;
-	};
-
 	std::string fix_graphite_string(const std::string &s) {
 		std::string sc = s;
 		strEx::s::replace(sc, " ", "_");
@@ -63,6 +70,10 @@ namespace graphite_client {
 		return sc;
 	}
 	struct graphite_client_handler : public client::handler_interface {
+		typedef std::map<std::string, boost::shared_ptr<graphite_sender> > sender_map;
+		sender_map senders_;
+		boost::mutex senders_mutex_;
+
 		bool query(client::destination_container sender, client::destination_container target, const Plugin::QueryRequestMessage &request_message, Plugin::QueryResponseMessage &response_message) {
 			return false;
 		}
@@ -158,35 +169,74 @@ namespace graphite_client {
 		}
 
 
+		boost::shared_ptr<graphite_sender> get_sender(const connection_data &con) {
+			sender_config config;
+			config.host = con.get_address();
+			config.port = con.get_port();
+			config.timeout = con.timeout;
+			config.flush_interval = con.flush_interval > 0 ? con.flush_interval : 1000;
+			config.flush_size = con.flush_size > 0 ? con.flush_size : 1;
+			config.buffer_size = con.buffer_size > 0 ? con.buffer_size : config.flush_size;
+
+			boost::unique_lock<boost::mutex> lock(senders_mutex_);
+			boost::shared_ptr<graphite_sender> &sender = senders_[con.get_endpoint_string()];
+			if (sender) {
+				sender->set_config(config);
+			} else {
+				sender = boost::make_shared<graphite_sender>(config);
+				sender->start();
+			}
+			return sender;
+		}
+
+		/**
+		 * Flush and disconnect all targets.
+		 */
+		void stop() {
+			sender_map senders;
+			{
+				boost::unique_lock<boost::mutex> lock(senders_mutex_);
+				senders.swap(senders_);
+			}
+			BOOST_FOREACH(const sender_map::value_type &v, senders) {
+				v.second->stop();
+			}
+		}
+
+		void fetch_metrics(Plugin::Common::MetricsBundle *bundle) {
+			boost::unique_lock<boost::mutex> lock(senders_mutex_);
+			BOOST_FOREACH(const sender_map::value_type &v, senders_) {
+				graphite_sender::counters c = v.second->get_counters();
+				Plugin::Common::MetricsBundle *child = bundle->add_children();
+				std::string key = fix_graphite_string(v.first);
+				strEx::s::replace(key, ".", "_");
+				strEx::s::replace(key, ":", "_");
+				child->set_key(key);
+				add_metric(child, "queued", c.queued);
+				add_metric(child, "sent", c.sent);
+				add_metric(child, "dropped", c.dropped);
+				add_metric(child, "pending", c.pending);
+				add_metric(child, "reconnects", c.reconnects);
+				add_metric(child, "errors", c.errors);
+			}
+		}
+
+		void add_metric(Plugin::Common::MetricsBundle *bundle, const std::string &key, boost::uint64_t value) {
+			Plugin::Common::Metric *m = bundle->add_value();
+			m->set_key(key);
+			m->mutable_value()->set_int_data(value);
+		}
+
 		boost::tuple<bool, std::string> send(connection_data con, const std::list<g_data> &data) {
 			try {
-				boost::asio::io_service io_service;
-				boost::asio::ip::tcp::resolver resolver(io_service);
-				boost::asio::ip::tcp::resolver::query query(con.get_address(), con.get_port());
-				boost::asio::ip::tcp::resolver::iterator endpoint_iterator = resolver.resolve(query);
-				boost::asio::ip::tcp::resolver::iterator end;
-
-				boost::asio::ip::tcp::socket socket(io_service);
-				boost::system::error_code error = boost::asio::error::host_not_found;
-				while (error && endpoint_iterator != end) {
-					socket.close();
-					socket.connect(*endpoint_iterator++, error);
-				}
-				if (error)
-					throw boost::system::system_error(error);
-
 				boost::posix_time::ptime time_t_epoch(boost::gregorian::date(1970, 1, 1));
 				boost::posix_time::ptime now = boost::posix_time::microsec_clock::universal_time();
 				boost::posix_time::time_duration diff = now - time_t_epoch;
-				int x = diff.total_seconds();
 
-				BOOST_FOREACH(const g_data &d, data) {
-					std::string msg = d.path + " " + d.value + " " + boost::lexical_cast<std::string>(x) + "\n";
-					socket.send(boost::asio::buffer(msg));
-				}
-				return boost::make_tuple(true, "Data presumably sent successfully");
-			} catch (const std::runtime_error &e) {
-				return boost::make_tuple(false, "Socket error: " + utf8::utf8_from_native(e.what()));
+				std::size_t dropped = get_sender(con)->push(data, diff.total_seconds());
+				if (dropped > 0)
+					return boost::make_tuple(false, "Send buffer full: dropped " + strEx::s::xtos(dropped) + " of " + strEx::s::xtos(data.size()) + " points");
+				return boost::make_tuple(true, "Queued " + strEx::s::xtos(data.size()) + " points");
 			} catch (const std::exception &e) {
 				return boost::make_tuple(false, "Error: " + utf8::utf8_from_native(e.what()));
 			} catch (...) {
@@ -37,6 +37,9 @@ namespace graphite_handler {
 			set_property_bool("send perfdata", true);
 			set_property_bool("send status", true);
 			set_property_int("timeout", 30);
+			set_property_int("flush interval", 1000);
+			set_property_int("flush size", 1000);
+			set_property_int("buffer size", 100000);
 			set_property_string("perf path", "system.${hostname}.${check_alias}.${perf_alias}");
 			set_property_string("status path", "system.${hostname}.${check_alias}.status");
 		}
@@ -67,6 +70,15 @@ namespace graphite_handler {
 					("send status", sh::bool_fun_key<bool>(boost::bind(&parent::set_property_bool, this, "send status", _1), true),
 						"SEND STATUS", "Send status data to this server")
 
+					("flush interval", sh::int_fun_key<int>(boost::bind(&parent::set_property_int, this, "flush interval", _1), 1000),
+						"FLUSH INTERVAL", "Maximum time (in milliseconds) to hold points before they are written to the server", true)
+
+					("flush size", sh::int_fun_key<int>(boost::bind(&parent::set_property_int, this, "flush size", _1), 1000),
+						"FLUSH SIZE", "Number of pending points which triggers a write before the flush interval has passed", true)
+
+					("buffer size", sh::int_fun_key<int>(boost::bind(&parent::set_property_int, this, "buffer size", _1), 100000),
+						"BUFFER SIZE", "Maximum number of points to keep in memory, points are dropped when the buffer is full", true)
+
 					;
 			} else {
 				root_path.add_key()
@@ -83,6 +95,15 @@ namespace graphite_handler {
 					("send status", sh::bool_fun_key<bool>(boost::bind(&parent::set_property_bool, this, "send status", _1)),
 						"SEND STATUS", "Send status data to this server")
 
+					("flush interval", sh::int_fun_key<int>(boost::bind(&parent::set_property_int, this, "flush interval", _1)),
+						"FLUSH INTERVAL", "Maximum time (in milliseconds) to hold points before they are written to the server", true)
+
+					("flush size", sh::int_fun_key<int>(boost::bind(&parent::set_property_int, this, "flush size", _1)),
+						"FLUSH SIZE", "Number of pending points which triggers a write before the flush interval has passed", true)
+
+					("buffer size", sh::int_fun_key<int>(boost::bind(&parent::set_property_int, this, "buffer size", _1)),
+						"BUFFER SIZE", "Maximum number of points to keep in memory, points are dropped when the buffer is full", true)
+
 					;
 			}
 			settings.register_all();
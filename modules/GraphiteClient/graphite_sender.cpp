@@ -0,0 +1,248 @@
+/*
+ * Copyright 2004-2016 The NSClient++ Authors - https://nsclient.org
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "graphite_sender.hpp"
+
+#include <boost/bind.hpp>
+#include <boost/foreach.hpp>
+#include <boost/lexical_cast.hpp>
+
+#include <utf8.hpp>
+
+namespace graphite_client {
+
+	graphite_sender::graphite_sender(const sender_config &config) : config_(config), buffer_points_(0), retry_points_(0), stop_(false), connected_before_(false) {}
+
+	graphite_sender::~graphite_sender() {
+		disconnect();
+	}
+
+	void graphite_sender::start() {
+		boost::unique_lock<boost::mutex> lock(mutex_);
+		if (thread_.get_id() != boost::thread::id())
+			return;
+		stop_ = false;
+		thread_ = boost::thread(boost::bind(&graphite_sender::thread_proc, shared_from_this()));
+	}
+
+	void graphite_sender::stop() {
+		{
+			boost::unique_lock<boost::mutex> lock(mutex_);
+			stop_ = true;
+		}
+		cond_.notify_all();
+		// All socket operations are bounded by the timeout so the thread always finishes (it must not outlive the module).
+		if (thread_.joinable())
+			thread_.join();
+	}
+
+	void graphite_sender::set_config(const sender_config &config) {
+		boost::unique_lock<boost::mutex> lock(mutex_);
+		config_ = config;
+	}
+
+	std::size_t graphite_sender::push(const std::list<g_data> &data, long long timestamp) {
+		std::string ts = " " + boost::lexical_cast<std::string>(timestamp) + "\n";
+		std::size_t dropped = 0;
+		bool notify = false;
+		{
+			boost::unique_lock<boost::mutex> lock(mutex_);
+			BOOST_FOREACH(const g_data &d, data) {
+				if (buffer_points_ + retry_points_ >= config_.buffer_size) {
+					dropped++;
+					continue;
+				}
+				buffer_.append(d.path).append(" ").append(d.value).append(ts);
+				buffer_points_++;
+			}
+			counters_.queued += data.size() - dropped;
+			counters_.dropped += dropped;
+			notify = buffer_points_ >= config_.flush_size;
+		}
+		if (notify)
+			cond_.notify_all();
+		return dropped;
+	}
+
+	graphite_sender::counters graphite_sender::get_counters() const {
+		boost::unique_lock<boost::mutex> lock(mutex_);
+		counters ret = counters_;
+		ret.pending = buffer_points_ + retry_points_;
+		return ret;
+	}
+
+	std::string graphite_sender::get_last_error() const {
+		boost::unique_lock<boost::mutex> lock(mutex_);
+		return last_error_;
+	}
+
+	void graphite_sender::thread_proc() {
+		std::string batch;
+		while (true) {
+			bool stopping;
+			{
+				boost::unique_lock<boost::mutex> lock(mutex_);
+				boost::system_time deadline = boost::get_system_time() + boost::posix_time::milliseconds(config_.flush_interval);
+				// A failed batch is retried on the next interval, otherwise wait for enough points to fill a write.
+				while (!stop_ && (retry_points_ > 0 || buffer_points_ < config_.flush_size)) {
+					if (!cond_.timed_wait(lock, deadline))
+						break;
+				}
+				stopping = stop_;
+				if (retry_points_ == 0) {
+					batch.swap(buffer_);
+					buffer_.clear();
+					retry_points_ = buffer_points_;
+					buffer_points_ = 0;
+				}
+				if (retry_points_ == 0) {
+					if (stopping)
+						break;
+					continue;
+				}
+			}
+
+			bool ok = write(batch);
+			{
+				boost::unique_lock<boost::mutex> lock(mutex_);
+				if (ok) {
+					counters_.sent += retry_points_;
+				} else {
+					counters_.errors++;
+					if (stopping)
+						counters_.dropped += retry_points_;
+				}
+				if (ok || stopping) {
+					retry_points_ = 0;
+					batch.clear();
+				}
+				if (stopping && !ok) {
+					counters_.dropped += buffer_points_;
+					buffer_points_ = 0;
+					buffer_.clear();
+				}
+				if (stopping && buffer_points_ == 0)
+					break;
+			}
+		}
+		disconnect();
+	}
+
+	static void set_error(const boost::system::error_code &error, boost::system::error_code *target) {
+		*target = error;
+	}
+	static void set_resolved(const boost::system::error_code &error, boost::asio::ip::tcp::resolver::iterator iterator, boost::system::error_code *target, boost::asio::ip::tcp::resolver::iterator *result) {
+		*target = error;
+		*result = iterator;
+	}
+	static void set_expired(const boost::system::error_code &error, bool *expired) {
+		if (!error)
+			*expired = true;
+	}
+
+	// Run the io service until the pending operation sets op_error or the timeout expires (then cancel aborts it).
+	void graphite_sender::run_until(boost::system::error_code &op_error, const boost::function<void()> &cancel) {
+		int timeout;
+		{
+			boost::unique_lock<boost::mutex> lock(mutex_);
+			timeout = config_.timeout;
+		}
+		bool expired = false;
+		boost::asio::deadline_timer timer(io_service_, boost::posix_time::seconds(timeout));
+		timer.async_wait(boost::bind(&set_expired, boost::asio::placeholders::error, &expired));
+		io_service_.reset();
+		while (op_error == boost::asio::error::would_block && !expired && io_service_.run_one()) {}
+		if (op_error == boost::asio::error::would_block)
+			cancel();
+		timer.cancel();
+		// Let the aborted operation and the timer complete so no handler refers to this frame
+		io_service_.reset();
+		io_service_.run();
+		if (expired && (op_error == boost::asio::error::would_block || op_error == boost::asio::error::operation_aborted))
+			op_error = boost::asio::error::timed_out;
+	}
+
+	bool graphite_sender::write(const std::string &batch) {
+		// An idle connection may have been closed by the server so a failed write is retried once on a new connection.
+		for (int attempt = 0; attempt < 2; attempt++) {
+			try {
+				if (!socket_)
+					connect();
+				boost::system::error_code error = boost::asio::error::would_block;
+				boost::asio::async_write(*socket_, boost::asio::buffer(batch), boost::bind(&set_error, boost::asio::placeholders::error, &error));
+				run_until(error, boost::bind(&graphite_sender::abort, this));
+				if (error)
+					throw boost::system::system_error(error);
+				return true;
+			} catch (const std::exception &e) {
+				disconnect();
+				boost::unique_lock<boost::mutex> lock(mutex_);
+				last_error_ = "Failed to send to " + config_.host + ":" + config_.port + ": " + utf8::utf8_from_native(e.what());
+			}
+		}
+		return false;
+	}
+
+	void graphite_sender::connect() {
+		std::string host, port;
+		{
+			boost::unique_lock<boost::mutex> lock(mutex_);
+			host = config_.host;
+			port = config_.port;
+			if (connected_before_)
+				counters_.reconnects++;
+			connected_before_ = true;
+		}
+		boost::asio::ip::tcp::resolver resolver(io_service_);
+		boost::asio::ip::tcp::resolver::query query(host, port);
+		boost::asio::ip::tcp::resolver::iterator endpoint_iterator;
+		boost::asio::ip::tcp::resolver::iterator end;
+		boost::system::error_code error = boost::asio::error::would_block;
+		resolver.async_resolve(query, boost::bind(&set_resolved, boost::asio::placeholders::error, boost::asio::placeholders::iterator, &error, &endpoint_iterator));
+		run_until(error, boost::bind(&boost::asio::ip::tcp::resolver::cancel, &resolver));
+		if (error)
+			throw boost::system::system_error(error);
+
+		error = boost::asio::error::host_not_found;
+		while (error && endpoint_iterator != end) {
+			socket_.reset(new boost::asio::ip::tcp::socket(io_service_));
+			error = boost::asio::error::would_block;
+			socket_->async_connect(*endpoint_iterator++, boost::bind(&set_error, boost::asio::placeholders::error, &error));
+			run_until(error, boost::bind(&graphite_sender::abort, this));
+		}
+		if (error) {
+			disconnect();
+			throw boost::system::system_error(error);
+		}
+		socket_->set_option(boost::asio::ip::tcp::no_delay(true));
+	}
+
+	void graphite_sender::abort() {
+		if (!socket_)
+			return;
+		boost::system::error_code ignored;
+		socket_->close(ignored);
+	}
+
+	void graphite_sender::disconnect() {
+		if (!socket_)
+			return;
+		boost::system::error_code ignored;
+		socket_->shutdown(boost::asio::ip::tcp::socket::shutdown_both, ignored);
+		socket_->close(ignored);
+		socket_.reset();
+	}
+}
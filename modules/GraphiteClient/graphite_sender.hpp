@@ -0,0 +1,114 @@
+/*
+ * Copyright 2004-2016 The NSClient++ Authors - https://nsclient.org
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <list>
+#include <string>
+
+#include <boost/asio.hpp>
+#include <boost/cstdint.hpp>
+#include <boost/enable_shared_from_this.hpp>
+#include <boost/function.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/scoped_ptr.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/thread.hpp>
+
+namespace graphite_client {
+
+	struct g_data {
+		std::string path;
+		std::string value;
+	};
+
+	struct sender_config {
+		std::string host;
+		std::string port;
+		int timeout;
+		int flush_interval;
+		std::size_t flush_size;
+		std::size_t buffer_size;
+
+		sender_config() : timeout(30), flush_interval(1000), flush_size(1000), buffer_size(100000) {}
+	};
+
+	/**
+	 * Persistent connection to a single carbon endpoint.
+	 * Points are rendered into a bounded buffer and written by a background thread either when
+	 * flush size points are pending or when the flush interval expires.
+	 * The connection is kept open between flushes and re-established when a write fails, points
+	 * which do not fit in the buffer are dropped (and counted).
+	 * Resolving, connecting and writing are each bounded by the timeout.
+	 */
+	class graphite_sender : public boost::enable_shared_from_this<graphite_sender>, boost::noncopyable {
+	public:
+		struct counters {
+			boost::uint64_t queued;
+			boost::uint64_t sent;
+			boost::uint64_t dropped;
+			boost::uint64_t reconnects;
+			boost::uint64_t errors;
+			std::size_t pending;
+			counters() : queued(0), sent(0), dropped(0), reconnects(0), errors(0), pending(0) {}
+		};
+
+	private:
+		sender_config config_;
+		counters counters_;
+		std::string buffer_;
+		std::size_t buffer_points_;
+		std::size_t retry_points_;
+		std::string last_error_;
+		bool stop_;
+		bool connected_before_;
+
+		mutable boost::mutex mutex_;
+		boost::condition_variable cond_;
+		boost::thread thread_;
+
+		boost::asio::io_service io_service_;
+		boost::scoped_ptr<boost::asio::ip::tcp::socket> socket_;
+
+	public:
+		graphite_sender(const sender_config &config);
+		~graphite_sender();
+
+		void start();
+		/**
+		 * Flush all pending points and stop (and join) the background thread.
+		 */
+		void stop();
+		void set_config(const sender_config &config);
+
+		/**
+		 * Queue points for sending.
+		 * @return the number of points which were dropped since the buffer was full
+		 */
+		std::size_t push(const std::list<g_data> &data, long long timestamp);
+		counters get_counters() const;
+		std::string get_last_error() const;
+
+	private:
+		void thread_proc();
+		bool write(const std::string &batch);
+		void connect();
+		void disconnect();
+		void abort();
+		void run_until(boost::system::error_code &op_error, const boost::function<void()> &cancel);
+	};
+}
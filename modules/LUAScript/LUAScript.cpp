@@ -28,6 +28,7 @@
 #include <nscapi/macros.hpp>
 
 #include <nscapi/nscapi_settings_helper.hpp>
+#include <nscapi/nscapi_metrics_helper.hpp>
 
 namespace sh = nscapi::settings_helper;
 namespace po = boost::program_options;
@@ -50,9 +51,21 @@ bool LUAScript::loadModuleEx(std::string alias, NSCAPI::moduleLoadMode) {
 				"SCRIPT DEFENTION", "For more configuration options add a dedicated section")
 			;
 
+		int pool_size = 0, max_pool_size = 0;
+		settings.alias().add_key_to_settings()
+			("pool size", sh::int_key(&pool_size, 0),
+				"POOL SIZE", "Number of lua states loaded for each script when it is loaded (in addition to the main state). Each state runs the script on its own.", true)
+
+			("max pool size", sh::int_key(&max_pool_size, 0),
+				"MAX POOL SIZE", "Maximum number of lua states per script used to run queries concurrently. Each state runs the top level code of the script on its own and has its own global variables. The default (0) runs all queries on the main state one at a time.", true)
+			;
+
 		settings.register_all();
 		settings.notify();
 
+		lua_runtime_->pool_size = pool_size < 0 ? 0 : pool_size;
+		lua_runtime_->max_pool_size = max_pool_size < 0 ? 0 : max_pool_size;
+
 		// 		if (!scriptDirectory_.empty()) {
 		// 			addAllScriptsFrom(scriptDirectory_);
 		// 		}
@@ -96,6 +109,31 @@ bool LUAScript::unloadModule() {
 	return true;
 }
 
+void LUAScript::fetchMetrics(Plugin::MetricsMessage::Response *response) {
+	using namespace nscapi::metrics;
+	if (!scripts_)
+		return;
+
+	Plugin::Common::MetricsBundle *bundle = response->add_bundles();
+	bundle->set_key("lua");
+	BOOST_FOREACH(scripts::script_information<lua::lua_traits> *info, scripts_->get_scripts()) {
+		boost::shared_ptr<lua::lua_state_pool> pool = info->user_data.pool;
+		if (!pool)
+			continue;
+		lua::lua_state_pool::pool_metrics m = pool->get_metrics();
+		Plugin::Common::MetricsBundle *section = bundle->add_children();
+		section->set_key(info->script_alias.empty() ? boost::filesystem::path(info->script).filename().string() : info->script_alias);
+		add_metric(section, "pool.size", static_cast<unsigned long long>(m.size));
+		add_metric(section, "pool.idle", static_cast<unsigned long long>(m.idle));
+		add_metric(section, "pool.hits", m.hits);
+		add_metric(section, "pool.misses", m.misses);
+		add_metric(section, "pool.created", m.created);
+		add_metric(section, "pool.waits", m.waits);
+		add_metric(section, "pool.wait_avg_us", m.waits == 0 ? 0 : m.wait_total_us / m.waits);
+		add_metric(section, "pool.wait_max_us", m.wait_max_us);
+	}
+}
+
 void LUAScript::query_fallback(const Plugin::QueryRequestMessage::Request &request, Plugin::QueryResponseMessage::Response *response, const Plugin::QueryRequestMessage &request_message) {
 	std::string response_buffer;
 	boost::optional<scripts::command_definition<lua::lua_traits> > cmd = scripts_->find_command(scripts::nscp::tags::query_tag, request.command());
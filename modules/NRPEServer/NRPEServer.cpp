@@ -29,11 +29,13 @@
 
 namespace sh = nscapi::settings_helper;
 
-NRPEServer::NRPEServer() {}
+NRPEServer::NRPEServer() : check_threads_(10), queue_size_(100), max_client_requests_(10) {}
 NRPEServer::~NRPEServer() {}
 
 bool NRPEServer::loadModuleEx(std::string alias, NSCAPI::moduleLoadMode mode) {
 	try {
+		// Stop the pool first so requests it drops are answered while the server is still running
+		pool_.stop();
 		if (server_) {
 			server_->stop();
 			server_.reset();
@@ -75,6 +77,15 @@ bool NRPEServer::loadModuleEx(std::string alias, NSCAPI::moduleLoadMode mode) {
 		("performance data", sh::bool_fun_key<bool>(boost::bind(&NRPEServer::set_perf_data, this, _1), true),
 			"PERFORMANCE DATA", "Send performance data back to nagios (set this to 0 to remove all performance data).", true)
 
+		("check threads", sh::uint_key(&check_threads_, 10),
+			"CHECK THREADS", "Number of threads executing checks (separate from the socket thread pool).", true)
+
+		("queue size", sh::uint_key(&queue_size_, 100),
+			"CHECK QUEUE SIZE", "Maximum number of requests waiting for a check thread, further requests are answered with UNKNOWN (0 for no limit).", true)
+
+		("max client requests", sh::uint_key(&max_client_requests_, 10),
+			"MAX REQUESTS PER CLIENT", "Maximum number of queued or running requests from a single client address (0 for no limit).", true)
+
 		;
 
 	socket_helpers::settings_helper::add_core_server_opts(settings, info_);
@@ -124,6 +135,7 @@ bool NRPEServer::loadModuleEx(std::string alias, NSCAPI::moduleLoadMode mode) {
 
 		boost::asio::io_service io_service_;
 
+		pool_.start(check_threads_ > 0 ? check_threads_ : 1, queue_size_, max_client_requests_);
 		server_.reset(new nrpe::server::server(info_, this));
 		if (!server_) {
 			NSC_LOG_ERROR_STD("Failed to create server instance!");
@@ -136,6 +148,8 @@ bool NRPEServer::loadModuleEx(std::string alias, NSCAPI::moduleLoadMode mode) {
 
 bool NRPEServer::unloadModule() {
 	try {
+		// Stop the pool first so requests it drops are answered while the server is still running
+		pool_.stop();
 		if (server_) {
 			server_->stop();
 			server_.reset();
@@ -147,7 +161,67 @@ bool NRPEServer::unloadModule() {
 	return true;
 }
 
-std::list<nrpe::packet> NRPEServer::handle(nrpe::packet p) {
+void NRPEServer::fetchMetrics(Plugin::MetricsMessage::Response *response) {
+	nrpe::server::check_pool::metrics m = pool_.get_metrics();
+	Plugin::Common::MetricsBundle *bundle = response->add_bundles();
+	bundle->set_key("nrpe");
+	Plugin::Common::Metric *v = bundle->add_value();
+	v->set_key("queue");
+	v->mutable_value()->set_int_data(m.queue_depth);
+	v = bundle->add_value();
+	v->set_key("active");
+	v->mutable_value()->set_int_data(m.active);
+	v = bundle->add_value();
+	v->set_key("executed");
+	v->mutable_value()->set_int_data(m.executed);
+	v = bundle->add_value();
+	v->set_key("rejected");
+	v->mutable_value()->set_int_data(m.rejected);
+	v = bundle->add_value();
+	v->set_key("wait_total");
+	v->mutable_value()->set_int_data(m.wait_total_ms);
+	v = bundle->add_value();
+	v->set_key("wait_avg");
+	v->mutable_value()->set_int_data(m.wait_avg_ms);
+	v = bundle->add_value();
+	v->set_key("wait_max");
+	v->mutable_value()->set_int_data(m.wait_max_ms);
+}
+
+void NRPEServer::handle_async(const nrpe::packet &p, const std::string &client, callback_type callback) {
+	nrpe::server::check_pool::submit_result result = pool_.submit(client, boost::bind(&NRPEServer::execute, this, p, callback),
+		boost::bind(&NRPEServer::reject, p, callback, std::string("UNKNOWN: Server is shutting down")));
+	if (result == nrpe::server::check_pool::accepted)
+		return;
+	if (result == nrpe::server::check_pool::client_limit)
+		reject(p, callback, "UNKNOWN: Too many concurrent requests from " + client);
+	else if (result == nrpe::server::check_pool::queue_full)
+		reject(p, callback, "UNKNOWN: Server busy, check queue is full");
+	else
+		reject(p, callback, "UNKNOWN: Server is shutting down");
+}
+
+void NRPEServer::reject(const nrpe::packet p, callback_type callback, const std::string msg) {
+	// Rejections are counted in the rejected metric, logging each one at error level would flood the log under load.
+	NSC_DEBUG_MSG(msg);
+	std::list<nrpe::packet> packets;
+	packets.push_back(nrpe::packet::create_response(NSCAPI::query_return_codes::returnUNKNOWN, msg, p.get_payload_length()));
+	callback(packets);
+}
+
+void NRPEServer::execute(const nrpe::packet packet, callback_type callback) {
+	std::list<nrpe::packet> packets;
+	try {
+		packets = handle(packet);
+	} catch (const std::exception &e) {
+		packets.push_back(create_error("Exception processing request: " + utf8::utf8_from_native(e.what())));
+	} catch (...) {
+		packets.push_back(create_error("Exception processing request"));
+	}
+	callback(packets);
+}
+
+std::list<nrpe::packet> NRPEServer::handle(const nrpe::packet &p) {
 	std::list<nrpe::packet> packets;
 	strEx::s::token cmd = strEx::s::getToken(p.getPayload(), '!');
 	if (cmd.first == "_NRPE_CHECK") {
@@ -16,9 +16,11 @@
 
 #include <nrpe/server/protocol.hpp>
 #include <nscapi/nscapi_targets.hpp>
+#include <nscapi/nscapi_protobuf.hpp>
 #include <nscapi/nscapi_plugin_impl.hpp>
 #include <nrpe/packet.hpp>
 #include <nrpe/server/handler.hpp>
+#include <nrpe/server/check_pool.hpp>
 
 class NRPEServer : public nscapi::impl::simple_plugin, nrpe::server::handler {
 private:
@@ -28,6 +30,10 @@ private:
 	bool allowArgs_;
 	bool multiple_packets_;
 	std::string encoding_;
+	unsigned int check_threads_;
+	unsigned int queue_size_;
+	unsigned int max_client_requests_;
+	nrpe::server::check_pool pool_;
 
 	void set_perf_data(bool v) {
 		noPerfData_ = !v;
@@ -41,9 +47,13 @@ public:
 	// Module calls
 	bool loadModuleEx(std::string alias, NSCAPI::moduleLoadMode mode);
 	bool unloadModule();
+	void fetchMetrics(Plugin::MetricsMessage::Response *response);
 
 	// Handler
-	std::list<nrpe::packet> handle(nrpe::packet packet);
+	std::list<nrpe::packet> handle(const nrpe::packet &packet);
+	void handle_async(const nrpe::packet &packet, const std::string &client, callback_type callback);
+	void execute(const nrpe::packet packet, callback_type callback);
+	static void reject(const nrpe::packet packet, callback_type callback, const std::string msg);
 
 	nrpe::packet create_error(std::string msg) {
 		return nrpe::packet::create_response(3, msg, payload_length_);
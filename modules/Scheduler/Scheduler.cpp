@@ -24,6 +24,8 @@
 #include <nscapi/nscapi_settings_helper.hpp>
 #include <nscapi/macros.hpp>
 
+#include <boost/asio/ip/host_name.hpp>
+
 namespace sh = nscapi::settings_helper;
 
 bool Scheduler::loadModuleEx(std::string alias, NSCAPI::moduleLoadMode mode) {
@@ -35,6 +37,7 @@ bool Scheduler::loadModuleEx(std::string alias, NSCAPI::moduleLoadMode mode) {
 	}
 
 
+	std::string splay_seed;
 	sh::settings_registry settings(get_settings_proxy());
 	settings.set_alias(alias, "scheduler");
 	schedules_.set_path(settings.alias().get_settings_path("schedules"));
@@ -47,6 +50,15 @@ bool Scheduler::loadModuleEx(std::string alias, NSCAPI::moduleLoadMode mode) {
 	settings.alias().add_key_to_settings()
 		("threads", sh::int_fun_key<unsigned int>(boost::bind(&schedules::scheduler::set_threads, &scheduler_, _1), 5),
 			"THREAD COUNT", "Number of threads to use.")
+
+		("engine", sh::string_fun_key<std::string>(boost::bind(&schedules::scheduler::set_engine, &scheduler_, _1), "queue"),
+			"SCHEDULER ENGINE", "Scheduling engine to use: queue (each worker sleeps until its item is due) or wheel (timer wheel with a single dispatcher handing due items to the workers).", true)
+
+		("splay seed", sh::string_key(&splay_seed, "auto"),
+			"SPLAY SEED", "Interval schedules are spread over their interval based on this seed and the alias so they always run at the same offset (auto means the hostname which spreads the same schedules differently on different hosts).", true)
+
+		("max starts", sh::int_fun_key<int>(boost::bind(&schedules::scheduler::set_max_starts, &scheduler_, _1), 0),
+			"MAX STARTS PER SECOND", "Maximum number of schedules to start per second (0 means no limit), schedules over the limit are delayed.", true)
 		;
 
 	settings.alias().add_path_to_settings()
@@ -75,6 +87,10 @@ bool Scheduler::loadModuleEx(std::string alias, NSCAPI::moduleLoadMode mode) {
 
 	schedules_.ensure_default();
 
+	if (splay_seed == "auto")
+		splay_seed = boost::asio::ip::host_name();
+	scheduler_.set_splay_seed(splay_seed);
+
 	BOOST_FOREACH(const schedules::schedule_handler::object_list_type::value_type &o, schedules_.get_object_list()) {
 		if (o->duration && (*o->duration).total_seconds() == 0) {
 			NSC_LOG_ERROR("WE cant add schedules with 0 duration: " + o->to_string());
@@ -211,6 +227,16 @@ void Scheduler::fetchMetrics(Plugin::MetricsMessage::Response *response) {
 		m = bundle->add_value();
 		m->set_key("queue");
 		m->mutable_value()->set_int_data(queue);
+		BOOST_FOREACH(const simple_scheduler::scheduler::histogram_type::value_type &v, scheduler_.get_scheduler().get_metric_lateness()) {
+			m = bundle->add_value();
+			m->set_key(v.first);
+			m->mutable_value()->set_int_data(v.second);
+		}
+		BOOST_FOREACH(const simple_scheduler::scheduler::histogram_type::value_type &v, scheduler_.get_scheduler().get_metric_starts()) {
+			m = bundle->add_value();
+			m->set_key(v.first);
+			m->mutable_value()->set_int_data(v.second);
+		}
 	} else {
 		Plugin::Common::Metric *m = bundle->add_value();
 		m->set_key("metrics.available");
@@ -203,6 +203,15 @@ namespace schedules {
 		void set_threads(int count) {
 			tasks.set_threads(count);
 		}
+		void set_engine(std::string engine) {
+			tasks.set_engine(engine);
+		}
+		void set_splay_seed(std::string seed) {
+			tasks.set_splay_seed(seed);
+		}
+		void set_max_starts(int per_second) {
+			tasks.set_max_starts(per_second);
+		}
 
 		void add_task(const target_object target);
 
@@ -27,6 +27,7 @@
 #include <boost/program_options.hpp>
 #include <boost/filesystem/operations.hpp>
 #include <boost/unordered_set.hpp>
+#include <boost/make_shared.hpp>
 
 #include <nscapi/nscapi_protobuf.hpp>
 #include <nscapi/nscapi_protobuf_functions.hpp>
@@ -37,6 +38,7 @@
 #include <nscapi/nscapi_common_options.hpp>
 
 #include <client/simple_client.hpp>
+#include <metrics/metrics_prometheus.hpp>
 
 #include <json_spirit.h>
 
@@ -50,6 +52,33 @@ WEBServer::~WEBServer() {}
 
 error_handler log_data;
 metrics_handler metrics_store;
+void build_metrics(json_spirit::Object &metrics, const Plugin::Common::MetricsBundle & b) {
+	json_spirit::Object node;
+	BOOST_FOREACH(const Plugin::Common::MetricsBundle &b2, b.children()) {
+		build_metrics(node, b2);
+	}
+	BOOST_FOREACH(const Plugin::Common::Metric &v, b.value()) {
+		const ::Plugin::Common_AnyDataType &value = v.value();
+		if (value.has_int_data())
+			node.insert(json_spirit::Object::value_type(v.key(), v.value().int_data()));
+		else if (value.has_string_data())
+			node.insert(json_spirit::Object::value_type(v.key(), v.value().string_data()));
+		else if (value.has_float_data())
+			node.insert(json_spirit::Object::value_type(v.key(), v.value().float_data()));
+		else
+			node.insert(json_spirit::Object::value_type(v.key(), "TODO"));
+	}
+	metrics.insert(json_spirit::Object::value_type(b.key(), node));
+}
+void store_metrics(const Plugin::MetricsMessage &response) {
+	json_spirit::Object metrics;
+	BOOST_FOREACH(const Plugin::MetricsMessage::Response &p, response.payload()) {
+		BOOST_FOREACH(const Plugin::Common::MetricsBundle &b, p.bundles()) {
+			build_metrics(metrics, b);
+		}
+	}
+	metrics_store.set(json_spirit::write(metrics), boost::make_shared<Plugin::MetricsMessage>(response));
+}
 static const char alphanum[] = "0123456789" "ABCDEFGHIJKLMNOPQRSTUVWXYZ" "abcdefghijklmnopqrstuvwxyz";
 class token_store {
 	typedef boost::unordered_set<std::string> token_set;
@@ -85,6 +114,36 @@ token_store tokens;
 socket_helpers::allowed_hosts_manager allowed_hosts;
 
 
+// Longest time (in seconds) a /log/messages request can wait for new messages
+const long max_log_wait = 30;
+
+// Escapes the same characters as json_spirit does (including bytes outside of ASCII).
+void append_json_string(std::string &buffer, const std::string &str) {
+	static const char hex[] = "0123456789ABCDEF";
+	buffer += '"';
+	BOOST_FOREACH(char c, str) {
+		switch (c) {
+		case '"': buffer += "\\\""; break;
+		case '\\': buffer += "\\\\"; break;
+		case '\b': buffer += "\\b"; break;
+		case '\f': buffer += "\\f"; break;
+		case '\n': buffer += "\\n"; break;
+		case '\r': buffer += "\\r"; break;
+		case '\t': buffer += "\\t"; break;
+		default:
+			unsigned char u = static_cast<unsigned char>(c);
+			if (u >= 0x20 && u < 0x7f) {
+				buffer += c;
+			} else {
+				buffer += "\\u00";
+				buffer += hex[u >> 4];
+				buffer += hex[u & 0x0f];
+			}
+		}
+	}
+	buffer += '"';
+}
+
 bool is_loggedin(Mongoose::Request &request, Mongoose::StreamResponse &response, std::string gpassword, bool respond = true) {
 	std::list<std::string> errors;
 	if (!allowed_hosts.is_allowed(boost::asio::ip::address::from_string(request.getRemoteIp()), errors)) {
@@ -423,30 +482,70 @@ public:
 	void log_messages(Mongoose::Request &request, Mongoose::StreamResponse &response) {
 		if (!is_loggedin(request, response, password))
 			return;
-		json_spirit::Object root, log;
-		json_spirit::Array data;
-
-		std::string str_position = request.get("pos", "0");
-		std::size_t pos = strEx::s::stox<std::size_t>(str_position);
-		BOOST_FOREACH(const error_handler::log_entry &e, log_data.get_errors(pos)) {
-			json_spirit::Object node;
-			node.insert(json_spirit::Object::value_type("file", e.file));
-			node.insert(json_spirit::Object::value_type("line", e.line));
-			node.insert(json_spirit::Object::value_type("type", e.type));
-			node.insert(json_spirit::Object::value_type("date", e.date));
-			node.insert(json_spirit::Object::value_type("message", e.message));
-			data.push_back(node);
+		std::size_t pos = strEx::s::stox<std::size_t>(request.get("pos", "0"), 0);
+		// Long polling: wait up to "wait" seconds for new messages
+		long wait = strEx::s::stox<long>(request.get("wait", "0"), 0);
+		if (wait > max_log_wait)
+			wait = max_log_wait;
+		std::size_t missed = 0;
+		error_handler::log_list entries = log_data.get_errors(pos, wait * 1000, missed);
+
+		std::string buffer;
+		buffer.reserve(128 + entries.size() * 160);
+		buffer += "{\"log\":{\"data\":[";
+		bool first = true;
+		BOOST_FOREACH(const error_handler::log_entry &e, entries) {
+			if (!first)
+				buffer += ",";
+			first = false;
+			buffer += "{\"file\":";
+			append_json_string(buffer, e.file);
+			buffer += ",\"line\":" + strEx::s::xtos(e.line) + ",\"type\":";
+			append_json_string(buffer, e.type);
+			buffer += ",\"date\":";
+			append_json_string(buffer, e.date);
+			buffer += ",\"message\":";
+			append_json_string(buffer, e.message);
+			buffer += "}";
 		}
-		log.insert(json_spirit::Object::value_type("data", data));
-		log.insert(json_spirit::Object::value_type("pos", pos));
-		root.insert(json_spirit::Object::value_type("log", log));
-		response << json_spirit::write(root);
+		buffer += "],\"pos\":" + strEx::s::xtos(pos) + ",\"missed\":" + strEx::s::xtos(missed) + "}}";
+		response << buffer;
 	}
 	void get_metrics(Mongoose::Request &request, Mongoose::StreamResponse &response) {
 		if (!is_loggedin(request, response, password))
 			return;
+		if (request.get("format", "") == "prometheus")
+			return write_prometheus_metrics(response);
 		response << metrics_store.get();
 	}
+	void get_prometheus_metrics(Mongoose::Request &request, Mongoose::StreamResponse &response) {
+		if (!is_loggedin(request, response, password))
+			return;
+		write_prometheus_metrics(response);
+	}
+	void collect_metrics() {
+		// Only fetches metrics, the other metrics submitters are left to the scheduler
+		std::string buffer;
+		if (!core->fetch_metrics(buffer)) {
+			NSC_LOG_ERROR("Failed to collect metrics");
+			return;
+		}
+		Plugin::MetricsMessage message;
+		if (!message.ParseFromString(buffer)) {
+			NSC_LOG_ERROR("Failed to parse metrics");
+			return;
+		}
+		store_metrics(message);
+	}
+	void write_prometheus_metrics(Mongoose::StreamResponse &response) {
+		metrics_handler::message_type message = metrics_store.get_fresh(boost::bind(&BaseController::collect_metrics, this));
+		response.setHeader("Content-Type", "text/plain; version=0.0.4; charset=utf-8");
+		if (!message)
+			return;
+		metrics::prometheus_writer writer(response);
+		writer.write(*message);
+		writer.flush();
+	}
 	void log_reset(Mongoose::Request &request, Mongoose::StreamResponse &response) {
 		if (!is_loggedin(request, response, password))
 			return;
@@ -485,6 +584,7 @@ public:
 		addRoute("GET", "/core/isalive", BaseController, alive);
 		addRoute("GET", "/console/exec", BaseController, console_exec);
 		addRoute("GET", "/metrics", BaseController, get_metrics);
+		addRoute("GET", "/metrics/prometheus", BaseController, get_prometheus_metrics);
 		addRoute("GET", "/", BaseController, redirect_index);
 	}
 };
@@ -697,6 +797,8 @@ bool WEBServer::loadModuleEx(std::string alias, NSCAPI::moduleLoadMode mode) {
 	std::string port;
 	std::string password;
 	std::string certificate;
+	int log_buffer_size;
+	std::string metrics_cache;
 
 	settings.alias().add_path_to_settings()
 		("WEB SERVER SECTION", "Section for WEB (WEBServer.dll) (check_WEB) protocol options.")
@@ -709,6 +811,14 @@ bool WEBServer::loadModuleEx(std::string alias, NSCAPI::moduleLoadMode mode) {
 		("certificate", sh::string_key(&certificate, "${certificate-path}/certificate.pem"),
 			"CERTIFICATE", "Ssl certificate to use for the ssl server")
 		;
+	settings.alias().add_key_to_settings()
+		("log buffer size", sh::int_key(&log_buffer_size, 5000),
+			"LOG BUFFER SIZE", "Number of log messages to keep for the web interface, older messages are discarded.", true)
+		;
+	settings.alias().add_key_to_settings()
+		("metrics cache", sh::string_key(&metrics_cache, "1s"),
+			"METRICS CACHE", "When /metrics/prometheus is requested metrics older than this are collected from all modules before responding.", true)
+		;
 
 	settings.alias().add_parent("/settings/default").add_key_to_settings()
 
@@ -727,6 +837,9 @@ bool WEBServer::loadModuleEx(std::string alias, NSCAPI::moduleLoadMode mode) {
 	settings.register_all();
 	settings.notify();
 	certificate = get_core()->expand_path(certificate);
+	log_data.set_capacity(log_buffer_size > 0 ? log_buffer_size : 1);
+	log_data.startup();
+	metrics_store.set_cache_time(strEx::stoui_as_time(metrics_cache));
 
 	if (mode == NSCAPI::normalStart) {
 		std::list<std::string> errors;
@@ -774,6 +887,8 @@ bool WEBServer::loadModuleEx(std::string alias, NSCAPI::moduleLoadMode mode) {
 
 bool WEBServer::unloadModule() {
 	try {
+		// Long polling clients hold a server thread, wake them up so the server can stop.
+		log_data.shutdown();
 		if (server) {
 			server->stop();
 			server.reset();
@@ -785,63 +900,41 @@ bool WEBServer::unloadModule() {
 	return true;
 }
 
-void error_handler::add_message(bool is_error, const log_entry &message) {
-	{
-		boost::unique_lock<boost::timed_mutex> lock(mutex_, boost::get_system_time() + boost::posix_time::seconds(5));
-		if (!lock.owns_lock())
-			return;
-		log_entries.push_back(message);
-		if (is_error) {
-			error_count_++;
-			last_error_ = message.message;
-		}
-	}
-}
-void error_handler::reset() {
+void metrics_handler::set(const std::string &metrics, const message_type &message) {
 	boost::unique_lock<boost::timed_mutex> lock(mutex_, boost::get_system_time() + boost::posix_time::seconds(5));
 	if (!lock.owns_lock())
 		return;
-	log_entries.clear();
-	last_error_ = "";
-	error_count_ = 0;
+	metrics_ = metrics;
+	message_ = message;
+	updated_ = boost::posix_time::microsec_clock::universal_time();
 }
-error_handler::status error_handler::get_status() {
-	status ret;
+std::string metrics_handler::get() {
 	boost::unique_lock<boost::timed_mutex> lock(mutex_, boost::get_system_time() + boost::posix_time::seconds(5));
 	if (!lock.owns_lock())
-		return ret;
-	ret.error_count = error_count_;
-	ret.last_error = last_error_;
-	return ret;
+		return "";
+	return metrics_;
 }
-error_handler::log_list error_handler::get_errors(std::size_t &position) {
-	log_list ret;
-	boost::unique_lock<boost::timed_mutex> lock(mutex_, boost::get_system_time() + boost::posix_time::seconds(5));
-	if (!lock.owns_lock())
-		return ret;
-	if (position >= log_entries.size())
-		return ret;
-	log_list::iterator cit = log_entries.begin() + position;
-	log_list::iterator end = log_entries.end();
-
-	for (; cit != end; ++cit) {
-		ret.push_back(*cit);
-		position++;
+metrics_handler::message_type metrics_handler::get_fresh(const boost::function<void()> &collect) {
+	boost::unique_lock<boost::mutex> collect_lock(collect_mutex_);
+	{
+		boost::unique_lock<boost::timed_mutex> lock(mutex_, boost::get_system_time() + boost::posix_time::seconds(5));
+		if (!lock.owns_lock())
+			return message_type();
+		if (message_ && boost::posix_time::microsec_clock::universal_time() - updated_ < boost::posix_time::milliseconds(cache_time_))
+			return message_;
 	}
-	return ret;
-}
-
-void metrics_handler::set(const std::string &metrics) {
+	// collect ends up in set() (via store_metrics) so the lock can not be held here
+	collect();
 	boost::unique_lock<boost::timed_mutex> lock(mutex_, boost::get_system_time() + boost::posix_time::seconds(5));
 	if (!lock.owns_lock())
-		return;
-	metrics_ = metrics;
+		return message_type();
+	return message_;
 }
-std::string metrics_handler::get() {
+void metrics_handler::set_cache_time(unsigned int ms) {
 	boost::unique_lock<boost::timed_mutex> lock(mutex_, boost::get_system_time() + boost::posix_time::seconds(5));
 	if (!lock.owns_lock())
-		return "";
-	return metrics_;
+		return;
+	cache_time_ = ms;
 }
 
 void WEBServer::handleLogMessage(const Plugin::LogEntry::Entry &message) {
@@ -1073,32 +1166,8 @@ bool WEBServer::password(const Plugin::ExecuteRequestMessage::Request &request,
 	return true;
 }
 
-void build_metrics(json_spirit::Object &metrics, const Plugin::Common::MetricsBundle & b) {
-	json_spirit::Object node;
-	BOOST_FOREACH(const Plugin::Common::MetricsBundle &b2, b.children()) {
-		build_metrics(node, b2);
-	}
-	BOOST_FOREACH(const Plugin::Common::Metric &v, b.value()) {
-		const ::Plugin::Common_AnyDataType &value = v.value();
-		if (value.has_int_data())
-			node.insert(json_spirit::Object::value_type(v.key(), v.value().int_data()));
-		else if (value.has_string_data())
-			node.insert(json_spirit::Object::value_type(v.key(), v.value().string_data()));
-		else if (value.has_float_data())
-			node.insert(json_spirit::Object::value_type(v.key(), v.value().float_data()));
-		else
-			node.insert(json_spirit::Object::value_type(v.key(), "TODO"));
-	}
-	metrics.insert(json_spirit::Object::value_type(b.key(), node));
-}
 void WEBServer::submitMetrics(const Plugin::MetricsMessage &response) {
-	json_spirit::Object metrics;
-	BOOST_FOREACH(const Plugin::MetricsMessage::Response &p, response.payload()) {
-		BOOST_FOREACH(const Plugin::Common::MetricsBundle &b, p.bundles()) {
-			build_metrics(metrics, b);
-		}
-	}
-	metrics_store.set(json_spirit::write(metrics));
+	store_metrics(response);
 	get_client(get_core(), get_id())->push_metrics(response);
 
 }
\ No newline at end of file
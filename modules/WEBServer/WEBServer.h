@@ -15,6 +15,13 @@
  */
 
 #include <boost/shared_ptr.hpp>
+#include <boost/atomic.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/function.hpp>
+#include <boost/date_time/posix_time/posix_time.hpp>
+
+#include "error_handler.hpp"
 
 #include <socket/socket_helpers.hpp>
 
@@ -30,38 +37,27 @@
 #include <nscapi/nscapi_protobuf.hpp>
 #include <nscapi/plugin.hpp>
 
-struct error_handler {
-	struct status {
-		status() : error_count(0) {}
-		std::string last_error;
-		unsigned int error_count;
-	};
-	struct log_entry {
-		int line;
-		std::string type;
-		std::string file;
-		std::string message;
-		std::string date;
-	};
-	typedef std::vector<log_entry> log_list;
-	error_handler() : error_count_(0) {}
-	void add_message(bool is_error, const log_entry &message);
-	void reset();
-	status get_status();
-	log_list get_errors(std::size_t &position);
-private:
-	boost::timed_mutex mutex_;
-	log_list log_entries;
-	std::string last_error_;
-	unsigned int error_count_;
-};
-
+/**
+ * The last metrics submitted by the core (both rendered as json for the UI and as the raw message).
+ */
 struct metrics_handler {
-	void set(const std::string &metrics);
+	typedef boost::shared_ptr<const Plugin::MetricsMessage> message_type;
+	metrics_handler() : cache_time_(1000) {}
+	void set(const std::string &metrics, const message_type &message);
 	std::string get();
+	/**
+	 * Get the last metrics message, if it is older than the cache time collect is called first to refresh it.
+	 * Only one caller collects at a time, concurrent callers wait for and reuse the result.
+	 */
+	message_type get_fresh(const boost::function<void()> &collect);
+	void set_cache_time(unsigned int ms);
 private:
 	std::string metrics_;
+	message_type message_;
+	boost::posix_time::ptime updated_;
+	unsigned int cache_time_;
 	boost::timed_mutex mutex_;
+	boost::mutex collect_mutex_;
 };
 
 class WEBServer : public nscapi::impl::simple_plugin {
@@ -0,0 +1,123 @@
+/*
+ * Copyright 2004-2016 The NSClient++ Authors - https://nsclient.org
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "error_handler.hpp"
+
+#include <algorithm>
+
+#include <boost/thread/thread_time.hpp>
+#include <boost/date_time/posix_time/posix_time.hpp>
+
+error_handler::error_handler() : incoming_(4096), ring_(1000), first_(0), next_(0), cleared_(0), stopped_(false), error_count_(0) {}
+
+void error_handler::add_message(bool is_error, const log_entry &message) {
+	if (is_error)
+		error_count_++;
+	queued_entry entry(message, is_error);
+	if (!incoming_.try_push(entry)) {
+		// The queue is full (nobody is reading the log): move it into the ring ourselves.
+		boost::unique_lock<boost::mutex> lock(mutex_);
+		do {
+			drain();
+		} while (!incoming_.try_push(entry));
+	}
+	cond_.notify_all();
+}
+void error_handler::drain() {
+	queued_entry entry;
+	while (incoming_.try_pop(entry)) {
+		if (entry.is_error)
+			last_error_ = entry.entry.message;
+		std::swap(ring_[next_ % ring_.size()], entry.entry);
+		next_++;
+		if (next_ - first_ > ring_.size())
+			first_ = next_ - ring_.size();
+	}
+}
+void error_handler::reset() {
+	boost::unique_lock<boost::mutex> lock(mutex_);
+	drain();
+	// Sequence numbers keep increasing so clients polling with an old position only get new messages.
+	first_ = next_;
+	cleared_ = next_;
+	last_error_ = "";
+	error_count_ = 0;
+}
+error_handler::status error_handler::get_status() {
+	status ret;
+	boost::unique_lock<boost::mutex> lock(mutex_);
+	drain();
+	ret.error_count = error_count_;
+	ret.last_error = last_error_;
+	return ret;
+}
+error_handler::log_list error_handler::get_errors(std::size_t &position, long wait, std::size_t &missed) {
+	log_list ret;
+	missed = 0;
+	boost::unique_lock<boost::mutex> lock(mutex_);
+	drain();
+	// A position from before a restart: start over from the oldest message.
+	if (position > next_)
+		position = first_;
+	if (wait > 0 && position == next_ && !stopped_) {
+		boost::system_time deadline = boost::get_system_time() + boost::posix_time::milliseconds(wait);
+		while (position == next_ && !stopped_) {
+			// Producers notify without holding the lock so a wakeup can be missed: wait in short slices.
+			boost::system_time slice = boost::get_system_time() + boost::posix_time::milliseconds(250);
+			bool last = slice >= deadline;
+			cond_.timed_wait(lock, last ? deadline : slice);
+			drain();
+			if (last)
+				break;
+		}
+	}
+	if (position < first_) {
+		// Messages removed by a reset are not counted as missed
+		std::size_t from = (std::max)(position, cleared_);
+		if (from < first_)
+			missed = first_ - from;
+		position = first_;
+	}
+	ret.reserve(next_ - position);
+	for (; position < next_; position++)
+		ret.push_back(ring_[position % ring_.size()]);
+	return ret;
+}
+void error_handler::set_capacity(std::size_t capacity) {
+	if (capacity == 0)
+		capacity = 1;
+	boost::unique_lock<boost::mutex> lock(mutex_);
+	drain();
+	if (capacity == ring_.size())
+		return;
+	log_list ring(capacity);
+	if (next_ - first_ > capacity)
+		first_ = next_ - capacity;
+	for (std::size_t i = first_; i < next_; i++)
+		std::swap(ring[i % capacity], ring_[i % ring_.size()]);
+	ring_.swap(ring);
+}
+void error_handler::shutdown() {
+	{
+		boost::unique_lock<boost::mutex> lock(mutex_);
+		stopped_ = true;
+	}
+	cond_.notify_all();
+}
+void error_handler::startup() {
+	boost::unique_lock<boost::mutex> lock(mutex_);
+	stopped_ = false;
+}
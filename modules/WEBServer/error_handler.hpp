@@ -0,0 +1,84 @@
+/*
+ * Copyright 2004-2016 The NSClient++ Authors - https://nsclient.org
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include <boost/atomic.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
+
+#include <bounded_mpsc_queue.hpp>
+
+/**
+ * Keeps the last log messages for the web UI.
+ * Messages are added to a lock-free queue and moved into a fixed size ring when the log is read
+ * (or the queue is full). Every message gets a sequence number which clients use to fetch only
+ * the messages they have not seen.
+ */
+struct error_handler {
+	struct status {
+		status() : error_count(0) {}
+		std::string last_error;
+		unsigned int error_count;
+	};
+	struct log_entry {
+		log_entry() : line(0) {}
+		int line;
+		std::string type;
+		std::string file;
+		std::string message;
+		std::string date;
+	};
+	typedef std::vector<log_entry> log_list;
+	error_handler();
+	void add_message(bool is_error, const log_entry &message);
+	void reset();
+	status get_status();
+	/**
+	 * Get all messages from position (a sequence number) and move position past the last one.
+	 * If there are no new messages wait up to wait ms for one to arrive.
+	 * Messages which have already been dropped from the ring are counted in missed.
+	 */
+	log_list get_errors(std::size_t &position, long wait, std::size_t &missed);
+	void set_capacity(std::size_t capacity);
+	/**
+	 * Wake up all clients waiting in get_errors and stop waiting for new messages until startup is called.
+	 */
+	void shutdown();
+	void startup();
+private:
+	struct queued_entry {
+		queued_entry() : is_error(false) {}
+		queued_entry(const log_entry &entry, bool is_error) : entry(entry), is_error(is_error) {}
+		log_entry entry;
+		bool is_error;
+	};
+	void drain();
+
+	bounded_mpsc_queue<queued_entry> incoming_;
+	boost::mutex mutex_;
+	boost::condition_variable cond_;
+	log_list ring_;
+	std::size_t first_;
+	std::size_t next_;
+	std::size_t cleared_;
+	bool stopped_;
+	std::string last_error_;
+	boost::atomic<unsigned int> error_count_;
+};
@@ -0,0 +1,157 @@
+/*
+ * Copyright 2004-2016 The NSClient++ Authors - https://nsclient.org
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "error_handler.hpp"
+
+#include <boost/bind.hpp>
+#include <boost/thread.hpp>
+#include <boost/lexical_cast.hpp>
+#include <boost/date_time/posix_time/posix_time.hpp>
+
+#include <gtest/gtest.h>
+
+error_handler::log_entry make_entry(int i) {
+	error_handler::log_entry e;
+	e.line = i;
+	e.type = "info";
+	e.message = "message " + boost::lexical_cast<std::string>(i);
+	return e;
+}
+
+TEST(error_handler, sequence_numbers) {
+	error_handler log;
+	std::size_t position = 0, missed = 0;
+	EXPECT_TRUE(log.get_errors(position, 0, missed).empty());
+	EXPECT_EQ(0u, position);
+
+	for (int i = 0; i < 3; i++)
+		log.add_message(false, make_entry(i));
+	error_handler::log_list entries = log.get_errors(position, 0, missed);
+	ASSERT_EQ(3u, entries.size());
+	EXPECT_EQ("message 0", entries[0].message);
+	EXPECT_EQ("message 2", entries[2].message);
+	EXPECT_EQ(3u, position);
+	EXPECT_EQ(0u, missed);
+
+	// Only new messages are returned
+	log.add_message(true, make_entry(3));
+	entries = log.get_errors(position, 0, missed);
+	ASSERT_EQ(1u, entries.size());
+	EXPECT_EQ("message 3", entries[0].message);
+	EXPECT_EQ(4u, position);
+
+	// A position from before a restart starts over from the oldest message
+	position = 100;
+	EXPECT_EQ(4u, log.get_errors(position, 0, missed).size());
+	EXPECT_EQ(4u, position);
+}
+
+TEST(error_handler, ring_counts_missed) {
+	error_handler log;
+	log.set_capacity(5);
+	for (int i = 0; i < 12; i++)
+		log.add_message(false, make_entry(i));
+	std::size_t position = 0, missed = 0;
+	error_handler::log_list entries = log.get_errors(position, 0, missed);
+	ASSERT_EQ(5u, entries.size());
+	EXPECT_EQ("message 7", entries[0].message);
+	EXPECT_EQ("message 11", entries[4].message);
+	EXPECT_EQ(7u, missed);
+	EXPECT_EQ(12u, position);
+}
+
+TEST(error_handler, reset) {
+	error_handler log;
+	log.add_message(true, make_entry(0));
+	log.add_message(false, make_entry(1));
+	error_handler::status status = log.get_status();
+	EXPECT_EQ(1u, status.error_count);
+	EXPECT_EQ("message 0", status.last_error);
+
+	std::size_t old_position = 1, position = 0, missed = 0;
+	log.reset();
+	status = log.get_status();
+	EXPECT_EQ(0u, status.error_count);
+	EXPECT_EQ("", status.last_error);
+	EXPECT_TRUE(log.get_errors(position, 0, missed).empty());
+	// Cleared messages are not reported as missed
+	EXPECT_EQ(0u, missed);
+	EXPECT_EQ(2u, position);
+
+	log.add_message(false, make_entry(2));
+	error_handler::log_list entries = log.get_errors(old_position, 0, missed);
+	ASSERT_EQ(1u, entries.size());
+	EXPECT_EQ("message 2", entries[0].message);
+	EXPECT_EQ(0u, missed);
+}
+
+TEST(error_handler, set_capacity_keeps_newest) {
+	error_handler log;
+	log.set_capacity(10);
+	for (int i = 0; i < 8; i++)
+		log.add_message(false, make_entry(i));
+	log.set_capacity(3);
+	std::size_t position = 0, missed = 0;
+	error_handler::log_list entries = log.get_errors(position, 0, missed);
+	ASSERT_EQ(3u, entries.size());
+	EXPECT_EQ("message 5", entries[0].message);
+	EXPECT_EQ("message 7", entries[2].message);
+	EXPECT_EQ(5u, missed);
+
+	// Growing keeps what is there
+	log.set_capacity(10);
+	log.add_message(false, make_entry(8));
+	position = 0;
+	entries = log.get_errors(position, 0, missed);
+	ASSERT_EQ(4u, entries.size());
+	EXPECT_EQ("message 5", entries[0].message);
+	EXPECT_EQ("message 8", entries[3].message);
+}
+
+void wait_for_errors(error_handler *log, std::size_t *count) {
+	std::size_t position = 0, missed = 0;
+	*count = log->get_errors(position, 30000, missed).size();
+}
+
+TEST(error_handler, long_poll) {
+	error_handler log;
+	std::size_t count = 0;
+	boost::thread waiter(boost::bind(&wait_for_errors, &log, &count));
+	boost::this_thread::sleep(boost::posix_time::milliseconds(50));
+	log.add_message(false, make_entry(0));
+	ASSERT_TRUE(waiter.timed_join(boost::posix_time::seconds(5)));
+	EXPECT_EQ(1u, count);
+}
+
+TEST(error_handler, shutdown_wakes_waiters) {
+	error_handler log;
+	std::size_t count = 1;
+	boost::thread waiter(boost::bind(&wait_for_errors, &log, &count));
+	boost::this_thread::sleep(boost::posix_time::milliseconds(50));
+	boost::posix_time::ptime start = boost::posix_time::microsec_clock::universal_time();
+	log.shutdown();
+	ASSERT_TRUE(waiter.timed_join(boost::posix_time::seconds(5)));
+	EXPECT_EQ(0u, count);
+	EXPECT_GT(1000, (boost::posix_time::microsec_clock::universal_time() - start).total_milliseconds());
+
+	// Once stopped nobody waits, until the handler is started again
+	std::size_t position = 0, missed = 0;
+	start = boost::posix_time::microsec_clock::universal_time();
+	EXPECT_TRUE(log.get_errors(position, 30000, missed).empty());
+	EXPECT_GT(1000, (boost::posix_time::microsec_clock::universal_time() - start).total_milliseconds());
+	log.startup();
+	EXPECT_TRUE(log.get_errors(position, 100, missed).empty());
+}
@@ -140,7 +140,7 @@ public:
 	bool hasNotificationHandler(void);
 	bool hasMessageHandler(void);
 	NSCAPI::nagiosReturn handleCommand(const char* dataBuffer, const unsigned int dataBuffer_len, char** returnBuffer, unsigned int *returnBuffer_len);
-	NSCAPI::nagiosReturn handleCommand(const std::string request, std::string &reply);
+	NSCAPI::nagiosReturn handleCommand(const std::string &request, std::string &reply);
 	NSCAPI::nagiosReturn handle_schedule(const char* dataBuffer, const unsigned int dataBuffer_len);
 	NSCAPI::nagiosReturn handle_schedule(const std::string &request);
 	NSCAPI::nagiosReturn handleNotification(const char *channel, std::string &request, std::string &reply);
@@ -26,6 +26,7 @@
 #endif
 
 #include <boost/unordered_set.hpp>
+#include <boost/make_shared.hpp>
 #include <timer.hpp>
 #include <file_helpers.hpp>
 
@@ -145,6 +146,8 @@ NSClientT::NSClientT()
 	, metricsFetchers(log_instance_)
 	, metricsSubmitetrs(log_instance_)
 	, plugin_cache_(log_instance_)
+	, query_pool_(log_instance_)
+	, query_timeout_(60)
 	, event_subscribers_(log_instance_)
 
 {
@@ -508,6 +511,14 @@ bool NSClientT::boot_start_plugins(bool boot) {
 		smi = settings_manager::get_settings()->get_string("/settings/core", "metrics interval", "5s");
 		scheduler_.add_task(task_scheduler::schedule_metadata::METRICS, smi);
 		scheduler_.start();
+		settings_manager::get_core()->register_key(0xffff, "/settings/core", "query threads", settings::settings_core::key_integer, "Query threads", "Number of threads used to run commands for different modules in the same query concurrently (0 runs them one after the other)", "4", true, false);
+		int query_threads = settings_manager::get_settings()->get_int("/settings/core", "query threads", 4);
+		settings_manager::get_core()->register_key(0xffff, "/settings/core", "query timeout", settings::settings_core::key_string, "Query timeout", "How long to wait for all modules in a query to respond, commands which have not finished by then are reported as UNKNOWN", "60s", true, false);
+		query_timeout_ = strEx::stoui_as_time_sec(settings_manager::get_settings()->get_string("/settings/core", "query timeout", "60s"), 1);
+		settings_manager::get_core()->register_key(0xffff, "/settings/core", "query queue size", settings::settings_core::key_integer, "Query queue size", "Maximum number of commands waiting for a query thread, commands over this are rejected (reported as UNKNOWN) which happens when modules hang and keep the threads busy (0 means no limit)", "64", true, false);
+		int query_queue = settings_manager::get_settings()->get_int("/settings/core", "query queue size", 64);
+		if (query_threads > 0)
+			query_pool_.start(query_threads, query_queue > 0 ? query_queue : 0);
 	}
 	LOG_DEBUG_CORE(utf8::cvt<std::string>(APPLICATION_NAME " - " CURRENT_SERVICE_VERSION " Started!"));
 	return true;
@@ -546,6 +557,7 @@ void NSClientT::startTrayIcon(DWORD dwSessionId) {
 */
 bool NSClientT::stop_unload_plugins_pre() {
 	scheduler_.stop();
+	query_pool_.stop();
 	LOG_DEBUG_CORE("Attempting to stop all plugins");
 	try {
 		LOG_DEBUG_CORE("Stopping all plugins");
@@ -856,9 +868,65 @@ void NSClientT::registerCommand(unsigned int id, std::string cmd, std::string de
 
 struct command_chunk {
 	nsclient::commands::plugin_type plugin;
-	Plugin::QueryRequestMessage request;
+	std::list<int> payloads;
 };
 
+/**
+ * A chunk of a query dispatched to the query pool.
+ * Shared with the worker so a chunk which misses the deadline can finish (and be discarded) in the background.
+ */
+struct query_job {
+	nsclient::commands::plugin_type plugin;
+	std::list<int> payloads;
+	std::string request;
+	std::string response;
+	int ret;
+	bool done;
+	bool rejected;
+	query_job() : ret(NSCAPI::cmd_return_codes::hasFailed), done(false), rejected(false) {}
+};
+typedef boost::shared_ptr<query_job> query_job_type;
+
+struct query_batch {
+	boost::mutex mutex;
+	boost::condition_variable cond;
+	std::size_t pending;
+	query_batch(std::size_t pending) : pending(pending) {}
+
+	bool wait(boost::system_time deadline) {
+		boost::mutex::scoped_lock lock(mutex);
+		while (pending > 0) {
+			if (!cond.timed_wait(lock, deadline))
+				return pending == 0;
+		}
+		return true;
+	}
+};
+
+void run_query_job(boost::shared_ptr<query_batch> batch, query_job_type job, nsclient::core::query_pool *pool) {
+	std::string response;
+	int ret = NSCAPI::cmd_return_codes::hasFailed;
+	boost::posix_time::ptime start = boost::posix_time::microsec_clock::local_time();
+	try {
+		ret = job->plugin->handleCommand(job->request, response);
+	} catch (const NSPluginException &e) {
+		mainClient->get_logger()->error("core", __FILE__, __LINE__, "Failed to execute command: " + e.reason());
+	} catch (const std::exception &e) {
+		mainClient->get_logger()->error("core", __FILE__, __LINE__, "Failed to execute command: " + utf8::utf8_from_native(e.what()));
+	} catch (...) {
+		mainClient->get_logger()->error("core", __FILE__, __LINE__, "Failed to execute command");
+	}
+	pool->record(job->plugin->get_alias_or_name(), boost::posix_time::microsec_clock::local_time() - start);
+	{
+		boost::mutex::scoped_lock lock(batch->mutex);
+		job->response.swap(response);
+		job->ret = ret;
+		job->done = true;
+		batch->pending--;
+	}
+	batch->cond.notify_all();
+}
+
 
 ::Plugin::QueryResponseMessage NSClientT::execute_query(const ::Plugin::QueryRequestMessage &req) {
 	::Plugin::QueryResponseMessage resp;
@@ -871,13 +939,12 @@ struct command_chunk {
 /**
  * Inject a command into the plug-in stack.
  *
- * @param command Command to inject
- * @param argLen Length of argument buffer
- * @param **argument Argument buffer
- * @param *returnMessageBuffer Message buffer
- * @param returnMessageBufferLen Length of returnMessageBuffer
- * @param *returnPerfBuffer Performance data buffer
- * @param returnPerfBufferLen Length of returnPerfBuffer
+ * When all commands are handled by a single plug-in (the normal case) the request buffer is
+ * forwarded as-is and the reply from the plug-in is returned as-is. Only requests spanning
+ * several plug-ins are split and have their responses merged.
+ *
+ * @param request The serialized QueryRequestMessage
+ * @param response The serialized QueryResponseMessage
  * @return The command status
  */
 NSCAPI::nagiosReturn NSClientT::execute_query(const std::string &request, std::string &response) {
@@ -890,29 +957,29 @@ NSCAPI::nagiosReturn NSClientT::execute_query(const std::string &request, std::s
 		command_chunk_type command_chunks;
 
 		std::string missing_commands;
+		bool modified = false;
 
 		if (request_message.header().has_command()) {
 			std::string command = request_message.header().command();
 			nsclient::commands::plugin_type plugin = commands_.get(command);
 			if (plugin) {
-				unsigned int id = plugin->get_id();
-				command_chunks[id].plugin = plugin;
-				command_chunks[id].request.CopyFrom(request_message);
+				command_chunks[plugin->get_id()].plugin = plugin;
 			} else {
 				strEx::append_list(missing_commands, command);
 			}
 		} else {
 			for (int i = 0; i < request_message.payload_size(); i++) {
 				::Plugin::QueryRequestMessage::Request *payload = request_message.mutable_payload(i);
-				payload->set_command(commands_.make_key(payload->command()));
-				nsclient::commands::plugin_type plugin = commands_.get(payload->command());
+				std::string key = commands_.make_key(payload->command());
+				if (key != payload->command()) {
+					payload->set_command(key);
+					modified = true;
+				}
+				nsclient::commands::plugin_type plugin = commands_.get(key);
 				if (plugin) {
-					unsigned int id = plugin->get_id();
-					if (command_chunks.find(id) == command_chunks.end()) {
-						command_chunks[id].plugin = plugin;
-						command_chunks[id].request.mutable_header()->CopyFrom(request_message.header());
-					}
-					command_chunks[id].request.add_payload()->CopyFrom(*payload);
+					command_chunk &chunk = command_chunks[plugin->get_id()];
+					chunk.plugin = plugin;
+					chunk.payloads.push_back(i);
 				} else {
 					strEx::append_list(missing_commands, payload->command());
 				}
@@ -929,22 +996,83 @@ NSCAPI::nagiosReturn NSClientT::execute_query(const std::string &request, std::s
 			return NSCAPI::cmd_return_codes::isSuccess;
 		}
 
-		BOOST_FOREACH(command_chunk_type::value_type &v, command_chunks) {
-			std::string local_response;
-			int ret = v.second.plugin->handleCommand(v.second.request.SerializeAsString(), local_response);
+		if (command_chunks.size() == 1 && missing_commands.empty()) {
+			command_chunk &chunk = command_chunks.begin()->second;
+			int ret;
+			boost::posix_time::ptime start = boost::posix_time::microsec_clock::local_time();
+			if (modified)
+				ret = chunk.plugin->handleCommand(request_message.SerializeAsString(), response);
+			else
+				ret = chunk.plugin->handleCommand(request, response);
+			query_pool_.record(chunk.plugin->get_alias_or_name(), boost::posix_time::microsec_clock::local_time() - start);
 			if (ret != NSCAPI::cmd_return_codes::isSuccess) {
 				LOG_ERROR_CORE("Failed to execute command");
+				response = response_message.SerializeAsString();
+			}
+			return NSCAPI::cmd_return_codes::isSuccess;
+		}
+
+		// Chunks for different plugins are run concurrently on the query pool while this thread waits for them (up to the query timeout).
+		// Nested queries (issued from a pool worker) run inline as waiting for the pool from the pool can deadlock it.
+		std::vector<query_job_type> jobs;
+		BOOST_FOREACH(command_chunk_type::value_type &v, command_chunks) {
+			Plugin::QueryRequestMessage local_request;
+			local_request.mutable_header()->CopyFrom(request_message.header());
+			BOOST_FOREACH(int i, v.second.payloads) {
+				local_request.add_payload()->CopyFrom(request_message.payload(i));
+			}
+			query_job_type job = boost::make_shared<query_job>();
+			job->plugin = v.second.plugin;
+			job->payloads = v.second.payloads;
+			job->request = local_request.SerializeAsString();
+			jobs.push_back(job);
+		}
+		boost::shared_ptr<query_batch> batch = boost::make_shared<query_batch>(jobs.size());
+		boost::system_time deadline = boost::get_system_time() + boost::posix_time::seconds(query_timeout_);
+		BOOST_FOREACH(const query_job_type &job, jobs) {
+			if (!query_pool_.is_running() || query_pool_.is_pool_thread()) {
+				run_query_job(batch, job, &query_pool_);
+			} else if (!query_pool_.post(boost::bind(&run_query_job, batch, job, &query_pool_))) {
+				boost::mutex::scoped_lock lock(batch->mutex);
+				job->rejected = true;
+				job->done = true;
+				batch->pending--;
+			}
+		}
+		batch->wait(deadline);
+
+		boost::mutex::scoped_lock lock(batch->mutex);
+		BOOST_FOREACH(const query_job_type &job, jobs) {
+			if (job->rejected) {
+				LOG_DEBUG_CORE_STD("Query queue is full, rejecting commands for " + job->plugin->get_alias_or_name());
+				BOOST_FOREACH(int i, job->payloads) {
+					Plugin::QueryResponseMessage::Response *payload = response_message.add_payload();
+					payload->set_command(request_message.payload(i).command());
+					nscapi::protobuf::functions::set_response_bad(*payload, "Too many commands waiting to run, command was rejected");
+				}
+			} else if (!job->done) {
+				query_pool_.record_timeout(job->plugin->get_alias_or_name());
+				LOG_ERROR_CORE("Timeout waiting for " + job->plugin->get_alias_or_name() + " after " + strEx::s::xtos(query_timeout_) + "s");
+				BOOST_FOREACH(int i, job->payloads) {
+					Plugin::QueryResponseMessage::Response *payload = response_message.add_payload();
+					payload->set_command(request_message.payload(i).command());
+					nscapi::protobuf::functions::set_response_bad(*payload, "Command timed out after " + strEx::s::xtos(query_timeout_) + "s");
+				}
+			} else if (job->ret != NSCAPI::cmd_return_codes::isSuccess) {
+				LOG_ERROR_CORE("Failed to execute command");
 			} else {
 				Plugin::QueryResponseMessage local_response_message;
-				local_response_message.ParseFromString(local_response);
+				local_response_message.ParseFromString(job->response);
 				if (!response_message.has_header()) {
-					response_message.mutable_header()->CopyFrom(local_response_message.header());
+					response_message.mutable_header()->Swap(local_response_message.mutable_header());
 				}
 				for (int i = 0; i < local_response_message.payload_size(); i++) {
-					response_message.add_payload()->CopyFrom(local_response_message.payload(i));
+					response_message.add_payload()->Swap(local_response_message.mutable_payload(i));
 				}
 			}
 		}
+		if (!response_message.has_header() && response_message.payload_size() > 0)
+			nscapi::protobuf::functions::create_simple_header(response_message.mutable_header());
 		response = response_message.SerializeAsString();
 	} catch (const std::exception &e) {
 		LOG_ERROR_CORE("Failed to process command: " + utf8::utf8_from_native(e.what()));
@@ -1719,6 +1847,9 @@ struct metrics_fetcher {
 
 void NSClientT::ownMetricsFetcher(Plugin::MetricsMessage::Response *response) {
 	Plugin::Common::MetricsBundle *bundle = response->add_bundles();
+	bundle->set_key("queries");
+	query_pool_.fetch_metrics(bundle);
+	bundle = response->add_bundles();
 	bundle->set_key("workers");
 	if (scheduler_.get_scheduler().has_metrics()) {
 		boost::uint64_t taskes__ = scheduler_.get_scheduler().get_metric_executed();
@@ -1738,18 +1869,64 @@ void NSClientT::ownMetricsFetcher(Plugin::MetricsMessage::Response *response) {
 		m = bundle->add_value();
 		m->set_key("threads");
 		m->mutable_value()->set_int_data(threads);
+		BOOST_FOREACH(const simple_scheduler::scheduler::histogram_type::value_type &v, scheduler_.get_scheduler().get_metric_lateness()) {
+			m = bundle->add_value();
+			m->set_key(v.first);
+			m->mutable_value()->set_int_data(v.second);
+		}
+		BOOST_FOREACH(const simple_scheduler::scheduler::histogram_type::value_type &v, scheduler_.get_scheduler().get_metric_starts()) {
+			m = bundle->add_value();
+			m->set_key(v.first);
+			m->mutable_value()->set_int_data(v.second);
+		}
 	} else {
 		Plugin::Common::Metric *m = bundle->add_value();
 		m->set_key("metrics.available");
 		m->mutable_value()->set_string_data("false");
 	}
+	bundle = response->add_bundles();
+	bundle->set_key("log");
+	typedef std::map<std::string, long long> log_metrics_type;
+	log_metrics_type log_metrics;
+	log_instance_->fetch_metrics(log_metrics);
+	BOOST_FOREACH(const log_metrics_type::value_type &v, log_metrics) {
+		Plugin::Common::Metric *m = bundle->add_value();
+		m->set_key(v.first);
+		m->mutable_value()->set_int_data(v.second);
+	}
 }
-void NSClientT::process_metrics() {
+bool NSClientT::fetch_metrics(std::string &buffer) {
+	// Metrics are fetched both from the scheduler and on demand (by the WEB server)
+	boost::unique_lock<boost::timed_mutex> lock(metrics_mutex_, boost::get_system_time() + boost::posix_time::seconds(5));
+	if (!lock.owns_lock()) {
+		LOG_ERROR_CORE("Failed to get metrics mutex");
+		return false;
+	}
 	metrics_fetcher f;
 
 	metricsFetchers.do_all(boost::bind(&metrics_fetcher::fetch, &f, _1));
 	ownMetricsFetcher(f.get_root());
 	f.render();
+	buffer = f.buffer;
+	return true;
+}
+NSCAPI::errorReturn NSClientT::fetch_metrics(char **response_buffer, unsigned int *response_buffer_len) {
+	std::string buffer;
+	if (!fetch_metrics(buffer))
+		return NSCAPI::api_return_codes::hasFailed;
+	*response_buffer_len = static_cast<unsigned int>(buffer.size());
+	if (buffer.empty())
+		*response_buffer = NULL;
+	else {
+		*response_buffer = new char[*response_buffer_len + 10];
+		memcpy(*response_buffer, buffer.c_str(), *response_buffer_len);
+	}
+	return NSCAPI::api_return_codes::isSuccess;
+}
+void NSClientT::process_metrics() {
+	metrics_fetcher f;
+	if (!fetch_metrics(f.buffer))
+		return;
 	metricsSubmitetrs.do_all(boost::bind(&metrics_fetcher::digest, &f, _1));
 }
 
@@ -27,6 +27,7 @@
 #include <nsclient/logger/logger.hpp>
 #include "scheduler_handler.hpp"
 #include "plugin_cache.hpp"
+#include "query_pool.hpp"
 
 #include <nscapi/nscapi_protobuf.hpp>
 
@@ -84,7 +85,10 @@ private:
 	nsclient::routers routers_;
 	nsclient::simple_plugins_list metricsFetchers;
 	nsclient::simple_plugins_list metricsSubmitetrs;
+	boost::timed_mutex metrics_mutex_;
 	nsclient::core::plugin_cache plugin_cache_;
+	nsclient::core::query_pool query_pool_;
+	unsigned int query_timeout_;
 
 	task_scheduler::scheduler scheduler_;
 
@@ -206,6 +210,8 @@ public:
 	std::string expand_path(std::string file);
 
 	void process_metrics();
+	NSCAPI::errorReturn fetch_metrics(char **response_buffer, unsigned int *response_buffer_len);
+	bool fetch_metrics(std::string &buffer);
 
 	typedef boost::function<int(plugin_type)> run_function;
 	int load_and_run(std::string module, run_function fun, std::list<std::string> &errors);
@@ -0,0 +1,112 @@
+/*
+ * Copyright 2004-2016 The NSClient++ Authors - https://nsclient.org
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <bounded_mpsc_queue.hpp>
+
+#include <vector>
+
+#include <boost/bind.hpp>
+#include <boost/thread.hpp>
+
+#include <gtest/gtest.h>
+
+TEST(bounded_mpsc_queue, empty) {
+	bounded_mpsc_queue<int> queue(4);
+	int value = -1;
+	EXPECT_TRUE(queue.empty());
+	EXPECT_FALSE(queue.try_pop(value));
+	EXPECT_EQ(-1, value);
+	std::vector<int> target;
+	EXPECT_EQ(0u, queue.drain(target, 10));
+	EXPECT_TRUE(target.empty());
+
+	EXPECT_TRUE(queue.try_push(1));
+	EXPECT_FALSE(queue.empty());
+	EXPECT_TRUE(queue.try_pop(value));
+	EXPECT_EQ(1, value);
+	EXPECT_TRUE(queue.empty());
+	EXPECT_FALSE(queue.try_pop(value));
+}
+
+TEST(bounded_mpsc_queue, full) {
+	bounded_mpsc_queue<int> queue(3);
+	// The capacity is rounded up to a power of two
+	EXPECT_EQ(4u, queue.capacity());
+	for (int i = 0; i < 4; i++)
+		EXPECT_TRUE(queue.try_push(i));
+	EXPECT_EQ(4u, queue.size());
+	EXPECT_FALSE(queue.try_push(4));
+
+	int value = -1;
+	EXPECT_TRUE(queue.try_pop(value));
+	EXPECT_EQ(0, value);
+	EXPECT_TRUE(queue.try_push(4));
+	EXPECT_FALSE(queue.try_push(5));
+
+	// Wraps around the ring several times without losing or reordering items
+	std::vector<int> target;
+	for (int i = 5; i < 50; i++) {
+		EXPECT_EQ(1u, queue.drain(target, 1));
+		EXPECT_TRUE(queue.try_push(i));
+	}
+	EXPECT_EQ(4u, queue.drain(target, 10));
+	ASSERT_EQ(49u, target.size());
+	for (std::size_t i = 0; i < target.size(); i++)
+		EXPECT_EQ(static_cast<int>(i + 1), target[i]);
+}
+
+namespace {
+	const int producers = 4;
+	const int items_per_producer = 20000;
+
+	void produce(bounded_mpsc_queue<int> *queue, int producer) {
+		for (int i = 0; i < items_per_producer; i++) {
+			while (!queue->try_push(producer * items_per_producer + i))
+				boost::this_thread::yield();
+		}
+	}
+}
+
+TEST(bounded_mpsc_queue, multi_producer_ordering) {
+	bounded_mpsc_queue<int> queue(64);
+	boost::thread_group threads;
+	for (int p = 0; p < producers; p++)
+		threads.create_thread(boost::bind(&produce, &queue, p));
+
+	// Items from different producers interleave, but each producer's items arrive in order
+	std::vector<int> next(producers, 0);
+	std::vector<int> batch;
+	int received = 0;
+	while (received < producers * items_per_producer) {
+		batch.clear();
+		if (queue.drain(batch, 16) == 0) {
+			boost::this_thread::yield();
+			continue;
+		}
+		for (std::size_t i = 0; i < batch.size(); i++) {
+			int producer = batch[i] / items_per_producer;
+			ASSERT_LE(0, producer);
+			ASSERT_GT(producers, producer);
+			ASSERT_EQ(next[producer], batch[i] % items_per_producer);
+			next[producer]++;
+		}
+		received += static_cast<int>(batch.size());
+	}
+	threads.join_all();
+	for (int p = 0; p < producers; p++)
+		EXPECT_EQ(items_per_producer, next[p]);
+	EXPECT_TRUE(queue.empty());
+}
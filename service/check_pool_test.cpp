@@ -0,0 +1,181 @@
+/*
+ * Copyright 2004-2016 The NSClient++ Authors - https://nsclient.org
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <nrpe/server/check_pool.hpp>
+
+#include <boost/bind.hpp>
+#include <boost/thread.hpp>
+
+#include <gtest/gtest.h>
+
+// Blocks jobs until the test opens it so the pool state can be inspected while they run.
+struct gate {
+	boost::mutex mutex;
+	boost::condition_variable cond;
+	bool is_open;
+	int ran;
+	gate() : is_open(false), ran(0) {}
+
+	void job() {
+		boost::unique_lock<boost::mutex> lock(mutex);
+		ran++;
+		while (!is_open)
+			cond.wait(lock);
+	}
+	void open() {
+		{
+			boost::unique_lock<boost::mutex> lock(mutex);
+			is_open = true;
+		}
+		cond.notify_all();
+	}
+	int get_ran() {
+		boost::unique_lock<boost::mutex> lock(mutex);
+		return ran;
+	}
+};
+
+void wait_for_active(const nrpe::server::check_pool &pool, std::size_t active) {
+	for (int i = 0; i < 500 && pool.get_metrics().active != active; i++)
+		boost::this_thread::sleep(boost::posix_time::milliseconds(10));
+}
+
+void wait_for_queue(const nrpe::server::check_pool &pool, std::size_t depth) {
+	for (int i = 0; i < 500 && pool.get_metrics().queue_depth != depth; i++)
+		boost::this_thread::sleep(boost::posix_time::milliseconds(10));
+}
+
+void wait_for_executed(const nrpe::server::check_pool &pool, boost::uint64_t executed) {
+	for (int i = 0; i < 500 && pool.get_metrics().executed != executed; i++)
+		boost::this_thread::sleep(boost::posix_time::milliseconds(10));
+}
+
+TEST(check_pool, queue_limit) {
+	gate g;
+	nrpe::server::check_pool pool;
+	pool.start(1, 2, 0);
+	EXPECT_EQ(nrpe::server::check_pool::accepted, pool.submit("a", boost::bind(&gate::job, &g)));
+	wait_for_active(pool, 1);
+	EXPECT_EQ(nrpe::server::check_pool::accepted, pool.submit("b", boost::bind(&gate::job, &g)));
+	EXPECT_EQ(nrpe::server::check_pool::accepted, pool.submit("c", boost::bind(&gate::job, &g)));
+	EXPECT_EQ(nrpe::server::check_pool::queue_full, pool.submit("d", boost::bind(&gate::job, &g)));
+
+	nrpe::server::check_pool::metrics m = pool.get_metrics();
+	EXPECT_EQ(2u, m.queue_depth);
+	EXPECT_EQ(1u, m.active);
+	EXPECT_EQ(1u, m.rejected);
+
+	g.open();
+	wait_for_executed(pool, 3);
+	m = pool.get_metrics();
+	EXPECT_EQ(0u, m.queue_depth);
+	EXPECT_EQ(0u, m.active);
+	EXPECT_EQ(3u, m.executed);
+	EXPECT_EQ(3, g.get_ran());
+	pool.stop();
+}
+
+TEST(check_pool, unlimited_queue) {
+	gate g;
+	nrpe::server::check_pool pool;
+	pool.start(1, 0, 0);
+	EXPECT_EQ(nrpe::server::check_pool::accepted, pool.submit("a", boost::bind(&gate::job, &g)));
+	wait_for_active(pool, 1);
+	for (int i = 0; i < 100; i++)
+		EXPECT_EQ(nrpe::server::check_pool::accepted, pool.submit("a", boost::bind(&gate::job, &g)));
+	EXPECT_EQ(100u, pool.get_metrics().queue_depth);
+	EXPECT_EQ(0u, pool.get_metrics().rejected);
+
+	g.open();
+	wait_for_executed(pool, 101);
+	EXPECT_EQ(101u, pool.get_metrics().executed);
+	pool.stop();
+}
+
+TEST(check_pool, client_limit) {
+	gate g;
+	nrpe::server::check_pool pool;
+	pool.start(1, 10, 2);
+	EXPECT_EQ(nrpe::server::check_pool::accepted, pool.submit("a", boost::bind(&gate::job, &g)));
+	wait_for_active(pool, 1);
+	EXPECT_EQ(nrpe::server::check_pool::accepted, pool.submit("a", boost::bind(&gate::job, &g)));
+	// Running jobs count towards the limit as well as queued ones
+	EXPECT_EQ(nrpe::server::check_pool::client_limit, pool.submit("a", boost::bind(&gate::job, &g)));
+	EXPECT_EQ(nrpe::server::check_pool::accepted, pool.submit("b", boost::bind(&gate::job, &g)));
+	EXPECT_EQ(1u, pool.get_metrics().rejected);
+
+	g.open();
+	wait_for_executed(pool, 3);
+	// Once the jobs have finished the client can submit again
+	EXPECT_EQ(nrpe::server::check_pool::accepted, pool.submit("a", boost::bind(&gate::job, &g)));
+	wait_for_executed(pool, 4);
+	EXPECT_EQ(4u, pool.get_metrics().executed);
+	pool.stop();
+}
+
+void open_when_dropped(const nrpe::server::check_pool &pool, gate &g) {
+	wait_for_queue(pool, 0);
+	g.open();
+}
+
+void count_dropped(boost::mutex &mutex, int &dropped) {
+	boost::unique_lock<boost::mutex> lock(mutex);
+	dropped++;
+}
+
+TEST(check_pool, stop_drops_queued_jobs) {
+	gate g;
+	boost::mutex mutex;
+	int dropped = 0;
+	nrpe::server::check_pool::job_type on_dropped = boost::bind(&count_dropped, boost::ref(mutex), boost::ref(dropped));
+	nrpe::server::check_pool pool;
+	pool.start(1, 10, 0);
+	EXPECT_EQ(nrpe::server::check_pool::accepted, pool.submit("a", boost::bind(&gate::job, &g), on_dropped));
+	wait_for_active(pool, 1);
+	EXPECT_EQ(nrpe::server::check_pool::accepted, pool.submit("a", boost::bind(&gate::job, &g), on_dropped));
+	EXPECT_EQ(nrpe::server::check_pool::accepted, pool.submit("a", boost::bind(&gate::job, &g), on_dropped));
+
+	// stop() waits for the running job, so open the gate from another thread once the queue has been dropped
+	boost::thread opener(boost::bind(&open_when_dropped, boost::ref(pool), boost::ref(g)));
+	pool.stop();
+	opener.join();
+
+	EXPECT_EQ(1, g.get_ran());
+	// The queued jobs are answered through their dropped handler, the running one is not
+	EXPECT_EQ(2, dropped);
+	nrpe::server::check_pool::metrics m = pool.get_metrics();
+	EXPECT_EQ(0u, m.queue_depth);
+	EXPECT_EQ(1u, m.executed);
+	EXPECT_EQ(nrpe::server::check_pool::stopped, pool.submit("a", boost::bind(&gate::job, &g)));
+}
+
+TEST(check_pool, metrics_are_cumulative) {
+	gate g;
+	g.open();
+	nrpe::server::check_pool pool;
+	pool.start(2, 10, 0);
+	for (int i = 0; i < 5; i++)
+		EXPECT_EQ(nrpe::server::check_pool::accepted, pool.submit("a", boost::bind(&gate::job, &g)));
+	wait_for_executed(pool, 5);
+	nrpe::server::check_pool::metrics first = pool.get_metrics();
+	nrpe::server::check_pool::metrics second = pool.get_metrics();
+	EXPECT_EQ(5u, first.executed);
+	EXPECT_EQ(first.executed, second.executed);
+	EXPECT_EQ(first.wait_total_ms, second.wait_total_ms);
+	EXPECT_EQ(first.wait_avg_ms, second.wait_avg_ms);
+	EXPECT_EQ(first.wait_max_ms, second.wait_max_ms);
+	pool.stop();
+}
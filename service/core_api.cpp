@@ -132,6 +132,10 @@ NSCAPI::errorReturn NSAPIRegistryQuery(const char *request_buffer, const unsigne
 	return mainClient->registry_query(request_buffer, request_buffer_len, response_buffer, response_buffer_len);
 }
 
+NSCAPI::errorReturn NSAPIFetchMetrics(char **response_buffer, unsigned int *response_buffer_len) {
+	return mainClient->fetch_metrics(response_buffer, response_buffer_len);
+}
+
 wchar_t* copyString(const std::wstring &str) {
 	std::size_t sz = str.size();
 	wchar_t *tc = new wchar_t[sz + 2];
@@ -172,6 +176,8 @@ nscapi::core_api::FUNPTR NSAPILoader(const char* buffer) {
 		return reinterpret_cast<nscapi::core_api::FUNPTR>(&NSAPISettingsQuery);
 	if (strcmp(buffer, "NSAPIRegistryQuery") == 0)
 		return reinterpret_cast<nscapi::core_api::FUNPTR>(&NSAPIRegistryQuery);
+	if (strcmp(buffer, "NSAPIFetchMetrics") == 0)
+		return reinterpret_cast<nscapi::core_api::FUNPTR>(&NSAPIFetchMetrics);
 	if (strcmp(buffer, "NSCAPIJson2Protobuf") == 0)
 		return reinterpret_cast<nscapi::core_api::FUNPTR>(&NSCAPIJson2Protobuf);
 	if (strcmp(buffer, "NSCAPIProtobuf2Json") == 0)
@@ -39,6 +39,7 @@ NSCAPI::errorReturn NSAPIReload(const char *);
 NSCAPI::log_level::level NSAPIGetLoglevel();
 NSCAPI::errorReturn NSAPISettingsQuery(const char *request_buffer, const unsigned int request_buffer_len, char **response_buffer, unsigned int *response_buffer_len);
 NSCAPI::errorReturn NSAPIRegistryQuery(const char *request_buffer, const unsigned int request_buffer_len, char **response_buffer, unsigned int *response_buffer_len);
+NSCAPI::errorReturn NSAPIFetchMetrics(char **response_buffer, unsigned int *response_buffer_len);
 #ifdef HAVE_JSON_SPIRIT
 NSCAPI::errorReturn NSCAPIJson2Protobuf(const char* request_buffer, unsigned int request_buffer_len, char ** response_buffer, unsigned int *response_buffer_len);
 NSCAPI::errorReturn NSCAPIProtobuf2Json(const char* object, const char* request_buffer, unsigned int request_buffer_len, char ** response_buffer, unsigned int *response_buffer_len);
@@ -0,0 +1,83 @@
+/*
+ * Copyright 2004-2016 The NSClient++ Authors - https://nsclient.org
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <vector>
+#include <iostream>
+#include <cstdlib>
+#include <utils.h>
+
+#include <boost/date_time/posix_time/posix_time.hpp>
+#include <boost/lexical_cast.hpp>
+
+unsigned long bytewise_crc32(const unsigned char *buffer, int buffer_size) {
+	static unsigned long table[256];
+	static bool has_table = false;
+	if (!has_table) {
+		for (unsigned long i = 0; i < 256; i++) {
+			unsigned long crc = i;
+			for (int j = 8; j > 0; j--)
+				crc = (crc & 1) ? (crc >> 1) ^ 0xEDB88320L : crc >> 1;
+			table[i] = crc;
+		}
+		has_table = true;
+	}
+	unsigned long crc = 0xFFFFFFFF;
+	for (int i = 0; i < buffer_size; i++)
+		crc = ((crc >> 8) & 0x00FFFFFF) ^ table[(crc ^ buffer[i]) & 0xFF];
+	return crc ^ 0xFFFFFFFF;
+}
+
+typedef unsigned long(*crc_function)(const unsigned char *buffer, int buffer_size);
+
+unsigned long dispatched_crc32(const unsigned char *buffer, int buffer_size) {
+	return calculate_crc32(buffer, buffer_size);
+}
+
+void run(const std::string &name, crc_function fun, const std::vector<unsigned char> &buffer, int size, int iterations) {
+	unsigned long sum = 0;
+	boost::posix_time::ptime start = boost::posix_time::microsec_clock::local_time();
+	for (int i = 0; i < iterations; i++)
+		sum += fun(&buffer[0], size);
+	boost::posix_time::time_duration elapsed = boost::posix_time::microsec_clock::local_time() - start;
+	double seconds = elapsed.total_microseconds() / 1000000.0;
+	double mb = static_cast<double>(size) * iterations / (1024.0 * 1024.0);
+	std::cout << name << " " << size << " bytes: " << elapsed.total_milliseconds() << "ms";
+	if (seconds > 0)
+		std::cout << " (" << static_cast<long long>(mb / seconds) << " MB/s)";
+	std::cout << " [" << sum << "]" << std::endl;
+}
+
+/**
+ * Compares the crc32 implementations on NRPE sized packets: crc32_bench [iterations]
+ */
+int main(int argc, char *argv[]) {
+	int iterations = 200000;
+	if (argc > 1)
+		iterations = boost::lexical_cast<int>(argv[1]);
+	std::cout << "PCLMUL: " << (crc32_has_pclmul() ? "yes" : "no") << std::endl;
+	int sizes[] = { 1036, 4106, 65546 };
+	for (std::size_t i = 0; i < sizeof(sizes) / sizeof(int); i++) {
+		int size = sizes[i];
+		std::vector<unsigned char> buffer(size);
+		for (int j = 0; j < size; j++)
+			buffer[j] = static_cast<unsigned char>(std::rand() & 0xFF);
+		int n = static_cast<int>(static_cast<long long>(iterations) * 1036 / size);
+		run("bytewise  ", &bytewise_crc32, buffer, size, n);
+		run("slice-by-8", &calculate_crc32_slice8, buffer, size, n);
+		run("dispatched", &dispatched_crc32, buffer, size, n);
+	}
+	return 0;
+}
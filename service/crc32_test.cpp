@@ -0,0 +1,85 @@
+/*
+ * Copyright 2004-2016 The NSClient++ Authors - https://nsclient.org
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <vector>
+#include <cstdlib>
+#include <utils.h>
+
+#include <gtest/gtest.h>
+
+// The original byte at a time implementation.
+unsigned long reference_crc32(const unsigned char *buffer, int buffer_size) {
+	unsigned long table[256];
+	for (unsigned long i = 0; i < 256; i++) {
+		unsigned long crc = i;
+		for (int j = 8; j > 0; j--) {
+			if (crc & 1)
+				crc = (crc >> 1) ^ 0xEDB88320L;
+			else
+				crc >>= 1;
+		}
+		table[i] = crc;
+	}
+	unsigned long crc = 0xFFFFFFFF;
+	for (int i = 0; i < buffer_size; i++)
+		crc = ((crc >> 8) & 0x00FFFFFF) ^ table[(crc ^ buffer[i]) & 0xFF];
+	return crc ^ 0xFFFFFFFF;
+}
+
+std::vector<unsigned char> random_buffer(std::size_t size) {
+	std::vector<unsigned char> ret(size + 1);
+	for (std::size_t i = 0; i < ret.size(); i++)
+		ret[i] = static_cast<unsigned char>(std::rand() & 0xFF);
+	return ret;
+}
+
+TEST(crc32, known_values) {
+	EXPECT_EQ(0, calculate_crc32("", 0));
+	EXPECT_EQ(0xCBF43926, calculate_crc32("123456789", 9));
+	EXPECT_EQ(0x414FA339, calculate_crc32("The quick brown fox jumps over the lazy dog", 43));
+}
+
+TEST(crc32, matches_reference) {
+	std::srand(42);
+	for (int size = 0; size < 1200; size++) {
+		std::vector<unsigned char> buffer = random_buffer(size);
+		// Use an unaligned start as well as the aligned one.
+		for (int offset = 0; offset < 2; offset++) {
+			unsigned long expected = reference_crc32(&buffer[offset], size);
+			EXPECT_EQ(expected, calculate_crc32(&buffer[offset], size)) << "size: " << size << ", offset: " << offset;
+			EXPECT_EQ(expected, calculate_crc32_slice8(&buffer[offset], size)) << "size: " << size << ", offset: " << offset;
+			EXPECT_EQ(expected, calculate_crc32(reinterpret_cast<const char*>(&buffer[offset]), size));
+		}
+	}
+}
+
+TEST(crc32, incremental) {
+	std::srand(17);
+	std::vector<unsigned char> buffer = random_buffer(1036);
+	unsigned long crc = update_crc32(0, &buffer[0], 4);
+	crc = update_crc32(crc, &buffer[4], 500);
+	crc = update_crc32(crc, &buffer[504], 532);
+	EXPECT_EQ(reference_crc32(&buffer[0], 1036), crc);
+}
+
+TEST(crc32, nrpe_packet_sizes) {
+	std::srand(4711);
+	int sizes[] = { 1036, 1034, 4106, 65546 };
+	for (std::size_t i = 0; i < sizeof(sizes) / sizeof(int); i++) {
+		std::vector<unsigned char> buffer = random_buffer(sizes[i]);
+		EXPECT_EQ(reference_crc32(&buffer[0], sizes[i]), calculate_crc32(&buffer[0], sizes[i]));
+	}
+}
@@ -0,0 +1,196 @@
+/*
+ * Copyright 2004-2016 The NSClient++ Authors - https://nsclient.org
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <sstream>
+
+#include <nscapi/nscapi_protobuf.hpp>
+#include <strEx.h>
+
+/**
+ * The original substr/stringstream based performance data parser and writer.
+ * Kept as a reference for the fuzz test and the benchmark of nscapi::protobuf::functions.
+ */
+namespace legacy_performance_data {
+	inline double trim_to_double(std::string s) {
+		std::string::size_type pend = s.find_first_not_of("0123456789,.-");
+		if (pend != std::string::npos)
+			s = s.substr(0, pend);
+		strEx::s::replace(s, ",", ".");
+		if (s.empty()) {
+			return 0.0;
+		}
+		try {
+			return strEx::stod(s);
+		} catch (...) {
+			return 0.0;
+		}
+	}
+
+	inline void parse_performance_data(Plugin::QueryResponseMessage::Response::Line *payload, const std::string &perff) {
+		std::string perf = perff;
+		// TODO: make this work with const!
+
+		const std::string perf_separator = " ";
+		const std::string perf_lable_enclosure = "'";
+		const std::string perf_equal_sign = "=";
+		const std::string perf_item_splitter = ";";
+		const std::string perf_valid_number = "0123456789,.-";
+
+		while (true) {
+			if (perf.size() == 0)
+				return;
+			std::string::size_type p = 0;
+			p = perf.find_first_not_of(perf_separator, p);
+			if (p != 0)
+				perf = perf.substr(p);
+			if (perf[0] == perf_lable_enclosure[0]) {
+				p = perf.find(perf_lable_enclosure[0], 1) + 1;
+				if (p == std::string::npos)
+					return;
+			}
+			p = perf.find(perf_separator, p);
+			if (p == 0)
+				return;
+			std::string chunk;
+			if (p == std::string::npos) {
+				chunk = perf;
+				perf = std::string();
+			} else {
+				chunk = perf.substr(0, p);
+				p = perf.find_first_not_of(perf_separator, p);
+				if (p == std::string::npos)
+					perf = std::string();
+				else
+					perf = perf.substr(p);
+			}
+			std::vector<std::string> items;
+			strEx::split(items, chunk, perf_item_splitter);
+			if (items.size() < 1) {
+				Plugin::Common::PerformanceData* perfData = payload->add_perf();
+				std::pair<std::string, std::string> fitem = strEx::split("", perf_equal_sign);
+				perfData->set_alias("invalid");
+				Plugin::Common_PerformanceData_StringValue* stringPerfData = perfData->mutable_string_value();
+				stringPerfData->set_value("invalid performance data");
+				break;
+			}
+
+			std::pair<std::string, std::string> fitem = strEx::split(items[0], perf_equal_sign);
+			std::string alias = fitem.first;
+			if (alias.size() > 0 && alias[0] == perf_lable_enclosure[0] && alias[alias.size() - 1] == perf_lable_enclosure[0])
+				alias = alias.substr(1, alias.size() - 2);
+
+			if (alias.empty())
+				continue;
+			Plugin::Common::PerformanceData* perfData = payload->add_perf();
+			perfData->set_alias(alias);
+			Plugin::Common_PerformanceData_FloatValue* floatPerfData = perfData->mutable_float_value();
+
+			std::string::size_type pstart = fitem.second.find_first_of(perf_valid_number);
+			if (pstart == std::string::npos) {
+				floatPerfData->set_value(0);
+				continue;
+			}
+			if (pstart != 0)
+				fitem.second = fitem.second.substr(pstart);
+			std::string::size_type pend = fitem.second.find_first_not_of(perf_valid_number);
+			if (pend == std::string::npos) {
+				floatPerfData->set_value(trim_to_double(fitem.second));
+			} else {
+				floatPerfData->set_value(trim_to_double(fitem.second.substr(0, pend)));
+				floatPerfData->set_unit(fitem.second.substr(pend));
+			}
+			if (items.size() >= 2 && items[1].size() > 0)
+				floatPerfData->set_warning(trim_to_double(items[1]));
+			if (items.size() >= 3 && items[2].size() > 0)
+				floatPerfData->set_critical(trim_to_double(items[2]));
+			if (items.size() >= 4 && items[3].size() > 0)
+				floatPerfData->set_minimum(trim_to_double(items[3]));
+			if (items.size() >= 5 && items[4].size() > 0)
+				floatPerfData->set_maximum(trim_to_double(items[4]));
+		}
+	}
+
+	inline std::string build_performance_data(Plugin::QueryResponseMessage::Response::Line const &payload) {
+		std::stringstream ss;
+		ss.precision(5);
+
+		bool first = true;
+		for (int i = 0; i < payload.perf_size(); i++) {
+			Plugin::Common::PerformanceData perfData = payload.perf(i);
+			if (!first)
+				ss << " ";
+			first = false;
+			ss << '\'' << perfData.alias() << "'=";
+			if (perfData.has_float_value()) {
+				Plugin::Common_PerformanceData_FloatValue fval = perfData.float_value();
+
+				ss << strEx::s::xtos_non_sci(fval.value());
+				if (fval.has_unit())
+					ss << fval.unit();
+				if (!fval.has_warning() && !fval.has_critical() && !fval.has_minimum() && !fval.has_maximum())
+					continue;
+				ss << ";";
+				if (fval.has_warning())
+					ss << strEx::s::xtos_non_sci(fval.warning());
+				if (!fval.has_critical() && !fval.has_minimum() && !fval.has_maximum())
+					continue;
+				ss << ";";
+				if (fval.has_critical())
+					ss << strEx::s::xtos_non_sci(fval.critical());
+				if (!fval.has_minimum() && !fval.has_maximum())
+					continue;
+				ss << ";";
+				if (fval.has_minimum())
+					ss << strEx::s::xtos_non_sci(fval.minimum());
+				if (!fval.has_maximum())
+					continue;
+				ss << ";";
+				if (fval.has_maximum())
+					ss << strEx::s::xtos_non_sci(fval.maximum());
+			} else if (perfData.has_int_value()) {
+				Plugin::Common_PerformanceData_IntValue fval = perfData.int_value();
+				ss << fval.value();
+				if (fval.has_unit())
+					ss << fval.unit();
+				if (!fval.has_warning() && !fval.has_critical() && !fval.has_minimum() && !fval.has_maximum())
+					continue;
+				ss << ";";
+				if (fval.has_warning())
+					ss << fval.warning();
+				if (!fval.has_critical() && !fval.has_minimum() && !fval.has_maximum())
+					continue;
+				ss << ";";
+				if (fval.has_critical())
+					ss << fval.critical();
+				if (!fval.has_minimum() && !fval.has_maximum())
+					continue;
+				ss << ";";
+				if (fval.has_minimum())
+					ss << fval.minimum();
+				if (!fval.has_maximum())
+					continue;
+				ss << ";";
+				if (fval.has_maximum())
+					ss << fval.maximum();
+			}
+		}
+		return ss.str();
+	}
+}
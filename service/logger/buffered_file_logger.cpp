@@ -0,0 +1,243 @@
+/*
+ * Copyright 2004-2016 The NSClient++ Authors - https://nsclient.org
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "config.h"
+
+#include "buffered_file_logger.hpp"
+
+#include <nscapi/nscapi_protobuf.hpp>
+#include <nscapi/nscapi_settings_helper.hpp>
+#include <file_helpers.hpp>
+#include <format.hpp>
+
+#include <boost/filesystem.hpp>
+#include <boost/lexical_cast.hpp>
+#include <boost/bind.hpp>
+
+namespace nsclient {
+	namespace logging {
+		namespace impl {
+
+			namespace sh = nscapi::settings_helper;
+
+			buffered_file_logger::buffered_file_logger(std::string file)
+				: format_("%Y-%m-%d %H:%M:%S")
+				, max_size_(0)
+				, backups_(3)
+				, buffer_size_(64 * 1024)
+				, flush_interval_(boost::posix_time::seconds(1))
+				, current_size_(0)
+				, last_flush_(boost::posix_time::microsec_clock::universal_time())
+				, date_time_(0)
+			{
+				file_ = file_logger_helper::base_path() + file;
+			}
+			buffered_file_logger::~buffered_file_logger() {
+				try {
+					boost::mutex::scoped_lock lock(mutex_);
+					flush_unlocked();
+					close_unlocked();
+				} catch (...) {}
+			}
+
+			const std::string& buffered_file_logger::get_date() {
+				// The date has second resolution so it only has to be rendered once per second.
+				std::time_t now = std::time(NULL);
+				if (now != date_time_) {
+					date_ = nsclient::logging::logger_helper::get_formated_date(format_);
+					date_time_ = now;
+				}
+				return date_;
+			}
+
+			void buffered_file_logger::do_log(const std::string data) {
+				try {
+					Plugin::LogEntry message;
+					if (!message.ParseFromString(data)) {
+						logger_helper::log_fatal("Failed to parse message: " + format::strip_ctrl_chars(data));
+						return;
+					}
+					boost::mutex::scoped_lock lock(mutex_);
+					if (file_.empty())
+						return;
+					const std::string &date = get_date();
+					for (int i = 0; i < message.entry_size(); i++) {
+						const Plugin::LogEntry::Entry &msg = message.entry(i);
+						buffer_.append(date);
+						buffer_.append(": ");
+						buffer_.append(logger_helper::render_log_level_long(msg.level()));
+						buffer_.append(":");
+						buffer_.append(msg.file());
+						buffer_.append(":");
+						buffer_.append(boost::lexical_cast<std::string>(msg.line()));
+						buffer_.append(": ");
+						buffer_.append(msg.message());
+						buffer_.append("\n");
+					}
+					if (buffer_.size() >= buffer_size_ || boost::posix_time::microsec_clock::universal_time() - last_flush_ >= flush_interval_)
+						flush_unlocked();
+				} catch (std::exception &e) {
+					logger_helper::log_fatal("Failed to parse data from: " + format::strip_ctrl_chars(data) + ": " + e.what());
+				} catch (...) {
+					logger_helper::log_fatal("Failed to parse data from: " + format::strip_ctrl_chars(data));
+				}
+			}
+
+			void buffered_file_logger::flush() {
+				try {
+					boost::mutex::scoped_lock lock(mutex_);
+					flush_unlocked();
+				} catch (std::exception &e) {
+					logger_helper::log_fatal(std::string("Failed to write log file: ") + e.what());
+				} catch (...) {
+					logger_helper::log_fatal("Failed to write log file");
+				}
+			}
+
+			void buffered_file_logger::flush_unlocked() {
+				last_flush_ = boost::posix_time::microsec_clock::universal_time();
+				if (buffer_.empty() || file_.empty())
+					return;
+				if (!stream_.is_open() && !open_unlocked()) {
+					logger_helper::log_fatal(file_ + " could not be opened, Discarding " + boost::lexical_cast<std::string>(buffer_.size()) + " bytes of log data");
+					buffer_.clear();
+					return;
+				}
+				if (max_size_ != 0 && current_size_ > 0 && current_size_ + buffer_.size() > max_size_)
+					rotate_unlocked();
+				if (!stream_.is_open()) {
+					buffer_.clear();
+					return;
+				}
+				stream_.write(buffer_.data(), buffer_.size());
+				stream_.flush();
+				if (!stream_) {
+					logger_helper::log_fatal("Failed to write to log file: " + file_);
+					close_unlocked();
+				} else {
+					current_size_ += buffer_.size();
+				}
+				buffer_.clear();
+			}
+
+			bool buffered_file_logger::open_unlocked() {
+				boost::system::error_code ec;
+				boost::filesystem::path parent = file_helpers::meta::get_path(file_);
+				if (!parent.empty() && !boost::filesystem::exists(parent, ec)) {
+					boost::filesystem::create_directories(parent, ec);
+					if (ec)
+						logger_helper::log_fatal("Failed to create directory: " + parent.string());
+				}
+				stream_.clear();
+				stream_.open(file_.c_str(), std::ios::out | std::ios::app);
+				if (!stream_.is_open())
+					return false;
+				boost::uintmax_t size = boost::filesystem::file_size(file_, ec);
+				current_size_ = ec ? 0 : static_cast<std::size_t>(size);
+				return true;
+			}
+
+			void buffered_file_logger::close_unlocked() {
+				if (stream_.is_open())
+					stream_.close();
+				stream_.clear();
+				current_size_ = 0;
+			}
+
+			void buffered_file_logger::rotate_unlocked() {
+				close_unlocked();
+				boost::system::error_code ec;
+				if (backups_ > 0) {
+					std::string last = file_ + "." + boost::lexical_cast<std::string>(backups_);
+					boost::filesystem::remove(last, ec);
+					for (std::size_t i = backups_ - 1; i > 0; i--) {
+						std::string from = file_ + "." + boost::lexical_cast<std::string>(i);
+						if (boost::filesystem::exists(from, ec))
+							boost::filesystem::rename(from, file_ + "." + boost::lexical_cast<std::string>(i + 1), ec);
+					}
+					ec.clear();
+					boost::filesystem::rename(file_, file_ + ".1", ec);
+					if (!ec) {
+						open_unlocked();
+						return;
+					}
+					logger_helper::log_fatal("Failed to rotate log file " + file_ + ": " + ec.message() + " (truncating it instead)");
+				}
+				stream_.open(file_.c_str(), std::ios::out | std::ios::trunc);
+				current_size_ = 0;
+			}
+
+			void buffered_file_logger::add_settings(sh::settings_registry &settings, config_data *config) {
+				settings.add_key_to_settings("log/file")
+					("backup count", sh::size_key(&config->backups, 3),
+						"BACKUP COUNT", "Number of rotated log files to keep (nsclient.log.1, nsclient.log.2, ...) when the file reaches max size.")
+
+					("buffer size", sh::size_key(&config->buffer_size, 64 * 1024),
+						"WRITE BUFFER SIZE", "Size (in bytes) of the buffer log messages are collected in before they are written to disk.", true)
+
+					("flush interval", sh::uint_key(&config->flush_interval, 1000),
+						"FLUSH INTERVAL", "Maximum time (in milliseconds) a log message is kept in the buffer while the logger is busy.", true)
+					;
+			}
+
+			buffered_file_logger::config_data buffered_file_logger::do_config(const bool log_fault) {
+				config_data ret;
+				ret.common = file_logger_helper::read_config(log_fault, "When file size reaches this it will be rotated (or truncated if backup count is 0), if set to 0 (default) the file will grow forever",
+					boost::bind(&buffered_file_logger::add_settings, _1, &ret));
+				return ret;
+			}
+			void buffered_file_logger::synch_configure() {
+				do_config(true);
+			}
+
+			void buffered_file_logger::asynch_configure() {
+				try {
+					config_data config = do_config(false);
+
+					std::string file = file_logger_helper::resolve_file(config.common.file);
+
+					boost::mutex::scoped_lock lock(mutex_);
+					format_ = config.common.format;
+					date_time_ = 0;
+					max_size_ = config.common.max_size;
+					backups_ = config.backups;
+					buffer_size_ = config.buffer_size;
+					flush_interval_ = boost::posix_time::milliseconds(config.flush_interval);
+					if (file != file_) {
+						flush_unlocked();
+						close_unlocked();
+						file_ = file;
+					}
+				} catch (const std::exception &e) {
+					// ignored, since this might be after shutdown...
+				} catch (...) {
+					// ignored, since this might be after shutdown...
+				}
+			}
+
+			bool buffered_file_logger::shutdown() {
+				try {
+					boost::mutex::scoped_lock lock(mutex_);
+					flush_unlocked();
+					close_unlocked();
+				} catch (...) {
+					logger_helper::log_fatal("Failed to close log file: " + file_);
+				}
+				return nsclient::logging::log_driver_interface_impl::shutdown();
+			}
+		}
+	}
+}
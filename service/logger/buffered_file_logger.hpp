@@ -0,0 +1,84 @@
+/*
+ * Copyright 2004-2016 The NSClient++ Authors - https://nsclient.org
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <nsclient/logger/base_logger_impl.hpp>
+
+#include "file_logger_helper.hpp"
+
+#include <boost/thread/mutex.hpp>
+#include <boost/date_time/posix_time/posix_time.hpp>
+
+#include <ctime>
+#include <string>
+#include <fstream>
+
+namespace nsclient {
+	namespace logging {
+		namespace impl {
+			/**
+			 * File log backend which keeps the file open and writes through a buffer.
+			 * The buffer is written when it is full, when the flush interval has passed
+			 * or when flush() is called (the threaded logger does so whenever its queue runs empty).
+			 * When the file grows beyond max size it is rotated by renaming (file.1, file.2, ...).
+			 */
+			class buffered_file_logger : public nsclient::logging::log_driver_interface_impl {
+				boost::mutex mutex_;
+				std::string file_;
+				std::string format_;
+				std::size_t max_size_;
+				std::size_t backups_;
+				std::size_t buffer_size_;
+				boost::posix_time::time_duration flush_interval_;
+
+				std::ofstream stream_;
+				std::size_t current_size_;
+				std::string buffer_;
+				boost::posix_time::ptime last_flush_;
+				std::time_t date_time_;
+				std::string date_;
+
+			public:
+				buffered_file_logger(std::string file);
+				virtual ~buffered_file_logger();
+
+				void do_log(const std::string data);
+				void flush();
+				struct config_data {
+					file_logger_helper::config_data common;
+					std::size_t backups;
+					std::size_t buffer_size;
+					unsigned int flush_interval;
+					config_data() : backups(3), buffer_size(64 * 1024), flush_interval(1000) {}
+				};
+				config_data do_config(const bool log_fault);
+				void synch_configure();
+				void asynch_configure();
+				bool shutdown();
+
+			private:
+				static void add_settings(nscapi::settings_helper::settings_registry &settings, config_data *config);
+				const std::string& get_date();
+				void flush_unlocked();
+				bool open_unlocked();
+				void close_unlocked();
+				void rotate_unlocked();
+			};
+
+		}
+	}
+}
@@ -0,0 +1,111 @@
+/*
+ * Copyright 2004-2016 The NSClient++ Authors - https://nsclient.org
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "config.h"
+
+#include "file_logger_helper.hpp"
+
+#include <nsclient/logger/logger_helper.hpp>
+
+#ifdef WIN32
+#include <Windows.h>
+#endif
+
+#include "../libs/settings_manager/settings_manager_impl.h"
+
+namespace nsclient {
+	namespace logging {
+		namespace impl {
+
+			namespace sh = nscapi::settings_helper;
+
+			std::string file_logger_helper::base_path() {
+#ifdef WIN32
+				unsigned int buf_len = 4096;
+				char* buffer = new char[buf_len + 1];
+				GetModuleFileNameA(NULL, buffer, buf_len);
+				std::string path = buffer;
+				std::string::size_type pos = path.rfind('\\');
+				path = path.substr(0, pos + 1);
+				delete[] buffer;
+				return path;
+#else
+				return "";
+#endif
+			}
+
+			file_logger_helper::config_data file_logger_helper::read_config(const bool log_fault, const std::string &max_size_description, add_keys_type add_keys) {
+				config_data ret;
+				try {
+					sh::settings_registry settings(settings_manager::get_proxy());
+					settings.set_alias("log/file");
+
+					settings.add_path_to_settings()
+						("log", "LOG SECTION", "Configure log properties.")
+
+						("log/file", "LOG SECTION", "Configure log file properties.")
+						;
+
+					settings.add_key_to_settings("log")
+						("file name", sh::string_key(&ret.file, DEFAULT_LOG_LOCATION),
+							"FILENAME", "The file to write log data to. Set this to none to disable log to file.")
+
+						("date format", sh::string_key(&ret.format, "%Y-%m-%d %H:%M:%S"),
+							"DATEMASK", "The size of the buffer to use when getting messages this affects the speed and maximum size of messages you can recieve.")
+
+						;
+
+					settings.add_key_to_settings("log/file")
+						("max size", sh::size_key(&ret.max_size, 0),
+							"MAXIMUM FILE SIZE", max_size_description)
+						;
+
+					if (add_keys)
+						add_keys(settings);
+
+					settings.register_all();
+					settings.notify();
+
+#ifdef WIN32
+					if (ret.file == "/nsclient.log")
+						ret.file = "${exe-path}/nsclient.log";
+#endif
+					ret.file = settings.expand_path(ret.file);
+				} catch (const std::exception &e) {
+					if (log_fault)
+						logger_helper::log_fatal(std::string("Failed to configure logger: ") + e.what());
+				} catch (...) {
+					if (log_fault)
+						logger_helper::log_fatal("Failed to configure logging.");
+				}
+				return ret;
+			}
+
+			std::string file_logger_helper::resolve_file(const std::string &file) {
+				std::string ret = settings_manager::get_proxy()->expand_path(file);
+				if (ret.empty())
+					ret = base_path() + "nsclient.log";
+				if (ret.find('\\') == std::string::npos && ret.find('/') == std::string::npos) {
+					ret = base_path() + ret;
+				}
+				if (ret == "none") {
+					ret = "";
+				}
+				return ret;
+			}
+		}
+	}
+}
@@ -0,0 +1,52 @@
+/*
+ * Copyright 2004-2016 The NSClient++ Authors - https://nsclient.org
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <nscapi/nscapi_settings_helper.hpp>
+
+#include <boost/function.hpp>
+
+#include <string>
+
+namespace nsclient {
+	namespace logging {
+		namespace impl {
+			/**
+			 * Settings handling shared by the file log backends so they read (and resolve) the log file the same way.
+			 */
+			struct file_logger_helper {
+				struct config_data {
+					std::string file;
+					std::string format;
+					std::size_t max_size;
+					config_data() : max_size(0) {}
+				};
+				typedef boost::function<void(nscapi::settings_helper::settings_registry &)> add_keys_type;
+
+				static std::string base_path();
+				/**
+				 * Read the common log file keys, add_keys can register backend specific keys (in the same registry).
+				 */
+				static config_data read_config(const bool log_fault, const std::string &max_size_description, add_keys_type add_keys = add_keys_type());
+				/**
+				 * Turn the configured file name into the file to log to (an empty string means file logging is disabled).
+				 */
+				static std::string resolve_file(const std::string &file);
+			};
+		}
+	}
+}
@@ -21,6 +21,7 @@
 
 #include "simple_console_logger.hpp"
 #include "simple_file_logger.hpp"
+#include "buffered_file_logger.hpp"
 #include "threaded_logger.hpp"
 
 #define CONSOLE_BACKEND "console"
@@ -33,7 +34,7 @@ void nsclient::logging::impl::nsclient_logger::set_backend(std::string backend)
 	if (backend == CONSOLE_BACKEND) {
 		tmp = log_driver_instance(new simple_console_logger());
 	} else if (backend == THREADED_FILE_BACKEND) {
-		nsclient::logging::log_driver_instance inner = log_driver_instance(new simple_file_logger("nsclient.log"));
+		nsclient::logging::log_driver_instance inner = log_driver_instance(new buffered_file_logger("nsclient.log"));
 		tmp = log_driver_instance(new threaded_logger(this, inner));
 	} else if (backend == FILE_BACKEND) {
 		tmp = log_driver_instance(new simple_file_logger("nsclient.log"));
@@ -78,6 +79,11 @@ void nsclient::logging::impl::nsclient_logger::configure() {
 	backend_->asynch_configure();
 }
 
+void nsclient::logging::impl::nsclient_logger::fetch_metrics(std::map<std::string, long long> &metrics) const {
+	if (backend_)
+		backend_->fetch_metrics(metrics);
+}
+
 void nsclient::logging::impl::nsclient_logger::do_log(const std::string data) {
 	backend_->do_log(data);
 }
@@ -84,6 +84,7 @@ namespace nsclient {
 
 				void set_backend(std::string backend);
 				void destroy();
+				void fetch_metrics(std::map<std::string, long long> &metrics) const;
 
 
 				void add_subscriber(nsclient::logging::logging_subscriber_instance);
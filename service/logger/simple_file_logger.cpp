@@ -43,23 +43,8 @@ namespace nsclient {
 
 
 			simple_file_logger::simple_file_logger(std::string file) : max_size_(0), format_("%Y-%m-%d %H:%M:%S") {
-				file_ = base_path() + file;
+				file_ = file_logger_helper::base_path() + file;
 			}
-			std::string simple_file_logger::base_path() {
-#ifdef WIN32
-				unsigned int buf_len = 4096;
-				char* buffer = new char[buf_len + 1];
-				GetModuleFileNameA(NULL, buffer, buf_len);
-				std::string path = buffer;
-				std::string::size_type pos = path.rfind('\\');
-				path = path.substr(0, pos + 1);
-				delete[] buffer;
-				return path;
-#else
-				return "";
-#endif
-			}
-
 			void simple_file_logger::do_log(const std::string data) {
 				if (file_.empty())
 					return;
@@ -117,47 +102,7 @@ namespace nsclient {
 			}
 
 			simple_file_logger::config_data simple_file_logger::do_config(const bool log_fault) {
-				config_data ret;
-				try {
-					sh::settings_registry settings(settings_manager::get_proxy());
-					settings.set_alias("log/file");
-
-					settings.add_path_to_settings()
-						("log", "LOG SECTION", "Configure log properties.")
-
-						("log/file", "LOG SECTION", "Configure log file properties.")
-						;
-
-					settings.add_key_to_settings("log")
-						("file name", sh::string_key(&ret.file, DEFAULT_LOG_LOCATION),
-							"FILENAME", "The file to write log data to. Set this to none to disable log to file.")
-
-							("date format", sh::string_key(&ret.format, "%Y-%m-%d %H:%M:%S"),
-								"DATEMASK", "The size of the buffer to use when getting messages this affects the speed and maximum size of messages you can recieve.")
-
-						;
-
-					settings.add_key_to_settings("log/file")
-						("max size", sh::size_key(&ret.max_size, 0),
-							"MAXIMUM FILE SIZE", "When file size reaches this it will be truncated to 50% if set to 0 (default) truncation will be disabled")
-						;
-
-					settings.register_all();
-					settings.notify();
-
-#ifdef WIN32
-					if (ret.file == "/nsclient.log")
-						ret.file = "${exe-path}/nsclient.log";
-#endif
-					ret.file = settings.expand_path(ret.file);
-				} catch (const std::exception &e) {
-					if (log_fault)
-						logger_helper::log_fatal(std::string("Failed to configure logger: ") + e.what());
-				} catch (...) {
-					if (log_fault)
-						logger_helper::log_fatal("Failed to configure logging.");
-				}
-				return ret;
+				return file_logger_helper::read_config(log_fault, "When file size reaches this it will be truncated to 50% if set to 0 (default) truncation will be disabled");
 			}
 			void simple_file_logger::synch_configure() {
 				do_config(true);
@@ -169,15 +114,7 @@ namespace nsclient {
 
 					format_ = config.format;
 					max_size_ = config.max_size;
-					file_ = settings_manager::get_proxy()->expand_path(config.file);
-					if (file_.empty())
-						file_ = base_path() + "nsclient.log";
-					if (file_.find('\\') == std::string::npos && file_.find('/') == std::string::npos) {
-						file_ = base_path() + file_;
-					}
-					if (file_ == "none") {
-						file_ = "";
-					}
+					file_ = file_logger_helper::resolve_file(config.file);
 				} catch (const std::exception &e) {
 					// ignored, since this might be after shutdown...
 				} catch (...) {
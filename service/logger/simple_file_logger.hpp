@@ -18,6 +18,8 @@
 
 #include <nsclient/logger/base_logger_impl.hpp>
 
+#include "file_logger_helper.hpp"
+
 #include <string>
 
 namespace nsclient {
@@ -30,14 +32,9 @@ namespace nsclient {
 
 			public:
 				simple_file_logger(std::string file);
-				std::string base_path();
 
 				void do_log(const std::string data);
-				struct config_data {
-					std::string file;
-					std::string format;
-					std::size_t max_size;
-				};
+				typedef file_logger_helper::config_data config_data;
 				config_data do_config(const bool log_fault);
 				void synch_configure();
 				void asynch_configure();
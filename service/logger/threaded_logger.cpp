@@ -16,15 +16,50 @@
 
 #include "threaded_logger.hpp"
 
+#include <nscapi/nscapi_protobuf.hpp>
+#include <nscapi/nscapi_settings_helper.hpp>
 
-const static std::string QUIT_MESSAGE = "$$QUIT$$";
-const static std::string CONFIGURE_MESSAGE = "$$CONFIGURE$$";
-const static std::string SET_CONFIG_MESSAGE = "$$SET_CONFIG$$";
+#include <boost/foreach.hpp>
+
+#include "../libs/settings_manager/settings_manager_impl.h"
+
+#include <vector>
+#include <algorithm>
+
+namespace {
+	// Capacity of the message ring, with the drop-debug-first policy debug and trace
+	// messages are dropped once it is three quarters full.
+	const std::size_t queue_size = 8192;
+	const std::size_t max_batch = 256;
+
+	bool is_debug_message(const std::string &data) {
+		Plugin::LogEntry message;
+		if (!message.ParseFromString(data) || message.entry_size() == 0)
+			return false;
+		return message.entry(0).level() == Plugin::LogEntry_Entry_Level_LOG_DEBUG
+			|| message.entry(0).level() == Plugin::LogEntry_Entry_Level_LOG_TRACE;
+	}
+}
 
 namespace nsclient {
 	namespace logging {
 		namespace impl {
-			threaded_logger::threaded_logger(logging_subscriber *subscriber_manager, log_driver_instance background_logger) : subscriber_manager_(subscriber_manager), background_logger_(background_logger) {}
+			namespace sh = nscapi::settings_helper;
+
+			threaded_logger::threaded_logger(logging_subscriber *subscriber_manager, log_driver_instance background_logger)
+				: log_queue_(queue_size)
+				, high_water_(log_queue_.capacity() * 3 / 4)
+				, has_control_(false)
+				, sleeping_(false)
+				, waiting_producers_(0)
+				, policy_(overflow_drop_debug)
+				, queued_(0)
+				, dropped_(0)
+				, dropped_debug_(0)
+				, blocked_(0)
+				, background_logger_(background_logger)
+				, subscriber_manager_(subscriber_manager)
+			{}
 			threaded_logger::~threaded_logger() {
 				shutdown();
 			}
@@ -33,46 +68,204 @@ namespace nsclient {
 				push(data);
 			}
 			void threaded_logger::push(const std::string &data) {
-				log_queue_.push(data);
+				int policy = policy_.load(boost::memory_order_relaxed);
+				if (policy == overflow_drop_debug && log_queue_.size() >= high_water_ && is_debug_message(data)) {
+					dropped_debug_++;
+					return;
+				}
+				if (log_queue_.try_push(data)) {
+					queued_++;
+					wake_consumer();
+					return;
+				}
+				if (policy == overflow_drop) {
+					dropped_++;
+					return;
+				}
+				wait_for_space(data);
 			}
 
-			void threaded_logger::thread_proc() {
-				std::string data;
-				while (true) {
+			void threaded_logger::wait_for_space(const std::string &data) {
+				boost::unique_lock<boost::mutex> lock(wait_mutex_);
+				// The log thread (or anyone logging before startup) can not wait for itself.
+				if (!is_started() || boost::this_thread::get_id() == thread_id_) {
+					dropped_++;
+					return;
+				}
+				blocked_++;
+				waiting_producers_++;
+				wait_cond_.notify_one();
+				while (!log_queue_.try_push(data)) {
+					if (!is_started()) {
+						dropped_++;
+						waiting_producers_--;
+						return;
+					}
+					space_cond_.timed_wait(lock, boost::posix_time::milliseconds(100));
+				}
+				waiting_producers_--;
+				queued_++;
+			}
+
+			void threaded_logger::wake_consumer() {
+				// Pairs with the fence in thread_proc: either we see the consumer sleeping or it sees our message.
+				boost::atomic_thread_fence(boost::memory_order_seq_cst);
+				if (sleeping_.load(boost::memory_order_relaxed)) {
+					boost::mutex::scoped_lock lock(wait_mutex_);
+					wait_cond_.notify_one();
+				}
+			}
+
+			void threaded_logger::push_control(const control_message &message) {
+				{
+					boost::mutex::scoped_lock lock(control_mutex_);
+					control_queue_.push_back(message);
+					has_control_ = true;
+				}
+				wake_consumer();
+			}
+
+			// Returns false when the thread should exit
+			bool threaded_logger::process_control() {
+				control_list messages;
+				{
+					boost::mutex::scoped_lock lock(control_mutex_);
+					messages.swap(control_queue_);
+					has_control_ = false;
+				}
+				BOOST_FOREACH(const control_message &m, messages) {
 					try {
-						log_queue_.wait_and_pop(data);
-						if (data == QUIT_MESSAGE) {
-							return;
-						} else if (data == CONFIGURE_MESSAGE) {
+						if (m.type == control_message::quit) {
+							return false;
+						} else if (m.type == control_message::configure) {
 							if (background_logger_)
 								background_logger_->asynch_configure();
-						} else if (data.size() > SET_CONFIG_MESSAGE.size() && data.substr(0, SET_CONFIG_MESSAGE.size()) == SET_CONFIG_MESSAGE) {
-							background_logger_->set_config(data.substr(SET_CONFIG_MESSAGE.size()));
-						} else {
-							if (background_logger_->is_console()) {
-								std::pair<bool, std::string> m = logger_helper::render_console_message(is_oneline(), data);
-								if (!is_no_std_err() && m.first)
-									std::cerr << m.second;
-								else
-									std::cout << m.second;
-							}
+							set_overflow_policy(do_config(false));
+						} else if (m.type == control_message::set_config) {
 							if (background_logger_)
-								background_logger_->do_log(data);
-							subscriber_manager_->on_log_message(data);
+								background_logger_->set_config(m.key);
 						}
 					} catch (const std::exception &e) {
-						logger_helper::log_fatal(std::string("Failed to process log message: ") + e.what());
+						logger_helper::log_fatal(std::string("Failed to process log control message: ") + e.what());
 					} catch (...) {
-						logger_helper::log_fatal("Failed to process log message");
+						logger_helper::log_fatal("Failed to process log control message");
 					}
 				}
+				return true;
+			}
+
+			void threaded_logger::process_message(std::string &data) {
+				try {
+					if (background_logger_->is_console()) {
+						std::pair<bool, std::string> m = logger_helper::render_console_message(is_oneline(), data);
+						if (!is_no_std_err() && m.first)
+							std::cerr << m.second;
+						else
+							std::cout << m.second;
+					}
+					if (background_logger_)
+						background_logger_->do_log(data);
+					subscriber_manager_->on_log_message(data);
+				} catch (const std::exception &e) {
+					logger_helper::log_fatal(std::string("Failed to process log message: ") + e.what());
+				} catch (...) {
+					logger_helper::log_fatal("Failed to process log message");
+				}
+			}
+
+			void threaded_logger::thread_proc() {
+				{
+					// Read by producers in wait_for_space under the same lock
+					boost::mutex::scoped_lock lock(wait_mutex_);
+					thread_id_ = boost::this_thread::get_id();
+				}
+				std::vector<std::string> batch;
+				batch.reserve(max_batch);
+				bool running = true;
+				bool dirty = false;
+				// Messages left to write after quit, anything queued after the quit message is not waited for
+				std::size_t pending = 0;
+				while (true) {
+					if (running && has_control_.load()) {
+						running = process_control();
+						if (!running)
+							pending = log_queue_.size();
+					}
+
+					batch.clear();
+					std::size_t count = running ? max_batch : std::min(max_batch, pending);
+					if (count > 0 && log_queue_.drain(batch, count) > 0) {
+						if (!running)
+							pending -= batch.size();
+						BOOST_FOREACH(std::string &data, batch) {
+							process_message(data);
+						}
+						dirty = true;
+						if (waiting_producers_.load() > 0) {
+							boost::mutex::scoped_lock lock(wait_mutex_);
+							space_cond_.notify_all();
+						}
+						continue;
+					}
+					// Let buffering backends write once the current burst has been handled
+					if (dirty && background_logger_) {
+						background_logger_->flush();
+						dirty = false;
+					}
+					// Everything queued before the quit message has been written
+					if (!running)
+						break;
+
+					boost::unique_lock<boost::mutex> lock(wait_mutex_);
+					sleeping_.store(true);
+					boost::atomic_thread_fence(boost::memory_order_seq_cst);
+					if (log_queue_.empty() && !has_control_.load())
+						wait_cond_.timed_wait(lock, boost::posix_time::seconds(1));
+					sleeping_.store(false);
+				}
+			}
+
+			void threaded_logger::set_overflow_policy(const std::string &policy) {
+				if (policy == "block")
+					policy_ = overflow_block;
+				else if (policy == "drop")
+					policy_ = overflow_drop;
+				else if (policy == "drop-debug-first")
+					policy_ = overflow_drop_debug;
+				else
+					logger_helper::log_fatal("Invalid log queue overflow policy: " + policy);
+			}
+
+			std::string threaded_logger::do_config(const bool log_fault) {
+				// If the settings can not be read we fall back to the default policy
+				std::string policy = "drop-debug-first";
+				try {
+					sh::settings_registry settings(settings_manager::get_proxy());
+					settings.set_alias("log");
+
+					settings.add_key_to_settings("log")
+						("queue overflow", sh::string_key(&policy, "drop-debug-first"),
+							"QUEUE OVERFLOW POLICY", "What to do when log messages are produced faster than they can be written: block (wait for room in the queue), drop (discard the message) or drop-debug-first (discard debug and trace messages when the queue is filling up and wait for room for all other messages).", true)
+						;
+
+					settings.register_all();
+					settings.notify();
+				} catch (const std::exception &e) {
+					if (log_fault)
+						logger_helper::log_fatal(std::string("Failed to configure log queue: ") + e.what());
+				} catch (...) {
+					if (log_fault)
+						logger_helper::log_fatal("Failed to configure log queue.");
+				}
+				return policy;
 			}
 
 			void threaded_logger::asynch_configure() {
-				push(CONFIGURE_MESSAGE);
+				push_control(control_message(control_message::configure));
 			}
 			void threaded_logger::synch_configure() {
 				background_logger_->synch_configure();
+				set_overflow_policy(do_config(true));
 			}
 			bool threaded_logger::startup() {
 				if (is_started())
@@ -84,7 +277,7 @@ namespace nsclient {
 				if (!is_started())
 					return true;
 				try {
-					push(QUIT_MESSAGE);
+					push_control(control_message(control_message::quit));
 					if (!thread_.timed_join(boost::posix_time::seconds(10))) {
 						logger_helper::log_fatal("Failed to exit log slave!");
 						nsclient::logging::log_driver_interface_impl::shutdown();
@@ -100,9 +293,17 @@ namespace nsclient {
 				return false;
 			}
 			void threaded_logger::set_config(const std::string &key) {
-				std::string message = SET_CONFIG_MESSAGE + key;
-				push(message);
+				push_control(control_message(control_message::set_config, key));
+			}
+
+			void threaded_logger::fetch_metrics(log_metrics_type &metrics) const {
+				metrics["queued"] = static_cast<long long>(queued_.load());
+				metrics["dropped"] = static_cast<long long>(dropped_.load());
+				metrics["dropped.debug"] = static_cast<long long>(dropped_debug_.load());
+				metrics["blocked"] = static_cast<long long>(blocked_.load());
+				metrics["depth"] = static_cast<long long>(log_queue_.size());
+				metrics["capacity"] = static_cast<long long>(log_queue_.capacity());
 			}
 		}
 	}
-}
\ No newline at end of file
+}
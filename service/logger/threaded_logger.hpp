@@ -18,20 +18,63 @@
 
 #include <nsclient/logger/base_logger_impl.hpp>
 
-#include <concurrent_queue.hpp>
+#include <bounded_mpsc_queue.hpp>
 
 #include <boost/thread.hpp>
+#include <boost/atomic.hpp>
+#include <boost/cstdint.hpp>
 #include <boost/shared_ptr.hpp>
 
+#include <list>
 #include <string>
 
 
 namespace nsclient {
 	namespace logging {
 		namespace impl {
+			/**
+			 * Log driver which hands messages to a background thread.
+			 * Messages go through a lock-free ring (plugin threads never contend on a lock unless
+			 * the ring is full), control messages (configure, quit, ...) are kept in a separate queue.
+			 */
 			class threaded_logger : public nsclient::logging::log_driver_interface_impl {
-				concurrent_queue<std::string> log_queue_;
+			public:
+				enum overflow_policy {
+					overflow_block,
+					overflow_drop,
+					overflow_drop_debug
+				};
+
+			private:
+				struct control_message {
+					enum type_enum { quit, configure, set_config };
+					type_enum type;
+					std::string key;
+					control_message(type_enum type, std::string key = "") : type(type), key(key) {}
+				};
+				typedef std::list<control_message> control_list;
+
+				bounded_mpsc_queue<std::string> log_queue_;
+				std::size_t high_water_;
+
+				boost::mutex control_mutex_;
+				control_list control_queue_;
+				boost::atomic<bool> has_control_;
+
+				boost::mutex wait_mutex_;
+				boost::condition_variable wait_cond_;
+				boost::condition_variable space_cond_;
+				boost::atomic<bool> sleeping_;
+				boost::atomic<int> waiting_producers_;
+
+				boost::atomic<int> policy_;
+				boost::atomic<boost::uint64_t> queued_;
+				boost::atomic<boost::uint64_t> dropped_;
+				boost::atomic<boost::uint64_t> dropped_debug_;
+				boost::atomic<boost::uint64_t> blocked_;
+
 				boost::thread thread_;
+				boost::thread::id thread_id_;
 
 				log_driver_instance background_logger_;
 				logging_subscriber *subscriber_manager_;
@@ -53,7 +96,18 @@ namespace nsclient {
 
 				//virtual void set_log_level(NSCAPI::log_level::level level);
 				virtual void set_config(const std::string &key);
+				virtual void fetch_metrics(log_metrics_type &metrics) const;
+
+				void set_overflow_policy(const std::string &policy);
+
+			private:
+				void push_control(const control_message &message);
+				bool process_control();
+				void process_message(std::string &data);
+				void wake_consumer();
+				void wait_for_space(const std::string &data);
+				std::string do_config(const bool log_fault);
 			};
 		}
 	}
-}
\ No newline at end of file
+}
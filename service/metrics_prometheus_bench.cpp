@@ -0,0 +1,61 @@
+/*
+ * Copyright 2004-2016 The NSClient++ Authors - https://nsclient.org
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <string>
+#include <sstream>
+#include <iostream>
+
+#include <metrics/metrics_prometheus.hpp>
+#include <strEx.h>
+
+#include <boost/date_time/posix_time/posix_time.hpp>
+#include <boost/lexical_cast.hpp>
+
+void add_metrics(Plugin::MetricsMessage &message, const std::string &module, int children, int values) {
+	Plugin::Common::MetricsBundle *bundle = message.add_payload()->add_bundles();
+	bundle->set_key(module);
+	for (int c = 0; c < children; c++) {
+		Plugin::Common::MetricsBundle *child = bundle->add_children();
+		child->set_key("child_" + strEx::s::xtos(c));
+		for (int v = 0; v < values; v++) {
+			Plugin::Common::Metric *m = child->add_value();
+			m->set_key("value_" + strEx::s::xtos(v));
+			m->mutable_value()->set_int_data(v);
+		}
+	}
+}
+
+/**
+ * Times rendering a large metrics tree in Prometheus text format: metrics_prometheus_bench [modules]
+ * (each module has 100 children with 100 values each)
+ */
+int main(int argc, char *argv[]) {
+	int modules = 10;
+	if (argc > 1)
+		modules = boost::lexical_cast<int>(argv[1]);
+	Plugin::MetricsMessage message;
+	for (int i = 0; i < modules; i++)
+		add_metrics(message, "module_" + strEx::s::xtos(i), 100, 100);
+
+	std::stringstream ss;
+	boost::posix_time::ptime start = boost::posix_time::microsec_clock::local_time();
+	metrics::prometheus_writer writer(ss);
+	writer.write(message);
+	writer.flush();
+	boost::posix_time::time_duration elapsed = boost::posix_time::microsec_clock::local_time() - start;
+	std::cout << "render " << writer.samples() << " samples: " << elapsed.total_milliseconds() << "ms [" << ss.str().size() << " bytes]" << std::endl;
+	return 0;
+}
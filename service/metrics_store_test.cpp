@@ -0,0 +1,161 @@
+/*
+ * Copyright 2004-2016 The NSClient++ Authors - https://nsclient.org
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <string>
+#include <sstream>
+#include <metrics/metrics_store_map.hpp>
+#include <metrics/metrics_prometheus.hpp>
+#include <strEx.h>
+
+#include <gtest/gtest.h>
+
+void add_metrics(Plugin::MetricsMessage &message, const std::string &module, int children, int values) {
+	Plugin::Common::MetricsBundle *bundle = message.add_payload()->add_bundles();
+	bundle->set_key(module);
+	for (int c = 0; c < children; c++) {
+		Plugin::Common::MetricsBundle *child = bundle->add_children();
+		child->set_key("child_" + strEx::s::xtos(c));
+		for (int v = 0; v < values; v++) {
+			Plugin::Common::Metric *m = child->add_value();
+			m->set_key("value_" + strEx::s::xtos(v));
+			m->mutable_value()->set_int_data(v);
+		}
+	}
+}
+
+TEST(metrics_store, typed_values) {
+	Plugin::MetricsMessage message;
+	Plugin::Common::MetricsBundle *bundle = message.add_payload()->add_bundles();
+	bundle->set_key("system");
+	Plugin::Common::Metric *m = bundle->add_value();
+	m->set_key("load");
+	m->mutable_value()->set_float_data(1.5);
+	m = bundle->add_value();
+	m->set_key("procs");
+	m->mutable_value()->set_int_data(42);
+	m = bundle->add_value();
+	m->set_key("name");
+	m->mutable_value()->set_string_data("foo");
+
+	metrics::metrics_store store;
+	store.set(message);
+	metrics::metrics_store::values_map values = store.get("");
+	ASSERT_EQ(3u, values.size());
+	EXPECT_EQ("1.5", values["system.load"]);
+	EXPECT_EQ("42", values["system.procs"]);
+	EXPECT_EQ("foo", values["system.name"]);
+}
+
+TEST(metrics_store, set_replaces_all) {
+	metrics::metrics_store store;
+	Plugin::MetricsMessage first;
+	add_metrics(first, "foo", 2, 2);
+	add_metrics(first, "bar", 2, 2);
+	store.set(first);
+	EXPECT_EQ(8u, store.size());
+
+	Plugin::MetricsMessage second;
+	add_metrics(second, "foo", 1, 1);
+	store.set(second);
+	EXPECT_EQ(1u, store.size());
+	EXPECT_EQ(1u, store.get_prefix("foo.").size());
+	EXPECT_EQ(0u, store.get_prefix("bar.").size());
+
+	store.set(Plugin::MetricsMessage());
+	EXPECT_EQ(0u, store.size());
+}
+
+TEST(metrics_store, prefix_and_filter) {
+	metrics::metrics_store store;
+	Plugin::MetricsMessage message;
+	add_metrics(message, "foo", 12, 3);
+	add_metrics(message, "foobar", 1, 3);
+	store.set(message);
+
+	EXPECT_EQ(39u, store.get_prefix("foo").size());
+	EXPECT_EQ(36u, store.get_prefix("foo.").size());
+	EXPECT_EQ(3u, store.get_prefix("foo.child_1.").size());
+	EXPECT_EQ(9u, store.get_prefix("foo.child_1").size());
+	EXPECT_EQ(1u, store.get_prefix("foo.child_1.value_2").size());
+	EXPECT_EQ(0u, store.get_prefix("bar").size());
+	EXPECT_EQ(13u, store.get("value_2").size());
+}
+
+TEST(metrics_store, hundred_thousand_keys) {
+	Plugin::MetricsMessage message;
+	for (int i = 0; i < 10; i++)
+		add_metrics(message, "module_" + strEx::s::xtos(i), 100, 100);
+	metrics::metrics_store store;
+	store.set(message);
+	std::size_t found = 0;
+	for (int i = 0; i < 1000; i++)
+		found += store.get_prefix("module_5.child_" + strEx::s::xtos(i % 100) + ".").size();
+
+	EXPECT_EQ(100000u, store.size());
+	EXPECT_EQ(100000u, found);
+	EXPECT_EQ(1000u, store.get("child_42.").size());
+}
+
+TEST(metrics_prometheus, render) {
+	Plugin::MetricsMessage message;
+	Plugin::Common::MetricsBundle *bundle = message.add_payload()->add_bundles();
+	bundle->set_key("system");
+	Plugin::Common::Metric *m = bundle->add_value();
+	m->set_key("cpu.total");
+	m->mutable_value()->set_float_data(12.5);
+	m = bundle->add_value();
+	m->set_key("procs");
+	m->mutable_value()->set_int_data(-42);
+	m = bundle->add_value();
+	m->set_key("version");
+	m->mutable_value()->set_string_data("0.5 \"beta\"\\\n");
+	Plugin::Common::MetricsBundle *child = bundle->add_children();
+	child->set_key("C:\\");
+	m = child->add_value();
+	m->set_key("free-%");
+	m->mutable_value()->set_float_data(1e300 * 1e300);
+
+	std::stringstream ss;
+	metrics::prometheus_writer writer(ss);
+	writer.write(message);
+	writer.flush();
+	EXPECT_EQ(4u, writer.samples());
+	EXPECT_EQ("nscp_system_cpu_total 12.5\n"
+		"nscp_system_procs -42\n"
+		"nscp_system_version_info{value=\"0.5 \\\"beta\\\"\\\\\\n\"} 1\n"
+		"nscp_system_C:__free__ +Inf\n", ss.str());
+}
+
+TEST(metrics_prometheus, large_tree) {
+	Plugin::MetricsMessage message;
+	for (int i = 0; i < 10; i++)
+		add_metrics(message, "module_" + strEx::s::xtos(i), 100, 100);
+	std::stringstream ss;
+	{
+		metrics::prometheus_writer writer(ss);
+		writer.write(message);
+		EXPECT_EQ(100000u, writer.samples());
+	}
+	std::string last;
+	std::string line;
+	std::size_t lines = 0;
+	while (std::getline(ss, line)) {
+		last = line;
+		lines++;
+	}
+	EXPECT_EQ(100000u, lines);
+	EXPECT_EQ("nscp_module_9_child_99_value_99 99", last);
+}
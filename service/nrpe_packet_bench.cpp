@@ -0,0 +1,59 @@
+/*
+ * Copyright 2004-2016 The NSClient++ Authors - https://nsclient.org
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <string>
+#include <vector>
+#include <iostream>
+
+#include <nrpe/packet.hpp>
+#include <nrpe/server/parser.hpp>
+
+#include <boost/date_time/posix_time/posix_time.hpp>
+#include <boost/lexical_cast.hpp>
+
+/**
+ * Times the NRPE framing layer (parse a request, write a response): nrpe_packet_bench [iterations]
+ */
+int main(int argc, char *argv[]) {
+	int iterations = 100000;
+	if (argc > 1)
+		iterations = boost::lexical_cast<int>(argv[1]);
+	const unsigned int payload_length = 1024;
+	std::vector<char> request = nrpe::packet::make_request("check_cpu!warn=load > 80!crit=load > 90!time=5m!time=1m", payload_length).get_buffer();
+	nrpe::packet response = nrpe::packet::create_response(0, "OK: CPU load is ok.|'5m'=1%;80;90 '1m'=2%;80;90", payload_length);
+	nrpe::server::parser parser(payload_length);
+	std::vector<char> data;
+	std::vector<char> outbound;
+
+	std::size_t bytes = 0;
+	boost::posix_time::ptime start = boost::posix_time::microsec_clock::local_time();
+	for (int i = 0; i < iterations; i++) {
+		bool result;
+		char *pos;
+		boost::tie(result, pos) = parser.digest(&request[0], &request[0] + request.size());
+		const nrpe::packet &p = parser.parse();
+		if (!result || p.get_payload().empty()) {
+			std::cout << "Failed to parse request" << std::endl;
+			return 1;
+		}
+		response.write_to(data);
+		outbound = data;
+		bytes += outbound.size();
+	}
+	boost::posix_time::time_duration elapsed = boost::posix_time::microsec_clock::local_time() - start;
+	std::cout << iterations << " round trips: " << elapsed.total_milliseconds() << "ms [" << bytes << " bytes]" << std::endl;
+	return 0;
+}
@@ -0,0 +1,109 @@
+/*
+ * Copyright 2004-2016 The NSClient++ Authors - https://nsclient.org
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <string>
+#include <vector>
+
+#include <nrpe/packet.hpp>
+#include <nrpe/server/parser.hpp>
+
+#include <gtest/gtest.h>
+
+std::vector<char> make_request(const std::string &payload, unsigned int payload_length) {
+	return nrpe::packet::make_request(payload, payload_length).get_buffer();
+}
+
+TEST(nrpe_packet, round_trip) {
+	std::vector<char> buffer = make_request("check_cpu!foo", 1024);
+	ASSERT_EQ(1036u, buffer.size());
+	nrpe::packet_view view = nrpe::frame::parse(&buffer[0], buffer.size(), 1024);
+	EXPECT_TRUE(view.type == nrpe::data::queryPacket);
+	EXPECT_TRUE(view.version == nrpe::data::version2);
+	EXPECT_EQ("check_cpu!foo", std::string(view.payload, view.payload_size));
+
+	nrpe::packet p(buffer, 1024);
+	EXPECT_EQ("check_cpu!foo", p.getPayload());
+	EXPECT_TRUE(p.getType() == nrpe::data::queryPacket);
+}
+
+TEST(nrpe_packet, invalid_checksum) {
+	std::vector<char> buffer = make_request("check_cpu", 1024);
+	buffer[20] = 'x';
+	EXPECT_THROW(nrpe::frame::parse(&buffer[0], buffer.size(), 1024), nrpe::nrpe_exception);
+	EXPECT_THROW(nrpe::frame::parse(&buffer[0], buffer.size() - 1, 1024), nrpe::nrpe_exception);
+}
+
+TEST(nrpe_packet, payload_too_large) {
+	nrpe::packet p = nrpe::packet::create_response(0, std::string(1024, 'x'), 1024);
+	EXPECT_THROW(p.get_buffer(), nrpe::nrpe_exception);
+}
+
+TEST(nrpe_packet, parser_split_reads) {
+	std::vector<char> buffer = make_request("check_memory", 1024);
+	nrpe::server::parser parser(1024);
+	bool result;
+	char *pos;
+	boost::tie(result, pos) = parser.digest(&buffer[0], &buffer[100]);
+	EXPECT_FALSE(result);
+	boost::tie(result, pos) = parser.digest(&buffer[100], &buffer[0] + buffer.size());
+	EXPECT_TRUE(result);
+	EXPECT_EQ(&buffer[0] + buffer.size(), pos);
+	EXPECT_EQ("check_memory", parser.parse().getPayload());
+
+	boost::tie(result, pos) = parser.digest(&buffer[0], &buffer[0] + buffer.size());
+	EXPECT_TRUE(result);
+	EXPECT_EQ("check_memory", parser.parse().getPayload());
+}
+
+// After the first round trip all buffers are reused: none of them is reallocated.
+TEST(nrpe_packet, round_trip_reuses_buffers) {
+	const unsigned int payload_length = 1024;
+	std::vector<char> request = make_request("check_cpu!warn=load > 80!crit=load > 90!time=5m!time=1m", payload_length);
+	nrpe::packet response = nrpe::packet::create_response(0, "OK: CPU load is ok.|'5m'=1%;80;90 '1m'=2%;80;90", payload_length);
+	nrpe::server::parser parser(payload_length);
+	std::vector<char> data;
+	std::vector<char> outbound;
+
+	const char *payload_data = NULL;
+	const char *response_data = NULL;
+	const char *outbound_data = NULL;
+	for (int i = 0; i < 1000; i++) {
+		bool result;
+		char *pos;
+		// Alternate between in place parsing and reassembling a split packet
+		if (i % 2 == 0) {
+			boost::tie(result, pos) = parser.digest(&request[0], &request[0] + request.size());
+		} else {
+			boost::tie(result, pos) = parser.digest(&request[0], &request[0] + 10);
+			ASSERT_FALSE(result);
+			boost::tie(result, pos) = parser.digest(&request[10], &request[0] + request.size());
+		}
+		ASSERT_TRUE(result);
+		const nrpe::packet &p = parser.parse();
+		ASSERT_EQ("check_cpu!warn=load > 80!crit=load > 90!time=5m!time=1m", p.get_payload());
+		response.write_to(data);
+		outbound = data;
+		if (i == 0) {
+			payload_data = p.get_payload().data();
+			response_data = &data[0];
+			outbound_data = &outbound[0];
+		} else {
+			ASSERT_EQ(payload_data, p.get_payload().data());
+			ASSERT_EQ(response_data, &data[0]);
+			ASSERT_EQ(outbound_data, &outbound[0]);
+		}
+	}
+}
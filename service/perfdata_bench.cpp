@@ -0,0 +1,92 @@
+/*
+ * Copyright 2004-2016 The NSClient++ Authors - https://nsclient.org
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <string>
+#include <iostream>
+
+#include <nscapi/nscapi_protobuf.hpp>
+#include <nscapi/nscapi_protobuf_functions.hpp>
+
+#include <boost/date_time/posix_time/posix_time.hpp>
+#include <boost/lexical_cast.hpp>
+
+#include "legacy_performance_data.hpp"
+
+std::string make_perf_string(int entries) {
+	std::string ret;
+	for (int i = 0; i < entries; i++) {
+		if (i > 0)
+			ret += " ";
+		std::string n = boost::lexical_cast<std::string>(i);
+		if (i % 3 == 0)
+			ret += "'C:\\ used " + n + "'=" + n + ".123456GB;80.5;90.25;0;" + n + "00.75";
+		else if (i % 3 == 1)
+			ret += "load_" + n + "=" + n + "%;80;90";
+		else
+			ret += "time" + n + "=0.00" + n + "s";
+	}
+	return ret;
+}
+
+struct result {
+	long long parse_us;
+	long long build_us;
+	std::size_t length;
+};
+
+template<class parse_type, class build_type>
+result run(const std::string &perf, int iterations, parse_type parse, build_type build) {
+	result ret;
+	ret.length = 0;
+	boost::posix_time::ptime start = boost::posix_time::microsec_clock::local_time();
+	Plugin::QueryResponseMessage::Response::Line line;
+	for (int i = 0; i < iterations; i++) {
+		line.Clear();
+		parse(&line, perf);
+	}
+	boost::posix_time::ptime mid = boost::posix_time::microsec_clock::local_time();
+	for (int i = 0; i < iterations; i++)
+		ret.length += build(line).size();
+	boost::posix_time::ptime end = boost::posix_time::microsec_clock::local_time();
+	ret.parse_us = (mid - start).total_microseconds();
+	ret.build_us = (end - mid).total_microseconds();
+	return ret;
+}
+
+/**
+ * Compares the legacy and current performance data parser and writer: perfdata_bench [total entries]
+ */
+int main(int argc, char *argv[]) {
+	int total = 500000;
+	if (argc > 1)
+		total = boost::lexical_cast<int>(argv[1]);
+
+	int sizes[] = { 1, 5, 20, 100, 500 };
+	for (int s = 0; s < 5; s++) {
+		std::string perf = make_perf_string(sizes[s]);
+		int iterations = total / sizes[s];
+		result legacy = run(perf, iterations, &legacy_performance_data::parse_performance_data, &legacy_performance_data::build_performance_data);
+		result current = run(perf, iterations, &nscapi::protobuf::functions::parse_performance_data, &nscapi::protobuf::functions::build_performance_data);
+		std::cout << sizes[s] << " entries x " << iterations << ": "
+			<< "parse " << legacy.parse_us / 1000 << "ms -> " << current.parse_us / 1000 << "ms, "
+			<< "build " << legacy.build_us / 1000 << "ms -> " << current.build_us / 1000 << "ms" << std::endl;
+		if (legacy.length != current.length) {
+			std::cout << "Legacy and current output differ" << std::endl;
+			return 1;
+		}
+	}
+	return 0;
+}
@@ -16,9 +16,14 @@
 
 #include <vector>
 #include <string>
+#include <cstring>
 #include <nscapi/functions.hpp>
 #include <format.hpp>
 
+#include <boost/cstdint.hpp>
+
+#include "legacy_performance_data.hpp"
+
 #include <gtest/gtest.h>
 
 std::string do_parse(std::string str) {
@@ -129,4 +134,150 @@ TEST(PerfDataTest, unit_conversion_m) {
 TEST(PerfDataTest, unit_conversion_g) {
 	double d = format::convert_to_byte_units(1234567890, "G");
 	ASSERT_DOUBLE_EQ(1.1497809458523989, d);
-}
\ No newline at end of file
+}
+
+// Deterministic generator for the fuzz tests (xorshift64)
+struct fuzz_random {
+	boost::uint64_t state;
+	fuzz_random(boost::uint64_t seed) : state(seed) {}
+	boost::uint64_t next() {
+		state ^= state << 13;
+		state ^= state >> 7;
+		state ^= state << 17;
+		return state;
+	}
+	int next(int max) {
+		return static_cast<int>(next() % max);
+	}
+	std::string number() {
+		static const char *special[] = { "-", ".", "-.", "1..2", "1-2", "--1", "-0", "0.", ".5", "1,5", "1,000,000", "007",
+			"123456789012345678901234567890", "0.0000000000000000000000001", "1.797693134862315e308" };
+		if (next(10) == 0)
+			return special[next(sizeof(special) / sizeof(special[0]))];
+		std::string ret;
+		if (next(4) == 0)
+			ret += '-';
+		int digits = next(18);
+		for (int i = 0; i < digits; i++)
+			ret += static_cast<char>('0' + next(10));
+		if (next(2) == 0) {
+			ret += next(4) == 0 ? ',' : '.';
+			digits = next(25);
+			for (int i = 0; i < digits; i++)
+				ret += static_cast<char>('0' + next(10));
+		}
+		return ret;
+	}
+	std::string item() {
+		static const char *labels[] = { "aaa", "'a b'", "'a;b'", "'a=b'", "'", "''", "'open", "x'", "=", "", "a'b'c" };
+		static const char *units[] = { "", "", "ms", "%", "B", "KB", "c", "s=x", "g9" };
+		std::string ret = labels[next(sizeof(labels) / sizeof(labels[0]))];
+		if (next(8) != 0)
+			ret += "=";
+		ret += number();
+		ret += units[next(sizeof(units) / sizeof(units[0]))];
+		int thresholds = next(7);
+		for (int i = 0; i < thresholds; i++) {
+			ret += ";";
+			int kind = next(5);
+			if (kind == 1)
+				ret += number();
+			else if (kind == 2)
+				ret += "~:" + number();
+			else if (kind == 3)
+				ret += number() + ":";
+			else if (kind == 4)
+				ret += "@" + number();
+		}
+		return ret;
+	}
+	std::string perf_string() {
+		static const char alphabet[] = " '=;,.-0123456789abcKm%~:@";
+		std::string ret;
+		if (next(5) == 0) {
+			int len = next(40);
+			for (int i = 0; i < len; i++)
+				ret += alphabet[next(sizeof(alphabet) - 1)];
+			return ret;
+		}
+		int items = next(6);
+		for (int i = 0; i < items; i++) {
+			int spaces = next(3);
+			ret += std::string(i == 0 ? spaces : spaces + 1, ' ');
+			ret += item();
+		}
+		return ret;
+	}
+	double value() {
+		boost::uint64_t bits = next();
+		double d;
+		switch (next(6)) {
+		case 0:
+			std::memcpy(&d, &bits, sizeof(d));
+			return d;
+		case 1:
+			return static_cast<double>(static_cast<boost::int64_t>(bits) >> next(64));
+		case 2:
+			return (static_cast<double>(bits % 2000000) - 1000000) / 1000.0;
+		case 3:
+			return static_cast<double>(bits % 1000) / 3.0;
+		default:
+			return (static_cast<double>(bits % 2000) - 1000) / (1 + next(100000));
+		}
+	}
+};
+
+TEST(PerfDataTest, fuzz_parser_matches_legacy) {
+	fuzz_random rnd(0x5eed1234);
+	for (int i = 0; i < 50000; i++) {
+		std::string perf = rnd.perf_string();
+		Plugin::QueryResponseMessage::Response::Line expected, actual;
+		try {
+			legacy_performance_data::parse_performance_data(&expected, perf);
+		} catch (const std::exception &) {
+			// The legacy parser throws on strings with only spaces
+			continue;
+		}
+		nscapi::protobuf::functions::parse_performance_data(&actual, perf);
+		ASSERT_EQ(expected.SerializePartialAsString(), actual.SerializePartialAsString()) << "Failed to parse: \"" << perf << "\"";
+		ASSERT_EQ(legacy_performance_data::build_performance_data(expected), nscapi::protobuf::functions::build_performance_data(actual)) << "Failed to render: \"" << perf << "\"";
+	}
+}
+
+TEST(PerfDataTest, fuzz_writer_matches_legacy) {
+	fuzz_random rnd(0xfeedbeef);
+	for (int i = 0; i < 20000; i++) {
+		Plugin::QueryResponseMessage::Response::Line line;
+		int count = rnd.next(4);
+		for (int j = 0; j < count; j++) {
+			Plugin::Common::PerformanceData *perf = line.add_perf();
+			perf->set_alias(j % 2 ? "a b" : "x");
+			if (rnd.next(2) == 0) {
+				Plugin::Common_PerformanceData_FloatValue *v = perf->mutable_float_value();
+				v->set_value(rnd.value());
+				if (rnd.next(2) == 0)
+					v->set_unit("ms");
+				if (rnd.next(2) == 0)
+					v->set_warning(rnd.value());
+				if (rnd.next(2) == 0)
+					v->set_critical(rnd.value());
+				if (rnd.next(2) == 0)
+					v->set_minimum(rnd.value());
+				if (rnd.next(2) == 0)
+					v->set_maximum(rnd.value());
+			} else {
+				Plugin::Common_PerformanceData_IntValue *v = perf->mutable_int_value();
+				v->set_value(static_cast<boost::int64_t>(rnd.next()) >> rnd.next(64));
+				if (rnd.next(2) == 0)
+					v->set_unit("B");
+				if (rnd.next(2) == 0)
+					v->set_warning(static_cast<boost::int64_t>(rnd.next()));
+				if (rnd.next(2) == 0)
+					v->set_critical(-static_cast<boost::int64_t>(rnd.next(1000)));
+				if (rnd.next(2) == 0)
+					v->set_maximum(0);
+			}
+		}
+		ASSERT_EQ(legacy_performance_data::build_performance_data(line), nscapi::protobuf::functions::build_performance_data(line)) << line.DebugString();
+	}
+}
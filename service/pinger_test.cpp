@@ -0,0 +1,127 @@
+/*
+ * Copyright 2004-2016 The NSClient++ Authors - https://nsclient.org
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <net/pinger.hpp>
+
+#include <gtest/gtest.h>
+
+namespace {
+	const boost::asio::ip::address host_a = boost::asio::ip::address::from_string("10.0.0.1");
+	const boost::asio::ip::address host_b = boost::asio::ip::address::from_string("10.0.0.2");
+	const posix_time::ptime start = posix_time::ptime(boost::gregorian::date(2016, 1, 1));
+
+	posix_time::ptime at(int ms) {
+		return start + posix_time::millisec(ms);
+	}
+}
+
+TEST(echo_tracker, matches_identifier_sequence_and_source) {
+	echo_tracker tracker(1234, 500);
+	tracker.add_target("a", host_a);
+	tracker.add_target("b", host_b);
+	EXPECT_EQ(1, tracker.add_echo(0, at(0), true));
+	EXPECT_EQ(2, tracker.add_echo(1, at(0), true));
+	EXPECT_EQ(2u, tracker.get_outstanding());
+
+	// Wrong identifier, unknown sequence numbers and a reply from the wrong host are ignored
+	EXPECT_EQ(echo_tracker::reply_ignored, tracker.add_reply(true, 4321, 1, host_a, at(10), 30, 64));
+	EXPECT_EQ(echo_tracker::reply_ignored, tracker.add_reply(true, 1234, 0, host_a, at(10), 30, 64));
+	EXPECT_EQ(echo_tracker::reply_ignored, tracker.add_reply(true, 1234, 3, host_a, at(10), 30, 64));
+	EXPECT_EQ(echo_tracker::reply_ignored, tracker.add_reply(true, 1234, 2, host_a, at(10), 30, 64));
+	EXPECT_EQ(2u, tracker.get_outstanding());
+
+	EXPECT_EQ(echo_tracker::reply_matched, tracker.add_reply(true, 1234, 1, host_a, at(10), 30, 64));
+	// Duplicates are ignored
+	EXPECT_EQ(echo_tracker::reply_ignored, tracker.add_reply(true, 1234, 1, host_a, at(11), 30, 64));
+	// Datagram sockets do not check the identifier
+	EXPECT_EQ(echo_tracker::reply_matched, tracker.add_reply(false, 4321, 2, host_b, at(20), 30, 0));
+	EXPECT_EQ(0u, tracker.get_outstanding());
+
+	tracker.calculate_results();
+	std::vector<result_container> results = tracker.get_results();
+	ASSERT_EQ(2u, results.size());
+	EXPECT_EQ("a", results[0].destination_);
+	EXPECT_EQ("10.0.0.1", results[0].ip_);
+	EXPECT_EQ(1u, results[0].num_replies_);
+	EXPECT_EQ(10u, results[0].time_);
+	EXPECT_EQ(64, results[0].ttl_);
+	EXPECT_EQ(30u, results[0].length_);
+	EXPECT_EQ(1u, results[1].num_replies_);
+	EXPECT_EQ(20u, results[1].time_);
+}
+
+TEST(echo_tracker, late_replies_are_timeouts) {
+	echo_tracker tracker(1, 100);
+	tracker.add_target("a", host_a);
+	tracker.add_echo(0, at(0), true);
+	tracker.add_echo(0, at(0), true);
+	tracker.add_echo(0, at(0), false);
+	EXPECT_EQ(2u, tracker.get_outstanding());
+	EXPECT_EQ(echo_tracker::reply_matched, tracker.add_reply(true, 1, 1, host_a, at(100), 30, 64));
+	EXPECT_EQ(echo_tracker::reply_late, tracker.add_reply(true, 1, 2, host_a, at(101), 30, 64));
+	// Echoes which failed to send never match
+	EXPECT_EQ(echo_tracker::reply_ignored, tracker.add_reply(true, 1, 3, host_a, at(10), 30, 64));
+	EXPECT_EQ(0u, tracker.get_outstanding());
+
+	tracker.calculate_results();
+	result_container r = tracker.get_results().front();
+	EXPECT_EQ(3u, r.num_send_);
+	EXPECT_EQ(1u, r.num_replies_);
+	EXPECT_EQ(2u, r.num_timeouts_);
+	EXPECT_EQ(100u, r.time_);
+}
+
+TEST(echo_tracker, min_max_and_jitter) {
+	echo_tracker tracker(1, 1000);
+	tracker.add_target("a", host_a);
+	int rtt[] = { 10, 30, 20, 0, 60 };
+	for (int i = 0; i < 5; i++)
+		tracker.add_echo(0, at(i * 100), true);
+	for (int i = 0; i < 5; i++) {
+		// The fourth echo is lost
+		if (i != 3)
+			tracker.add_reply(true, 1, static_cast<unsigned short>(i + 1), host_a, at(i * 100 + rtt[i]), 30, 64);
+	}
+	tracker.calculate_results();
+	result_container r = tracker.get_results().front();
+	EXPECT_EQ(4u, r.num_replies_);
+	EXPECT_EQ(1u, r.num_timeouts_);
+	EXPECT_EQ(10u, r.time_min_);
+	EXPECT_EQ(60u, r.time_max_);
+	// (10 + 30 + 20 + 60) / 4
+	EXPECT_EQ(30u, r.time_);
+	// Differences between consecutive replies: 20, 10, 40
+	EXPECT_EQ(23u, r.jitter_);
+}
+
+TEST(result_container, add) {
+	result_container a, b, c, total;
+	a.num_send_ = 2; a.num_replies_ = 2; a.rtt_total_us_ = 40000; a.time_min_ = 15; a.time_max_ = 25;
+	a.jitter_total_us_ = 10000; a.jitter_samples_ = 1;
+	b.num_send_ = 3; b.num_replies_ = 1; b.num_timeouts_ = 2; b.rtt_total_us_ = 50000; b.time_min_ = 50; b.time_max_ = 50;
+	// No replies: min and max are not taken into account
+	c.num_send_ = 1; c.num_timeouts_ = 1;
+	total.add(c);
+	total.add(b);
+	total.add(a);
+	EXPECT_EQ(6u, total.num_send_);
+	EXPECT_EQ(3u, total.num_replies_);
+	EXPECT_EQ(3u, total.num_timeouts_);
+	EXPECT_EQ(15u, total.time_min_);
+	EXPECT_EQ(50u, total.time_max_);
+	EXPECT_EQ(30u, total.time_);
+	EXPECT_EQ(10u, total.jitter_);
+}
@@ -0,0 +1,154 @@
+/*
+ * Copyright 2004-2016 The NSClient++ Authors - https://nsclient.org
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <map>
+#include <list>
+#include <string>
+#include <iostream>
+
+#include <nscapi/nscapi_protobuf.hpp>
+
+#include <boost/date_time/posix_time/posix_time.hpp>
+#include <boost/lexical_cast.hpp>
+#include <boost/foreach.hpp>
+
+// Stands in for a plugin behind the C buffer ABI: parses the request and serializes a reply per payload.
+int fake_plugin(const std::string &request, std::string &response) {
+	Plugin::QueryRequestMessage request_message;
+	request_message.ParseFromString(request);
+	Plugin::QueryResponseMessage response_message;
+	response_message.mutable_header()->CopyFrom(request_message.header());
+	BOOST_FOREACH(const Plugin::QueryRequestMessage::Request &r, request_message.payload()) {
+		Plugin::QueryResponseMessage::Response *p = response_message.add_payload();
+		p->set_command(r.command());
+		p->set_result(Plugin::Common_ResultCode_OK);
+		Plugin::QueryResponseMessage::Response::Line *l = p->add_lines();
+		l->set_message("OK: CPU load is ok.");
+		Plugin::Common::PerformanceData *pd = l->add_perf();
+		pd->set_alias("total 5m");
+		pd->mutable_float_value()->set_value(12);
+		pd->mutable_float_value()->set_unit("%");
+	}
+	response = response_message.SerializeAsString();
+	return 0;
+}
+
+// Returns the "plugin" for a command (commands starting with a-m go to plugin 1, the rest to plugin 2).
+int plugin_for(const std::string &command) {
+	return command.empty() || command[0] < 'n' ? 1 : 2;
+}
+
+// The old dispatch: every request is split, copied, re-serialized and the replies merged.
+void dispatch_copy(const std::string &request, std::string &response) {
+	Plugin::QueryRequestMessage request_message;
+	request_message.ParseFromString(request);
+	std::map<int, Plugin::QueryRequestMessage> chunks;
+	BOOST_FOREACH(const Plugin::QueryRequestMessage::Request &r, request_message.payload()) {
+		int id = plugin_for(r.command());
+		if (chunks.find(id) == chunks.end())
+			chunks[id].mutable_header()->CopyFrom(request_message.header());
+		chunks[id].add_payload()->CopyFrom(r);
+	}
+	Plugin::QueryResponseMessage response_message;
+	for (std::map<int, Plugin::QueryRequestMessage>::iterator it = chunks.begin(); it != chunks.end(); ++it) {
+		std::string local_response;
+		fake_plugin(it->second.SerializeAsString(), local_response);
+		Plugin::QueryResponseMessage local_response_message;
+		local_response_message.ParseFromString(local_response);
+		if (!response_message.has_header())
+			response_message.mutable_header()->CopyFrom(local_response_message.header());
+		for (int i = 0; i < local_response_message.payload_size(); i++)
+			response_message.add_payload()->CopyFrom(local_response_message.payload(i));
+	}
+	response = response_message.SerializeAsString();
+}
+
+// The current dispatch: single plugin requests are forwarded as-is, others are split by index and merged with Swap.
+void dispatch_forward(const std::string &request, std::string &response) {
+	Plugin::QueryRequestMessage request_message;
+	request_message.ParseFromString(request);
+	std::map<int, std::list<int> > chunks;
+	for (int i = 0; i < request_message.payload_size(); i++)
+		chunks[plugin_for(request_message.payload(i).command())].push_back(i);
+	if (chunks.size() == 1) {
+		fake_plugin(request, response);
+		return;
+	}
+	Plugin::QueryResponseMessage response_message;
+	for (std::map<int, std::list<int> >::iterator it = chunks.begin(); it != chunks.end(); ++it) {
+		Plugin::QueryRequestMessage local_request;
+		local_request.mutable_header()->CopyFrom(request_message.header());
+		BOOST_FOREACH(int i, it->second)
+			local_request.add_payload()->CopyFrom(request_message.payload(i));
+		std::string local_response;
+		fake_plugin(local_request.SerializeAsString(), local_response);
+		Plugin::QueryResponseMessage local_response_message;
+		local_response_message.ParseFromString(local_response);
+		if (!response_message.has_header())
+			response_message.mutable_header()->Swap(local_response_message.mutable_header());
+		for (int i = 0; i < local_response_message.payload_size(); i++)
+			response_message.add_payload()->Swap(local_response_message.mutable_payload(i));
+	}
+	response = response_message.SerializeAsString();
+}
+
+std::string make_request(int commands, bool mixed) {
+	Plugin::QueryRequestMessage message;
+	message.mutable_header()->set_source_id("nrpe");
+	for (int i = 0; i < commands; i++) {
+		Plugin::QueryRequestMessage::Request *r = message.add_payload();
+		r->set_command(mixed && i % 2 ? "check_uptime" : "check_cpu");
+		r->add_arguments("warn=load > 80");
+		r->add_arguments("crit=load > 90");
+		r->add_arguments("time=5m");
+	}
+	return message.SerializeAsString();
+}
+
+template<class dispatch_type>
+long long run(const std::string &request, int iterations, dispatch_type dispatch, std::size_t &length) {
+	std::string response;
+	length = 0;
+	boost::posix_time::ptime start = boost::posix_time::microsec_clock::local_time();
+	for (int i = 0; i < iterations; i++) {
+		dispatch(request, response);
+		length += response.size();
+	}
+	return (boost::posix_time::microsec_clock::local_time() - start).total_milliseconds();
+}
+
+/**
+ * Compares copying and forwarding query dispatch in the core: query_dispatch_bench [iterations]
+ */
+int main(int argc, char *argv[]) {
+	int iterations = 200000;
+	if (argc > 1)
+		iterations = boost::lexical_cast<int>(argv[1]);
+
+	const char* names[] = { "1 command, 1 plugin ", "10 commands, 1 plugin ", "10 commands, 2 plugins" };
+	std::string requests[] = { make_request(1, false), make_request(10, false), make_request(10, true) };
+	for (int i = 0; i < 3; i++) {
+		std::size_t copy_length, forward_length;
+		long long copy = run(requests[i], iterations, &dispatch_copy, copy_length);
+		long long forward = run(requests[i], iterations, &dispatch_forward, forward_length);
+		std::cout << names[i] << " x " << iterations << ": copy " << copy << "ms -> forward " << forward << "ms" << std::endl;
+		if (copy_length != forward_length) {
+			std::cout << "Copy and forward responses differ" << std::endl;
+			return 1;
+		}
+	}
+	return 0;
+}
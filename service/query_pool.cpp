@@ -0,0 +1,123 @@
+/*
+ * Copyright 2004-2016 The NSClient++ Authors - https://nsclient.org
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "query_pool.hpp"
+
+#include <boost/bind.hpp>
+#include <boost/foreach.hpp>
+
+#include <utf8.hpp>
+
+void nsclient::core::query_pool::start(std::size_t threads, std::size_t max_queue) {
+	if (running_ || threads == 0)
+		return;
+	max_queue_ = max_queue;
+	running_ = true;
+	for (std::size_t i = 0; i < threads; i++) {
+		boost::function<void()> f = boost::bind(&query_pool::thread_proc, this);
+		threads_.createThread(f);
+	}
+}
+
+void nsclient::core::query_pool::stop() {
+	if (!running_)
+		return;
+	running_ = false;
+	threads_.interruptThreads();
+	threads_.waitForThreads();
+}
+
+bool nsclient::core::query_pool::post(job_type job) {
+	{
+		boost::mutex::scoped_lock lock(queue_mutex_);
+		if (max_queue_ > 0 && queued_ >= max_queue_) {
+			rejected_++;
+			return false;
+		}
+		queued_++;
+	}
+	queue_.push(job);
+	return true;
+}
+
+void nsclient::core::query_pool::thread_proc() {
+	pool_thread_.reset(new bool(true));
+	job_type job;
+	while (running_) {
+		try {
+			queue_.wait_and_pop(job);
+			{
+				boost::mutex::scoped_lock lock(queue_mutex_);
+				queued_--;
+			}
+			job();
+		} catch (const boost::thread_interrupted &) {
+			return;
+		} catch (const std::exception &e) {
+			LOG_ERROR_CORE("Exception in query thread: " + utf8::utf8_from_native(e.what()));
+		} catch (...) {
+			LOG_ERROR_CORE("Exception in query thread");
+		}
+	}
+}
+
+void nsclient::core::query_pool::record(const std::string &plugin, boost::posix_time::time_duration time) {
+	unsigned long long ms = time.total_milliseconds();
+	boost::mutex::scoped_lock lock(metrics_mutex_);
+	latency_metric &m = metrics_[plugin];
+	m.count++;
+	m.total_ms += ms;
+	m.last_ms = ms;
+	if (ms > m.max_ms)
+		m.max_ms = ms;
+}
+
+void nsclient::core::query_pool::record_timeout(const std::string &plugin) {
+	boost::mutex::scoped_lock lock(metrics_mutex_);
+	metrics_[plugin].timeouts++;
+}
+
+void nsclient::core::query_pool::fetch_metrics(Plugin::Common::MetricsBundle *bundle) {
+	{
+		boost::mutex::scoped_lock lock(queue_mutex_);
+		Plugin::Common::Metric *m = bundle->add_value();
+		m->set_key("queued");
+		m->mutable_value()->set_int_data(queued_);
+		m = bundle->add_value();
+		m->set_key("rejected");
+		m->mutable_value()->set_int_data(rejected_);
+	}
+	boost::mutex::scoped_lock lock(metrics_mutex_);
+	BOOST_FOREACH(const metrics_type::value_type &v, metrics_) {
+		Plugin::Common::MetricsBundle *child = bundle->add_children();
+		child->set_key(v.first);
+		Plugin::Common::Metric *m = child->add_value();
+		m->set_key("count");
+		m->mutable_value()->set_int_data(v.second.count);
+		m = child->add_value();
+		m->set_key("timeouts");
+		m->mutable_value()->set_int_data(v.second.timeouts);
+		m = child->add_value();
+		m->set_key("avg");
+		m->mutable_value()->set_int_data(v.second.count == 0 ? 0 : v.second.total_ms / v.second.count);
+		m = child->add_value();
+		m->set_key("max");
+		m->mutable_value()->set_int_data(v.second.max_ms);
+		m = child->add_value();
+		m->set_key("last");
+		m->mutable_value()->set_int_data(v.second.last_ms);
+	}
+}
@@ -0,0 +1,105 @@
+/*
+ * Copyright 2004-2016 The NSClient++ Authors - https://nsclient.org
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <nsclient/logger/logger.hpp>
+#include <nscapi/nscapi_protobuf.hpp>
+
+#include <has-threads.hpp>
+#include <concurrent_queue.hpp>
+
+#include <boost/function.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/tss.hpp>
+#include <boost/date_time/posix_time/posix_time_types.hpp>
+
+#include <string>
+#include <map>
+
+namespace nsclient {
+	namespace core {
+
+		/**
+		 * Worker pool used by the core to run the per plugin chunks of a query concurrently.
+		 * Also keeps track of the time each plugin spends handling queries.
+		 * The number of queued (not yet started) jobs is bounded: when workers are stuck in plugins
+		 * which do not return new jobs are rejected instead of piling up.
+		 * Jobs should not wait for other jobs on the pool (that can deadlock when all workers wait):
+		 * use is_pool_thread() to run nested work inline instead.
+		 */
+		class query_pool : public boost::noncopyable {
+		public:
+			typedef boost::function<void()> job_type;
+
+		private:
+			struct latency_metric {
+				unsigned long long count;
+				unsigned long long timeouts;
+				unsigned long long total_ms;
+				unsigned long long max_ms;
+				unsigned long long last_ms;
+				latency_metric() : count(0), timeouts(0), total_ms(0), max_ms(0), last_ms(0) {}
+			};
+			typedef std::map<std::string, latency_metric> metrics_type;
+
+			nsclient::logging::logger_instance logger_;
+			has_threads threads_;
+			concurrent_queue<job_type> queue_;
+			volatile bool running_;
+			boost::mutex metrics_mutex_;
+			metrics_type metrics_;
+			boost::mutex queue_mutex_;
+			std::size_t max_queue_;
+			std::size_t queued_;
+			unsigned long long rejected_;
+			boost::thread_specific_ptr<bool> pool_thread_;
+
+		public:
+			query_pool(nsclient::logging::logger_instance logger) : logger_(logger), running_(false), max_queue_(0), queued_(0), rejected_(0) {}
+			~query_pool() {
+				stop();
+			}
+
+			void start(std::size_t threads, std::size_t max_queue);
+			void stop();
+			bool is_running() const {
+				return running_;
+			}
+			/**
+			 * True when called from one of the pool workers.
+			 */
+			bool is_pool_thread() const {
+				return pool_thread_.get() != NULL;
+			}
+			/**
+			 * Queue a job, returns false (and does not run it) if the queue is full.
+			 */
+			bool post(job_type job);
+
+			void record(const std::string &plugin, boost::posix_time::time_duration time);
+			void record_timeout(const std::string &plugin);
+			void fetch_metrics(Plugin::Common::MetricsBundle *bundle);
+
+		private:
+			void thread_proc();
+			nsclient::logging::logger_instance get_logger() {
+				return logger_;
+			}
+		};
+	}
+}
@@ -0,0 +1,173 @@
+/*
+ * Copyright 2004-2016 The NSClient++ Authors - https://nsclient.org
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <string>
+#include <scheduler/simple_scheduler.hpp>
+#include <strEx.h>
+
+#include <boost/foreach.hpp>
+
+#include <gtest/gtest.h>
+
+using boost::posix_time::ptime;
+using boost::posix_time::seconds;
+using boost::posix_time::milliseconds;
+
+const ptime epoch(boost::gregorian::date(1970, 1, 1));
+
+boost::int64_t phase(ptime time, boost::int64_t interval_ms) {
+	return (time - epoch).total_milliseconds() % interval_ms;
+}
+
+simple_scheduler::task make_task(const std::string &tag, int interval, const std::string &seed = "host") {
+	simple_scheduler::task t(tag, seconds(interval));
+	t.set_splay(seed);
+	return t;
+}
+
+TEST(scheduler_splay, stable_phase) {
+	simple_scheduler::task t = make_task("check_cpu", 60);
+	ptime start(boost::gregorian::date(2016, 5, 1), seconds(3600));
+	ptime first = t.get_next(start);
+	EXPECT_GT(first, start);
+	EXPECT_LE(first, start + seconds(60));
+	EXPECT_EQ(t.get_splay(), phase(first, 60000));
+	// Starting (or finishing a run) at any other time keeps the same phase
+	for (int i = 1; i < 500; i++) {
+		ptime next = t.get_next(start + milliseconds(i * 997));
+		EXPECT_EQ(t.get_splay(), phase(next, 60000));
+		EXPECT_GT(next, start + milliseconds(i * 997));
+		EXPECT_LE(next, start + milliseconds(i * 997) + seconds(60));
+	}
+	// Running exactly on time schedules the next run one interval later
+	EXPECT_EQ(first + seconds(60), t.get_next(first));
+}
+
+TEST(scheduler_splay, seed_and_tag) {
+	EXPECT_EQ(make_task("a", 300).get_splay(), make_task("a", 300).get_splay());
+	EXPECT_NE(make_task("a", 300).get_splay(), make_task("b", 300).get_splay());
+	EXPECT_NE(make_task("a", 300, "host1").get_splay(), make_task("a", 300, "host2").get_splay());
+	// Cron schedules are not affected
+	simple_scheduler::task cron("a", cron_parser::parse("1 * * * *"));
+	cron.set_splay("host");
+	EXPECT_EQ(0, cron.get_splay());
+}
+
+TEST(scheduler_splay, spread) {
+	const int tasks = 6000;
+	const int interval = 60;
+	int buckets[interval] = { 0 };
+	for (int i = 0; i < tasks; i++) {
+		simple_scheduler::task t = make_task("check_" + strEx::s::xtos(i), interval);
+		buckets[t.get_splay() / 1000]++;
+	}
+	// 100 tasks per second on average, a storm would show up as a single large bucket
+	for (int i = 0; i < interval; i++) {
+		EXPECT_GT(buckets[i], 50);
+		EXPECT_LT(buckets[i], 150);
+	}
+}
+
+struct start_counter : public simple_scheduler::handler {
+	boost::mutex mutex;
+	int starts;
+	start_counter() : starts(0) {}
+	bool handle_schedule(simple_scheduler::task) {
+		boost::mutex::scoped_lock l(mutex);
+		starts++;
+		// Run each task once
+		return false;
+	}
+	void on_error(const char*, int, std::string) {}
+	void on_trace(const char*, int, std::string) {}
+	int get_starts() {
+		boost::mutex::scoped_lock l(mutex);
+		return starts;
+	}
+};
+
+boost::int64_t get_metric(const simple_scheduler::scheduler::histogram_type &metrics, const std::string &key) {
+	BOOST_FOREACH(const simple_scheduler::scheduler::histogram_type::value_type &v, metrics) {
+		if (v.first == key)
+			return v.second;
+	}
+	return -1;
+}
+
+void run_limited(simple_scheduler::scheduler::engine_type engine) {
+	simple_scheduler::scheduler s;
+	start_counter handler;
+	s.set_handler(&handler);
+	s.set_engine(engine);
+	s.set_max_starts(5);
+	// A single worker: a throttled start must not hold it
+	s.set_threads(1);
+	ptime start = boost::get_system_time();
+	for (int i = 0; i < 10; i++)
+		s.add_task("check_" + strEx::s::xtos(i), seconds(0));
+	s.start();
+
+	// The burst (5) runs right away and the rest are rescheduled 200ms apart
+	boost::this_thread::sleep(milliseconds(100));
+	EXPECT_EQ(5, handler.get_starts());
+	EXPECT_EQ(5, get_metric(s.get_metric_starts(), "starts.throttled"));
+
+	while (handler.get_starts() < 10 && boost::get_system_time() - start < seconds(5))
+		boost::this_thread::sleep(milliseconds(10));
+	boost::posix_time::time_duration elapsed = boost::get_system_time() - start;
+	s.stop();
+	s.unset_handler();
+
+	EXPECT_EQ(10, handler.get_starts());
+	EXPECT_GE(elapsed, milliseconds(950));
+	simple_scheduler::scheduler::histogram_type metrics = s.get_metric_starts();
+	EXPECT_EQ(10, get_metric(metrics, "starts.last_minute"));
+	EXPECT_GE(get_metric(metrics, "starts.peak_second"), 5);
+	EXPECT_LE(get_metric(metrics, "starts.peak_second"), 10);
+	EXPECT_EQ(5, get_metric(metrics, "starts.throttled"));
+	// 200 + 400 + 600 + 800 + 1000ms
+	EXPECT_GE(get_metric(metrics, "starts.throttled_ms"), 2900);
+	EXPECT_LE(get_metric(metrics, "starts.throttled_ms"), 3000);
+}
+
+TEST(scheduler_limiter, queue) {
+	run_limited(simple_scheduler::scheduler::engine_queue);
+}
+
+TEST(scheduler_limiter, wheel) {
+	run_limited(simple_scheduler::scheduler::engine_wheel);
+}
+
+TEST(scheduler_limiter, unlimited) {
+	simple_scheduler::scheduler s;
+	start_counter handler;
+	s.set_handler(&handler);
+	s.set_threads(2);
+	for (int i = 0; i < 20; i++)
+		s.add_task("check_" + strEx::s::xtos(i), seconds(0));
+	s.start();
+	ptime start = boost::get_system_time();
+	while (handler.get_starts() < 20 && boost::get_system_time() - start < seconds(5))
+		boost::this_thread::sleep(milliseconds(10));
+	s.stop();
+	s.unset_handler();
+
+	EXPECT_EQ(20, handler.get_starts());
+	simple_scheduler::scheduler::histogram_type metrics = s.get_metric_starts();
+	EXPECT_EQ(20, get_metric(metrics, "starts.last_minute"));
+	EXPECT_EQ(0, get_metric(metrics, "starts.throttled"));
+	EXPECT_EQ(0, get_metric(metrics, "starts.throttled_ms"));
+}
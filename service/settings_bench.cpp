@@ -0,0 +1,182 @@
+/*
+ * Copyright 2004-2016 The NSClient++ Authors - https://nsclient.org
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <map>
+#include <string>
+#include <cstring>
+#include <cstdlib>
+#include <iostream>
+
+#include <nscapi/nscapi_protobuf.hpp>
+#include <nscapi/nscapi_protobuf_functions.hpp>
+#include <nscapi/nscapi_core_wrapper.hpp>
+#include <nscapi/nscapi_settings_proxy.hpp>
+#include <nscapi/nscapi_settings_helper.hpp>
+
+#include <boost/date_time/posix_time/posix_time.hpp>
+#include <boost/lexical_cast.hpp>
+#include <boost/foreach.hpp>
+
+namespace sh = nscapi::settings_helper;
+
+// The "ini file": path/key -> value
+typedef std::map<std::pair<std::string, std::string>, std::string> ini_type;
+ini_type ini;
+int round_trips = 0;
+int registrations = 0;
+
+NSCAPI::errorReturn fake_settings_query(const char *request_buffer, const unsigned int request_buffer_len, char **response_buffer, unsigned int *response_buffer_len) {
+	round_trips++;
+	Plugin::SettingsRequestMessage request;
+	Plugin::SettingsResponseMessage response;
+	request.ParseFromArray(request_buffer, request_buffer_len);
+	nscapi::protobuf::functions::create_simple_header(response.mutable_header());
+	BOOST_FOREACH(const Plugin::SettingsRequestMessage::Request &r, request.payload()) {
+		Plugin::SettingsResponseMessage::Response* rp = response.add_payload();
+		if (r.has_registration()) {
+			registrations++;
+			rp->mutable_registration();
+		} else if (r.has_query()) {
+			const Plugin::SettingsRequestMessage::Request::Query &q = r.query();
+			Plugin::SettingsResponseMessage::Response::Query *rpp = rp->mutable_query();
+			rpp->mutable_node()->CopyFrom(q.node());
+			ini_type::const_iterator it = ini.find(std::make_pair(q.node().path(), q.node().key()));
+			if (q.type() == Plugin::Common_DataType_INT)
+				rpp->mutable_value()->set_int_data(it == ini.end() ? q.default_value().int_data() : std::atoi(it->second.c_str()));
+			else if (q.type() == Plugin::Common_DataType_BOOL)
+				rpp->mutable_value()->set_bool_data(it == ini.end() ? q.default_value().bool_data() : it->second == "true");
+			else
+				rpp->mutable_value()->set_string_data(it == ini.end() ? q.default_value().string_data() : it->second);
+		}
+		rp->mutable_result()->set_code(Plugin::Common_Result_StatusCodeType_STATUS_OK);
+	}
+	*response_buffer_len = response.ByteSize();
+	*response_buffer = new char[*response_buffer_len + 10];
+	response.SerializeToArray(*response_buffer, *response_buffer_len);
+	return NSCAPI::api_return_codes::isSuccess;
+}
+void fake_destroy_buffer(char**buffer) {
+	delete[] * buffer;
+}
+NSCAPI::log_level::level fake_get_loglevel() {
+	return NSCAPI::log_level::error;
+}
+nscapi::core_api::FUNPTR fake_loader(const char *name) {
+	if (strcmp(name, "NSAPISettingsQuery") == 0)
+		return reinterpret_cast<nscapi::core_api::FUNPTR>(&fake_settings_query);
+	if (strcmp(name, "NSAPIDestroyBuffer") == 0)
+		return reinterpret_cast<nscapi::core_api::FUNPTR>(&fake_destroy_buffer);
+	if (strcmp(name, "NSAPIGetLoglevel") == 0)
+		return reinterpret_cast<nscapi::core_api::FUNPTR>(&fake_get_loglevel);
+	return NULL;
+}
+
+// Hides the batching support of the proxy to measure the old one-request-per-key behavior.
+class unbatched : public sh::settings_impl_interface {
+	sh::settings_impl_interface_ptr core_;
+public:
+	unbatched(sh::settings_impl_interface_ptr core) : core_(core) {}
+	void register_path(std::string path, std::string title, std::string description, bool advanced, bool sample) { core_->register_path(path, title, description, advanced, sample); }
+	void register_key(std::string path, std::string key, int type, std::string title, std::string description, std::string defValue, bool advanced, bool sample) { core_->register_key(path, key, type, title, description, defValue, advanced, sample); }
+	void register_tpl(std::string path, std::string title, std::string icon, std::string description, std::string fields) { core_->register_tpl(path, title, icon, description, fields); }
+	std::string get_string(std::string path, std::string key, std::string def) { return core_->get_string(path, key, def); }
+	void set_string(std::string path, std::string key, std::string value) { core_->set_string(path, key, value); }
+	int get_int(std::string path, std::string key, int def) { return core_->get_int(path, key, def); }
+	void set_int(std::string path, std::string key, int value) { core_->set_int(path, key, value); }
+	bool get_bool(std::string path, std::string key, bool def) { return core_->get_bool(path, key, def); }
+	void set_bool(std::string path, std::string key, bool value) { core_->set_bool(path, key, value); }
+	string_list get_sections(std::string path) { return core_->get_sections(path); }
+	string_list get_keys(std::string path) { return core_->get_keys(path); }
+	std::string expand_path(std::string key) { return core_->expand_path(key); }
+	void err(const char* file, int line, std::string message) { core_->err(file, line, message); }
+	void warn(const char* file, int line, std::string message) { core_->warn(file, line, message); }
+	void info(const char* file, int line, std::string message) { core_->info(file, line, message); }
+	void debug(const char* file, int line, std::string message) { core_->debug(file, line, message); }
+};
+
+struct module_settings {
+	std::map<std::string, std::string> strings;
+	std::map<std::string, int> ints;
+	std::map<std::string, bool> bools;
+};
+
+long long load_modules(const std::string &name, sh::settings_impl_interface_ptr core, int modules, int keys) {
+	round_trips = 0;
+	registrations = 0;
+	long long checksum = 0;
+	boost::posix_time::ptime start = boost::posix_time::microsec_clock::local_time();
+	for (int m = 0; m < modules; m++) {
+		module_settings data;
+		sh::settings_registry settings(core);
+		std::string path = "/settings/module" + boost::lexical_cast<std::string>(m);
+		settings.add_path_to_settings()
+			("module" + boost::lexical_cast<std::string>(m), "MODULE", "A module section")
+			;
+		sh::settings_keys_easy_init keys_init = settings.add_key_to_path(path);
+		for (int k = 0; k < keys; k++) {
+			std::string key = "key" + boost::lexical_cast<std::string>(k);
+			if (k % 3 == 0)
+				keys_init(key, sh::string_key(&data.strings[key], "default"), "STRING", "A string key");
+			else if (k % 3 == 1)
+				keys_init(key, sh::int_key(&data.ints[key], 42), "INT", "An int key");
+			else
+				keys_init(key, sh::bool_key(&data.bools[key], false), "BOOL", "A bool key");
+		}
+		settings.register_all();
+		settings.notify();
+		checksum += data.strings.size() + data.ints.size() + data.bools.size();
+		typedef std::map<std::string, int> int_map;
+		BOOST_FOREACH(const int_map::value_type &v, data.ints)
+			checksum += v.second;
+	}
+	boost::posix_time::time_duration elapsed = boost::posix_time::microsec_clock::local_time() - start;
+	std::cout << name << ": " << elapsed.total_milliseconds() << "ms, " << round_trips << " round trips, " << registrations << " registrations [" << checksum << "]" << std::endl;
+	return checksum;
+}
+
+/**
+ * Simulates loading modules against a large ini file: settings_bench [modules] [keys per module]
+ */
+int main(int argc, char *argv[]) {
+	int modules = 40;
+	int keys = 300;
+	if (argc > 1)
+		modules = boost::lexical_cast<int>(argv[1]);
+	if (argc > 2)
+		keys = boost::lexical_cast<int>(argv[2]);
+
+	// Every other key is set in the ini, the rest use their defaults.
+	for (int m = 0; m < modules; m++) {
+		std::string path = "/settings/module" + boost::lexical_cast<std::string>(m);
+		for (int k = 0; k < keys; k += 2) {
+			std::string key = "key" + boost::lexical_cast<std::string>(k);
+			ini[std::make_pair(path, key)] = k % 3 == 2 ? "true" : boost::lexical_cast<std::string>(k);
+		}
+	}
+
+	nscapi::core_wrapper core;
+	core.load_endpoints(&fake_loader);
+	sh::settings_impl_interface_ptr proxy(new nscapi::settings_proxy(1, &core));
+	sh::settings_impl_interface_ptr plain(new unbatched(proxy));
+
+	long long a = load_modules("one request per key", plain, modules, keys);
+	long long b = load_modules("batched            ", proxy, modules, keys);
+	if (a != b) {
+		std::cout << "Batched and unbatched results differ" << std::endl;
+		return 1;
+	}
+	return 0;
+}
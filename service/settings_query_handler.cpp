@@ -37,11 +37,11 @@ namespace nsclient {
 				Plugin::SettingsResponseMessage::Response* rp = response.add_payload();
 				try {
 					if (r.has_inventory()) {
-						return parse_inventory(r.inventory(), rp);
+						parse_inventory(r.inventory(), rp);
 					} else if (r.has_query()) {
-						return parse_query(r.query(), rp);
+						parse_query(r.query(), rp);
 					} else if (r.has_registration()) {
-						return parse_registration(r.registration(), r.plugin_id(), rp);
+						parse_registration(r.registration(), r.plugin_id(), rp);
 					} else if (r.has_update()) {
 						const Plugin::SettingsRequestMessage::Request::Update &p = r.update();
 						rp->mutable_update();
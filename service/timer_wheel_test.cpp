@@ -0,0 +1,76 @@
+/*
+ * Copyright 2004-2016 The NSClient++ Authors - https://nsclient.org
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <vector>
+#include <scheduler/timer_wheel.hpp>
+
+#include <gtest/gtest.h>
+
+typedef simple_scheduler::timer_wheel wheel_type;
+
+std::vector<int> advance_to(wheel_type &wheel, wheel_type::tick_type tick) {
+	wheel_type::slot_type ready;
+	wheel.advance(tick, ready);
+	std::vector<int> ret;
+	for (wheel_type::slot_type::const_iterator cit = ready.begin(); cit != ready.end(); ++cit)
+		ret.push_back(cit->id);
+	return ret;
+}
+
+TEST(timer_wheel, expires_on_due_tick) {
+	wheel_type wheel;
+	wheel.insert(1, 5);
+	EXPECT_EQ(1, wheel.size());
+	EXPECT_TRUE(advance_to(wheel, 4).empty());
+	std::vector<int> ready = advance_to(wheel, 5);
+	ASSERT_EQ(1, ready.size());
+	EXPECT_EQ(1, ready[0]);
+	EXPECT_TRUE(wheel.empty());
+}
+
+TEST(timer_wheel, past_due_expires_on_next_advance) {
+	wheel_type wheel(100);
+	wheel.insert(1, 10);
+	EXPECT_EQ(1, advance_to(wheel, 100).size());
+}
+
+TEST(timer_wheel, cascades_from_higher_levels) {
+	wheel_type wheel;
+	wheel_type::tick_type dues[] = { 255, 256, 257, 1000, 65535, 65536, 70000, 16777216 + 3 };
+	for (int i = 0; i < 8; i++)
+		wheel.insert(i, dues[i]);
+	for (int i = 0; i < 8; i++) {
+		EXPECT_TRUE(advance_to(wheel, dues[i] - 1).empty()) << "item " << i << " expired early";
+		std::vector<int> ready = advance_to(wheel, dues[i]);
+		ASSERT_EQ(1, ready.size()) << "item " << i << " did not expire on time";
+		EXPECT_EQ(i, ready[0]);
+	}
+	EXPECT_TRUE(wheel.empty());
+}
+
+TEST(timer_wheel, cancel_and_reinsert) {
+	wheel_type wheel;
+	wheel.insert(1, 10);
+	wheel.insert(2, 300);
+	EXPECT_TRUE(wheel.cancel(1));
+	EXPECT_FALSE(wheel.cancel(1));
+	wheel.insert(2, 20);
+	EXPECT_EQ(1, wheel.size());
+	std::vector<int> ready = advance_to(wheel, 20);
+	ASSERT_EQ(1, ready.size());
+	EXPECT_EQ(2, ready[0]);
+	EXPECT_TRUE(advance_to(wheel, 1000).empty());
+}